@@ -45,6 +45,8 @@
 #include "MsgTypes.h"
 #include "NWSvcDataServer.h"
 #include "NWCommManager.h"
+#include "NWTimerService.h"
+#include "NWSlabAllocator.h"
 
 static bool gAppInit = false;
 static const char * SVC_DATA_SERVER_NAME = "DATA_SERVER";
@@ -71,6 +73,12 @@ bool Application::init(const char* _cmdLine)
         mainWindow->setWindowEventHandler(this);
     }
 
+    if ( ok )
+    {
+        ok = NWTimerService::staticInit();
+        ASSERT(ok);
+    }
+
     if ( ok )
     {
         ok = MsgMgr::init(0);
@@ -130,6 +138,8 @@ void Application::done()
 
     MsgMgr::done();
 
+    NWTimerService::staticShutdown();
+
     DISPOSE(mGUI);
     for ( std::list<UserNotification*>::iterator it = mUserNotifications.begin() ; it != mUserNotifications.end() ; ++it )
     {
@@ -137,6 +147,8 @@ void Application::done()
         DISPOSE(un);
     }
     mUserNotifications.clear();
+
+    NWSlabAllocator::staticShutdown();
 }
 
 //********************************************************************
@@ -43,6 +43,8 @@
 
 #include "MsgMgrDefs.h"
 #include "MsgMgrAux.h" // zzz temp
+#include "MsgDispatchTable.h"
+#include "NWTimerService.h"
 #include <string>
 
 class NWEvent;
@@ -68,7 +70,7 @@ enum eCommNodeType
 class MsgReceiverCallback
 {
 public:
-    virtual void receiveMessage(CommNodeId _from, int _msgFamily, int _msgType, void * _msg, int _msgSize) = 0;
+    virtual void receiveMessage(CommNodeId _from, int _msgFamily, int _msgType, void const * _msg, int _msgSize) = 0; // _msg is shared with other receivers
 };
 
 //----------------------------------------------------------------------------
@@ -91,16 +93,39 @@ public:
     void exitChannel(ChannelId _channelId);
     void exitAllChannels();
 
-    template <class T> void sendMessage(T const & _msg);
+    template <class T> void sendMessage(T const & _msg, int _priority=MSG_PRIORITY_DEFAULT); // thread safe, any thread can send through the node. Waits for credits (flow control)
+    template <class T> bool trySendMessage(T const & _msg, int _priority=MSG_PRIORITY_DEFAULT); // doesn't send and returns false when a listener is out of credits
+    void sendMessageData(NWBaseMsgInternal * _msgData, int _msgFamily, int _msgType, int _dataLen, int _priority=MSG_PRIORITY_DEFAULT); // msgs created at run time (MsgFactory), takes the reference of _msgData
+    bool trySendMessageData(NWBaseMsgInternal * _msgData, int _msgFamily, int _msgType, int _dataLen, int _priority=MSG_PRIORITY_DEFAULT); // the reference is only taken when it returns true
+
+    // Direct dispatch : binds the node to the calling thread. The msgs it sends from that thread are
+    // delivered synchronously when every listener is also bound to it and has nothing older pending,
+    // otherwise they go through the dispatcher as usual. Nodes mustn't be destroyed from a handler.
+    void setDirectDispatch(bool _enable);
+    bool isDirectDispatchThread() const;
 
     bool waitMessage(int _timeOutMs=COMM_NODE_WAIT_INFINITE);
     bool testMsgAvailable(ChannelId _channelId = InvalidChannelId);
-    bool getAvailableMsg(int & msgFamily_, int & msgType_, void * & msg_, int & msgSize_, ChannelId & msgSenderChannel_, ChannelId _checkChannelId/*=InvalidChannelId*/);
+    bool getAvailableMsg(int & msgFamily_, int & msgType_, void const * & msg_, int & msgSize_, ChannelId & msgSenderChannel_, ChannelId _checkChannelId/*=InvalidChannelId*/);
 
     void addMessageReceiverCallback(MsgReceiverCallback * _receiver, ChannelId _channelId = InvalidChannelId);
     void removeMessageReceiverCallback(MsgReceiverCallback * _receiver, ChannelId _channelId = InvalidChannelId);
     void dispatchAvailableMessages(ChannelId _channelId=InvalidChannelId);
 
+    // Typed receivers, one handler per msg type : node.on<MsgClientSetValue>(this, &Server::onSetValue)
+    // A node with typed handlers and no MsgReceiverCallback only gets the msgs it handles
+    template <class T, class O> bool on(O * _object, void (O::*_fnPtr)(CommNodeId _from, T const & _msg));
+    template <class T> bool on(void (*_fnPtr)(CommNodeId _from, T const & _msg));
+    template <class T> void off();
+
+    // Content filter of the msgs received from a joined channel (types, keys of the keyed msgs).
+    // The rejected msgs are neither stored nor read, NULL removes it. Called from the node thread.
+    bool setChannelFilter(ChannelId _channelId, MsgFilter const * _filter);
+
+    // Timers : callbacks are invoked from dispatchAvailableMessages in the node thread
+    NWTimerId addTimer(int _ms, NWTimerCallback * _callback, void * _userData=NULL, bool _periodic=false);
+    bool removeTimer(NWTimerId _timerId);
+
     inline void setEventMsgAvailable(NWEvent * _eventMsgAvailable);
     inline NWEvent * getEventMsgAvailable();
 
@@ -116,6 +141,9 @@ public:
 
     inline void setReceiveAllMessages(bool _receiveAll){mReceiveAllMessages = _receiveAll;}
 
+    // Priority lanes are drained higher first, a lower priority msg is taken after _maxConsecutive higher ones (0 = strict)
+    inline void setLaneStarvationLimit(int _maxConsecutive);
+
 private:
     friend class MsgMgr;
 
@@ -126,27 +154,55 @@ private:
     bool mEventOwner;
     MsgChannel * mLocalChannel;
     MsgReceiverCallbackList * mMsgReceiverCallbackList;
-    int mSentMsgs;
+    MsgDispatchTable * mDispatchTable;
     bool mAddedNotificationList;
     bool mReceiveAllMessages;
+    NWTimerQueue * mTimerQueue;
+    bool mDirectDispatch;
+    unsigned int mThreadId;
+    int mDirectDepth; // direct dispatches in progress involving the node, only touched from its thread
 
     StoredMsg * addListener(MsgChannel * _listener);
     void removeListener(MsgChannel * _listener);
     inline MsgChannel * getLocalChannel();
     void dispatchMsg(StoredMsg const * _msg, ChannelId _msgFromChannel);
+    void exitEvictedChannels();
+    bool setMsgHandler(int _msgFamily, int _msgType, MsgHandlerBase * _handler);
+    void updateInterest();
+    bool dispatchDirect(StoredMsg const & _msg);
 };
 
-template <class T> void CommNode::sendMessage(T const & _msg)
+template <class T, class O> bool CommNode::on(O * _object, void (O::*_fnPtr)(CommNodeId _from, T const & _msg))
 {
-    mLocalChannel->sendMessage(_msg, mCommNodeId);
+    return setMsgHandler(T::MSG_FAMILY, T::MSG_TYPE, NEW MsgMemberHandler<T, O>(_object, _fnPtr));
+}
 
-    mSentMsgs++;
-    if(mSentMsgs >= NumMaxMsgsDispatched)
+template <class T> bool CommNode::on(void (*_fnPtr)(CommNodeId _from, T const & _msg))
+{
+    return setMsgHandler(T::MSG_FAMILY, T::MSG_TYPE, NEW MsgFnHandler<T>(_fnPtr));
+}
+
+template <class T> void CommNode::off()
+{
+    setMsgHandler(T::MSG_FAMILY, T::MSG_TYPE, NULL);
+}
+
+template <class T> void CommNode::sendMessage(T const & _msg, int _priority/*=MSG_PRIORITY_DEFAULT*/)
+{
+    sendMessageData(NEW T(_msg), T::MSG_FAMILY, T::MSG_TYPE, sizeof(T), _priority);
+}
+
+template <class T> bool CommNode::trySendMessage(T const & _msg, int _priority/*=MSG_PRIORITY_DEFAULT*/)
+{
+    T * msgData = NEW T(_msg); // shared by the direct dispatch and the channel
+
+    bool bRet = trySendMessageData(msgData, T::MSG_FAMILY, T::MSG_TYPE, sizeof(T), _priority);
+    if(!bRet)
     {
-        mSentMsgs = 0;
-        mLocalChannel->waitForListeners();
-        mLocalChannel->purgeSentMsgs();
+        msgData->release(); // not sent, the reference wasn't taken
     }
+
+    return bRet;
 }
 
 inline void CommNode::setEventMsgAvailable(NWEvent * _eventMsgAvailable)
@@ -159,6 +215,11 @@ inline NWEvent * CommNode::getEventMsgAvailable()
     return mEventMsgAvailable;
 }
 
+inline void CommNode::setLaneStarvationLimit(int _maxConsecutive)
+{
+    mLocalChannel->setStarvationLimit(_maxConsecutive);
+}
+
 inline void CommNode::waitDispatcher()
 {
     mLocalChannel->waitForListeners();
@@ -42,6 +42,7 @@
 
 #include "MemBufferRef.h"
 #include "NWCriticalSection.h"
+#include "NWAtomic.h"
 #include <memory.h>
 
 //****************************************************************************
@@ -50,21 +51,29 @@
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-struct sMemBufferData : public RefCount
+struct sMemBufferData
 {
+    long volatile mNumRefs;
     unsigned char * mBuffer;
     int mSize;
+    MemBufferPool * mPool;      // the buffer goes back to it when released
+    IMemBufferOwner * mOwner;   // frees the buffer if it isn't ours
 
     sMemBufferData(int _size);
     sMemBufferData(unsigned char * _buffer, int _size);
+    sMemBufferData(unsigned char * _buffer, int _size, IMemBufferOwner * _owner);
     ~sMemBufferData();
 
-private:
+    inline void addRef();
+    inline void release();
 };
 
-sMemBufferData::sMemBufferData(int _size) : RefCount(),
+sMemBufferData::sMemBufferData(int _size) :
+    mNumRefs(1),
     mBuffer(NULL),
-    mSize(_size)
+    mSize(_size),
+    mPool(NULL),
+    mOwner(NULL)
 {
     if(_size > 0)
     {
@@ -72,9 +81,12 @@ sMemBufferData::sMemBufferData(int _size) : RefCount(),
     }
 }
 
-sMemBufferData::sMemBufferData(unsigned char * _buffer, int _size) : RefCount(),
+sMemBufferData::sMemBufferData(unsigned char * _buffer, int _size) :
+    mNumRefs(1),
     mBuffer(NULL),
-    mSize(_size)
+    mSize(_size),
+    mPool(NULL),
+    mOwner(NULL)
 {
     if(_buffer && _size > 0)
     {
@@ -83,11 +95,47 @@ sMemBufferData::sMemBufferData(unsigned char * _buffer, int _size) : RefCount(),
     }
 }
 
+sMemBufferData::sMemBufferData(unsigned char * _buffer, int _size, IMemBufferOwner * _owner) :
+    mNumRefs(1),
+    mBuffer(_buffer),
+    mSize(_size),
+    mPool(NULL),
+    mOwner(_owner)
+{
+}
+
 sMemBufferData::~sMemBufferData()
 {
+    if(mOwner)
+    {
+        mOwner->freeMemBuffer(mBuffer, mSize);
+        mBuffer = NULL;
+    }
     DISPOSE_ARRAY(mBuffer);
 }
 
+inline void sMemBufferData::addRef()
+{
+    NWAtomic::increment(&mNumRefs);
+}
+
+inline void sMemBufferData::release()
+{
+    ASSERT(mNumRefs > 0);
+
+    if(NWAtomic::decrement(&mNumRefs) == 0)
+    {
+        if(mPool)
+        {
+            mPool->recycle(this);
+        }
+        else
+        {
+            delete this;
+        }
+    }
+}
+
 //****************************************************************************
 //
 //****************************************************************************
@@ -95,19 +143,21 @@ sMemBufferData::~sMemBufferData()
 //
 //----------------------------------------------------------------------------
 MemBufferRef::MemBufferRef() :
-    mData(NULL)
+    mData(NULL),
+    mOffset(0),
+    mSize(0)
 {
-    mCritSec = NWCriticalSection::create();
 }
 
 MemBufferRef::MemBufferRef(int _size) :
-    mData(NULL)
+    mData(NULL),
+    mOffset(0),
+    mSize(0)
 {
-    mCritSec = NWCriticalSection::create();
-
     if(_size > 0)
     {
         mData = NEW sMemBufferData(_size);
+        mSize = _size;
     }
 }
 
@@ -115,13 +165,45 @@ MemBufferRef::MemBufferRef(int _size) :
 //
 //----------------------------------------------------------------------------
 MemBufferRef::MemBufferRef(unsigned char * _buffer, int _size) :
-    mData(NULL)
+    mData(NULL),
+    mOffset(0),
+    mSize(0)
 {
-    mCritSec = NWCriticalSection::create();
-
     if(_buffer && _size > 0)
     {
         mData = NEW sMemBufferData(_buffer, _size);
+        mSize = _size;
+    }
+}
+
+//----------------------------------------------------------------------------
+// No copy, _owner gets the buffer back with the last reference (even an
+// empty one)
+//----------------------------------------------------------------------------
+MemBufferRef::MemBufferRef(unsigned char * _buffer, int _size, IMemBufferOwner * _owner) :
+    mData(NULL),
+    mOffset(0),
+    mSize(0)
+{
+    ASSERT(_owner);
+
+    mData = NEW sMemBufferData(_buffer, _size, _owner);
+    mSize = _size;
+}
+
+//----------------------------------------------------------------------------
+// The view keeps the whole buffer of _other alive
+//----------------------------------------------------------------------------
+MemBufferRef::MemBufferRef(MemBufferRef const & _other, int _offset, int _size) :
+    mData(NULL),
+    mOffset(0),
+    mSize(0)
+{
+    ASSERT(_offset >= 0 && _size >= 0 && _offset + _size <= _other.mSize);
+
+    if(_other.mData && _size > 0)
+    {
+        setData(_other.mData, _other.mOffset + _offset, _size);
     }
 }
 
@@ -130,83 +212,229 @@ MemBufferRef::MemBufferRef(unsigned char * _buffer, int _size) :
 //----------------------------------------------------------------------------
 /*virtual*/ MemBufferRef::~MemBufferRef()
 {
-    mCritSec->enter();
+    if(mData)
     {
-        if(mData)
-        {
-            if(mData->release(false) == 0)
-            {
-                DISPOSE(mData);
-            }
-        }
+        mData->release();
     }
-    mCritSec->leave();
-    
-    NWCriticalSection::destroy(mCritSec);
 }
 
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-MemBufferRef::MemBufferRef(MemBufferRef const & _other)
+MemBufferRef::MemBufferRef(MemBufferRef const & _other) :
+    mData(NULL),
+    mOffset(0),
+    mSize(0)
 {
-    mCritSec = NWCriticalSection::create();
+    setData(_other.mData, _other.mOffset, _other.mSize);
+}
 
-    NWAutoCritSec autoCS(mCritSec);
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MemBufferRef& MemBufferRef::operator = (MemBufferRef const & _other)
+{
+    if(this != &_other)
+    {
+        setData(_other.mData, _other.mOffset, _other.mSize);
+    }
 
-    mData = _other.mData;
-    if(mData)
-        mData->addRef();
+    return *this;
 }
 
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-MemBufferRef& MemBufferRef::operator = (MemBufferRef const & _other)
+void MemBufferRef::CloneBuffer(unsigned char * _buffer, int _size)
 {
-    NWAutoCritSec autoCS(mCritSec);
+    if(_buffer && _size > 0)
+    {
+        sMemBufferData * data = NEW sMemBufferData(_buffer, _size);
+        setData(data, 0, _size);
+        data->release(); // setData took its own reference
+    }
+}
 
-    if(mData)
-        mData->release();
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+unsigned char * MemBufferRef::getPtr() const
+{
+    return mData ? mData->mBuffer + mOffset : NULL;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int MemBufferRef::getSize() const
+{
+    return mSize;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int MemBufferRef::getOffset() const
+{
+    return mOffset;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+IMemBufferOwner * MemBufferRef::getOwner() const
+{
+    return mData ? mData->mOwner : NULL;
+}
 
-    mData = _other.mData;
+//----------------------------------------------------------------------------
+// The new data is referenced before the old one is released, _data may be
+// the current one
+//----------------------------------------------------------------------------
+void MemBufferRef::setData(sMemBufferData * _data, int _offset, int _size)
+{
+    if(_data)
+        _data->addRef();
 
     if(mData)
-        mData->addRef();
+        mData->release();
 
-    return *this;
+    mData = _data;
+    mOffset = _data ? _offset : 0;
+    mSize = _data ? _size : 0;
 }
 
+//****************************************************************************
+//
+//****************************************************************************
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-void MemBufferRef::CloneBuffer(unsigned char * _buffer, int _size)
+/*static*/ MemBufferPool * MemBufferPool::create(int _bufferSize, int _maxFree)
 {
-    if(_buffer && _size > 0)
+    return NEW MemBufferPool(_bufferSize, _maxFree);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ void MemBufferPool::destroy(MemBufferPool* & _pool)
+{
+    if(_pool)
     {
-        if(mData)
-            mData->release();
+        std::vector<sMemBufferData *> freeList;
 
-        mData = NEW sMemBufferData(_buffer, _size);
+        _pool->mCritSec->enter();
+        {
+            _pool->mDestroyed = true;
+            freeList.swap(_pool->mFree);
+        }
+        _pool->mCritSec->leave();
+
+        for(int i=0; i<(int)freeList.size(); i++)
+        {
+            freeList[i]->mPool = NULL;
+            DISPOSE(freeList[i]);
+        }
+
+        _pool->release();
+        _pool = NULL;
     }
 }
 
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-unsigned char * MemBufferRef::getPtr() const
+MemBufferPool::MemBufferPool(int _bufferSize, int _maxFree) :
+    mBufferSize(_bufferSize),
+    mMaxFree(_maxFree),
+    mNumRefs(1),
+    mDestroyed(false)
 {
-    NWAutoCritSec autoCS(mCritSec);
+    ASSERT(_bufferSize > 0);
 
-    return mData ? mData->mBuffer : NULL;
+    mCritSec = NWCriticalSection::create();
+    mFree.reserve(_maxFree);
 }
 
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-int MemBufferRef::getSize() const
+MemBufferPool::~MemBufferPool()
 {
-    NWAutoCritSec autoCS(mCritSec);
+    ASSERT(mFree.empty());
 
-    return mData ? mData->mSize : 0;
+    NWCriticalSection::destroy(mCritSec);
+}
+
+//----------------------------------------------------------------------------
+// The buffer isn't cleared
+//----------------------------------------------------------------------------
+MemBufferRef MemBufferPool::alloc()
+{
+    sMemBufferData * data = NULL;
+
+    mCritSec->enter();
+    {
+        if(!mFree.empty())
+        {
+            data = mFree.back();
+            mFree.pop_back();
+        }
+    }
+    mCritSec->leave();
+
+    if(data)
+    {
+        data->mNumRefs = 1;
+    }
+    else
+    {
+        data = NEW sMemBufferData(mBufferSize);
+        data->mPool = this;
+    }
+    NWAtomic::increment(&mNumRefs);
+
+    MemBufferRef memBuff;
+    memBuff.setData(data, 0, mBufferSize);
+    data->release(); // memBuff took its own reference
+
+    return memBuff;
+}
+
+//----------------------------------------------------------------------------
+// Last reference of a buffer of the pool released
+//----------------------------------------------------------------------------
+void MemBufferPool::recycle(sMemBufferData * _data)
+{
+    bool bKept = false;
+
+    mCritSec->enter();
+    {
+        if(!mDestroyed && (int)mFree.size() < mMaxFree)
+        {
+            mFree.push_back(_data);
+            bKept = true;
+        }
+    }
+    mCritSec->leave();
+
+    if(!bKept)
+    {
+        _data->mPool = NULL;
+        DISPOSE(_data);
+    }
+
+    release();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MemBufferPool::release()
+{
+    if(NWAtomic::decrement(&mNumRefs) == 0)
+    {
+        delete this;
+    }
 }
@@ -1,73 +1,135 @@
-/*       
-*       This file is part of NWFramework.
-*       Copyright (c) InCrew Software and Others.
-*       (See the AUTHORS file in the root of this distribution.)
-*
-*       NWFramework is free software; you can redistribute it and/or modify
-*       it under the terms of the GNU General Public License as published by
-*       the Free Software Foundation; either version 2 of the License, or
-*       (at your option) any later version.
-*
-*       NWFramework is distributed in the hope that it will be useful,
-*       but WITHOUT ANY WARRANTY; without even the implied warranty of
-*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
-*       GNU General Public License for more details.
-* 
-*       You should have received a copy of the GNU General Public License
-*       along with NWFramework; if not, write to the Free Software
-*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
-*
-*      Permission is hereby granted, free of charge, to any person obtaining
-*      a copy of this software and associated documentation files (the
-*      "Software"), to deal in the Software without restriction, including
-*      without limitation the rights to use, copy, modify, merge, publish,
-*      distribute, sublicense, and/or sell copies of the Software, and to
-*      permit persons to whom the Software is furnished to do so, subject to
-*      the following conditions:
-*
-*      The above copyright notice and this permission notice shall be
-*      included in all copies or substantial portions of the Software.
-*
-*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
-*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
-*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
-*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
-*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
-*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
-*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-*/
-
-
-#ifndef _MEM_BUFFER_REF_H_
-#define _MEM_BUFFER_REF_H_
-
-#include "RefCount.h"
-
-struct sMemBufferData;
-class NWCriticalSection;
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-class MemBufferRef
-{
-public:
-    MemBufferRef();
-    explicit MemBufferRef(int _size);
-    MemBufferRef(unsigned char * _buffer, int _size);
-    virtual ~MemBufferRef();
-
-    MemBufferRef(MemBufferRef const & _other);
-    MemBufferRef& operator = (MemBufferRef const & _other);
-
-    void CloneBuffer(unsigned char * _buffer, int _size);
-
-    unsigned char * getPtr() const;
-    int getSize() const;
-
-private:
-    sMemBufferData * mData;
-    NWCriticalSection * mCritSec;
-};
-
-#endif _MEM_BUFFER_REF_H_
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _MEM_BUFFER_REF_H_
+#define _MEM_BUFFER_REF_H_
+
+#include <vector>
+
+struct sMemBufferData;
+class MemBufferPool;
+class NWCriticalSection;
+
+//----------------------------------------------------------------------------
+// Memory a MemBufferRef takes without copying it (a mapping...), given back
+// to its owner with the last reference
+//----------------------------------------------------------------------------
+class IMemBufferOwner
+{
+public:
+    virtual ~IMemBufferOwner() {}
+
+    virtual void freeMemBuffer(unsigned char * _buffer, int _size) = 0;
+    virtual int getFd() const { return -1; }   // descriptor other processes can map the memory from, -1 if none
+};
+
+//----------------------------------------------------------------------------
+// Shared buffer, the copies and the views share the data and the last one
+// frees it. The count is atomic so the copies can go to other threads, a
+// single MemBufferRef must not be changed from two threads at a time.
+//----------------------------------------------------------------------------
+class MemBufferRef
+{
+public:
+    MemBufferRef();
+    explicit MemBufferRef(int _size);
+    MemBufferRef(unsigned char * _buffer, int _size);
+    MemBufferRef(unsigned char * _buffer, int _size, IMemBufferOwner * _owner); // takes _buffer, _owner frees it
+    MemBufferRef(MemBufferRef const & _other, int _offset, int _size); // view of a part of _other
+    virtual ~MemBufferRef();
+
+    MemBufferRef(MemBufferRef const & _other);
+    MemBufferRef& operator = (MemBufferRef const & _other);
+
+    void CloneBuffer(unsigned char * _buffer, int _size);
+
+    unsigned char * getPtr() const;
+    int getSize() const;
+    int getOffset() const;                  // of the view in the whole buffer
+    IMemBufferOwner * getOwner() const;     // NULL if the buffer is ours
+
+private:
+    friend class MemBufferPool;
+
+    sMemBufferData * mData;
+    int mOffset;
+    int mSize;
+
+    void setData(sMemBufferData * _data, int _offset, int _size);
+};
+
+//----------------------------------------------------------------------------
+// Buffers of a fixed size, a released buffer goes back to the pool. The
+// buffers still in use when the pool is destroyed keep it alive until they
+// are released. Thread safe.
+//----------------------------------------------------------------------------
+class MemBufferPool
+{
+public:
+    static MemBufferPool * create(int _bufferSize, int _maxFree);
+    static void destroy(MemBufferPool* & _pool);
+
+    MemBufferRef alloc();
+    inline int getBufferSize() const;
+
+private:
+    friend class MemBufferRef;
+    friend struct sMemBufferData;
+
+    int mBufferSize;
+    int mMaxFree;
+    long volatile mNumRefs; // the owner plus the buffers in use
+    bool mDestroyed;
+    NWCriticalSection * mCritSec;
+    std::vector<sMemBufferData *> mFree;
+
+    MemBufferPool(int _bufferSize, int _maxFree);
+    ~MemBufferPool();
+
+    void recycle(sMemBufferData * _data);
+    void release();
+};
+
+inline int MemBufferPool::getBufferSize() const
+{
+    return mBufferSize;
+}
+
+#endif // _MEM_BUFFER_REF_H_
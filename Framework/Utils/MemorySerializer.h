@@ -42,6 +42,9 @@
 #define _MEMORY_SERIALIZER_H_
 
 #include "Serializer.h"
+#include "NWIoVec.h"
+
+#include <vector>
 
 struct SerializerBlockList;
 class MemBufferRef;
@@ -74,8 +77,9 @@ public:
 
     virtual void finalize();
 
-    unsigned char * getBufferPtr(int & _outBufferSize);
-    MemBufferRef getMemBuffer();
+    unsigned char * getBufferPtr(int & _outBufferSize);   // a copy the caller owns
+    MemBufferRef getMemBuffer();                            // copied once, not at all if it fits in a block
+    int getIoVecs(std::vector<NWIoVec> & out_vecs);         // the blocks, valid while the serializer lives. Returns the total size
 
 private:
     typedef SerializerOut Inherited;
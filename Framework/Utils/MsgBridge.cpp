@@ -0,0 +1,838 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "MsgBridge.h"
+#include "CommNode.h"
+#include "MemorySerializer.h"
+#include "MemBufferRef.h"
+#include "NWSharedMemory.h"
+#include "NWEvent.h"
+#include "NWMultipleEvents.h"
+#include "NWAtomic.h"
+
+#include "MemoryUtils.h"
+
+#include "Log.h"
+
+#include <windows.h>
+#include <string.h>
+#include <deque>
+
+//****************************************************************************
+// Shared segments layout
+//****************************************************************************
+enum eMsgBridgeSlotState
+{
+    MSG_BRIDGE_SLOT_FREE = 0,   // the segments are zero filled
+    MSG_BRIDGE_SLOT_WRITING,
+    MSG_BRIDGE_SLOT_READY
+};
+
+struct MsgBridgeRegistrySlot
+{
+    long volatile mState; // eMsgBridgeSlotState
+    u32 mHash;
+    char mName[MsgBridgeMaxChannelName];
+};
+
+struct MsgBridgeRegistry
+{
+    MsgBridgeRegistrySlot mSlots[MsgBridgeRegistrySlots]; // open addressing, the slots are never freed
+};
+
+//----------------------------------------------------------------------------
+// Ring header, followed by its data. The counters only grow, the offsets
+// are taken modulo the ring size
+//----------------------------------------------------------------------------
+struct MsgBridgeRing
+{
+    long volatile mTail; // bytes written, only moved by the writer
+    u8 mPadTail[64 - sizeof(long)];
+    long volatile mHead; // bytes read, only moved by the reader
+    u8 mPadHead[64 - sizeof(long)];
+    long volatile mReaderWaiting; // set by the reader before sleeping on an empty ring
+    long volatile mWriterWaiting; // set by the writer before sleeping on a full ring
+    u8 mPadFlags[64 - 2*sizeof(long)];
+};
+
+//----------------------------------------------------------------------------
+// Segment of a pair of processes, followed by the ring written by the
+// process with the lower name and the ring written by the other one
+//----------------------------------------------------------------------------
+struct MsgBridgePair
+{
+    long volatile mRingSize; // set by the first process connecting
+    u8 mPad[64 - sizeof(long)];
+};
+
+//----------------------------------------------------------------------------
+// Frames never wrap around the end of the ring, the space left there is
+// skipped with a wrap mark. They are 4 bytes aligned
+//----------------------------------------------------------------------------
+enum
+{
+    MsgBridgeFrameWrap = 0xffffffff
+};
+
+struct MsgBridgeFrame
+{
+    u32 mSize; // payload bytes, or MsgBridgeFrameWrap
+    u32 mChannelSlot;
+    s32 mMsgFamily;
+    s32 mMsgType;
+};
+
+static inline u32 getFrameBytes(u32 _payloadSize)
+{
+    return (sizeof(MsgBridgeFrame) + _payloadSize + 3) & ~3u;
+}
+
+static u32 hashChannelName(const char * _channelName)
+{
+    u32 hash = 2166136261u; // FNV-1a
+
+    for(const char * c=_channelName; *c; c++)
+    {
+        hash = (hash ^ (u8)*c) * 16777619u;
+    }
+
+    return hash;
+}
+
+//****************************************************************************
+// A mirrored channel, its CommNode reads the local msgs and sends the ones
+// coming from the peers
+//****************************************************************************
+struct MsgBridgeChannel : public MsgReceiverCallback
+{
+    MsgBridge * mBridge;
+    int mSlot;
+    CommNode mCommNode;
+
+    MsgBridgeChannel(MsgBridge * _bridge, int _slot);
+
+    virtual void receiveMessage(CommNodeId _from, int _msgFamily, int _msgType, void const * _msg, int _msgSize);
+};
+
+MsgBridgeChannel::MsgBridgeChannel(MsgBridge * _bridge, int _slot) :
+    mBridge(_bridge),
+    mSlot(_slot)
+{
+}
+
+/*virtual*/ void MsgBridgeChannel::receiveMessage(CommNodeId _from, int _msgFamily, int _msgType, void const * _msg, int _msgSize)
+{
+    mBridge->sendToPeers(this, _msgFamily, _msgType, static_cast<NWBaseMsgInternal const *>(_msg));
+}
+
+//****************************************************************************
+// A connected process
+//****************************************************************************
+struct MsgBridgePeer
+{
+    std::string mName;
+    NWSharedMemory * mMemory;
+    MsgBridgeRing * mRingOut;
+    unsigned char * mDataOut;
+    MsgBridgeRing * mRingIn;
+    unsigned char * mDataIn;
+    NWEvent * mEventWakeUp; // the one of the peer
+    std::deque<MemBufferRef> mPendingFrames; // frames that didn't fit in the ring, in order
+    bool mCreditStalled; // the next frame read waits for credits of its channel
+
+    MsgBridgePeer();
+};
+
+MsgBridgePeer::MsgBridgePeer() :
+    mMemory(NULL),
+    mRingOut(NULL),
+    mDataOut(NULL),
+    mRingIn(NULL),
+    mDataIn(NULL),
+    mEventWakeUp(NULL),
+    mCreditStalled(false)
+{
+}
+
+//****************************************************************************
+// MsgBridge
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgBridge::MsgBridge() :
+    mInitd(false),
+    mCommNodeId(InvalidCommNodeID),
+    mRingSize(0),
+    mRegistryMemory(NULL),
+    mRegistry(NULL),
+    mEventMsgsAvailable(NULL),
+    mEventWakeUp(NULL),
+    mThread(NULL)
+{
+    memset(&mMetrics, 0, sizeof(mMetrics));
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ MsgBridge::~MsgBridge()
+{
+    done();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgBridge::init(const char * _processName, CommNodeId _commNodeId, u32 _ringSize/*=MsgBridgeDefaultRingSize*/)
+{
+    bool bRet = false;
+
+    ASSERT(_processName && *_processName);
+    ASSERT(_ringSize >= 4096 && (_ringSize & (_ringSize - 1)) == 0);
+
+    if(!mInitd && _processName && *_processName && _ringSize >= 4096 && (_ringSize & (_ringSize - 1)) == 0)
+    {
+        mRegistryMemory = NWSharedMemory::create("NWMsgBridge_Registry", sizeof(MsgBridgeRegistry));
+        if(mRegistryMemory)
+        {
+            mProcessName = _processName;
+            mCommNodeId = _commNodeId;
+            mRingSize = _ringSize;
+            mRegistry = (MsgBridgeRegistry *)mRegistryMemory->getPtr();
+            mChannelsBySlot.resize(MsgBridgeRegistrySlots, NULL);
+
+            std::string wakeUpName = "NWMsgBridge_" + mProcessName + "_wake";
+            mEventMsgsAvailable = NWEvent::create();
+            mEventWakeUp = NWEvent::create(false, false, wakeUpName.c_str());
+
+            memset(&mMetrics, 0, sizeof(mMetrics));
+
+            mInitd = true;
+            bRet = true;
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgBridge::done()
+{
+    if(mInitd)
+    {
+        stop();
+
+        for(int i=0; i<(int)mChannels.size(); i++)
+        {
+            mChannels[i]->mCommNode.done();
+            DISPOSE(mChannels[i]);
+        }
+        mChannels.clear();
+        mChannelsBySlot.clear();
+
+        for(int i=0; i<(int)mPeers.size(); i++)
+        {
+            NWSharedMemory::destroy(mPeers[i]->mMemory);
+            NWEvent::destroy(mPeers[i]->mEventWakeUp);
+            DISPOSE(mPeers[i]);
+        }
+        mPeers.clear();
+
+        NWEvent::destroy(mEventMsgsAvailable);
+        NWEvent::destroy(mEventWakeUp);
+
+        mRegistry = NULL;
+        NWSharedMemory::destroy(mRegistryMemory);
+
+        mFactory.clear();
+
+        mInitd = false;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgBridge::mirrorChannel(const char * _channelName)
+{
+    bool bRet = false;
+
+    ASSERT(mInitd && mThread == NULL);
+
+    if(mInitd && mThread == NULL)
+    {
+        int slot = registerChannelName(_channelName);
+        if(slot >= 0 && mChannelsBySlot[slot] == NULL)
+        {
+            MsgBridgeChannel * channel = NEW MsgBridgeChannel(this, slot);
+
+            std::string nodeName = std::string("MsgBridge_") + _channelName;
+            if(channel->mCommNode.init(mCommNodeId, nodeName.c_str(), 1, 1, mEventMsgsAvailable) &&
+               channel->mCommNode.joinChannel(_channelName) != InvalidChannelId)
+            {
+                channel->mCommNode.addMessageReceiverCallback(channel);
+
+                mChannels.push_back(channel);
+                mChannelsBySlot[slot] = channel;
+                bRet = true;
+            }
+            else
+            {
+                channel->mCommNode.done();
+                DISPOSE(channel);
+            }
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Both processes map the same segment, the one with the lower name writes
+// the first ring
+//----------------------------------------------------------------------------
+bool MsgBridge::connectPeer(const char * _peerProcessName)
+{
+    bool bRet = false;
+
+    ASSERT(mInitd && mThread == NULL);
+
+    if(mInitd && mThread == NULL && _peerProcessName && *_peerProcessName && mProcessName != _peerProcessName)
+    {
+        std::string peerName = _peerProcessName;
+        bool bLower = mProcessName < peerName;
+        std::string pairName = "NWMsgBridge_" + (bLower ? mProcessName + "_" + peerName : peerName + "_" + mProcessName);
+
+        u32 ringBytes = sizeof(MsgBridgeRing) + mRingSize;
+        NWSharedMemory * memory = NWSharedMemory::create(pairName.c_str(), sizeof(MsgBridgePair) + 2*ringBytes);
+        if(memory)
+        {
+            MsgBridgePair * pair = (MsgBridgePair *)memory->getPtr();
+            long ringSize = NWAtomic::compareExchange(&pair->mRingSize, (long)mRingSize, 0);
+            if(ringSize == 0 || ringSize == (long)mRingSize)
+            {
+                unsigned char * firstRing = (unsigned char *)(pair + 1);
+                unsigned char * secondRing = firstRing + ringBytes;
+
+                MsgBridgePeer * peer = NEW MsgBridgePeer();
+                peer->mName = peerName;
+                peer->mMemory = memory;
+                peer->mRingOut = (MsgBridgeRing *)(bLower ? firstRing : secondRing);
+                peer->mDataOut = (unsigned char *)(peer->mRingOut + 1);
+                peer->mRingIn = (MsgBridgeRing *)(bLower ? secondRing : firstRing);
+                peer->mDataIn = (unsigned char *)(peer->mRingIn + 1);
+
+                std::string wakeUpName = "NWMsgBridge_" + peerName + "_wake";
+                peer->mEventWakeUp = NWEvent::create(false, false, wakeUpName.c_str());
+
+                mPeers.push_back(peer);
+                bRet = true;
+            }
+            else
+            {
+                LOG("MsgBridge : %s uses rings of %d bytes, %d expected", peerName.c_str(), ringSize, mRingSize);
+                NWSharedMemory::destroy(memory);
+            }
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgBridge::start()
+{
+    bool bRet = false;
+
+    ASSERT(mInitd);
+
+    if(mInitd && mThread == NULL)
+    {
+        mThread = NWThread::create();
+        bRet = mThread->start(this);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgBridge::stop()
+{
+    if(mThread)
+    {
+        mThread->requestEnd();
+        mThread->waitForEnd();
+        NWThread::destroy(mThread);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Written by the bridge thread, approximate while it runs
+//----------------------------------------------------------------------------
+void MsgBridge::getMetrics(MsgBridgeMetrics & metrics_) const
+{
+    metrics_ = mMetrics;
+}
+
+//----------------------------------------------------------------------------
+// Lock free : a slot is claimed with a CAS and published once its name is
+// written, the names are never removed
+//----------------------------------------------------------------------------
+int MsgBridge::registerChannelName(const char * _channelName)
+{
+    int iRet = -1;
+
+    size_t nameLen = _channelName ? strlen(_channelName) : 0;
+    if(nameLen > 0 && nameLen < MsgBridgeMaxChannelName)
+    {
+        u32 hash = hashChannelName(_channelName);
+        int firstSlot = (int)(hash % MsgBridgeRegistrySlots);
+
+        for(int i=0; i<MsgBridgeRegistrySlots && iRet < 0; i++)
+        {
+            int slotIndex = (firstSlot + i) % MsgBridgeRegistrySlots;
+            MsgBridgeRegistrySlot * slot = &mRegistry->mSlots[slotIndex];
+
+            if(NWAtomic::compareExchange(&slot->mState, MSG_BRIDGE_SLOT_WRITING, MSG_BRIDGE_SLOT_FREE) == MSG_BRIDGE_SLOT_FREE)
+            {
+                slot->mHash = hash;
+                memcpy(slot->mName, _channelName, nameLen + 1);
+                NWAtomic::exchange(&slot->mState, MSG_BRIDGE_SLOT_READY);
+                iRet = slotIndex;
+            }
+            else
+            {
+                while(slot->mState == MSG_BRIDGE_SLOT_WRITING)
+                {
+                    Sleep(0);
+                }
+
+                if(slot->mHash == hash && strcmp(slot->mName, _channelName) == 0)
+                {
+                    iRet = slotIndex;
+                }
+            }
+        }
+    }
+
+    if(iRet < 0)
+    {
+        LOG("MsgBridge : can't register the channel %s", _channelName ? _channelName : "");
+    }
+
+    return iRet;
+}
+
+//****************************************************************************
+// Outbound
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Serialized once, the same payload is copied in the ring of every peer
+//----------------------------------------------------------------------------
+void MsgBridge::sendToPeers(MsgBridgeChannel * _channel, int _msgFamily, int _msgType, NWBaseMsgInternal const * _msg)
+{
+    if(!mPeers.empty())
+    {
+        MemorySerializerOut serializerOut;
+
+        if(_msg->serializeOut(serializerOut))
+        {
+            int payloadSize = 0;
+            unsigned char * payload = serializerOut.getBufferPtr(payloadSize);
+
+            if(getFrameBytes(payloadSize) <= mRingSize/4)
+            {
+                MsgBridgeFrame frame;
+                frame.mSize = payloadSize;
+                frame.mChannelSlot = _channel->mSlot;
+                frame.mMsgFamily = _msgFamily;
+                frame.mMsgType = _msgType;
+
+                for(int i=0; i<(int)mPeers.size(); i++)
+                {
+                    MsgBridgePeer * peer = mPeers[i];
+
+                    if(!peer->mPendingFrames.empty() || !writeFrame(peer, (unsigned char const *)&frame, payload, payloadSize))
+                    {
+                        MemBufferRef pendingFrame(sizeof(frame) + payloadSize);
+                        memcpy(pendingFrame.getPtr(), &frame, sizeof(frame));
+                        if(payloadSize > 0)
+                        {
+                            memcpy(pendingFrame.getPtr() + sizeof(frame), payload, payloadSize);
+                        }
+
+                        peer->mPendingFrames.push_back(pendingFrame);
+                        mMetrics.mRingFullWaits++;
+                    }
+                }
+
+                mMetrics.mMsgsOut++;
+                mMetrics.mBytesOut += payloadSize;
+            }
+            else
+            {
+                LOG("MsgBridge : msg 0x%08X:0x%08X of %d bytes is too big for the rings", _msgFamily, _msgType, payloadSize);
+                mMetrics.mOversizedMsgs++;
+            }
+
+            if(payload)
+            {
+                DISPOSE_ARRAY(payload);
+            }
+        }
+        else
+        {
+            mMetrics.mNotSerializableMsgs++;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgBridge::writeFrame(MsgBridgePeer * _peer, unsigned char const * _header, unsigned char const * _payload, u32 _payloadSize)
+{
+    MsgBridgeRing * ring = _peer->mRingOut;
+
+    u32 frameBytes = getFrameBytes(_payloadSize);
+    u32 tail = (u32)ring->mTail;
+    u32 head = (u32)ring->mHead;
+    u32 offset = tail & (mRingSize - 1);
+    u32 contiguous = mRingSize - offset;
+    u32 needed = (frameBytes <= contiguous) ? frameBytes : contiguous + frameBytes;
+
+    bool bRet = mRingSize - (tail - head) >= needed;
+    if(bRet)
+    {
+        if(frameBytes > contiguous)
+        {
+            ((MsgBridgeFrame *)(_peer->mDataOut + offset))->mSize = MsgBridgeFrameWrap;
+            tail += contiguous;
+            offset = 0;
+        }
+
+        memcpy(_peer->mDataOut + offset, _header, sizeof(MsgBridgeFrame));
+        if(_payloadSize > 0)
+        {
+            memcpy(_peer->mDataOut + offset + sizeof(MsgBridgeFrame), _payload, _payloadSize);
+        }
+
+        NWAtomic::exchange(&ring->mTail, (long)(tail + frameBytes)); // full barrier, published before the flag is read
+        wakeUpPeer(_peer, &ring->mReaderWaiting);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgBridge::flushPendingFrames()
+{
+    for(int i=0; i<(int)mPeers.size(); i++)
+    {
+        MsgBridgePeer * peer = mPeers[i];
+
+        bool bWritten = true;
+        while(bWritten && !peer->mPendingFrames.empty())
+        {
+            unsigned char const * frame = peer->mPendingFrames.front().getPtr();
+            u32 payloadSize = ((MsgBridgeFrame const *)frame)->mSize;
+
+            bWritten = writeFrame(peer, frame, frame + sizeof(MsgBridgeFrame), payloadSize);
+            if(bWritten)
+            {
+                peer->mPendingFrames.pop_front();
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int MsgBridge::getNumPendingFrames() const
+{
+    int numFrames = 0;
+
+    for(int i=0; i<(int)mPeers.size(); i++)
+    {
+        numFrames += (int)mPeers[i]->mPendingFrames.size();
+    }
+
+    return numFrames;
+}
+
+//****************************************************************************
+// Inbound
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgBridge::isCreditStalled() const
+{
+    bool bRet = false;
+
+    for(int i=0; i<(int)mPeers.size() && !bRet; i++)
+    {
+        bRet = mPeers[i]->mCreditStalled;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgBridge::readPeer(MsgBridgePeer * _peer)
+{
+    MsgBridgeRing * ring = _peer->mRingIn;
+
+    u32 head = (u32)ring->mHead;
+    u32 tail = (u32)ring->mTail;
+    int numFrames = 0;
+
+    _peer->mCreditStalled = false;
+
+    while(head != tail && numFrames < MsgBridgeMaxFramesPerPass && !_peer->mCreditStalled)
+    {
+        u32 offset = head & (mRingSize - 1);
+        MsgBridgeFrame const * frame = (MsgBridgeFrame const *)(_peer->mDataIn + offset);
+
+        if(frame->mSize == MsgBridgeFrameWrap)
+        {
+            head += mRingSize - offset;
+        }
+        else if(getFrameBytes(frame->mSize) > mRingSize - offset || getFrameBytes(frame->mSize) > tail - head)
+        {
+            LOG("MsgBridge : corrupted frame from %s, its msgs are discarded", _peer->mName.c_str());
+            ASSERT(false);
+            head = tail;
+        }
+        else if(receiveFrame((unsigned char const *)frame))
+        {
+            head += getFrameBytes(frame->mSize);
+            numFrames++;
+        }
+        else
+        {
+            _peer->mCreditStalled = true;
+        }
+    }
+
+    if(head != (u32)ring->mHead)
+    {
+        NWAtomic::exchange(&ring->mHead, (long)head);
+        wakeUpPeer(_peer, &ring->mWriterWaiting);
+    }
+}
+
+//----------------------------------------------------------------------------
+// The msgs of channels not mirrored in this process are skipped. The payload
+// is copied out of the ring before being read, the serializer clears its
+// buffer when a msg reads past its end
+//----------------------------------------------------------------------------
+bool MsgBridge::receiveFrame(unsigned char const * _frame)
+{
+    bool bRet = true;
+
+    MsgBridgeFrame const * frame = (MsgBridgeFrame const *)_frame;
+    MsgBridgeChannel * channel = (frame->mChannelSlot < mChannelsBySlot.size()) ? mChannelsBySlot[frame->mChannelSlot] : NULL;
+
+    if(channel)
+    {
+        int msgSize = 0;
+        NWBaseMsgInternal * msg = mFactory.createMsg(frame->mMsgFamily, frame->mMsgType, msgSize);
+
+        bool bValid = msg != NULL;
+        if(bValid && frame->mSize > 0)
+        {
+            mReadBuffer.assign(_frame + sizeof(MsgBridgeFrame), _frame + sizeof(MsgBridgeFrame) + frame->mSize);
+
+            MemorySerializerIn serializerIn;
+            serializerIn.setBuffer(&mReadBuffer[0], (int)frame->mSize);
+            bValid = msg->serializeIn(serializerIn);
+        }
+
+        if(bValid)
+        {
+            bRet = channel->mCommNode.trySendMessageData(msg, frame->mMsgFamily, frame->mMsgType, msgSize);
+            if(bRet)
+            {
+                mMetrics.mMsgsIn++;
+                mMetrics.mBytesIn += frame->mSize;
+            }
+            else
+            {
+                msg->release(); // read again once the channel has credits
+            }
+        }
+        else
+        {
+            mMetrics.mUnknownMsgs++;
+
+            if(msg)
+            {
+                msg->release();
+            }
+        }
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+// Wake ups
+//****************************************************************************
+//----------------------------------------------------------------------------
+// A side sets its flag and checks the ring again before sleeping, the other
+// one moves the counter before testing the flag : one of them sees the other
+//----------------------------------------------------------------------------
+bool MsgBridge::prepareWait(unsigned int & waitMs_)
+{
+    bool bRet = true;
+
+    waitMs_ = NWME_INFINITE;
+
+    for(int i=0; i<(int)mPeers.size(); i++)
+    {
+        MsgBridgePeer * peer = mPeers[i];
+
+        if(peer->mCreditStalled)
+        {
+            waitMs_ = MsgBridgeCreditRetryMs; // the local channels don't signal their credits to the bridge
+        }
+        else
+        {
+            NWAtomic::exchange(&peer->mRingIn->mReaderWaiting, 1);
+            if(peer->mRingIn->mTail != peer->mRingIn->mHead)
+            {
+                bRet = false;
+            }
+        }
+
+        if(!peer->mPendingFrames.empty())
+        {
+            NWAtomic::exchange(&peer->mRingOut->mWriterWaiting, 1);
+
+            u32 frameBytes = getFrameBytes(((MsgBridgeFrame const *)peer->mPendingFrames.front().getPtr())->mSize);
+            u32 used = (u32)peer->mRingOut->mTail - (u32)peer->mRingOut->mHead;
+            if(mRingSize - used >= frameBytes + (mRingSize - ((u32)peer->mRingOut->mTail & (mRingSize - 1))))
+            {
+                bRet = false; // room even if the frame had to wrap
+            }
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgBridge::wakeUpPeer(MsgBridgePeer * _peer, long volatile * _waitingFlag)
+{
+    if(*_waitingFlag && NWAtomic::exchange(_waitingFlag, 0))
+    {
+        _peer->mEventWakeUp->signal();
+        mMetrics.mWakeUps++;
+    }
+}
+
+//****************************************************************************
+// Bridge Thread Main Fn
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ unsigned int MsgBridge::threadMain(ThreadParams const * _params)
+{
+    enum eBridgeThreadEvents
+    {
+        BTE_MSGS_AVAILABLE = 0,
+        BTE_WAKE_UP,
+        BTE_END_REQUEST
+    };
+
+    NWMultipleEvents multipleEventWait(mEventMsgsAvailable, mEventWakeUp, _params->mEventEndRequest);
+
+    bool bLoop = true;
+    while(bLoop)
+    {
+        flushPendingFrames();
+
+        // The local msgs wait in their channels once too many frames are queued, unless a received
+        // msg waits for credits : the bridge nodes could be the listeners holding them
+        if(getNumPendingFrames() < MsgBridgeMaxPendingFrames || isCreditStalled())
+        {
+            for(int i=0; i<(int)mChannels.size(); i++)
+            {
+                mChannels[i]->mCommNode.dispatchAvailableMessages();
+            }
+        }
+
+        for(int i=0; i<(int)mPeers.size(); i++)
+        {
+            readPeer(mPeers[i]);
+        }
+
+        unsigned int waitMs = NWME_INFINITE;
+        if(prepareWait(waitMs))
+        {
+            int eventSignaled = multipleEventWait.waitForSignal(waitMs);
+            bLoop = eventSignaled != BTE_END_REQUEST && eventSignaled != NWME_INVALID_EVENT;
+        }
+        else
+        {
+            bLoop = !_params->mEventEndRequest->isSignaled();
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_MSG_BRIDGE_H_
+#define _INCREW_MSG_BRIDGE_H_
+
+#include "MsgMgrDefs.h"
+#include "MsgFactory.h"
+#include "NWThread.h"
+
+#include <string>
+#include <vector>
+
+class NWEvent;
+class NWThread;
+class NWSharedMemory;
+struct MsgBridgeChannel;
+struct MsgBridgePeer;
+struct MsgBridgeRegistry;
+struct MsgBridgeRing;
+
+enum eMsgBridgeDefs
+{
+    MsgBridgeDefaultRingSize = 256*1024,    // bytes of each direction, power of 2
+    MsgBridgeRegistrySlots = 256,           // channels known by the processes of the machine
+    MsgBridgeMaxChannelName = 64,
+    MsgBridgeMaxFramesPerPass = 256,        // frames read from a peer before looking at the other ones
+    MsgBridgeMaxPendingFrames = 1024,       // frames queued for the full peer rings, then the local msgs wait in their channels
+    MsgBridgeCreditRetryMs = 1              // only timed wait, while a local channel is out of credits
+};
+
+struct MsgBridgeMetrics
+{
+    u64 mMsgsOut;
+    u64 mBytesOut;
+    u64 mMsgsIn;
+    u64 mBytesIn;
+    u64 mNotSerializableMsgs; // without NWBaseMsgInternal::serializeOut, they stay in the process
+    u64 mOversizedMsgs; // frames over a quarter of the ring
+    u64 mUnknownMsgs; // received but not registered in the factory, or not readable
+    u64 mRingFullWaits; // frames queued in the bridge because a peer ring was full
+    u64 mWakeUps; // peer wake ups signaled, only when the peer was waiting
+};
+
+//****************************************************************************
+// Mirrors MsgMgr channels into other processes of the machine. Every pair
+// of connected processes shares a memory segment with two single producer
+// single consumer rings, one per direction. The msgs are serialized once
+// (NWBaseMsgInternal::serializeOut) and the frame is copied in the ring of
+// every peer, the receiving bridge creates them again through its factory
+// and sends them to the same channel. Channels are identified by their slot
+// in a registry segment shared by all the processes.
+//
+// Nobody polls : a side about to sleep flags it in the ring and the other
+// side signals its named wake up event, only when the flag is set.
+//
+// Msgs cross a single bridge, every pair of processes mirroring a channel
+// has to be connected. Channels and peers are added before start().
+//****************************************************************************
+class MsgBridge : public NWThreadFn
+{
+public:
+    MsgBridge();
+    virtual ~MsgBridge();
+
+    bool init(const char * _processName, CommNodeId _commNodeId, u32 _ringSize=MsgBridgeDefaultRingSize); // _processName is unique in the machine
+    void done();
+
+    template <class T> inline bool registerMsg(); // msgs that can be received, they need serializeOut/serializeIn
+    bool mirrorChannel(const char * _channelName);
+    bool connectPeer(const char * _peerProcessName); // the peer uses the same ring size
+
+    bool start();
+    void stop();
+
+    void getMetrics(MsgBridgeMetrics & metrics_) const;
+
+protected:
+    virtual unsigned int threadMain(ThreadParams const * _threadParams);
+
+private:
+    friend struct MsgBridgeChannel;
+
+    bool mInitd;
+    std::string mProcessName;
+    CommNodeId mCommNodeId;
+    u32 mRingSize;
+    MsgFactory mFactory;
+    NWSharedMemory * mRegistryMemory;
+    MsgBridgeRegistry * mRegistry;
+    std::vector<MsgBridgeChannel *> mChannels;
+    std::vector<MsgBridgeChannel *> mChannelsBySlot;
+    std::vector<MsgBridgePeer *> mPeers;
+    NWEvent * mEventMsgsAvailable; // shared by the CommNodes of the channels
+    NWEvent * mEventWakeUp; // named, signaled by the peers
+    NWThread * mThread;
+    std::vector<unsigned char> mReadBuffer; // payload being read, out of the ring
+    MsgBridgeMetrics mMetrics;
+
+    int registerChannelName(const char * _channelName); // slot in the registry, -1 when full
+
+    void sendToPeers(MsgBridgeChannel * _channel, int _msgFamily, int _msgType, NWBaseMsgInternal const * _msg);
+    bool writeFrame(MsgBridgePeer * _peer, unsigned char const * _header, unsigned char const * _payload, u32 _payloadSize); // false if the ring is full
+    void flushPendingFrames();
+    int getNumPendingFrames() const;
+
+    bool isCreditStalled() const;
+    void readPeer(MsgBridgePeer * _peer);
+    bool receiveFrame(unsigned char const * _frame); // false if the msg has to wait for credits of its channel
+
+    bool prepareWait(unsigned int & waitMs_); // flags the rings before sleeping, false if there is something to do
+    void wakeUpPeer(MsgBridgePeer * _peer, long volatile * _waitingFlag);
+};
+
+template <class T> inline bool MsgBridge::registerMsg()
+{
+    return mFactory.registerMsg<T>();
+}
+
+#endif // _INCREW_MSG_BRIDGE_H_
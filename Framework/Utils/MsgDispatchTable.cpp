@@ -0,0 +1,313 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "MsgDispatchTable.h"
+
+#include <iterator>
+
+//****************************************************************************
+// MsgInterestSet
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgInterestSet::MsgInterestSet() :
+    mAcceptAll(true)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgInterestSet::clear(bool _acceptAll)
+{
+    mAcceptAll = _acceptAll;
+    mFamilies.clear();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgInterestSet::add(int _msgFamily, int _msgType)
+{
+    ASSERT(_msgFamily >= 0 && _msgFamily < MsgDispatchMaxIndex);
+    ASSERT(_msgType >= 0 && _msgType < MsgDispatchMaxIndex);
+
+    if(_msgFamily >= 0 && _msgFamily < MsgDispatchMaxIndex && _msgType >= 0 && _msgType < MsgDispatchMaxIndex)
+    {
+        if(_msgFamily >= (int)mFamilies.size())
+        {
+            mFamilies.resize(_msgFamily + 1);
+        }
+
+        std::vector<u32> & bits = mFamilies[_msgFamily];
+        unsigned int word = (unsigned int)_msgType >> 5;
+        if(word >= bits.size())
+        {
+            bits.resize(word + 1, 0);
+        }
+
+        bits[word] |= 1u << (_msgType & 31);
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgInterestSet::merge(MsgInterestSet const & _other)
+{
+    if(_other.mAcceptAll)
+    {
+        clear(true);
+    }
+    else if(!mAcceptAll)
+    {
+        int numFamilies = (int)_other.mFamilies.size();
+        if(numFamilies > (int)mFamilies.size())
+        {
+            mFamilies.resize(numFamilies);
+        }
+
+        for(int i=0; i<numFamilies; i++)
+        {
+            std::vector<u32> const & from = _other.mFamilies[i];
+            std::vector<u32> & to = mFamilies[i];
+
+            int numWords = (int)from.size();
+            if(numWords > (int)to.size())
+            {
+                to.resize(numWords, 0);
+            }
+
+            for(int j=0; j<numWords; j++)
+            {
+                to[j] |= from[j];
+            }
+        }
+    }
+}
+
+//****************************************************************************
+// MsgFilter
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgFilter::MsgFilter() :
+    mAllTypes(true),
+    mAllKeys(true)
+{
+    mTypes.clear(false);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgFilter::clear()
+{
+    mAllTypes = true;
+    mTypes.clear(false);
+    mKeys.clear();
+    mAllKeys = true;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgFilter::addType(int _msgFamily, int _msgType)
+{
+    mAllTypes = false;
+    mTypes.add(_msgFamily, _msgType);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgFilter::addKey(u32 _key)
+{
+    mAllKeys = false;
+
+    std::vector<u32>::iterator it = std::lower_bound(mKeys.begin(), mKeys.end(), _key);
+    if(it == mKeys.end() || *it != _key)
+    {
+        mKeys.insert(it, _key);
+    }
+}
+
+//----------------------------------------------------------------------------
+// The union of both filters, used for the filter of a whole channel
+//----------------------------------------------------------------------------
+void MsgFilter::merge(MsgFilter const & _other)
+{
+    if(_other.mAllTypes)
+    {
+        mAllTypes = true;
+        mTypes.clear(false);
+    }
+    else if(!mAllTypes)
+    {
+        mTypes.merge(_other.mTypes);
+    }
+
+    if(_other.mAllKeys)
+    {
+        mAllKeys = true;
+        mKeys.clear();
+    }
+    else if(!mAllKeys)
+    {
+        std::vector<u32> keys;
+        keys.reserve(mKeys.size() + _other.mKeys.size());
+        std::set_union(mKeys.begin(), mKeys.end(), _other.mKeys.begin(), _other.mKeys.end(), std::back_inserter(keys));
+        mKeys.swap(keys);
+    }
+}
+
+//****************************************************************************
+// MsgDispatchTable
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgDispatchTable::MsgDispatchTable() :
+    mNumHandlers(0)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgDispatchTable::~MsgDispatchTable()
+{
+    clear();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgDispatchTable::setHandler(int _msgFamily, int _msgType, MsgHandlerBase * _handler)
+{
+    bool bRet = false;
+
+    ASSERT(_msgFamily >= 0 && _msgFamily < MsgDispatchMaxIndex);
+    ASSERT(_msgType >= 0 && _msgType < MsgDispatchMaxIndex);
+
+    if(_msgFamily >= 0 && _msgFamily < MsgDispatchMaxIndex && _msgType >= 0 && _msgType < MsgDispatchMaxIndex)
+    {
+        if(_handler)
+        {
+            if(_msgFamily >= (int)mFamilies.size())
+            {
+                mFamilies.resize(_msgFamily + 1);
+            }
+
+            if(_msgType >= (int)mFamilies[_msgFamily].size())
+            {
+                mFamilies[_msgFamily].resize(_msgType + 1, NULL);
+            }
+        }
+
+        MsgHandlerBase * old = getHandler(_msgFamily, _msgType);
+        if(old)
+        {
+            mFamilies[_msgFamily][_msgType] = NULL;
+            DISPOSE(old);
+            mNumHandlers--;
+        }
+
+        if(_handler)
+        {
+            mFamilies[_msgFamily][_msgType] = _handler;
+            mNumHandlers++;
+        }
+
+        bRet = true;
+    }
+    else
+    {
+        DISPOSE(_handler);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgDispatchTable::clear()
+{
+    int numFamilies = (int)mFamilies.size();
+    for(int i=0; i<numFamilies; i++)
+    {
+        std::vector<MsgHandlerBase *> & handlers = mFamilies[i];
+
+        int numTypes = (int)handlers.size();
+        for(int j=0; j<numTypes; j++)
+        {
+            DISPOSE(handlers[j]);
+        }
+    }
+
+    mFamilies.clear();
+    mNumHandlers = 0;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgDispatchTable::fillInterest(MsgInterestSet & interest_) const
+{
+    int numFamilies = (int)mFamilies.size();
+    for(int i=0; i<numFamilies; i++)
+    {
+        std::vector<MsgHandlerBase *> const & handlers = mFamilies[i];
+
+        int numTypes = (int)handlers.size();
+        for(int j=0; j<numTypes; j++)
+        {
+            if(handlers[j])
+            {
+                interest_.add(i, j);
+            }
+        }
+    }
+}
@@ -0,0 +1,265 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_MSG_DISPATCH_TABLE_H_
+#define _INCREW_MSG_DISPATCH_TABLE_H_
+
+#include "MsgMgrDefs.h"
+#include "MsgDefs.h"
+
+#include <vector>
+#include <algorithm>
+
+enum
+{
+    MsgDispatchMaxIndex = 4096 // msg families and types must be below it to get a typed handler
+};
+
+//****************************************************************************
+// Typed msg handlers, registered through CommNode::on<T>()
+//****************************************************************************
+class MsgHandlerBase
+{
+public:
+    virtual ~MsgHandlerBase(){}
+
+    virtual void handleMessage(CommNodeId _from, NWBaseMsgInternal const * _msg) = 0;
+};
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+template <class T, class O>
+class MsgMemberHandler : public MsgHandlerBase
+{
+public:
+    typedef void (O::*HandlerFnPtr)(CommNodeId _from, T const & _msg);
+
+    MsgMemberHandler(O * _this, HandlerFnPtr _fnPtr);
+
+    virtual void handleMessage(CommNodeId _from, NWBaseMsgInternal const * _msg);
+
+private:
+    O * mThis;
+    HandlerFnPtr mFnPtr;
+};
+
+template <class T, class O>
+MsgMemberHandler<T, O>::MsgMemberHandler(O * _this, HandlerFnPtr _fnPtr) :
+    mThis(_this),
+    mFnPtr(_fnPtr)
+{
+}
+
+template <class T, class O>
+/*virtual*/ void MsgMemberHandler<T, O>::handleMessage(CommNodeId _from, NWBaseMsgInternal const * _msg)
+{
+    (mThis->*mFnPtr)(_from, *static_cast<T const *>(_msg));
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+template <class T>
+class MsgFnHandler : public MsgHandlerBase
+{
+public:
+    typedef void (*HandlerFnPtr)(CommNodeId _from, T const & _msg);
+
+    MsgFnHandler(HandlerFnPtr _fnPtr);
+
+    virtual void handleMessage(CommNodeId _from, NWBaseMsgInternal const * _msg);
+
+private:
+    HandlerFnPtr mFnPtr;
+};
+
+template <class T>
+MsgFnHandler<T>::MsgFnHandler(HandlerFnPtr _fnPtr) :
+    mFnPtr(_fnPtr)
+{
+}
+
+template <class T>
+/*virtual*/ void MsgFnHandler<T>::handleMessage(CommNodeId _from, NWBaseMsgInternal const * _msg)
+{
+    (*mFnPtr)(_from, *static_cast<T const *>(_msg));
+}
+
+//****************************************************************************
+// Set of (family, type) pairs a channel wants to receive, one bit per type
+//****************************************************************************
+class MsgInterestSet
+{
+public:
+    MsgInterestSet();
+
+    void clear(bool _acceptAll);
+    void add(int _msgFamily, int _msgType);
+    void merge(MsgInterestSet const & _other);
+
+    inline bool acceptsAll() const;
+    inline bool accepts(int _msgFamily, int _msgType) const;
+
+private:
+    bool mAcceptAll;
+    std::vector<std::vector<u32> > mFamilies;
+};
+
+inline bool MsgInterestSet::acceptsAll() const
+{
+    return mAcceptAll;
+}
+
+inline bool MsgInterestSet::accepts(int _msgFamily, int _msgType) const
+{
+    bool bRet = mAcceptAll;
+
+    if(!bRet && (unsigned int)_msgFamily < mFamilies.size())
+    {
+        std::vector<u32> const & bits = mFamilies[_msgFamily];
+        unsigned int word = (unsigned int)_msgType >> 5;
+
+        bRet = word < bits.size() && (bits[word] & (1u << (_msgType & 31))) != 0;
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+// Content filter of a listener : msg types plus, optionally, the keys of the
+// keyed msgs (NWBaseMsgInternal::getMsgKey). Msgs without key only go
+// through the types check. Cheap enough to run on every msg dispatched.
+//****************************************************************************
+class MsgFilter
+{
+public:
+    MsgFilter();
+
+    void clear(); // accepts every msg
+    void addType(int _msgFamily, int _msgType); // the first type added restricts the filter to the types added
+    template <class T> inline void addType();
+    void addKey(u32 _key); // the first key added restricts the keyed msgs to the keys added
+    void merge(MsgFilter const & _other);
+
+    inline bool acceptsAll() const;
+    inline bool acceptsAllKeys() const;
+    inline bool accepts(int _msgFamily, int _msgType, bool _hasKey, u32 _key) const;
+
+private:
+    bool mAllTypes;
+    MsgInterestSet mTypes;
+    std::vector<u32> mKeys; // sorted, empty with mAllKeys
+    bool mAllKeys;
+};
+
+template <class T> inline void MsgFilter::addType()
+{
+    addType(T::MSG_FAMILY, T::MSG_TYPE);
+}
+
+inline bool MsgFilter::acceptsAll() const
+{
+    return mAllTypes && mAllKeys;
+}
+
+inline bool MsgFilter::acceptsAllKeys() const
+{
+    return mAllKeys;
+}
+
+inline bool MsgFilter::accepts(int _msgFamily, int _msgType, bool _hasKey, u32 _key) const
+{
+    bool bRet = mAllTypes || mTypes.accepts(_msgFamily, _msgType);
+
+    if(bRet && _hasKey && !mAllKeys)
+    {
+        std::vector<u32>::const_iterator it = std::lower_bound(mKeys.begin(), mKeys.end(), _key);
+        bRet = it != mKeys.end() && *it == _key; // a hash collision only lets an extra msg through
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+// Dense handlers table indexed by [family][type], built at registration
+// time so the dispatch is a single indexed call
+//****************************************************************************
+class MsgDispatchTable
+{
+public:
+    MsgDispatchTable();
+    ~MsgDispatchTable();
+
+    bool setHandler(int _msgFamily, int _msgType, MsgHandlerBase * _handler); // the table owns the handler, NULL removes it
+    void clear();
+
+    inline MsgHandlerBase * getHandler(int _msgFamily, int _msgType) const;
+    inline int getNumHandlers() const;
+
+    void fillInterest(MsgInterestSet & interest_) const;
+
+private:
+    std::vector<std::vector<MsgHandlerBase *> > mFamilies;
+    int mNumHandlers;
+};
+
+inline MsgHandlerBase * MsgDispatchTable::getHandler(int _msgFamily, int _msgType) const
+{
+    MsgHandlerBase * pRet = NULL;
+
+    if((unsigned int)_msgFamily < mFamilies.size())
+    {
+        std::vector<MsgHandlerBase *> const & handlers = mFamilies[_msgFamily];
+        if((unsigned int)_msgType < handlers.size())
+        {
+            pRet = handlers[_msgType];
+        }
+    }
+
+    return pRet;
+}
+
+inline int MsgDispatchTable::getNumHandlers() const
+{
+    return mNumHandlers;
+}
+
+#endif // _INCREW_MSG_DISPATCH_TABLE_H_
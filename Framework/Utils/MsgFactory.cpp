@@ -0,0 +1,114 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "MsgFactory.h"
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgFactory::MsgFactory()
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgFactory::~MsgFactory()
+{
+    clear();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgFactory::registerMsg(int _msgFamily, int _msgType, CreateFnPtr _createFn, int _msgSize)
+{
+    bool bRet = false;
+
+    ASSERT(_msgFamily >= 0 && _msgFamily < MsgDispatchMaxIndex);
+    ASSERT(_msgType >= 0 && _msgType < MsgDispatchMaxIndex);
+
+    if(_msgFamily >= 0 && _msgFamily < MsgDispatchMaxIndex && _msgType >= 0 && _msgType < MsgDispatchMaxIndex)
+    {
+        if(_msgFamily >= (int)mFamilies.size())
+        {
+            mFamilies.resize(_msgFamily + 1);
+        }
+
+        std::vector<MsgFactoryEntry> & entries = mFamilies[_msgFamily];
+        if(_msgType >= (int)entries.size())
+        {
+            entries.resize(_msgType + 1);
+        }
+
+        entries[_msgType].mCreateFn = _createFn;
+        entries[_msgType].mMsgSize = _msgSize;
+        bRet = true;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgFactory::clear()
+{
+    mFamilies.clear();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWBaseMsgInternal * MsgFactory::createMsg(int _msgFamily, int _msgType, int & msgSize_) const
+{
+    NWBaseMsgInternal * pRet = NULL;
+
+    MsgFactoryEntry const * entry = getEntry(_msgFamily, _msgType);
+    if(entry)
+    {
+        pRet = entry->mCreateFn();
+        msgSize_ = entry->mMsgSize;
+    }
+
+    return pRet;
+}
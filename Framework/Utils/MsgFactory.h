@@ -0,0 +1,115 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_MSG_FACTORY_H_
+#define _INCREW_MSG_FACTORY_H_
+
+#include "MsgDispatchTable.h"
+
+#include <vector>
+
+//****************************************************************************
+// Creates msgs from their (family, type) pair, for the msgs built at run
+// time from serialized data (MsgBridge). Dense table like MsgDispatchTable,
+// registered before the msgs are read.
+//****************************************************************************
+class MsgFactory
+{
+public:
+    typedef NWBaseMsgInternal * (*CreateFnPtr)();
+
+    MsgFactory();
+    ~MsgFactory();
+
+    template <class T> inline bool registerMsg();
+    bool registerMsg(int _msgFamily, int _msgType, CreateFnPtr _createFn, int _msgSize);
+    void clear();
+
+    NWBaseMsgInternal * createMsg(int _msgFamily, int _msgType, int & msgSize_) const; // NULL if the msg isn't registered
+    inline bool isRegistered(int _msgFamily, int _msgType) const;
+
+private:
+    struct MsgFactoryEntry
+    {
+        CreateFnPtr mCreateFn;
+        int mMsgSize;
+
+        MsgFactoryEntry() : mCreateFn(NULL), mMsgSize(0) {}
+    };
+
+    std::vector<std::vector<MsgFactoryEntry> > mFamilies;
+
+    inline MsgFactoryEntry const * getEntry(int _msgFamily, int _msgType) const;
+
+    template <class T> static NWBaseMsgInternal * createMsgT();
+};
+
+template <class T> inline bool MsgFactory::registerMsg()
+{
+    return registerMsg(T::MSG_FAMILY, T::MSG_TYPE, &MsgFactory::createMsgT<T>, sizeof(T));
+}
+
+template <class T> /*static*/ NWBaseMsgInternal * MsgFactory::createMsgT()
+{
+    return NEW T;
+}
+
+inline MsgFactory::MsgFactoryEntry const * MsgFactory::getEntry(int _msgFamily, int _msgType) const
+{
+    MsgFactoryEntry const * pRet = NULL;
+
+    if((unsigned int)_msgFamily < mFamilies.size())
+    {
+        std::vector<MsgFactoryEntry> const & entries = mFamilies[_msgFamily];
+        if((unsigned int)_msgType < entries.size() && entries[_msgType].mCreateFn)
+        {
+            pRet = &entries[_msgType];
+        }
+    }
+
+    return pRet;
+}
+
+inline bool MsgFactory::isRegistered(int _msgFamily, int _msgType) const
+{
+    return getEntry(_msgFamily, _msgType) != NULL;
+}
+
+#endif // _INCREW_MSG_FACTORY_H_
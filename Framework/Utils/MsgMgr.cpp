@@ -1,692 +1,1153 @@
-/*       
-*       This file is part of NWFramework.
-*       Copyright (c) InCrew Software and Others.
-*       (See the AUTHORS file in the root of this distribution.)
-*
-*       NWFramework is free software; you can redistribute it and/or modify
-*       it under the terms of the GNU General Public License as published by
-*       the Free Software Foundation; either version 2 of the License, or
-*       (at your option) any later version.
-*
-*       NWFramework is distributed in the hope that it will be useful,
-*       but WITHOUT ANY WARRANTY; without even the implied warranty of
-*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
-*       GNU General Public License for more details.
-* 
-*       You should have received a copy of the GNU General Public License
-*       along with NWFramework; if not, write to the Free Software
-*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
-*
-*      Permission is hereby granted, free of charge, to any person obtaining
-*      a copy of this software and associated documentation files (the
-*      "Software"), to deal in the Software without restriction, including
-*      without limitation the rights to use, copy, modify, merge, publish,
-*      distribute, sublicense, and/or sell copies of the Software, and to
-*      permit persons to whom the Software is furnished to do so, subject to
-*      the following conditions:
-*
-*      The above copyright notice and this permission notice shall be
-*      included in all copies or substantial portions of the Software.
-*
-*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
-*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
-*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
-*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
-*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
-*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
-*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-*/
-
-
-#include "PchUtils.h"
-
-#include "MsgMgr.h"
-
-#include "MsgMgrAux.h"
-#include "CommNode.h"
-
-#include "NWEvent.h"
-#include "NWMultipleEvents.h"
-#include "NWCriticalSection.h"
-
-//****************************************************************************
-//
-//****************************************************************************
-static const int DISPATCHER_TIMEOUT_MS = /**/300;/**/ /*NWME_INFINITE;*/ // zzz test
-static const int PURGE_MAX_MSGS_PER_CHANNEL = 1000;
-static const int COMM_NODE_NOTIFICATION_CALLBACK_RESERVE = 16;
-
-//****************************************************************************
-//
-//****************************************************************************
-/*static*/ MsgMgr * MsgMgr::mInstance = NULL;
-
-//****************************************************************************
-// MsgMgr Singleton
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-/*static*/ bool MsgMgr::init(MsgMgr_InitData const * _initData)
-{
-    if(mInstance == NULL)
-    {
-        mInstance = NEW MsgMgr();
-        mInstance->initializeInstance(_initData);
-    }
-
-    return (mInstance != NULL);
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-/*static*/ void MsgMgr::done()
-{
-    if(mInstance)
-    {
-        mInstance->shutdownInstance();
-        DISPOSE(mInstance);
-    }
-}
-
-//****************************************************************************
-// MsgMgr class
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-MsgMgr::MsgMgr() :
-    mMailboxUpdateEvent(NULL),
-    mThreadDispatcher(NULL),
-    mMsgMgrThreadParams(),
-    mChannelList(NULL),
-    mMsgMgrDns(NULL),
-    mCritSecAddRemoveCommNodes(NULL),
-    mCritSecDns(NULL),
-    mChannelIdGenerator(0),
-    mNotificationCallback(NULL)
-{
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-MsgMgr::~MsgMgr()
-{
-}
-
-//****************************************************************************
-// Instance Init / Shutdown
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-bool MsgMgr::initializeInstance(MsgMgr_InitData const * _initData)
-{
-    mChannelList = NEW ChannelList();
-    mChannelList->initialize();
-
-    mMailboxUpdateEvent = NWEvent::create();
-
-    mMsgMgrThreadParams.mMailboxUpdateEvent = mMailboxUpdateEvent;
-
-    mThreadDispatcher = NWThread::create();
-    mThreadDispatcher->start(this, (void *)&mMsgMgrThreadParams);
-
-    mCritSecAddRemoveCommNodes = NWCriticalSection::create();
-    mCritSecDns = NWCriticalSection::create();
-
-    mMsgMgrDns = NEW MsgMgr_Dns();
-    mMsgMgrDns->initialize();
-
-    return true;
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-void MsgMgr::shutdownInstance()
-{
-    mMsgMgrDns->shutdown();
-    DISPOSE(mMsgMgrDns);
-
-    NWThread::destroy(mThreadDispatcher);
-
-    mChannelList->shutdown();
-    DISPOSE(mChannelList);
-    mChannelList = 0;
-
-    NWEvent::destroy(mMailboxUpdateEvent);
-
-    NWCriticalSection::destroy(mCritSecAddRemoveCommNodes);
-    NWCriticalSection::destroy(mCritSecDns);
-}
-
-//****************************************************************************
-// Add channel / Remove channel / SendTo Channel
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-ChannelId MsgMgr::addCommNodeToChannel(const char * _channelName, CommNode * _commNode)
-{
-    ASSERT(_commNode);
-
-    ChannelId channelId = InvalidChannelId;
-    
-    {
-        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
-
-        channelId = findChannel(_channelName);
-
-        if(channelId == InvalidChannelId)
-        {
-            MsgChannel * channel = createChannel(_channelName);
-            channelId = channel->getChannelId();
-        }
-
-        addCommNodeToChannel(channelId, _commNode);
-    }
-    
-    return channelId;
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-bool MsgMgr::addCommNodeToChannel(ChannelId _channelId, CommNode * _commNode)
-{
-    ASSERT(_commNode);
-
-    bool bRet = false;
-
-    ASSERT(_channelId != InvalidChannelId);
-    if(_channelId != InvalidChannelId)
-    {
-        {
-            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
-
-            MsgChannel * channel = mChannelList->getChannel(_channelId);
-            ASSERT(channel);
-            if(channel)
-            {
-                MsgChannel * commNodeChannel = _commNode->getLocalChannel();
-                channel->listenTo(commNodeChannel);
-                commNodeChannel->listenTo(channel);
-                bRet = true;
-            }
-        }
-    }
-
-    return bRet;
-}
-
-//****************************************************************************
-//
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-ChannelId MsgMgr::addCommNodeListenerToChannel(const char * _channelName, CommNode * _commNode)
-{
-    ASSERT(_commNode);
-
-    ChannelId channelId = InvalidChannelId;
-
-    {
-        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
-        
-        channelId = findChannel(_channelName);
-
-        if(channelId == InvalidChannelId)
-        {
-            MsgChannel * channel = createChannel(_channelName);
-            channelId = channel->getChannelId();
-        }
-
-        addCommNodeListenerToChannel(channelId, _commNode);
-    }
-
-    return channelId;
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-bool MsgMgr::addCommNodeListenerToChannel(ChannelId _channelId, CommNode * _commNode)
-{
-    ASSERT(_commNode);
-
-    bool bRet = false;
-
-    ASSERT(_channelId != InvalidChannelId);
-    if(_channelId != InvalidChannelId)
-    {
-        {
-            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
-
-            MsgChannel * channel = mChannelList->getChannel(_channelId);
-            ASSERT(channel);
-            if(channel)
-            {
-                MsgChannel * commNodeChannel = _commNode->getLocalChannel();
-                commNodeChannel->listenTo(channel);
-                bRet = true;
-            }
-        }
-    }
-
-    return bRet;
-}
-
-//****************************************************************************
-//
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-ChannelId MsgMgr::addCommNodeSenderToChannel(const char * _channelName, CommNode * _commNode)
-{
-    ASSERT(_commNode);
-
-    ChannelId channelId = InvalidChannelId; 
-    
-    {
-        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
-        
-        channelId = findChannel(_channelName);
-
-        if(channelId == InvalidChannelId)
-        {
-            MsgChannel * channel = createChannel(_channelName);
-            channelId = channel->getChannelId();
-        }
-
-        addCommNodeSenderToChannel(channelId, _commNode);
-    }
-
-    return channelId;
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-bool MsgMgr::addCommNodeSenderToChannel(ChannelId _channelId, CommNode * _commNode)
-{
-    bool bRet = false;
-
-    ASSERT(_commNode);
-    ASSERT(_channelId != InvalidChannelId);
-    if(_channelId != InvalidChannelId)
-    {
-        {
-            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
-
-            MsgChannel * channel = mChannelList->getChannel(_channelId);
-            ASSERT(channel);
-            if(channel)
-            {
-                MsgChannel * commNodeChannel = _commNode->getLocalChannel();
-                channel->listenTo(commNodeChannel);
-                bRet = true;
-            }
-        }
-    }
-
-    return bRet;
-}
-
-//****************************************************************************
-//
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-void MsgMgr::removeCommNodeFromChannel(const char * _channelName, CommNode * _commNode)
-{
-    {
-        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
-
-        ChannelId channelId = findChannel(_channelName, false);
-
-        if(channelId != InvalidChannelId)
-        {
-            removeCommNodeFromChannel(channelId, _commNode);
-        }
-    }
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-void MsgMgr::removeCommNodeFromChannel(ChannelId _channelId, CommNode * _commNode)
-{
-    if(_channelId != InvalidChannelId)
-    {
-        {
-            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
-
-            MsgChannel * channel = mChannelList->getChannel(_channelId);
-            MsgChannel * commNodeChannel = _commNode->getLocalChannel();
-
-            if(channel)
-            {
-                channel->stopListeningTo(commNodeChannel);
-                commNodeChannel->stopListeningTo(channel);
-
-                if(channel->getNumListeners() < 1 && channel->getNumListened() < 1)
-                {
-                    unregChannelName(getChannelName(_channelId));
-                    mChannelList->removeChannel(_channelId);
-                }
-            }
-        }
-    }
-}
-
-//****************************************************************************
-//
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-void MsgMgr::regChannelName(const char * _name, ChannelId _id)
-{
-    {
-        NWAutoCritSec critSec(mCritSecDns);
-
-        mMsgMgrDns->regChannelName(_name, _id);
-    }
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-void MsgMgr::unregChannelName(const char * _name)
-{
-    {
-        NWAutoCritSec critSec(mCritSecDns);
-
-        mMsgMgrDns->unregChannelName(_name);
-    }
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-ChannelId MsgMgr::getChannelId(const char * _name)
-{
-    ChannelId channelId = InvalidChannelId;
-
-    {
-        NWAutoCritSec critSec(mCritSecDns);
-
-        channelId = mMsgMgrDns->getChannelId(_name);
-    }
-
-    return channelId;
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-const char * MsgMgr::getChannelName(ChannelId _channelId)
-{
-    const char * pRet = NULL;
-
-    {
-        NWAutoCritSec critSec(mCritSecDns);
-
-        MsgChannel * channel = mChannelList->getChannel(_channelId);
-        if(channel)
-        {
-            pRet = channel->getName();
-        }
-    }
-
-    return pRet;
-}
-
-//****************************************************************************
-// Main thread CommNodes fn : This type of nodes need help for message dispatching
-//****************************************************************************
-void MsgMgr::regNotificationCallback(MsgMgrNotificationCallback * _notificationCallback)
-{
-    mNotificationCallback = _notificationCallback;
-}
-
-void MsgMgr::addCommNodeToNotificationList(CommNode * _commNode)
-{
-    mCommNodeNotificationCallbackList.push_back(_commNode);
-}
-
-void MsgMgr::removeCommNodeFromNotificationList(CommNode * _commNode)
-{
-    mCommNodeNotificationCallbackList.remove(_commNode);
-}
-
-void MsgMgr::dispatchNotificationMessages()
-{
-    for(NotificationIt it = mCommNodeNotificationCallbackList.begin(); it != mCommNodeNotificationCallbackList.end(); it++)
-    {
-        CommNode * commNode = (*it);
-        commNode->dispatchAvailableMessages();
-    }
-}
-
-//****************************************************************************
-//
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-ChannelId MsgMgr::findChannel(const char * _channelName, bool _createIfNotExist/*=true*/)
-{
-    ChannelId channelId = InvalidChannelId;
-    
-    {
-        NWAutoCritSec critSec(mCritSecDns);
-        
-        channelId = mChannelList->getChannelId(_channelName);
-    }
-
-    return channelId;
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-ChannelId MsgMgr::generateChannelId()
-{
-    ChannelId channelId = InvalidChannelId;
-
-    {
-        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
-
-        mChannelIdGenerator++;
-        channelId = mChannelIdGenerator;
-    }
-
-    return channelId;
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-MsgChannel * MsgMgr::createChannel(const char * _channelName)
-{
-    MsgChannel * newChannel = mChannelList->addChannel(_channelName, generateChannelId(), mMailboxUpdateEvent);
-
-    ChannelId channelId = newChannel->getChannelId();
-    regChannelName(_channelName, channelId);
-
-    return newChannel;
-}
-
-//****************************************************************************
-// Dispatcher Thread Main Fn
-//****************************************************************************
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-/*virtual*/ unsigned int MsgMgr::threadMain(ThreadParams const * _params)
-{
-
-    MsgMgrThreadParams * msgMgrParams = (MsgMgrThreadParams *)_params->mUserParams;
-
-    enum eMsgThreadEvents
-    {
-        MTE_MAILBOX_UPDATE = 0,
-        MTE_END_REQUEST
-    };
-
-    NWMultipleEvents multipleEventWait(msgMgrParams->mMailboxUpdateEvent, _params->mEventEndRequest);
-
-    bool bLoop = true;
-    while(bLoop)
-    {
-        int eventSignaled = multipleEventWait.waitForSignal(DISPATCHER_TIMEOUT_MS); // wait for any event signaling
-        if(eventSignaled == MTE_END_REQUEST)
-        {
-            bLoop = false;
-            continue;
-        }
-
-        if(eventSignaled == NWME_TIMEOUT)
-        {
-            {
-            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes); // avoids message processing while adding or removing nodes (or add/remove nodes while processing msgs)
-
-            threadPurgeMessages();
-            }
-        }
-        else if(eventSignaled == MTE_MAILBOX_UPDATE)
-        {
-            {
-            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes); // avoids message processing while adding or removing nodes (or add/remove nodes while processing msgs)
-
-            threadMailboxUpdate();
-            }
-        }
-    }
-
-    return 0;
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-void MsgMgr::threadPurgeMessages()
-{
-    MsgChannel * channel = mChannelList->getHeadChannelList();
-    while(channel)
-    {
-        bool signalNewMessages = false;
-
-        u64 minMsgId = 0xffffffffffffffff;
-
-        ChannelListener * listener = channel->getHeadListenerChannel();
-        while(listener)
-        {
-            if(listener->mCurrentMsg)
-            {
-                if(minMsgId > listener->mCurrentMsg->mMsgRefId)
-                    minMsgId = listener->mCurrentMsg->mMsgRefId;
-            }
-            listener = listener->getNext();
-        }
-
-        int numMsgs = 0;
-        while(channel->mHeadMsgList && channel->mHeadMsgList->mMsgRefId < minMsgId)
-        {
-            channel->unlinkAndDestroyStoredMsgHead();
-
-            //numMsgs++;
-            //if(numMsgs > PURGE_MAX_MSGS_PER_CHANNEL)
-            //{
-            //    break;
-            //}
-        }
-
-        channel = channel->getNext();
-    }
-}
-
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-void MsgMgr::threadMailboxUpdate()
-{
-    bool bCallNotificationCallback = false;
-    bool bContinue = true;
-
-    while(bContinue)
-    {
-        bContinue = false;
-
-        ChannelId msgChannelFrom = InvalidChannelId;
-        MsgChannel * channel = mChannelList->getHeadChannelList();
-        while(channel)
-        {
-            bool signalNewMessages = false;
-
-            ListenedChannel * listened = channel->getHeadListenedChannel();
-            while(listened)
-            {
-                if(listened->mListener->mCurrentMsg)
-                {
-                    int numMsgs = 0;
-                    StoredMsg * msg = listened->mListener->mCurrentMsg->getNext();
-                    while(msg)
-                    {
-                        StoredMsg * newMsg = channel->createStoredMsg();
-                        newMsg->copyFrom(*msg);
-
-                        channel->linkStoredMsg(newMsg);
-
-                        signalNewMessages = true;
-
-                        listened->mListener->mCurrentMsg = listened->mListener->mCurrentMsg->getNext();
-
-                        numMsgs++;
-                        if(numMsgs > NumMaxMsgsDispatched) // avoid one sender collapse the msg system
-                        {
-                            bContinue = true;
-                            msg = NULL;
-                        }
-                        else
-                        {
-                            msg = listened->mListener->mCurrentMsg->getNext();
-                        }
-                    }
-                }
-
-                listened = listened->getNext();
-            }
-
-            if(signalNewMessages)
-            {
-                ChannelListener * listener = channel->getHeadListenerChannel();
-                while(listener)
-                {
-                    if(listener->mEventMessagesAvailable)
-                    {
-                        listener->mEventMessagesAvailable->signal();
-                    }
-                    listener = listener->getNext();
-                }
-                bCallNotificationCallback = true;
-            }
-
-            channel = channel->getNext();
-        }
-
-        threadPurgeMessages(); // zzz pending : add min time between purges?
-    }
-
-    if(bCallNotificationCallback && mNotificationCallback)
-    {
-        mNotificationCallback->msgMgrNotification();
-    }
-}
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "MsgMgr.h"
+
+#include "MsgMgrAux.h"
+#include "CommNode.h"
+
+#include "NWEvent.h"
+#include "NWMultipleEvents.h"
+#include "NWCriticalSection.h"
+#include "NWAtomic.h"
+
+//****************************************************************************
+//
+//****************************************************************************
+static const int PURGE_MAX_MSGS_PER_CHANNEL = 1000;
+static const int COMM_NODE_NOTIFICATION_CALLBACK_RESERVE = 16;
+static const int DISPATCH_CHANNELS_RESERVE = 64;
+
+//****************************************************************************
+//
+//****************************************************************************
+/*static*/ MsgMgr * MsgMgr::mInstance = NULL;
+
+//****************************************************************************
+//
+//****************************************************************************
+MsgMgr_InitData::MsgMgr_InitData() :
+    mReserveChannels(0),
+    mReserveMessages(0),
+    mReserveReceivers(0),
+    mMaxRetainedMsgs(0),
+    mSlowConsumerPolicy(SLOW_CONSUMER_DROP),
+    mCreditWindow(0),
+    mNumDispatcherShards(1)
+{
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+MsgMgr::DispatchShard::DispatchShard() :
+    mMailboxUpdateEvent(NULL),
+    mThreadDispatcher(NULL),
+    mCritSec(NULL),
+    mReadyList(NULL),
+    mDispatchPass(0)
+{
+}
+
+//****************************************************************************
+// MsgMgr Singleton
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ bool MsgMgr::init(MsgMgr_InitData const * _initData)
+{
+    if(mInstance == NULL)
+    {
+        mInstance = NEW MsgMgr();
+        mInstance->initializeInstance(_initData);
+    }
+
+    return (mInstance != NULL);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ void MsgMgr::done()
+{
+    if(mInstance)
+    {
+        mInstance->shutdownInstance();
+        DISPOSE(mInstance);
+    }
+}
+
+//****************************************************************************
+// MsgMgr class
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgMgr::MsgMgr() :
+    mMaxRetainedMsgs(0),
+    mSlowConsumerPolicy(SLOW_CONSUMER_DROP),
+    mCreditWindow(0),
+    mChannelList(NULL),
+    mMsgMgrDns(NULL),
+    mCritSecAddRemoveCommNodes(NULL),
+    mCritSecDns(NULL),
+    mNotificationCallback(NULL)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgMgr::~MsgMgr()
+{
+}
+
+//****************************************************************************
+// Instance Init / Shutdown
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgMgr::initializeInstance(MsgMgr_InitData const * _initData)
+{
+    MsgMgr_InitData defaultInitData;
+    if(_initData == NULL)
+    {
+        _initData = &defaultInitData;
+    }
+
+    mChannelList = NEW ChannelList();
+    mChannelList->initialize();
+
+    mMaxRetainedMsgs = _initData->mMaxRetainedMsgs;
+    mSlowConsumerPolicy = _initData->mSlowConsumerPolicy;
+    mCreditWindow = _initData->mCreditWindow;
+
+    int numShards = _initData->mNumDispatcherShards > 0 ? _initData->mNumDispatcherShards : 1;
+    mShards.reserve(numShards);
+    for(int i=0; i<numShards; i++)
+    {
+        mShards.push_back(createShard());
+    }
+
+    mCritSecAddRemoveCommNodes = NWCriticalSection::create();
+    mCritSecDns = NWCriticalSection::create();
+
+    mMsgMgrDns = NEW MsgMgr_Dns();
+    mMsgMgrDns->initialize();
+
+    return true;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgMgr::shutdownInstance()
+{
+    mMsgMgrDns->shutdown();
+    DISPOSE(mMsgMgrDns);
+
+    int numShards = (int)mShards.size();
+    for(int i=0; i<numShards; i++)
+    {
+        NWThread::destroy(mShards[i]->mThreadDispatcher);
+    }
+
+    mChannelList->shutdown();
+    DISPOSE(mChannelList);
+    mChannelList = 0;
+
+    for(int i=0; i<numShards; i++)
+    {
+        destroyShard(mShards[i]);
+    }
+    mShards.clear();
+
+    NWCriticalSection::destroy(mCritSecAddRemoveCommNodes);
+    NWCriticalSection::destroy(mCritSecDns);
+}
+
+//****************************************************************************
+// Add channel / Remove channel / SendTo Channel
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+ChannelId MsgMgr::addCommNodeToChannel(const char * _channelName, CommNode * _commNode)
+{
+    ASSERT(_commNode);
+
+    ChannelId channelId = InvalidChannelId;
+    
+    {
+        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+
+        channelId = findChannel(_channelName);
+
+        if(channelId == InvalidChannelId)
+        {
+            MsgChannel * channel = createChannel(_channelName);
+            if(channel)
+            {
+                channelId = channel->getChannelId();
+            }
+        }
+
+        addCommNodeToChannel(channelId, _commNode);
+    }
+    
+    return channelId;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgMgr::addCommNodeToChannel(ChannelId _channelId, CommNode * _commNode)
+{
+    ASSERT(_commNode);
+
+    bool bRet = false;
+
+    ASSERT(_channelId != InvalidChannelId);
+    if(_channelId != InvalidChannelId)
+    {
+        {
+            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+            AutoShardsLock shardsLock(this); // keeps the dispatchers out while the listeners change
+
+            MsgChannel * channel = mChannelList->getChannel(_channelId);
+            ASSERT(channel);
+            if(channel)
+            {
+                MsgChannel * commNodeChannel = _commNode->getLocalChannel();
+                channel->listenTo(commNodeChannel);
+                commNodeChannel->listenTo(channel);
+                channel->updateInterestFromListeners();
+                bRet = true;
+            }
+        }
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+ChannelId MsgMgr::addCommNodeListenerToChannel(const char * _channelName, CommNode * _commNode)
+{
+    ASSERT(_commNode);
+
+    ChannelId channelId = InvalidChannelId;
+
+    {
+        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+        
+        channelId = findChannel(_channelName);
+
+        if(channelId == InvalidChannelId)
+        {
+            MsgChannel * channel = createChannel(_channelName);
+            if(channel)
+            {
+                channelId = channel->getChannelId();
+            }
+        }
+
+        addCommNodeListenerToChannel(channelId, _commNode);
+    }
+
+    return channelId;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgMgr::addCommNodeListenerToChannel(ChannelId _channelId, CommNode * _commNode)
+{
+    ASSERT(_commNode);
+
+    bool bRet = false;
+
+    ASSERT(_channelId != InvalidChannelId);
+    if(_channelId != InvalidChannelId)
+    {
+        {
+            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+            AutoShardsLock shardsLock(this); // keeps the dispatchers out while the listeners change
+
+            MsgChannel * channel = mChannelList->getChannel(_channelId);
+            ASSERT(channel);
+            if(channel)
+            {
+                MsgChannel * commNodeChannel = _commNode->getLocalChannel();
+                commNodeChannel->listenTo(channel);
+                channel->updateInterestFromListeners();
+                bRet = true;
+            }
+        }
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+ChannelId MsgMgr::addCommNodeSenderToChannel(const char * _channelName, CommNode * _commNode)
+{
+    ASSERT(_commNode);
+
+    ChannelId channelId = InvalidChannelId; 
+    
+    {
+        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+        
+        channelId = findChannel(_channelName);
+
+        if(channelId == InvalidChannelId)
+        {
+            MsgChannel * channel = createChannel(_channelName);
+            if(channel)
+            {
+                channelId = channel->getChannelId();
+            }
+        }
+
+        addCommNodeSenderToChannel(channelId, _commNode);
+    }
+
+    return channelId;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgMgr::addCommNodeSenderToChannel(ChannelId _channelId, CommNode * _commNode)
+{
+    bool bRet = false;
+
+    ASSERT(_commNode);
+    ASSERT(_channelId != InvalidChannelId);
+    if(_channelId != InvalidChannelId)
+    {
+        {
+            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+            AutoShardsLock shardsLock(this); // keeps the dispatchers out while the listeners change
+
+            MsgChannel * channel = mChannelList->getChannel(_channelId);
+            ASSERT(channel);
+            if(channel)
+            {
+                MsgChannel * commNodeChannel = _commNode->getLocalChannel();
+                channel->listenTo(commNodeChannel);
+                bRet = true;
+            }
+        }
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgMgr::removeCommNodeFromChannel(const char * _channelName, CommNode * _commNode)
+{
+    {
+        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+
+        ChannelId channelId = findChannel(_channelName, false);
+
+        if(channelId != InvalidChannelId)
+        {
+            removeCommNodeFromChannel(channelId, _commNode);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgMgr::removeCommNodeFromChannel(ChannelId _channelId, CommNode * _commNode)
+{
+    if(_channelId != InvalidChannelId)
+    {
+        {
+            NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+            AutoShardsLock shardsLock(this); // keeps the dispatchers out while the listeners change
+
+            MsgChannel * channel = mChannelList->getChannel(_channelId);
+            MsgChannel * commNodeChannel = _commNode->getLocalChannel();
+
+            if(channel)
+            {
+                threadMailboxUpdate(getShard(_channelId)); // flush the ready list, the listener being removed could be queued
+
+                channel->stopListeningTo(commNodeChannel);
+                commNodeChannel->stopListeningTo(channel);
+
+                if(channel->getNumListeners() < 1 && channel->getNumListened() < 1)
+                {
+                    destroyChannel(_channelId);
+                }
+                else
+                {
+                    channel->updateInterestFromListeners();
+                }
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// The MsgMgr channels the node listens to only store what some listener handles
+//----------------------------------------------------------------------------
+void MsgMgr::updateCommNodeInterest(CommNode * _commNode, MsgInterestSet const & _interest)
+{
+    ASSERT(_commNode);
+
+    {
+        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+        AutoShardsLock shardsLock(this); // the dispatchers read the channels interest
+
+        MsgChannel * commNodeChannel = _commNode->getLocalChannel();
+        commNodeChannel->setInterest(_interest);
+
+        ListenedChannel * listened = commNodeChannel->getHeadListenedChannel();
+        while(listened)
+        {
+            listened->mChannelListened->updateInterestFromListeners();
+            listened = listened->getNext();
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// The channel only stores the msgs some listener filter accepts
+//----------------------------------------------------------------------------
+bool MsgMgr::setCommNodeChannelFilter(CommNode * _commNode, ChannelId _channelId, MsgFilter const * _filter)
+{
+    ASSERT(_commNode);
+
+    bool bRet = false;
+
+    {
+        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes);
+        AutoShardsLock shardsLock(this); // the dispatchers read the channels filter
+
+        MsgChannel * channel = mChannelList->getChannel(_channelId);
+        if(channel)
+        {
+            ChannelListener * listener = channel->findListener(_commNode->getLocalChannel());
+            if(listener)
+            {
+                channel->setListenerFilter(listener, _filter);
+                bRet = true;
+            }
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Same thread fast path. Delivers the msg from the sender thread when every
+// listener of the channels the sender reaches is bound to that thread. The
+// msg would overtake older ones if the sender or a listener had msgs still
+// queued, or if it was sent from a direct dispatch handler, these go through
+// the dispatcher.
+//----------------------------------------------------------------------------
+bool MsgMgr::dispatchDirect(CommNode * _sender, StoredMsg const & _msg)
+{
+    ASSERT(_sender);
+
+    struct DirectTarget
+    {
+        CommNode * mCommNode;
+        ChannelId mChannelId;
+    };
+
+    DirectTarget targets[DirectDispatchMaxTargets];
+    int numTargets = 0;
+    bool bDirect = _sender->mDirectDepth == 0;
+
+    if(bDirect)
+    {
+        NWAutoCritSec critSec(mCritSecAddRemoveCommNodes); // the listeners don't change while they are collected
+
+        ChannelListener * channelListener = _sender->getLocalChannel()->getHeadListenerChannel(); // MsgMgr channels reading the sender
+        while(channelListener && bDirect)
+        {
+            MsgChannel * channel = channelListener->mChannelListener;
+
+            if(channelListener->msgsPending()) // older msgs of the sender not dispatched yet
+            {
+                bDirect = false;
+            }
+            else if(channel->acceptsMsg(&_msg))
+            {
+                ChannelListener * listener = channel->getHeadListenerChannel();
+                while(listener && bDirect)
+                {
+                    CommNode * commNode = listener->mChannelListener->getOwner();
+
+                    if(commNode == NULL || !commNode->isDirectDispatchThread() || commNode->mDirectDepth > 0 ||
+                       listener->mEvicted || listener->msgsPending() || numTargets >= DirectDispatchMaxTargets)
+                    {
+                        bDirect = false;
+                    }
+                    else if(listener->mFilter == NULL || listener->mFilter->accepts(_msg.mMessageFamily, _msg.mMessageType, _msg.mHasKey, _msg.mMsgKey))
+                    {
+                        targets[numTargets].mCommNode = commNode;
+                        targets[numTargets].mChannelId = channel->getChannelId();
+                        numTargets++;
+                    }
+
+                    listener = listener->getNext();
+                }
+            }
+
+            channelListener = channelListener->getNext();
+        }
+    }
+
+    if(bDirect)
+    {
+        _sender->mDirectDepth++;
+        for(int i=0; i<numTargets; i++)
+        {
+            targets[i].mCommNode->mDirectDepth++; // the msgs sent from the handlers are queued, after this one
+        }
+
+        for(int i=0; i<numTargets; i++)
+        {
+            CommNode * commNode = targets[i].mCommNode;
+            if(commNode->mReceiveAllMessages || _msg.mSender != commNode->mCommNodeId)
+            {
+                commNode->dispatchMsg(&_msg, targets[i].mChannelId);
+            }
+        }
+
+        for(int i=0; i<numTargets; i++)
+        {
+            targets[i].mCommNode->mDirectDepth--;
+        }
+        _sender->mDirectDepth--;
+    }
+
+    return bDirect;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgMgr::regChannelName(const char * _name, ChannelId _id)
+{
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        mMsgMgrDns->regChannelName(_name, _id);
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgMgr::unregChannelName(const char * _name)
+{
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        mMsgMgrDns->unregChannelName(_name);
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+ChannelId MsgMgr::getChannelId(const char * _name)
+{
+    ChannelId channelId = InvalidChannelId;
+
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        channelId = mMsgMgrDns->getChannelId(_name);
+    }
+
+    return channelId;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+const char * MsgMgr::getChannelName(ChannelId _channelId)
+{
+    const char * pRet = NULL;
+
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        MsgChannel * channel = mChannelList->getChannel(_channelId);
+        if(channel)
+        {
+            pRet = channel->getName();
+        }
+    }
+
+    return pRet;
+}
+
+//****************************************************************************
+// Retention
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgMgr::setChannelRetentionLimit(ChannelId _channelId, int _maxRetainedMsgs, eSlowConsumerPolicy _policy/*=SLOW_CONSUMER_DROP*/)
+{
+    bool bRet = false;
+
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        MsgChannel * channel = mChannelList->getChannel(_channelId);
+        if(channel)
+        {
+            channel->setRetentionLimit(_maxRetainedMsgs, _policy);
+            bRet = true;
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgMgr::setChannelPriority(ChannelId _channelId, eMsgPriority _priority)
+{
+    bool bRet = false;
+
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        MsgChannel * channel = mChannelList->getChannel(_channelId);
+        if(channel)
+        {
+            channel->setDefaultPriority(_priority);
+            bRet = true;
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgMgr::setChannelConflation(ChannelId _channelId, bool _conflate)
+{
+    bool bRet = false;
+
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        MsgChannel * channel = mChannelList->getChannel(_channelId);
+        if(channel)
+        {
+            channel->setConflation(_conflate);
+            bRet = true;
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgMgr::setChannelCreditWindow(ChannelId _channelId, int _window)
+{
+    bool bRet = false;
+
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        MsgChannel * channel = mChannelList->getChannel(_channelId);
+        if(channel)
+        {
+            channel->setCreditWindow(_window);
+            bRet = true;
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool MsgMgr::getChannelMetrics(ChannelId _channelId, MsgChannelMetrics & metrics_)
+{
+    bool bRet = false;
+
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        MsgChannel * channel = mChannelList->getChannel(_channelId);
+        if(channel)
+        {
+            channel->getMetrics(metrics_);
+            bRet = true;
+        }
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+// Main thread CommNodes fn : This type of nodes need help for message dispatching
+//****************************************************************************
+void MsgMgr::regNotificationCallback(MsgMgrNotificationCallback * _notificationCallback)
+{
+    mNotificationCallback = _notificationCallback;
+}
+
+void MsgMgr::addCommNodeToNotificationList(CommNode * _commNode)
+{
+    mCommNodeNotificationCallbackList.push_back(_commNode);
+}
+
+void MsgMgr::removeCommNodeFromNotificationList(CommNode * _commNode)
+{
+    mCommNodeNotificationCallbackList.remove(_commNode);
+}
+
+void MsgMgr::dispatchNotificationMessages()
+{
+    for(NotificationIt it = mCommNodeNotificationCallbackList.begin(); it != mCommNodeNotificationCallbackList.end(); it++)
+    {
+        CommNode * commNode = (*it);
+        commNode->dispatchAvailableMessages();
+    }
+}
+
+//****************************************************************************
+// Timers
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Called from the timer thread
+//----------------------------------------------------------------------------
+/*virtual*/ void MsgMgr::timerNotification()
+{
+    if(mNotificationCallback)
+    {
+        mNotificationCallback->msgMgrNotification();
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+ChannelId MsgMgr::findChannel(const char * _channelName, bool /*_createIfNotExist=true*/)
+{
+    ChannelId channelId = InvalidChannelId;
+    
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+        
+        channelId = mMsgMgrDns->getChannelId(_channelName);
+        if(channelId != InvalidChannelId && mChannelList->getChannel(channelId) == NULL)
+        {
+            channelId = InvalidChannelId; // name bound to a destroyed channel
+        }
+    }
+
+    return channelId;
+}
+
+//----------------------------------------------------------------------------
+// Called with mCritSecAddRemoveCommNodes held, the table itself is also
+// guarded by mCritSecDns as lookups by id don't take the add/remove lock
+//----------------------------------------------------------------------------
+MsgChannel * MsgMgr::createChannel(const char * _channelName)
+{
+    MsgChannel * newChannel = NULL;
+
+    {
+        NWAutoCritSec critSec(mCritSecDns);
+
+        newChannel = mChannelList->addChannel(_channelName, NULL);
+        ASSERT(newChannel); // out of channel slots
+        if(newChannel)
+        {
+            DispatchShard * shard = getShard(newChannel->getChannelId());
+            newChannel->mEventMessagesAvailable = shard->mMailboxUpdateEvent;
+            newChannel->setReadyList(shard->mReadyList);
+            newChannel->setRetentionLimit(mMaxRetainedMsgs, mSlowConsumerPolicy);
+            newChannel->setCreditWindow(mCreditWindow);
+            mMsgMgrDns->regChannelName(_channelName, newChannel->getChannelId());
+        }
+    }
+
+    return newChannel;
+}
+
+//----------------------------------------------------------------------------
+// Called with mCritSecAddRemoveCommNodes held
+//----------------------------------------------------------------------------
+void MsgMgr::destroyChannel(ChannelId _channelId)
+{
+    NWAutoCritSec critSec(mCritSecDns);
+
+    MsgChannel * channel = mChannelList->getChannel(_channelId);
+    if(channel)
+    {
+        if(mMsgMgrDns->getChannelId(channel->getName()) == _channelId)
+        {
+            mMsgMgrDns->unregChannelName(channel->getName());
+        }
+
+        mChannelList->removeChannel(_channelId);
+    }
+}
+
+//****************************************************************************
+// Dispatcher shards
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgMgr::DispatchShard * MsgMgr::createShard()
+{
+    DispatchShard * shard = NEW DispatchShard();
+
+    shard->mMailboxUpdateEvent = NWEvent::create();
+    shard->mCritSec = NWCriticalSection::create();
+
+    shard->mReadyList = NEW MsgReadyList(shard->mMailboxUpdateEvent);
+    shard->mTouchedChannels.reserve(DISPATCH_CHANNELS_RESERVE);
+
+    shard->mThreadDispatcher = NWThread::create();
+    shard->mThreadDispatcher->start(this, (void *)shard);
+
+    return shard;
+}
+
+//----------------------------------------------------------------------------
+// The dispatcher thread must have been destroyed already
+//----------------------------------------------------------------------------
+void MsgMgr::destroyShard(DispatchShard * _shard)
+{
+    ASSERT(_shard->mThreadDispatcher == NULL);
+
+    ChannelListener * pending = _shard->mReadyList->popAll(); // the channels are gone, only their detached listeners are left
+    while(pending)
+    {
+        ChannelListener * listener = pending;
+        pending = pending->mNextReady;
+
+        if(listener->mDetached)
+        {
+            DISPOSE(listener);
+        }
+    }
+
+    DISPOSE(_shard->mReadyList);
+    _shard->mTouchedChannels.clear();
+
+    NWEvent::destroy(_shard->mMailboxUpdateEvent);
+    NWCriticalSection::destroy(_shard->mCritSec);
+
+    DISPOSE(_shard);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgMgr::DispatchShard * MsgMgr::getShard(ChannelId _channelId)
+{
+    return mShards[ChannelList::getSlotIndex(_channelId) % mShards.size()];
+}
+
+//----------------------------------------------------------------------------
+// Always in the same order, the dispatchers only take their own lock
+//----------------------------------------------------------------------------
+void MsgMgr::lockAllShards()
+{
+    int numShards = (int)mShards.size();
+    for(int i=0; i<numShards; i++)
+    {
+        mShards[i]->mCritSec->enter();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgMgr::unlockAllShards()
+{
+    int numShards = (int)mShards.size();
+    for(int i=numShards-1; i>=0; i--)
+    {
+        mShards[i]->mCritSec->leave();
+    }
+}
+
+//****************************************************************************
+// Dispatcher Thread Main Fn
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ unsigned int MsgMgr::threadMain(ThreadParams const * _params)
+{
+
+    DispatchShard * shard = (DispatchShard *)_params->mUserParams;
+
+    enum eMsgThreadEvents
+    {
+        MTE_MAILBOX_UPDATE = 0,
+        MTE_END_REQUEST
+    };
+
+    NWMultipleEvents multipleEventWait(shard->mMailboxUpdateEvent, _params->mEventEndRequest);
+
+    bool bLoop = true;
+    while(bLoop)
+    {
+        int eventSignaled = multipleEventWait.waitForSignal(NWME_INFINITE); // msgs are retired by the listeners, nothing to do on timeout
+        if(eventSignaled == MTE_END_REQUEST)
+        {
+            bLoop = false;
+            continue;
+        }
+
+        if(eventSignaled == MTE_MAILBOX_UPDATE)
+        {
+            {
+            NWAutoCritSec critSec(shard->mCritSec); // avoids message processing while adding or removing nodes (or add/remove nodes while processing msgs)
+
+            threadMailboxUpdate(shard);
+            }
+        }
+    }
+
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// Drains the ready list, work is proportional to the listeners with new msgs
+//----------------------------------------------------------------------------
+void MsgMgr::threadMailboxUpdate(DispatchShard * _shard)
+{
+    bool bCallNotificationCallback = false;
+
+    ChannelListener * pending = _shard->mReadyList->popAll();
+    while(pending)
+    {
+        _shard->mDispatchPass++;
+
+        ChannelListener * again = NULL;
+        ChannelListener * againTail = NULL;
+
+        while(pending)
+        {
+            ChannelListener * listener = pending;
+            pending = pending->mNextReady;
+            listener->mNextReady = NULL;
+
+            if(listener->mDetached) // removed from its channel while it was queued
+            {
+                DISPOSE(listener);
+                continue;
+            }
+
+            bool bRequeue = threadDispatchListener(_shard, listener);
+            if(!bRequeue)
+            {
+                NWAtomic::exchange(&listener->mReady, 0);
+
+                // a sender could have linked a msg after the last check but before the flag was cleared
+                bRequeue = listener->msgsPending() && NWAtomic::exchange(&listener->mReady, 1) == 0;
+            }
+
+            if(bRequeue)
+            {
+                if(againTail)
+                    againTail->mNextReady = listener;
+                else
+                    again = listener;
+                againTail = listener;
+            }
+        }
+
+        std::vector<MsgChannel *> & touchedChannels = _shard->mTouchedChannels;
+
+        int num = (int)touchedChannels.size();
+        for(int i=0; i<num; i++)
+        {
+            MsgChannel * channel = touchedChannels[i];
+            channel->signalListeners();
+            threadPurgeChannel(channel);
+        }
+
+        if(num > 0)
+        {
+            bCallNotificationCallback = true;
+            touchedChannels.clear();
+        }
+
+        // listeners over the NumMaxMsgsDispatched quota go after the newly queued ones
+        pending = _shard->mReadyList->popAll();
+        if(againTail)
+        {
+            againTail->mNextReady = pending;
+            pending = again;
+        }
+    }
+
+    if(bCallNotificationCallback && mNotificationCallback)
+    {
+        mNotificationCallback->msgMgrNotification();
+    }
+}
+
+//----------------------------------------------------------------------------
+// Copies the new msgs of the listened channel into the listener channel,
+// returns true if the quota was reached with msgs still pending
+//----------------------------------------------------------------------------
+bool MsgMgr::threadDispatchListener(DispatchShard * _shard, ChannelListener * _listener)
+{
+    bool bRet = false;
+
+    MsgChannel * channel = _listener->mChannelListener;
+
+    if(_listener->hasCursor())
+    {
+        bool bDrop = channel->getSlowConsumerPolicy() == SLOW_CONSUMER_DROP;
+
+        int numMsgs = 0;
+        int numStored = 0;
+
+        for(int lane=0; lane<NumMsgPriorities && !bRet; lane++) // higher priority lanes first
+        {
+            int numLaneMsgs = 0;
+            StoredMsg * last = NULL;
+            StoredMsg * msg = _listener->mCurrentMsg[lane]->getNextAcquire();
+            while(msg)
+            {
+                if(numMsgs >= NumMaxMsgsDispatched) // avoid one sender collapse the msg system
+                {
+                    bRet = true;
+                    break;
+                }
+
+                if(channel->acceptsMsg(msg)) // msgs no listener handles or wants aren't stored
+                {
+                    if(bDrop && channel->isOverRetentionLimit())
+                    {
+                        channel->dropMsg();
+                    }
+                    else
+                    {
+                        StoredMsg * newMsg = channel->createStoredMsg();
+                        newMsg->copyFrom(*msg); // keeps the sender priority, the channel one applies if there isn't
+
+                        channel->linkStoredMsg(newMsg, false);
+                        numStored++;
+                    }
+                }
+
+                last = msg;
+                numMsgs++;
+                numLaneMsgs++;
+
+                msg = msg->getNextAcquire();
+            }
+
+            if(last)
+            {
+                _listener->mChannelListened->advanceCursor(_listener, lane, last, numLaneMsgs); // once per batch, it may retire the source msgs
+            }
+        }
+
+        if(numStored > 0 && channel->mDispatchPass != _shard->mDispatchPass)
+        {
+            channel->mDispatchPass = _shard->mDispatchPass;
+            _shard->mTouchedChannels.push_back(channel);
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Retires what the listeners already read and applies the retention limit
+//----------------------------------------------------------------------------
+void MsgMgr::threadPurgeChannel(MsgChannel * _channel)
+{
+    _channel->purgeSentMsgs();
+
+    if(_channel->isOverRetentionLimit() && _channel->getSlowConsumerPolicy() == SLOW_CONSUMER_DISCONNECT)
+    {
+        _channel->evictSlowListeners();
+    }
+}
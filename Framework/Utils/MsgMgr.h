@@ -43,6 +43,7 @@
 
 #include "MsgMgrDefs.h"
 #include "NWThread.h"
+#include "NWTimerService.h"
 
 class NWEvent;
 class CommNode;
@@ -51,8 +52,14 @@ class ChannelList;
 class MsgMgr_Dns;
 class NWCriticalSection;
 class MsgChannel;
+struct MsgReadyList;
+struct ChannelListener;
+class MsgInterestSet;
+class MsgFilter;
+struct StoredMsg;
 
 #include <list>
+#include <vector>
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
@@ -69,7 +76,10 @@ struct MsgMgr_InitData
     int mReserveChannels;
     int mReserveMessages;
     int mReserveReceivers;
-    int mPurgeEveryMsgs;
+    int mMaxRetainedMsgs; // default retention limit of the channels (0 = no limit)
+    eSlowConsumerPolicy mSlowConsumerPolicy;
+    int mCreditWindow; // default flow control window of the channels (0 = the senders never wait)
+    int mNumDispatcherShards; // dispatcher threads, channels are assigned to them by id (1 = single dispatcher)
 
     MsgMgr_InitData();
 };
@@ -87,7 +97,7 @@ public:
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-class MsgMgr : public NWThreadFn
+class MsgMgr : public NWThreadFn, public NWTimerNotificationCallback
 {
 public:
     // singleton management
@@ -107,17 +117,35 @@ public:
 
     void removeCommNodeFromChannel(const char * _channelName, CommNode * _commNode);
     void removeCommNodeFromChannel(ChannelId _channelId, CommNode * _commNode);
+
+    void updateCommNodeInterest(CommNode * _commNode, MsgInterestSet const & _interest);
+    bool setCommNodeChannelFilter(CommNode * _commNode, ChannelId _channelId, MsgFilter const * _filter);
+    bool dispatchDirect(CommNode * _sender, StoredMsg const & _msg); // false if the msg has to go through the dispatcher
     
     template <class T> void sendMessageTo(const char * _channelName, T const * _msg, CommNodeId _from);
     template <class T> void sendMessageTo(ChannelId _channel, T const * _msg, CommNodeId _from);
     void sendMessageTo(ChannelId _channel, int _messageType, int _messageFamily, unsigned char * _msg, int _msgDataSize, CommNodeId _from);
 
-    // DNS - Refcounted, last one inserted with same name persists
+    // DNS - last one registered with same name persists
     void regChannelName(const char * _name, ChannelId _id);
     void unregChannelName(const char * _name);
     ChannelId getChannelId(const char * _name);
     const char * getChannelName(ChannelId _channelId);
 
+    // Retention : msgs kept for the slowest listener, over the limit the policy is applied
+    bool setChannelRetentionLimit(ChannelId _channelId, int _maxRetainedMsgs, eSlowConsumerPolicy _policy=SLOW_CONSUMER_DROP);
+    bool getChannelMetrics(ChannelId _channelId, MsgChannelMetrics & metrics_);
+
+    // Priority lane of the msgs sent to the channel without priority
+    bool setChannelPriority(ChannelId _channelId, eMsgPriority _priority);
+
+    // Conflation : a listener skips the msgs it didn't read yet once a newer msg of the same type and
+    // key is sent, for channels carrying state where only the latest value matters
+    bool setChannelConflation(ChannelId _channelId, bool _conflate);
+
+    // Flow control : the senders wait while a listener of the channel is _window msgs behind
+    bool setChannelCreditWindow(ChannelId _channelId, int _window);
+
     // Main thread CommNodes fn : This type of nodes need help for message dispatching
     void regNotificationCallback(MsgMgrNotificationCallback * _notificationCallback);
 
@@ -129,18 +157,40 @@ public:
 protected:
     virtual unsigned int threadMain(ThreadParams const * _params); // dispatcher thread entry point
 
+    virtual void timerNotification(); // CommNode timers expired in notification list nodes
+
 private:
-    struct MsgMgrThreadParams
+    // One dispatcher thread and its work lists. A channel is only written by
+    // the shard owning it, the ordering of the msgs of a sender to a channel
+    // is kept. Senders and other shards hand listeners over through the lock
+    // free ready list of the owner shard.
+    struct DispatchShard
     {
         NWEvent * mMailboxUpdateEvent;
-        MsgMgrThreadParams() : mMailboxUpdateEvent(0) {}
+        NWThread * mThreadDispatcher;
+        NWCriticalSection * mCritSec; // held while dispatching, topology changes take every shard
+
+        MsgReadyList * mReadyList; // listeners with msgs waiting to be dispatched
+        u32 mDispatchPass;
+        std::vector<MsgChannel *> mTouchedChannels; // channels that received msgs in the current pass
+
+        DispatchShard();
+    };
+
+    struct AutoShardsLock
+    {
+        MsgMgr * mMsgMgr;
+        AutoShardsLock(MsgMgr * _msgMgr) : mMsgMgr(_msgMgr) {mMsgMgr->lockAllShards();}
+        ~AutoShardsLock() {mMsgMgr->unlockAllShards();}
     };
+    friend struct AutoShardsLock;
 
     static MsgMgr * mInstance;
    
-    NWEvent * mMailboxUpdateEvent;
-    NWThread * mThreadDispatcher;
-    MsgMgrThreadParams mMsgMgrThreadParams;
+    std::vector<DispatchShard *> mShards;
+    int mMaxRetainedMsgs;
+    eSlowConsumerPolicy mSlowConsumerPolicy;
+    int mCreditWindow;
 
     ChannelList * mChannelList;
     MsgMgr_Dns * mMsgMgrDns;
@@ -148,8 +198,6 @@ private:
     NWCriticalSection * mCritSecAddRemoveCommNodes;
     NWCriticalSection * mCritSecDns;
 
-    ChannelId mChannelIdGenerator;
-
     MsgMgrNotificationCallback * mNotificationCallback;
 
     std::list<CommNode *> mCommNodeNotificationCallbackList;
@@ -162,12 +210,19 @@ private:
     void shutdownInstance();
 
     ChannelId findChannel(const char * _channelName, bool _createIfNotExist=true);
-    ChannelId generateChannelId(); 
 
-    void threadPurgeMessages();
-    void threadMailboxUpdate();
+    DispatchShard * createShard();
+    void destroyShard(DispatchShard * _shard);
+    DispatchShard * getShard(ChannelId _channelId);
+    void lockAllShards();
+    void unlockAllShards();
+
+    void threadMailboxUpdate(DispatchShard * _shard);
+    bool threadDispatchListener(DispatchShard * _shard, ChannelListener * _listener);
+    void threadPurgeChannel(MsgChannel * _channel);
 
     MsgChannel * createChannel(const char * _channelName);
+    void destroyChannel(ChannelId _channelId);
 };
 
 //----------------------------------------------------------------------------
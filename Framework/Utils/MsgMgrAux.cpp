@@ -42,13 +42,28 @@
 
 #include "MsgMgrAux.h"
 #include "NWEvent.h"
+#include "NWAtomic.h"
+#include "NWTime.h"
+#include "NWThread.h"
 #include "MsgTypes.h"
 
 #include "MemoryUtils.h"
 
 #include "Log.h"
 
-#include <windows.h>
+#include <string.h>
+
+enum
+{
+    CreditPollMs = 10 // a waiting sender checks its credits at least this often
+};
+
+//****************************************************************************
+//
+//****************************************************************************
+/*static*/ NWSlabStats StoredMsg::sSlabStats = NWSLAB_STATS_INIT("StoredMsg", -1, -1);
+/*static*/ NWSlabStats ChannelListener::sSlabStats = NWSLAB_STATS_INIT("ChannelListener", -1, -1);
+/*static*/ NWSlabStats ListenedChannel::sSlabStats = NWSLAB_STATS_INIT("ListenedChannel", -1, -1);
 
 //****************************************************************************
 //
@@ -62,38 +77,67 @@ StoredMsg::StoredMsg(u64 _msgRefId) :
     mMessageFamily(0),
     mMsgData(NULL),
     mDataLen(0),
-    mMsgRefId(_msgRefId)
+    mMsgRefId(_msgRefId),
+    mPriority(MSG_PRIORITY_DEFAULT),
+    mPins(0),
+    mHasKey(false),
+    mMsgKey(0),
+    mConflatable(false),
+    mSuperseded(0)
 {
 }
 
-StoredMsg::StoredMsg(CommNodeId _sender, int _messageType, int _messageFamily, NWBaseMsgInternal * _msgData, int _dataLen, u64 _msgRefId)
+StoredMsg::StoredMsg(CommNodeId _sender, int _messageType, int _messageFamily, NWBaseMsgInternal const * _msgData, int _dataLen, u64 _msgRefId)
 {
     mSender = _sender;
     mMessageType = _messageType;
     mMessageFamily = _messageFamily;
-    mMsgData = NULL;
-    if(_msgData)
+    mMsgData = _msgData;
+    if(mMsgData)
     {
-        mMsgData = _msgData->createInstance();
-        mMsgData->cloneFrom(_msgData);
+        mMsgData->addRef();
     }
     mDataLen = _dataLen;
     mMsgRefId = _msgRefId;
+    mPriority = MSG_PRIORITY_DEFAULT;
+    mPins = 0;
+    mHasKey = false;
+    mMsgKey = 0;
+    mConflatable = false;
+    mSuperseded = 0;
 }
 
 StoredMsg::~StoredMsg()
 {
-    DISPOSE(mMsgData);
+    if(mMsgData)
+    {
+        mMsgData->release();
+        mMsgData = NULL;
+    }
 }
 
+//----------------------------------------------------------------------------
+// Shares the payload, it is released with the last StoredMsg referencing it
+//----------------------------------------------------------------------------
 void StoredMsg::copyFrom(StoredMsg const & _other)
 {
+    if(_other.mMsgData)
+    {
+        _other.mMsgData->addRef();
+    }
+    if(mMsgData)
+    {
+        mMsgData->release();
+    }
+
     mSender = _other.mSender;
     mMessageType = _other.mMessageType;
     mMessageFamily = _other.mMessageFamily;
-    mMsgData = _other.mMsgData->createInstance();
-    mMsgData->cloneFrom(_other.mMsgData);
+    mMsgData = _other.mMsgData;
     mDataLen = _other.mDataLen;
+    mPriority = _other.mPriority;
+    mHasKey = _other.mHasKey;
+    mMsgKey = _other.mMsgKey;
 }
 
 //****************************************************************************
@@ -103,12 +147,81 @@ void StoredMsg::copyFrom(StoredMsg const & _other)
 //
 //----------------------------------------------------------------------------
 
-ChannelListener::ChannelListener(MsgChannel * _channelListener, StoredMsg * _currentMsg)
+ChannelListener::ChannelListener(MsgChannel * _channelListener, MsgChannel * _channelListened)
 {
     mChannelListener = _channelListener;
+    mChannelListened = _channelListened;
     mChannelId = _channelListener ? _channelListener->getChannelId() : InvalidChannelId;
     mEventMessagesAvailable = _channelListener ? _channelListener->getEventMessageAvailable() : NULL;
-    mCurrentMsg = _currentMsg;
+    for(int lane=0; lane<NumMsgPriorities; lane++)
+    {
+        mCurrentMsg[lane] = NULL;
+    }
+    mConsumedMsgs = 0;
+    mReadyList = _channelListener ? _channelListener->getReadyList() : NULL;
+    mNextReady = NULL;
+    mReady = 0;
+    mEvicted = 0;
+    mDetached = 0;
+    mFilter = NULL;
+}
+
+ChannelListener::~ChannelListener()
+{
+    DISPOSE(mFilter);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MsgReadyList::MsgReadyList(NWEvent * _eventReady) :
+    mHead(NULL),
+    mEventReady(_eventReady)
+{
+}
+
+//----------------------------------------------------------------------------
+// Called from the sender threads
+//----------------------------------------------------------------------------
+void MsgReadyList::push(ChannelListener * _listener)
+{
+    if(NWAtomic::exchange(&_listener->mReady, 1) == 0) // already queued otherwise, the dispatcher will see the new msgs
+    {
+        ChannelListener * head = NULL;
+        do
+        {
+            head = mHead;
+            _listener->mNextReady = head;
+        }
+        while(NWAtomic::compareExchangePtr(&mHead, _listener, head) != head);
+
+        if(head == NULL && mEventReady) // the dispatcher drains the whole list on each wake up
+        {
+            mEventReady->signal();
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Called from the dispatcher thread
+//----------------------------------------------------------------------------
+ChannelListener * MsgReadyList::popAll()
+{
+    ChannelListener * list = NWAtomic::exchangePtr(&mHead, (ChannelListener *)NULL);
+
+    ChannelListener * reversed = NULL;
+    while(list)
+    {
+        ChannelListener * next = list->mNextReady;
+        list->mNextReady = reversed;
+        reversed = list;
+        list = next;
+    }
+
+    return reversed;
 }
 
 //****************************************************************************
@@ -134,15 +247,44 @@ MsgChannel::MsgChannel() :
     mInitd(false),
     mChannelName("INVALID"),
     mChannelId(InvalidChannelId),
-    mHeadMsgList(NULL),
-    mTailMsg(NULL),
+    mDefaultPriority(MSG_PRIORITY_NORMAL),
     mHeadListenerDList(NULL),
+    mListenersReaders(0),
+    mListenersLocked(0),
     mHeadListenedDList(NULL),
     mNumListeners(0),
     mNumListened(0),
     mEventMessagesAvailable(NULL),
-    mMsgRefIdSeed(0)
+    mMsgRefIdSeed(0),
+    mPurging(0),
+    mPurgeRequested(0),
+    mReadyList(NULL),
+    mOwner(NULL),
+    mDispatchPass(0),
+    mMaxRetainedMsgs(0),
+    mSlowConsumerPolicy(SLOW_CONSUMER_DROP),
+    mNumRetained(0),
+    mLinkedMsgs(0),
+    mPeakRetained(0),
+    mRetiredMsgs(0),
+    mDroppedMsgs(0),
+    mDisconnectedListeners(0),
+    mCreditWindow(0),
+    mCreditEvent(NULL),
+    mCreditWaiters(0),
+    mCreditWaits(0),
+    mConflating(false),
+    mConflationCritSec(NULL),
+    mConflatedMsgs(0),
+    mStarvationLimit(DefaultLaneStarvationLimit),
+    mPendingListened(NULL),
+    mPendingLane(-1),
+    mPendingLanesMask(0)
 {
+    for(int lane=0; lane<NumMsgPriorities; lane++)
+    {
+        mLaneStreak[lane] = 0;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -166,6 +308,17 @@ void MsgChannel::init(const char * _name, ChannelId _channelId, NWEvent * _event
         mChannelId = _channelId;
         mEventMessagesAvailable = _eventMsgAvailable;
 
+        for(int lane=0; lane<NumMsgPriorities; lane++)
+        {
+            mLanes[lane].mTailMsg = NEW StoredMsg(InvalidCommNodeID, MsgType_Internal, MsgFamily_Null, NULL, 0, generateMsgRefId()); // stub, the queue is never empty
+            mLanes[lane].mHeadMsg = mLanes[lane].mTailMsg;
+        }
+        mNumRetained = 0;
+        mPeakRetained = 0;
+
+        mCreditEvent = NWEvent::create();
+        mConflationCritSec = NWCriticalSection::create();
+
         mInitd = true;
     }
 }
@@ -189,10 +342,10 @@ void MsgChannel::shutdown()
             stopListeningTo(mHeadListenedDList->mListener->mChannelListener);
         }
 
-        while(mHeadMsgList)
-        {
-            unlinkAndDestroyStoredMsgHead();
-        }
+        destroyAllStoredMsgs();
+
+        NWEvent::destroy(mCreditEvent);
+        NWCriticalSection::destroy(mConflationCritSec);
 
         mInitd = false;
     }
@@ -236,15 +389,12 @@ bool MsgChannel::testMsgAvailable(ChannelId _channelId/*=InvalidChannelId*/)
     ListenedChannel * listened = mHeadListenedDList;
     while(listened)
     {
-        if(_channelId == InvalidChannelId || listened->mListener->mChannelListener->getChannelId() == _channelId)
+        if(_channelId == InvalidChannelId || listened->mChannelListened->getChannelId() == _channelId)
         {
-            if(listened->mListener->mCurrentMsg)
+            if(listened->mListener->msgsPending())
             {
-                if(listened->mListener->mCurrentMsg->getNext())
-                {
-                    bRet = true;
-                    break;
-                }
+                bRet = true;
+                break;
             }
         }
 
@@ -261,18 +411,35 @@ StoredMsg * MsgChannel::getAvailableMsg(ChannelId & msgFromChannel_, ChannelId _
 {
     StoredMsg * pRet = NULL;
 
+    ListenedChannel * candidates[NumMsgPriorities]; // first channel with msgs in every lane
+    u32 lanesMask = 0;
+
+    for(int lane=0; lane<NumMsgPriorities; lane++)
+    {
+        candidates[lane] = NULL;
+    }
+
     ListenedChannel * listened = mHeadListenedDList;
     while(listened)
     {
-        if(_channelId == InvalidChannelId || listened->mListener->mChannelListener->getChannelId() == _channelId)
+        ChannelListener * listener = listened->mListener;
+
+        if(listener->mEvicted && listener->hasCursor())
         {
-            if(listened->mListener->mCurrentMsg)
+            listened->mChannelListened->releaseCursor(listener);
+        }
+
+        if(_channelId == InvalidChannelId || listened->mChannelListened->getChannelId() == _channelId)
+        {
+            if(listener->hasCursor())
             {
-                if(listened->mListener->mCurrentMsg->getNext())
+                for(int lane=0; lane<NumMsgPriorities; lane++)
                 {
-                    pRet = listened->mListener->mCurrentMsg->getNext();
-                    msgFromChannel_ = listened->mListener->mChannelListener->getChannelId();
-                    break;
+                    if(candidates[lane] == NULL && skipFilteredMsgs(listened, lane))
+                    {
+                        candidates[lane] = listened;
+                        lanesMask |= 1 << lane;
+                    }
                 }
             }
         }
@@ -280,6 +447,21 @@ StoredMsg * MsgChannel::getAvailableMsg(ChannelId & msgFromChannel_, ChannelId _
         listened = listened->getNext();
     }
 
+    mPendingListened = NULL;
+    mPendingLane = -1;
+
+    if(lanesMask)
+    {
+        int lane = selectLane(candidates);
+
+        mPendingListened = candidates[lane];
+        mPendingLane = lane;
+        mPendingLanesMask = lanesMask;
+
+        pRet = mPendingListened->mListener->mCurrentMsg[lane]->getNextAcquire();
+        msgFromChannel_ = mPendingListened->mChannelListened->getChannelId();
+    }
+
     return pRet;
 }
 
@@ -288,22 +470,29 @@ StoredMsg * MsgChannel::getAvailableMsg(ChannelId & msgFromChannel_, ChannelId _
 //----------------------------------------------------------------------------
 void MsgChannel::nextAvailableMsg(ChannelId _channelId/*=InvalidChannelId*/)
 {
-    ListenedChannel * listened = mHeadListenedDList;
-    while(listened)
+    if(mPendingListened == NULL)
     {
-        if(_channelId == InvalidChannelId || listened->mListener->mChannelListener->getChannelId() == _channelId)
+        ChannelId msgFromChannel = InvalidChannelId;
+        getAvailableMsg(msgFromChannel, _channelId);
+    }
+
+    if(mPendingListened)
+    {
+        ChannelListener * listener = mPendingListened->mListener;
+        int lane = mPendingLane;
+
+        if(listener->hasCursor())
         {
-            if(listened->mListener->mCurrentMsg)
+            StoredMsg * msg = listener->mCurrentMsg[lane]->getNextAcquire();
+            if(msg)
             {
-                if(listened->mListener->mCurrentMsg->getNext())
-                {
-                    listened->mListener->mCurrentMsg = listened->mListener->mCurrentMsg->getNext();
-                    break;
-                }
+                mPendingListened->mChannelListened->advanceCursor(listener, lane, msg);
+                consumeLane(lane, mPendingLanesMask);
             }
         }
 
-        listened = listened->getNext();
+        mPendingListened = NULL;
+        mPendingLane = -1;
     }
 }
 
@@ -316,27 +505,36 @@ void MsgChannel::waitForListeners(ChannelId _channelId/*=InvalidChannelId*/)
 
     while(bContinue)
     {
-        u64 minMsgRefId = 0xffffffffffffffff;
+        bContinue = false;
 
-        ChannelListener * head = mHeadListenerDList;
-        while(head)
         {
-            if(_channelId==InvalidChannelId || head->mChannelId == _channelId)
+            AutoListenersRead listenersRead(this);
+
+            ChannelListener * head = mHeadListenerDList;
+            while(head && !bContinue)
             {
-                if(minMsgRefId > head->mCurrentMsg->mMsgRefId)
-                    minMsgRefId = head->mCurrentMsg->mMsgRefId;
-            }
+                if(_channelId==InvalidChannelId || head->mChannelId == _channelId)
+                {
+                    if(head->hasCursor())
+                    {
+                        for(int lane=0; lane<NumMsgPriorities; lane++)
+                        {
+                            if(head->mCurrentMsg[lane] != mLanes[lane].mTailMsg) // msg ids aren't ordered between senders, compare positions
+                            {
+                                bContinue = true;
+                                break;
+                            }
+                        }
+                    }
+                }
 
-            head = head->getNext();
+                head = head->getNext();
+            }
         }
 
-        if(mTailMsg && minMsgRefId < mTailMsg->mMsgRefId)
-        {
-            Sleep(0);
-        }
-        else
+        if(bContinue)
         {
-            bContinue = false;
+            NWThread::yield();
         }
     }
 }
@@ -349,13 +547,26 @@ void MsgChannel::waitForListeners(ChannelId _channelId/*=InvalidChannelId*/)
 //----------------------------------------------------------------------------
 ChannelListener * MsgChannel::addListener(MsgChannel * _listener)
 {
-    if(!mTailMsg)
+    // the tail could be retired while it gets pinned, keep the purge out
+    while(NWAtomic::exchange(&mPurging, 1) != 0)
     {
-        mTailMsg = NEW StoredMsg(InvalidCommNodeID, MsgType_Internal, MsgFamily_Null, NULL, 0, generateMsgRefId()/*0xffffffffffffffff*/);
-        mHeadMsgList = mTailMsg;
+        NWThread::yield();
     }
 
-    ChannelListener * listener = createListener(_listener, mTailMsg);
+    ChannelListener * listener = createListener(_listener);
+
+    if(listener)
+    {
+        for(int lane=0; lane<NumMsgPriorities; lane++)
+        {
+            StoredMsg * tail = mLanes[lane].mTailMsg; // only msgs sent from now on
+            NWAtomic::increment(&tail->mPins);
+            listener->mCurrentMsg[lane] = tail;
+        }
+        listener->mConsumedMsgs = NWAtomic::load64(&mLinkedMsgs);
+    }
+
+    NWAtomic::exchange(&mPurging, 0);
 
     if(listener)
     {
@@ -375,6 +586,7 @@ void MsgChannel::removeListener(MsgChannel * _listener)
 
     if(listener)
     {
+        releaseCursor(listener);
         unlinkAndDestroyListener(listener);
     }
 }
@@ -391,36 +603,95 @@ StoredMsg * MsgChannel::createStoredMsg()
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-void MsgChannel::unlinkAndDestroyStoredMsgHead()
+bool MsgChannel::unlinkAndDestroyStoredMsgHead(MsgLane & _lane)
 {
-    if(mHeadMsgList)
-    {
-        StoredMsg * msg = mHeadMsgList;
-        mHeadMsgList = msg->getNext();
+    bool bRet = false;
 
-        if(msg == mTailMsg)
-            mTailMsg = NULL;
+    StoredMsg * msg = _lane.mHeadMsg;
+    StoredMsg * next = msg ? msg->getNextAcquire() : NULL;
 
+    if(next) // a msg without next could be the tail or a sender could be linking after it
+    {
+        NWAtomic::exchangePtr(&_lane.mHeadMsg, next); // full barrier, the pins of the new head are read after it is published
+        if(msg->mConflatable)
+        {
+            forgetConflatedMsg(msg);
+        }
         DISPOSE(msg);
+        NWAtomic::decrement(&mNumRetained);
+        mRetiredMsgs++;
+        bRet = true;
     }
+
+    return bRet;
 }
 
 //----------------------------------------------------------------------------
-//
+// No senders nor listeners left
+//----------------------------------------------------------------------------
+void MsgChannel::destroyAllStoredMsgs()
+{
+    for(int lane=0; lane<NumMsgPriorities; lane++)
+    {
+        MsgLane & msgLane = mLanes[lane];
+
+        while(msgLane.mHeadMsg)
+        {
+            StoredMsg * msg = msgLane.mHeadMsg;
+            msgLane.mHeadMsg = msg->getNext();
+            DISPOSE(msg);
+        }
+
+        msgLane.mTailMsg = NULL;
+    }
+
+    mConflationMap.clear();
+    mNumRetained = 0;
+}
+
+//----------------------------------------------------------------------------
+// Can be called from any thread. For the msgs created at run time, the typed
+// sendMessage ends up here too
+//----------------------------------------------------------------------------
+void MsgChannel::sendMessageData(NWBaseMsgInternal * _msgData, int _msgFamily, int _msgType, int _dataLen, CommNodeId _sender, int _priority/*=MSG_PRIORITY_DEFAULT*/)
+{
+    ASSERT(_msgData);
+
+    StoredMsg * storedMsg = createStoredMsg();
+    storedMsg->mSender = _sender;
+    storedMsg->mMsgData = _msgData;
+    storedMsg->mMessageFamily = _msgFamily;
+    storedMsg->mMessageType = _msgType;
+    storedMsg->mDataLen = _dataLen;
+    storedMsg->mPriority = _priority;
+    storedMsg->mHasKey = _msgData->getMsgKey(storedMsg->mMsgKey);
+
+    linkStoredMsg(storedMsg);
+}
+
+//----------------------------------------------------------------------------
+// Can be called from any thread
 //----------------------------------------------------------------------------
-void MsgChannel::linkStoredMsg(StoredMsg * _msg)
+void MsgChannel::linkStoredMsg(StoredMsg * _msg, bool _signalListeners/*=true*/)
 {
-    StoredMsg * tail = mTailMsg;
+    _msg->setNext(NULL);
 
-    mTailMsg = _msg;
+    long numRetained = NWAtomic::increment(&mNumRetained);
+    if(numRetained > mPeakRetained)
+        mPeakRetained = numRetained; // approximated when several threads send
+    NWAtomic::exchangeAdd64(&mLinkedMsgs, 1);
 
-    if(!mHeadMsgList)
-        mHeadMsgList = _msg;
+    if(mConflating)
+    {
+        registerConflatedMsg(_msg);
+    }
 
-    if(tail)
-        tail->setNext(_msg);
+    StoredMsg * prev = NWAtomic::exchangePtr(&mLanes[getLane(_msg)].mTailMsg, _msg);
 
-    signalListeners();
+    prev->setNextRelease(_msg); // readers see the msg from now on
+
+    if(_signalListeners)
+        signalListeners();
 }
 
 //****************************************************************************
@@ -429,23 +700,37 @@ void MsgChannel::linkStoredMsg(StoredMsg * _msg)
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-ChannelListener * MsgChannel::createListener(MsgChannel * _channelListener, StoredMsg * _currentMsg)
+ChannelListener * MsgChannel::createListener(MsgChannel * _channelListener)
 {
-    return NEW ChannelListener(_channelListener, _currentMsg);
+    return NEW ChannelListener(_channelListener, this);
 }
 
 //----------------------------------------------------------------------------
-//
+// Called with the dispatchers locked. The senders don't reach the listener
+// once unlinked, but it could be queued in a ready list already, the
+// dispatcher that pops it destroys it then
 //----------------------------------------------------------------------------
 void MsgChannel::unlinkAndDestroyListener(ChannelListener * _listener)
 {
     if(_listener)
     {
+        lockListeners();
+
         if(_listener == mHeadListenerDList)
             mHeadListenerDList = _listener->getNext();
 
         _listener->unlink();
-        DISPOSE(_listener);
+
+        unlockListeners();
+
+        if(_listener->mReadyList == NULL || NWAtomic::exchange(&_listener->mReady, 1) == 0)
+        {
+            DISPOSE(_listener);
+        }
+        else
+        {
+            NWAtomic::exchange(&_listener->mDetached, 1);
+        }
         mNumListeners--;
     }
 }
@@ -455,6 +740,8 @@ void MsgChannel::unlinkAndDestroyListener(ChannelListener * _listener)
 //----------------------------------------------------------------------------
 void MsgChannel::linkListener(ChannelListener * _listener)
 {
+    lockListeners();
+
     if(mHeadListenerDList)
     {
         ChannelListener * tail = mHeadListenerDList->getTail();
@@ -464,6 +751,8 @@ void MsgChannel::linkListener(ChannelListener * _listener)
     {
         mHeadListenerDList = _listener;
     }
+
+    unlockListeners();
 }
 
 //----------------------------------------------------------------------------
@@ -487,6 +776,56 @@ ChannelListener * MsgChannel::findListener(MsgChannel * _channelListener)
     return pRet;
 }
 
+//----------------------------------------------------------------------------
+// The senders and the credit checks walk the listeners without the MsgMgr
+// locks, the list only changes while no reader is inside
+//----------------------------------------------------------------------------
+void MsgChannel::enterListenersRead()
+{
+    NWAtomic::increment(&mListenersReaders); // full barrier, the lock flag is read after the reader is counted
+    while(mListenersLocked)
+    {
+        NWAtomic::decrement(&mListenersReaders);
+        while(mListenersLocked)
+        {
+            NWThread::yield();
+        }
+        NWAtomic::increment(&mListenersReaders);
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgChannel::leaveListenersRead()
+{
+    NWAtomic::decrement(&mListenersReaders);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgChannel::lockListeners()
+{
+    while(NWAtomic::exchange(&mListenersLocked, 1) != 0)
+    {
+        NWThread::yield();
+    }
+
+    while(mListenersReaders != 0)
+    {
+        NWThread::yield();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgChannel::unlockListeners()
+{
+    NWAtomic::exchange(&mListenersLocked, 0);
+}
+
 //****************************************************************************
 //
 //****************************************************************************
@@ -508,6 +847,9 @@ void MsgChannel::unlinkAndDestroyListened(ListenedChannel * _listened)
         if(_listened == mHeadListenedDList)
             mHeadListenedDList = _listened->getNext();
 
+        if(_listened == mPendingListened)
+            mPendingListened = NULL;
+
         _listened->unlink();
         DISPOSE(_listened);
 
@@ -554,203 +896,497 @@ ListenedChannel * MsgChannel::findListened(MsgChannel * _listenedChannel)
 
 u64 MsgChannel::generateMsgRefId()
 {
-    mMsgRefIdSeed++;
-    
-    return mMsgRefIdSeed;
+    return (u64)NWAtomic::increment64(&mMsgRefIdSeed);
 }
 
 void MsgChannel::signalListeners()
 {
+    AutoListenersRead listenersRead(this);
+
     ChannelListener * head = mHeadListenerDList;
     while(head)
     {
         //if(!head->mCurrentMsg)
         //    head->mCurrentMsg = mHeadMsgList;
 
-        if(head->mEventMessagesAvailable)
+        if(head->mReadyList)
+            head->mReadyList->push(head);
+        else if(head->mEventMessagesAvailable)
             head->mEventMessagesAvailable->signal();
 
         head = head->getNext();
     }
 }
 
+//****************************************************************************
+// Retirement
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Only one thread purges at a time, a request made while another thread is
+// purging makes it run again
+//----------------------------------------------------------------------------
 void MsgChannel::purgeSentMsgs()
 {
-    u64 minRefId = getMinMsgRefId();
-    purgeSentMsgs(minRefId);
-}
+    NWAtomic::exchange(&mPurgeRequested, 1);
 
-void MsgChannel::purgeSentMsgs(u64 _minMsgRefId)
-{
-    while(mHeadMsgList && _minMsgRefId > mHeadMsgList->mMsgRefId && mHeadMsgList != mTailMsg)
+    while(NWAtomic::exchange(&mPurging, 1) == 0)
     {
-        unlinkAndDestroyStoredMsgHead();
+        NWAtomic::exchange(&mPurgeRequested, 0);
+
+        for(int lane=0; lane<NumMsgPriorities; lane++)
+        {
+            MsgLane & msgLane = mLanes[lane];
+
+            while(msgLane.mHeadMsg->mPins == 0 && unlinkAndDestroyStoredMsgHead(msgLane))
+            {
+            }
+        }
+
+        NWAtomic::exchange(&mPurging, 0);
+
+        signalCredit();
+
+        if(mPurgeRequested == 0)
+            break;
     }
 }
 
-u64 MsgChannel::getMinMsgRefId()
+//----------------------------------------------------------------------------
+// Called by the thread owning the cursor. The new msg is pinned before the
+// old one is released so the msgs ahead of a cursor are never retired.
+//----------------------------------------------------------------------------
+void MsgChannel::advanceCursor(ChannelListener * _listener, int _lane, StoredMsg * _msg, int _numMsgs/*=1*/)
 {
-    u64 minMsgRefId = 0xffffffffffffffff;
+    StoredMsg * prev = _listener->mCurrentMsg[_lane];
 
-    ChannelListener * head = mHeadListenerDList;
-    while(head)
+    if(prev != _msg)
     {
-        if(minMsgRefId > head->mCurrentMsg->mMsgRefId)
-            minMsgRefId = head->mCurrentMsg->mMsgRefId;
+        NWAtomic::increment(&_msg->mPins);
+        NWAtomic::storeRelease(&_listener->mCurrentMsg[_lane], _msg);
+        NWAtomic::exchangeAdd64(&_listener->mConsumedMsgs, (u64)_numMsgs);
 
-        head = head->getNext();
+        if(NWAtomic::decrement(&prev->mPins) == 0 && prev == mLanes[_lane].mHeadMsg)
+        {
+            purgeSentMsgs();
+        }
+        else
+        {
+            signalCredit(); // the senders could be waiting on this listener and not on the oldest one
+        }
     }
-
-    return minMsgRefId;
 }
 
-//****************************************************************************
-//
-//****************************************************************************
 //----------------------------------------------------------------------------
-//
+// The listener stops reading, it doesn't hold any msg from now on
 //----------------------------------------------------------------------------
-ChannelList::ChannelList() : 
-    mHeadChannelList(NULL),
-    mTailChannel(NULL)
+void MsgChannel::releaseCursor(ChannelListener * _listener)
 {
+    if(_listener->hasCursor())
+    {
+        bool bPurge = false;
+
+        for(int lane=0; lane<NumMsgPriorities; lane++)
+        {
+            StoredMsg * prev = _listener->mCurrentMsg[lane];
+            NWAtomic::storeRelease(&_listener->mCurrentMsg[lane], (StoredMsg *)NULL);
+
+            if(NWAtomic::decrement(&prev->mPins) == 0)
+            {
+                bPurge = true;
+            }
+        }
+
+        if(bPurge)
+        {
+            purgeSentMsgs();
+        }
+    }
 }
 
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-ChannelList::~ChannelList()
+void MsgChannel::dropMsg()
 {
-    shutdown();
+    NWAtomic::increment64(&mDroppedMsgs);
 }
 
 //----------------------------------------------------------------------------
-//
+// The listeners parked on the head msg are the ones holding the retention,
+// they release their cursors and leave the channel from their own thread
 //----------------------------------------------------------------------------
-bool ChannelList::initialize()
+int MsgChannel::evictSlowListeners()
 {
-    bool bRet = false;
+    int numEvicted = 0;
 
-    if(!mInitd)
+    AutoListenersRead listenersRead(this);
+
+    ChannelListener * head = mHeadListenerDList;
+    while(head)
     {
-        mInitd = true;
-        bRet = mInitd;
-    }
+        bool bOldest = false; // parked on the oldest msg of a lane with msgs retained
 
-    return bRet;
-}
+        if(head->mReadyList == NULL && !head->mEvicted)
+        {
+            for(int lane=0; lane<NumMsgPriorities && !bOldest; lane++)
+            {
+                StoredMsg * headMsg = mLanes[lane].mHeadMsg;
+                bOldest = headMsg->getNextAcquire() && NWAtomic::loadAcquire(&head->mCurrentMsg[lane]) == headMsg;
+            }
+        }
 
-//----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-void ChannelList::shutdown()
-{
-    if(mInitd)
-    {
-        while(mTailChannel)
+        if(bOldest)
         {
-            MsgChannel * head = mHeadChannelList;
-            mHeadChannelList = mHeadChannelList->getNext();
+            NWAtomic::exchange(&head->mEvicted, 1);
+            NWAtomic::increment(&mDisconnectedListeners);
+            numEvicted++;
 
-            unlinkAndDestroyChannel(head->getChannelId());
+            LOG("MsgChannel %s : slow consumer disconnected, %d msgs retained", getName(), (int)mNumRetained);
 
-            if(head == mTailChannel)
-                mTailChannel = NULL;
+            if(head->mEventMessagesAvailable)
+                head->mEventMessagesAvailable->signal();
         }
 
-        mInitd = false;
+        head = head->getNext();
     }
+
+    return numEvicted;
 }
 
 //----------------------------------------------------------------------------
-//
+// Listened channels that disconnected me, called from the reader thread
 //----------------------------------------------------------------------------
-MsgChannel * ChannelList::addChannel(const char * _name, ChannelId _channelId, NWEvent * _eventMsgAvailable)
+ChannelId MsgChannel::getEvictedChannelId()
 {
-    MsgChannel * msgChannel = createChannel(_name, _channelId, _eventMsgAvailable);
-        
-    linkChannelAsTail(msgChannel);
-
-    return msgChannel;
-}
+    ChannelId channelId = InvalidChannelId;
+
+    ListenedChannel * listened = mHeadListenedDList;
+    while(listened)
+    {
+        if(listened->mListener->mEvicted)
+        {
+            if(listened->mListener->hasCursor())
+            {
+                listened->mChannelListened->releaseCursor(listened->mListener);
+            }
+
+            channelId = listened->mChannelListened->getChannelId();
+            break;
+        }
+
+        listened = listened->getNext();
+    }
+
+    return channelId;
+}
 
 //----------------------------------------------------------------------------
-//
-//----------------------------------------------------------------------------
-void ChannelList::removeChannel(ChannelId _channelId)
+//
+//----------------------------------------------------------------------------
+void MsgChannel::setRetentionLimit(int _maxRetainedMsgs, eSlowConsumerPolicy _policy)
 {
-    unlinkAndDestroyChannel(_channelId);
+    mMaxRetainedMsgs = _maxRetainedMsgs > 0 ? _maxRetainedMsgs : 0;
+    mSlowConsumerPolicy = _policy;
 }
 
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-ChannelId ChannelList::getChannelId(const char * _channelName)
+void MsgChannel::getMetrics(MsgChannelMetrics & metrics_) const
 {
-    ChannelId channelId = InvalidChannelId;
+    metrics_.mRetainedMsgs = (int)mNumRetained;
+    metrics_.mPeakRetainedMsgs = (int)mPeakRetained;
+    metrics_.mRetiredMsgs = (u64)mRetiredMsgs;
+    metrics_.mDroppedMsgs = (u64)mDroppedMsgs;
+    metrics_.mDisconnectedListeners = (int)mDisconnectedListeners;
+    metrics_.mCreditWaits = (u64)mCreditWaits;
+    metrics_.mConflatedMsgs = (u64)mConflatedMsgs;
+}
 
-    std::string name = _channelName;
+//****************************************************************************
+// Conflation
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgChannel::setConflation(bool _conflate)
+{
+    NWAutoCritSec critSec(mConflationCritSec);
 
-    MsgChannel * channel = mHeadChannelList;
-    while(channel)
+    mConflating = _conflate;
+    if(!mConflating)
     {
-        std::string channelName = channel->getName();
-        
-        if(name == channelName)
+        mConflationMap.clear(); // the msgs already superseded are still skipped
+    }
+}
+
+//----------------------------------------------------------------------------
+// Under mConflationCritSec
+//----------------------------------------------------------------------------
+MsgChannel::ConflationMapIt MsgChannel::findConflatedMsg(StoredMsg const & _msg)
+{
+    ConflationMapIt it = mConflationMap.lower_bound(_msg.mMsgKey);
+    while(it != mConflationMap.end() && it->first == _msg.mMsgKey)
+    {
+        StoredMsg const * msg = it->second;
+        if(msg->mMessageType == _msg.mMessageType && msg->mMessageFamily == _msg.mMessageFamily &&
+           msg->mMsgData->isSameMsgKey(_msg.mMsgData))
         {
-            channelId = channel->getChannelId();
             break;
         }
 
-        channel = channel->getNext();
+        ++it;
     }
 
-    return channelId;
+    if(it != mConflationMap.end() && it->first != _msg.mMsgKey)
+    {
+        it = mConflationMap.end();
+    }
+
+    return it;
+}
+
+//----------------------------------------------------------------------------
+// Called before the msg is linked. The previous msg of its key stays in the
+// lane, the listeners skip it when they reach it, so the ones that already
+// read it don't lose the newer value.
+//----------------------------------------------------------------------------
+void MsgChannel::registerConflatedMsg(StoredMsg * _msg)
+{
+    if(_msg->mHasKey && _msg->mMsgData->isConflatable())
+    {
+        _msg->mConflatable = true;
+
+        NWAutoCritSec critSec(mConflationCritSec);
+
+        ConflationMapIt it = findConflatedMsg(*_msg);
+        if(it != mConflationMap.end())
+        {
+            NWAtomic::exchange(&it->second->mSuperseded, 1); // it isn't retired while it is in the map
+            NWAtomic::increment64(&mConflatedMsgs);
+            it->second = _msg;
+        }
+        else
+        {
+            mConflationMap.insert(ConflationMap::value_type(_msg->mMsgKey, _msg));
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// The msg is being retired
+//----------------------------------------------------------------------------
+void MsgChannel::forgetConflatedMsg(StoredMsg * _msg)
+{
+    NWAutoCritSec critSec(mConflationCritSec);
+
+    ConflationMapIt it = mConflationMap.lower_bound(_msg->mMsgKey);
+    while(it != mConflationMap.end() && it->first == _msg->mMsgKey)
+    {
+        if(it->second == _msg)
+        {
+            mConflationMap.erase(it);
+            break;
+        }
+
+        ++it;
+    }
 }
 
+//****************************************************************************
+// Priority lanes
+//****************************************************************************
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-MsgChannel * ChannelList::getChannel(const char * _channelName)
+void MsgChannel::setDefaultPriority(int _priority)
 {
-    MsgChannel * pRet = NULL;
-    std::string name = _channelName;
+    ASSERT(_priority >= 0 && _priority < NumMsgPriorities);
+    if(_priority >= 0 && _priority < NumMsgPriorities)
+    {
+        mDefaultPriority = _priority;
+    }
+}
 
-    MsgChannel * channel = mHeadChannelList;
-    while(channel)
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgChannel::setStarvationLimit(int _maxConsecutive)
+{
+    mStarvationLimit = _maxConsecutive > 0 ? _maxConsecutive : 0;
+}
+
+//----------------------------------------------------------------------------
+// The highest priority lane with msgs, unless a lower one has been waiting
+// for mStarvationLimit msgs in a row
+//----------------------------------------------------------------------------
+int MsgChannel::selectLane(ListenedChannel * const * _candidates)
+{
+    int selected = -1;
+
+    if(mStarvationLimit > 0)
     {
-        std::string channelName = channel->getName();
+        for(int lane=1; lane<NumMsgPriorities; lane++)
+        {
+            if(_candidates[lane] && mLaneStreak[lane] >= mStarvationLimit)
+            {
+                selected = lane;
+                break;
+            }
+        }
+    }
 
-        if(name == channelName)
+    for(int lane=0; lane<NumMsgPriorities && selected < 0; lane++)
+    {
+        if(_candidates[lane])
         {
-            pRet = channel;
-            break;
+            selected = lane;
         }
+    }
 
-        channel = channel->getNext();
+    return selected;
+}
+
+//----------------------------------------------------------------------------
+// A msg of _lane has been read, _lanesMask had the lanes with msgs
+//----------------------------------------------------------------------------
+void MsgChannel::consumeLane(int _lane, u32 _lanesMask)
+{
+    for(int lane=0; lane<NumMsgPriorities; lane++)
+    {
+        if(lane > _lane && (_lanesMask & (1 << lane)))
+            mLaneStreak[lane]++;
+        else
+            mLaneStreak[lane] = 0;
     }
+}
 
-    return pRet;
+//****************************************************************************
+// Flow control
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgChannel::setCreditWindow(int _window)
+{
+    mCreditWindow = _window > 0 ? _window : 0;
+    signalCredit();
+}
+
+//----------------------------------------------------------------------------
+// Called on the sender local channel, true if every channel it sends to has room
+//----------------------------------------------------------------------------
+bool MsgChannel::testCredit()
+{
+    return findChannelWithoutCredit() == NULL;
+}
+
+//----------------------------------------------------------------------------
+// Called on the sender local channel
+//----------------------------------------------------------------------------
+bool MsgChannel::waitForCredit(unsigned int _msTimeout/*=NWE_INFINITE*/)
+{
+    MsgChannel * blocking = findChannelWithoutCredit();
+
+    if(blocking)
+    {
+        NWAtomic::increment64(&blocking->mCreditWaits);
+
+        u64 startMs = NWTime::getTimeMs();
+
+        while(blocking)
+        {
+            unsigned int waitMs = CreditPollMs;
+            if(_msTimeout != NWE_INFINITE)
+            {
+                u64 elapsedMs = NWTime::getTimeMs() - startMs;
+                if(elapsedMs >= _msTimeout)
+                    break;
+
+                if(_msTimeout - elapsedMs < waitMs)
+                    waitMs = (unsigned int)(_msTimeout - elapsedMs);
+            }
+
+            NWAtomic::increment(&blocking->mCreditWaiters);
+
+            if(!blocking->hasCreditFor(this)) // checked again once registered, a grant could have been missed
+            {
+                blocking->mCreditEvent->waitForSignal(waitMs);
+            }
+
+            NWAtomic::decrement(&blocking->mCreditWaiters);
+
+            if(blocking->hasCreditFor(this))
+            {
+                blocking->signalCredit(); // the event wakes one waiter, hand the grant over to the next one
+            }
+
+            blocking = findChannelWithoutCredit();
+        }
+    }
+
+    return blocking == NULL;
+}
+
+//----------------------------------------------------------------------------
+// The sender backlog (msgs not dispatched yet) counts against the window of
+// every channel it sends to. The sender itself isn't waited for when it also
+// listens to the channel
+//----------------------------------------------------------------------------
+bool MsgChannel::hasCreditFor(MsgChannel * _sender)
+{
+    bool bRet = true;
+
+    if(mCreditWindow > 0)
+    {
+        long backlog = _sender->mNumRetained;
+
+        if(mNumRetained + backlog >= mCreditWindow) // the retained msgs bound every listener, look at them only when there are too many
+        {
+            u64 linkedMsgs = NWAtomic::load64(&mLinkedMsgs);
+
+            AutoListenersRead listenersRead(this);
+
+            ChannelListener * head = mHeadListenerDList;
+            while(head)
+            {
+                if(head->mChannelListener != _sender && head->hasCursor() && !head->mEvicted)
+                {
+                    s64 behind = (s64)(linkedMsgs - NWAtomic::load64(&head->mConsumedMsgs)); // negative if it read msgs linked after linkedMsgs was taken
+                    if(behind + backlog >= mCreditWindow)
+                    {
+                        bRet = false;
+                        break;
+                    }
+                }
+
+                head = head->getNext();
+            }
+        }
+    }
+
+    return bRet;
 }
 
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-MsgChannel * ChannelList::getChannel(ChannelId _channelId)
+MsgChannel * MsgChannel::findChannelWithoutCredit()
 {
     MsgChannel * pRet = NULL;
 
-    MsgChannel * channel = mHeadChannelList;
-    while(channel)
-    {
+    AutoListenersRead listenersRead(this);
 
-        if(_channelId == channel->getChannelId())
+    ChannelListener * head = mHeadListenerDList;
+    while(head)
+    {
+        if(!head->mChannelListener->hasCreditFor(this))
         {
-            pRet = channel;
+            pRet = head->mChannelListener;
             break;
         }
 
-        channel = channel->getNext();
+        head = head->getNext();
     }
 
     return pRet;
@@ -759,77 +1395,255 @@ MsgChannel * ChannelList::getChannel(ChannelId _channelId)
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-MsgChannel * ChannelList::createChannel(const char * _name, ChannelId _channelId, NWEvent * _eventMsgAvailable)
+void MsgChannel::signalCredit()
 {
-    MsgChannel * channel = NEW MsgChannel();
-    
-    channel->init(_name, _channelId, _eventMsgAvailable);
+    if(mCreditWaiters > 0 && mCreditEvent)
+    {
+        mCreditEvent->signal();
+    }
+}
 
-    return channel;
+//****************************************************************************
+// Interest
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Called by the MsgMgr with the dispatchers locked, a channel without
+// listeners doesn't store anything
+//----------------------------------------------------------------------------
+void MsgChannel::updateInterestFromListeners()
+{
+    mInterest.clear(false);
+    mListenersFilter.clear();
+
+    bool bFiltered = mHeadListenerDList != NULL; // every listener has a filter
+    MsgFilter filter;
+
+    ChannelListener * listener = mHeadListenerDList;
+    while(listener)
+    {
+        if(!mInterest.acceptsAll())
+        {
+            mInterest.merge(listener->mChannelListener->mInterest);
+        }
+
+        if(bFiltered)
+        {
+            if(listener->mFilter == NULL)
+                bFiltered = false;
+            else if(listener == mHeadListenerDList)
+                filter = *listener->mFilter;
+            else
+                filter.merge(*listener->mFilter);
+        }
+
+        listener = listener->getNext();
+    }
+
+    if(bFiltered)
+    {
+        mListenersFilter = filter;
+    }
 }
 
+//****************************************************************************
+// Listeners filters
+//****************************************************************************
 //----------------------------------------------------------------------------
-//
+// Called by the MsgMgr with the dispatchers locked, from the thread reading
+// through the listener
 //----------------------------------------------------------------------------
-void ChannelList::linkChannelAsTail(MsgChannel * msgChannel)
+void MsgChannel::setListenerFilter(ChannelListener * _listener, MsgFilter const * _filter)
 {
-    if(mTailChannel)
+    DISPOSE(_listener->mFilter);
+
+    if(_filter && !_filter->acceptsAll())
     {
-        mTailChannel->setNext(msgChannel);
+        _listener->mFilter = NEW MsgFilter(*_filter);
     }
-    else
+
+    updateInterestFromListeners();
+}
+
+//----------------------------------------------------------------------------
+// Called from the reader thread, on its local channel. The msgs the filter
+// of the listener rejects and the ones a newer msg of their key superseded
+// are consumed without being read, returns the next msg of the lane the
+// listener accepts.
+//----------------------------------------------------------------------------
+StoredMsg * MsgChannel::skipFilteredMsgs(ListenedChannel * _listened, int _lane)
+{
+    ChannelListener * listener = _listened->mListener;
+    StoredMsg * msg = listener->mCurrentMsg[_lane]->getNextAcquire();
+
+    MsgFilter const * filter = listener->mFilter;
+    StoredMsg * last = NULL;
+    int numSkipped = 0;
+
+    while(msg && (msg->mSuperseded || (filter && !filter->accepts(msg->mMessageFamily, msg->mMessageType, msg->mHasKey, msg->mMsgKey))))
+    {
+        last = msg;
+        numSkipped++;
+        msg = msg->getNextAcquire();
+    }
+
+    if(last)
     {
-        mHeadChannelList = msgChannel;
+        _listened->mChannelListened->advanceCursor(listener, _lane, last, numSkipped);
     }
-    mTailChannel = msgChannel;
+
+    return msg;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+ChannelList::ChannelList() : 
+    mInitd(false),
+    mFreeSlot(InvalidSlot),
+    mNumChannels(0)
+{
 }
 
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-void ChannelList::unlinkAndDestroyChannel(ChannelId _channelId)
+ChannelList::~ChannelList()
 {
-    MsgChannel * prev = NULL;
-    MsgChannel * channel = mHeadChannelList;
-    while(channel)
+    shutdown();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool ChannelList::initialize()
+{
+    bool bRet = false;
+
+    if(!mInitd)
     {
-        if(_channelId == channel->getChannelId())
-        {
-            if(prev)
-                prev->setNext(channel->getNext());
-            if(channel == mHeadChannelList)
-                mHeadChannelList = channel->getNext();
-            if(channel == mTailChannel)
-                mTailChannel = channel->getNext();
+        mChannelTable.reserve(64);
+        mFreeSlot = InvalidSlot;
+        mNumChannels = 0;
 
-            channel->shutdown();
-            DISPOSE(channel);
-            break;
+        mInitd = true;
+        bRet = mInitd;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void ChannelList::shutdown()
+{
+    if(mInitd)
+    {
+        for(u32 i = 0; i < mChannelTable.size(); i++)
+        {
+            MsgChannel * channel = mChannelTable[i].mChannel;
+            if(channel)
+            {
+                channel->shutdown();
+                DISPOSE(channel);
+                mChannelTable[i].mChannel = NULL;
+            }
         }
 
-        prev = channel;
-        channel = channel->getNext();
+        mChannelTable.clear();
+        mFreeSlot = InvalidSlot;
+        mNumChannels = 0;
+
+        mInitd = false;
     }
 }
 
-//****************************************************************************
+//----------------------------------------------------------------------------
 //
-//****************************************************************************
-#include <hash_map>
+//----------------------------------------------------------------------------
+MsgChannel * ChannelList::addChannel(const char * _name, NWEvent * _eventMsgAvailable)
+{
+    MsgChannel * msgChannel = NULL;
+
+    u32 index = allocSlot();
+    ASSERT(index != InvalidSlot);
+    if(index != InvalidSlot)
+    {
+        ChannelSlot & slot = mChannelTable[index];
+
+        msgChannel = NEW MsgChannel();
+        msgChannel->init(_name, makeChannelId(index, slot.mGeneration), _eventMsgAvailable);
+
+        slot.mChannel = msgChannel;
+        mNumChannels++;
+    }
+
+    return msgChannel;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void ChannelList::removeChannel(ChannelId _channelId)
+{
+    MsgChannel * channel = getChannel(_channelId);
+    if(channel)
+    {
+        u32 index = getSlotIndex(_channelId);
+        mChannelTable[index].mChannel = NULL;
+        freeSlot(index);
+        mNumChannels--;
 
-typedef std::pair <const char *, ChannelId> DnsPair;
-typedef stdext::hash_map<const char *, ChannelId>::iterator DnsIter;
+        channel->shutdown();
+        DISPOSE(channel);
+    }
+}
 
-struct DnsHash
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+u32 ChannelList::allocSlot()
 {
-    stdext::hash_map <const char *, ChannelId> hash;
-};
+    u32 index = InvalidSlot;
+
+    if(mFreeSlot != InvalidSlot)
+    {
+        index = mFreeSlot;
+        mFreeSlot = mChannelTable[index].mNextFree;
+        mChannelTable[index].mNextFree = InvalidSlot;
+    }
+    else if(mChannelTable.size() < ChannelIndexMask)
+    {
+        index = (u32)mChannelTable.size();
+        mChannelTable.push_back(ChannelSlot());
+    }
+
+    return index;
+}
+
+//----------------------------------------------------------------------------
+// Bumps the generation so the ids handed out for the slot become stale
+//----------------------------------------------------------------------------
+void ChannelList::freeSlot(u32 _index)
+{
+    ChannelSlot & slot = mChannelTable[_index];
+    slot.mGeneration = (slot.mGeneration + 1) & ChannelGenerationMask;
+    slot.mNextFree = mFreeSlot;
+    mFreeSlot = _index;
+}
 
+//****************************************************************************
+//
+//****************************************************************************
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
 MsgMgr_Dns::MsgMgr_Dns() :
-    mDnsHash(NULL)
+    mInitd(false),
+    mNumEntries(0)
 {
 }
 
@@ -838,16 +1652,30 @@ MsgMgr_Dns::MsgMgr_Dns() :
 //----------------------------------------------------------------------------
 MsgMgr_Dns::~MsgMgr_Dns()
 {
+    shutdown();
 }
 
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-bool MsgMgr_Dns::initialize()
+bool MsgMgr_Dns::initialize(u32 _reserve/*=64*/)
 {
-    mDnsHash = NEW DnsHash();
+    bool bRet = false;
+
+    if(!mInitd)
+    {
+        u32 size = 16;
+        while(size < _reserve * 2)
+            size <<= 1;
+
+        mEntries.resize(size);
+        mNumEntries = 0;
+
+        mInitd = true;
+        bRet = mInitd;
+    }
 
-    return true;
+    return bRet;
 }
 
 //----------------------------------------------------------------------------
@@ -855,9 +1683,20 @@ bool MsgMgr_Dns::initialize()
 //----------------------------------------------------------------------------
 void MsgMgr_Dns::shutdown()
 {
-    if(mDnsHash)
+    if(mInitd)
     {
-        DISPOSE(mDnsHash);
+        for(u32 i = 0; i < mEntries.size(); i++)
+        {
+            if(mEntries[i].mName)
+            {
+                DISPOSE_ARRAY(mEntries[i].mName);
+            }
+        }
+
+        mEntries.clear();
+        mNumEntries = 0;
+
+        mInitd = false;
     }
 }
 
@@ -866,25 +1705,154 @@ void MsgMgr_Dns::shutdown()
 //----------------------------------------------------------------------------
 void MsgMgr_Dns::regChannelName(const char * _name, ChannelId _id)
 {
-    mDnsHash->hash.insert(DnsPair(_name, _id));
+    ASSERT(mInitd && _name);
+
+    u32 hash = hashName(_name);
+    u32 index = findEntry(_name, hash);
+    if(index != InvalidIndex)
+    {
+        mEntries[index].mId = _id;
+    }
+    else
+    {
+        if((mNumEntries + 1) * 4 > mEntries.size() * 3) // keep the load under 75%
+        {
+            grow();
+        }
+
+        size_t len = strlen(_name);
+        char * name = NEW char[len + 1];
+        memcpy(name, _name, len + 1);
+
+        insertEntry(name, hash, _id);
+        mNumEntries++;
+    }
 }
 
+//----------------------------------------------------------------------------
+// Backward shift deletion, no tombstones are left behind
+//----------------------------------------------------------------------------
 void MsgMgr_Dns::unregChannelName(const char * _name)
 {
-    mDnsHash->hash.erase(_name);
+    ASSERT(mInitd);
+
+    if(_name)
+    {
+        u32 index = findEntry(_name, hashName(_name));
+        if(index != InvalidIndex)
+        {
+            u32 mask = (u32)mEntries.size() - 1;
+
+            DISPOSE_ARRAY(mEntries[index].mName);
+            mEntries[index] = DnsEntry();
+            mNumEntries--;
+
+            u32 hole = index;
+            u32 next = (hole + 1) & mask;
+            while(mEntries[next].mName)
+            {
+                u32 home = mEntries[next].mHash & mask;
+                if(((next - home) & mask) >= ((next - hole) & mask)) // the hole is on the probe path of the entry
+                {
+                    mEntries[hole] = mEntries[next];
+                    mEntries[next] = DnsEntry();
+                    hole = next;
+                }
+                next = (next + 1) & mask;
+            }
+        }
+    }
 
     ASSERT(getChannelId(_name) == InvalidChannelId);
 }
 
-ChannelId MsgMgr_Dns::getChannelId(const char * _name)
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+ChannelId MsgMgr_Dns::getChannelId(const char * _name) const
 {
     ChannelId channelId = InvalidChannelId;
 
-    DnsIter it = mDnsHash->hash.find(_name);
-    if(it != mDnsHash->hash.end())
+    if(mInitd && _name)
     {
-        channelId = (*it).second;
+        u32 index = findEntry(_name, hashName(_name));
+        if(index != InvalidIndex)
+        {
+            channelId = mEntries[index].mId;
+        }
     }
 
     return channelId;
 }
+
+//----------------------------------------------------------------------------
+// FNV-1a
+//----------------------------------------------------------------------------
+/*static*/ u32 MsgMgr_Dns::hashName(const char * _name)
+{
+    u32 hash = 2166136261u;
+    while(*_name)
+    {
+        hash ^= (u8)*_name++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+u32 MsgMgr_Dns::findEntry(const char * _name, u32 _hash) const
+{
+    u32 mask = (u32)mEntries.size() - 1;
+
+    u32 index = _hash & mask;
+    while(mEntries[index].mName)
+    {
+        if(mEntries[index].mHash == _hash && strcmp(mEntries[index].mName, _name) == 0)
+        {
+            return index;
+        }
+        index = (index + 1) & mask;
+    }
+
+    return InvalidIndex;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void MsgMgr_Dns::insertEntry(char * _name, u32 _hash, ChannelId _id)
+{
+    u32 mask = (u32)mEntries.size() - 1;
+
+    u32 index = _hash & mask;
+    while(mEntries[index].mName)
+    {
+        index = (index + 1) & mask;
+    }
+
+    mEntries[index].mName = _name;
+    mEntries[index].mHash = _hash;
+    mEntries[index].mId = _id;
+}
+
+//----------------------------------------------------------------------------
+// Rehashes into a table twice as big, the interned names are moved over
+//----------------------------------------------------------------------------
+void MsgMgr_Dns::grow()
+{
+    std::vector<DnsEntry> oldEntries;
+    oldEntries.swap(mEntries);
+
+    mEntries.resize(oldEntries.size() * 2);
+
+    for(u32 i = 0; i < oldEntries.size(); i++)
+    {
+        if(oldEntries[i].mName)
+        {
+            insertEntry(oldEntries[i].mName, oldEntries[i].mHash, oldEntries[i].mId);
+        }
+    }
+}
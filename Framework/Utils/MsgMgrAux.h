@@ -42,15 +42,21 @@
 #define MESSAGE_MANAGER_AUX_H
 
 #include "MsgMgrDefs.h"
-#include "NWSlink.h"
+#include "NWSLink.h"
 #include "NWTypes.h"
 #include "MsgDefs.h"
+#include "NWSlabAllocator.h"
+#include "MsgDispatchTable.h"
+#include "NWEvent.h"
+#include "NWCriticalSection.h"
 
 #include <string>
+#include <vector>
+#include <map>
 
-class NWEvent;
 class CommNode;
 class MsgChannel;
+struct MsgReadyList;
 
 //****************************************************************************
 //
@@ -60,17 +66,26 @@ struct StoredMsg : public SNLink<StoredMsg>
     CommNodeId mSender;
     int mMessageType;
     int mMessageFamily;
-    NWBaseMsgInternal * mMsgData;
+    NWBaseMsgInternal const * mMsgData; // shared and immutable once sent
     int mDataLen;
     u64 mMsgRefId;
+    int mPriority; // eMsgPriority, selects the lane
+    long volatile mPins; // listener cursors parked on the msg, it isn't retired while pinned
+    bool mHasKey; // NWBaseMsgInternal::getMsgKey, taken once when the msg is sent
+    u32 mMsgKey;
+    bool mConflatable; // registered in the conflation map of its channel
+    long volatile mSuperseded; // a newer msg of its key was linked, the listeners that didn't read it skip it
 
     StoredMsg(u64 _msgRefId);
-    StoredMsg(CommNodeId _sender, int _messageType, int _messageFamily, NWBaseMsgInternal * _msgData, int _dataLen, u64 _msgRefId);
+    StoredMsg(CommNodeId _sender, int _messageType, int _messageFamily, NWBaseMsgInternal const * _msgData, int _dataLen, u64 _msgRefId);
     ~StoredMsg();
 
     void copyFrom(StoredMsg const & _other);
 
     StoredMsg operator = (StoredMsg const & _other);
+
+    static NWSlabStats sSlabStats;
+    NWSLAB_OPERATORS(StoredMsg, sSlabStats)
 };
 
 //****************************************************************************
@@ -79,11 +94,64 @@ struct StoredMsg : public SNLink<StoredMsg>
 struct ChannelListener : public DLink<ChannelListener>
 {
     MsgChannel * mChannelListener;
+    MsgChannel * mChannelListened; // owner of the listener, the cursor walks its msgs
     ChannelId mChannelId;
     NWEvent * mEventMessagesAvailable;
-    StoredMsg * volatile mCurrentMsg;
+    StoredMsg * volatile mCurrentMsg[NumMsgPriorities]; // one cursor per lane, all of them NULL once released
+    u64 volatile mConsumedMsgs; // compared with the msgs linked in the channel to know how far behind the listener is
+
+    // dispatcher managed listeners are queued instead of signaled
+    MsgReadyList * mReadyList;
+    ChannelListener * volatile mNextReady;
+    long volatile mReady; // 1 while queued or being dispatched
+    long volatile mEvicted; // disconnected by the slow consumer policy, the cursor is released by its reader
+    long volatile mDetached; // unlinked while queued, destroyed by the dispatcher that pops it
+
+    MsgFilter * mFilter; // content filter of the listener, NULL reads every msg
+
+    ChannelListener(MsgChannel * _channelListener, MsgChannel * _channelListened);
+    ~ChannelListener();
 
-    ChannelListener(MsgChannel * _channelListener, StoredMsg * _currentMsg);
+    inline bool hasCursor() const;
+    inline bool msgsPending() const;
+
+    static NWSlabStats sSlabStats;
+    NWSLAB_OPERATORS(ChannelListener, sSlabStats)
+};
+
+inline bool ChannelListener::hasCursor() const
+{
+    return mCurrentMsg[0] != NULL;
+}
+
+inline bool ChannelListener::msgsPending() const
+{
+    bool bRet = false;
+
+    if(hasCursor())
+    {
+        for(int lane=0; lane<NumMsgPriorities && !bRet; lane++)
+        {
+            bRet = mCurrentMsg[lane]->getNextAcquire() != NULL;
+        }
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+// Lock free list of listeners with pending messages, multiple producers
+// (any sender thread) and a single consumer (the dispatcher)
+//****************************************************************************
+struct MsgReadyList
+{
+    ChannelListener * volatile mHead;
+    NWEvent * mEventReady;
+
+    MsgReadyList(NWEvent * _eventReady);
+
+    void push(ChannelListener * _listener);
+    ChannelListener * popAll(); // FIFO ordered, linked by mNextReady
 };
 
 
@@ -97,12 +165,30 @@ struct ListenedChannel : public DLink<ListenedChannel>
     NWEvent * mEventMessagesAvailable;
 
     ListenedChannel(MsgChannel * _channelListened, ChannelListener * _listener, NWEvent * _eventMessagesAvailable);
+
+    static NWSlabStats sSlabStats;
+    NWSLAB_OPERATORS(ListenedChannel, sSlabStats)
 };
 
 //****************************************************************************
-//
+// One priority lane of a channel
 //****************************************************************************
-class MsgChannel : public SNLink<MsgChannel>
+struct MsgLane
+{
+    StoredMsg * volatile mHeadMsg; // oldest msg not retired, only modified by the purging thread
+    StoredMsg * volatile mTailMsg; // last sent msg, exchanged by the senders
+
+    MsgLane() : mHeadMsg(NULL), mTailMsg(NULL) {}
+};
+
+//****************************************************************************
+// Msgs are stored in lock free multiple producer queues (intrusive, with a
+// permanent stub node), one per priority lane, any thread can send.
+// Listeners read them through their cursors, a cursor pins the msg it is
+// parked on. The msgs older than the oldest pinned one are retired as soon
+// as the last cursor leaves them.
+//****************************************************************************
+class MsgChannel
 {
 public:
     MsgChannel();
@@ -114,7 +200,8 @@ public:
     void listenTo(MsgChannel * _channel);
     void stopListeningTo(MsgChannel * _channel);
 
-    template <class T> inline void sendMessage(T const & _msg, CommNodeId _sender);
+    template <class T> inline void sendMessage(T const & _msg, CommNodeId _sender, int _priority=MSG_PRIORITY_DEFAULT);
+    void sendMessageData(NWBaseMsgInternal * _msgData, int _msgFamily, int _msgType, int _dataLen, CommNodeId _sender, int _priority=MSG_PRIORITY_DEFAULT); // takes the reference of _msgData
 
     bool testMsgAvailable(ChannelId _channelId=InvalidChannelId);
     StoredMsg * getAvailableMsg(ChannelId & msgFromChannel_, ChannelId _channelId=InvalidChannelId);
@@ -127,8 +214,46 @@ public:
     inline ChannelId getChannelId();
     inline NWEvent * getEventMessageAvailable();
 
+    inline void setReadyList(MsgReadyList * _readyList);
+    inline MsgReadyList * getReadyList();
+
+    inline void setOwner(CommNode * _owner);
+    inline CommNode * getOwner() const; // NULL for the MsgMgr channels
+
+    // Priority lanes : the msgs sent with MSG_PRIORITY_DEFAULT go to the default lane. The reader
+    // takes a lower priority msg after _maxConsecutive higher priority ones (0 = strict priority)
+    void setDefaultPriority(int _priority);
+    inline int getDefaultPriority() const;
+    void setStarvationLimit(int _maxConsecutive);
+
+    // Retention limit, 0 keeps every msg until the slowest listener reads it
+    void setRetentionLimit(int _maxRetainedMsgs, eSlowConsumerPolicy _policy);
+    inline bool isOverRetentionLimit() const;
+    inline eSlowConsumerPolicy getSlowConsumerPolicy() const;
+    void getMetrics(MsgChannelMetrics & metrics_) const;
+
     void waitForListeners(ChannelId _channelId=InvalidChannelId);
-    void purgeSentMsgs();
+    void purgeSentMsgs(); // retires the msgs no cursor is parked on
+
+    void advanceCursor(ChannelListener * _listener, int _lane, StoredMsg * _msg, int _numMsgs=1); // _listener is one of my listeners
+    int evictSlowListeners();
+    ChannelId getEvictedChannelId();
+
+    // Flow control : the senders wait while a listener is _window msgs behind (0 = no limit)
+    void setCreditWindow(int _window);
+    inline int getCreditWindow() const;
+    bool testCredit(); // called on the sender local channel
+    bool waitForCredit(unsigned int _msTimeout=NWE_INFINITE); // false on timeout
+
+    // Conflation : every listener skips the msgs it didn't read yet once a newer msg of the same type and key is linked
+    void setConflation(bool _conflate);
+    inline bool isConflating() const;
+
+    // Msgs the channel stores : the interest of the CommNode for its local channel,
+    // the union of the listeners interest for the MsgMgr channels
+    inline bool acceptsMsg(StoredMsg const * _msg) const; // also checks the union of the listeners filters
+    inline void setInterest(MsgInterestSet const & _interest);
+    void updateInterestFromListeners();
 
 private:
     friend class MsgMgr;
@@ -136,28 +261,80 @@ private:
     bool mInitd;
     std::string mChannelName;
     ChannelId mChannelId;
-    StoredMsg * mHeadMsgList;
-    StoredMsg * mTailMsg;
+    MsgLane mLanes[NumMsgPriorities];
+    int mDefaultPriority;
     ChannelListener * mHeadListenerDList;
+    long volatile mListenersReaders; // threads walking the listeners without a lock (senders, credit checks)
+    long volatile mListenersLocked; // the listeners list is changing, the readers wait
     ListenedChannel * mHeadListenedDList;
     int mNumListeners;
     int mNumListened;
     NWEvent * mEventMessagesAvailable;
-    u64 mMsgRefIdSeed;
+    s64 volatile mMsgRefIdSeed;
+    long volatile mPurging;
+    long volatile mPurgeRequested;
+    MsgReadyList * mReadyList;
+    CommNode * mOwner;
+    u32 mDispatchPass; // last dispatcher pass that touched the channel
+
+    int mMaxRetainedMsgs;
+    eSlowConsumerPolicy mSlowConsumerPolicy;
+    long volatile mNumRetained; // stored msgs, the head of every lane excluded
+    u64 volatile mLinkedMsgs; // never wraps, the listeners lag is the difference with their mConsumedMsgs
+    long mPeakRetained;
+    s64 volatile mRetiredMsgs;
+    s64 volatile mDroppedMsgs;
+    long volatile mDisconnectedListeners;
+
+    int mCreditWindow;
+    NWEvent * mCreditEvent;
+    long volatile mCreditWaiters;
+    s64 volatile mCreditWaits;
+
+    MsgInterestSet mInterest;
+    MsgFilter mListenersFilter;
+
+    typedef std::multimap<u32, StoredMsg *> ConflationMap; // last msg linked per key
+    typedef ConflationMap::iterator ConflationMapIt;
+    bool mConflating;
+    NWCriticalSection * mConflationCritSec;
+    ConflationMap mConflationMap;
+    s64 volatile mConflatedMsgs;
+
+    // reader side of the lanes, for the CommNode local channels
+    int mStarvationLimit;
+    int mLaneStreak[NumMsgPriorities]; // higher priority msgs taken in a row while the lane had msgs
+    ListenedChannel * mPendingListened; // where the msg returned by getAvailableMsg comes from
+    int mPendingLane;
+    u32 mPendingLanesMask; // lanes that had msgs when it was returned
 
     ChannelListener * addListener(MsgChannel * _listener);
     void removeListener(MsgChannel * _listener);
 
     StoredMsg * createStoredMsg();
-    void unlinkAndDestroyStoredMsgHead();
-    void linkStoredMsg(StoredMsg * _msg);
+    bool unlinkAndDestroyStoredMsgHead(MsgLane & _lane);
+    void destroyAllStoredMsgs();
+    void linkStoredMsg(StoredMsg * _msg, bool _signalListeners=true);
 
-    ChannelListener * createListener(MsgChannel * _channelListener, StoredMsg * _currentMsg);
+    ChannelListener * createListener(MsgChannel * _channelListener);
     void unlinkAndDestroyListener(ChannelListener * _listener);
     void linkListener(ChannelListener * _listener);
     ChannelListener * findListener(MsgChannel * _channelListener);
     inline ChannelListener * getHeadListenerChannel();
 
+    void enterListenersRead();
+    void leaveListenersRead();
+    void lockListeners(); // waits for the readers to leave
+    void unlockListeners();
+
+    struct AutoListenersRead
+    {
+        MsgChannel * mChannel;
+        AutoListenersRead(MsgChannel * _channel) : mChannel(_channel) {mChannel->enterListenersRead();}
+        ~AutoListenersRead() {mChannel->leaveListenersRead();}
+    };
+    friend struct AutoListenersRead;
+
     ListenedChannel * createListened(MsgChannel * _listenedChannel, ChannelListener * _listener);
     void unlinkAndDestroyListened(ListenedChannel * _listened);
     void linkListened(ListenedChannel * _listened);
@@ -168,23 +345,28 @@ private:
 
     void signalListeners();
 
-    void purgeSentMsgs(u64 _minMsgRefId);
-    u64 getMinMsgRefId();
-};
+    inline int getLane(StoredMsg const * _msg) const;
+    int selectLane(ListenedChannel * const * _candidates);
+    void consumeLane(int _lane, u32 _lanesMask);
 
-template <class T> inline void MsgChannel::sendMessage(T const & _msg, CommNodeId _sender)
-{
-    T * msgData = NEW T();
-    *msgData = _msg;
+    StoredMsg * skipFilteredMsgs(ListenedChannel * _listened, int _lane); // also skips the superseded msgs
+    void setListenerFilter(ChannelListener * _listener, MsgFilter const * _filter);
 
-    StoredMsg * storedMsg = createStoredMsg();
-    storedMsg->mSender = _sender;
-    storedMsg->mMsgData = msgData;
-    storedMsg->mMessageFamily = T::MSG_FAMILY;
-    storedMsg->mMessageType = T::MSG_TYPE;
-    storedMsg->mDataLen = sizeof(T);
+    void dropMsg();
+
+    ConflationMapIt findConflatedMsg(StoredMsg const & _msg);
+    void registerConflatedMsg(StoredMsg * _msg);
+    void forgetConflatedMsg(StoredMsg * _msg);
+    void releaseCursor(ChannelListener * _listener);
+
+    bool hasCreditFor(MsgChannel * _sender);
+    MsgChannel * findChannelWithoutCredit();
+    void signalCredit();
+};
 
-    linkStoredMsg(storedMsg);
+template <class T> inline void MsgChannel::sendMessage(T const & _msg, CommNodeId _sender, int _priority/*=MSG_PRIORITY_DEFAULT*/)
+{
+    sendMessageData(NEW T(_msg), T::MSG_FAMILY, T::MSG_TYPE, sizeof(T), _sender, _priority); // the only copy of the payload, shared by every channel it goes through
 }
 
 inline const char * MsgChannel::getName() const
@@ -212,6 +394,67 @@ inline NWEvent * MsgChannel::getEventMessageAvailable()
     return mEventMessagesAvailable;
 }
 
+inline void MsgChannel::setReadyList(MsgReadyList * _readyList)
+{
+    mReadyList = _readyList;
+}
+
+inline MsgReadyList * MsgChannel::getReadyList()
+{
+    return mReadyList;
+}
+
+inline void MsgChannel::setOwner(CommNode * _owner)
+{
+    mOwner = _owner;
+}
+
+inline CommNode * MsgChannel::getOwner() const
+{
+    return mOwner;
+}
+
+inline bool MsgChannel::isOverRetentionLimit() const
+{
+    return mMaxRetainedMsgs > 0 && mNumRetained >= mMaxRetainedMsgs;
+}
+
+inline int MsgChannel::getDefaultPriority() const
+{
+    return mDefaultPriority;
+}
+
+inline int MsgChannel::getLane(StoredMsg const * _msg) const
+{
+    return (_msg->mPriority >= 0 && _msg->mPriority < NumMsgPriorities) ? _msg->mPriority : mDefaultPriority;
+}
+
+inline eSlowConsumerPolicy MsgChannel::getSlowConsumerPolicy() const
+{
+    return mSlowConsumerPolicy;
+}
+
+inline int MsgChannel::getCreditWindow() const
+{
+    return mCreditWindow;
+}
+
+inline bool MsgChannel::isConflating() const
+{
+    return mConflating;
+}
+
+inline bool MsgChannel::acceptsMsg(StoredMsg const * _msg) const
+{
+    return mInterest.accepts(_msg->mMessageFamily, _msg->mMessageType) &&
+           (mListenersFilter.acceptsAll() || mListenersFilter.accepts(_msg->mMessageFamily, _msg->mMessageType, _msg->mHasKey, _msg->mMsgKey));
+}
+
+inline void MsgChannel::setInterest(MsgInterestSet const & _interest)
+{
+    mInterest = _interest;
+}
+
 inline ChannelListener * MsgChannel::getHeadListenerChannel()
 {
     return mHeadListenerDList;
@@ -223,7 +466,10 @@ inline ListenedChannel * MsgChannel::getHeadListenedChannel()
 }
 
 //****************************************************************************
-//
+// Dense channel table indexed by ChannelId. The id packs the slot index (low
+// bits, biased by one so InvalidChannelId is never produced) and the slot
+// generation, a stale id of a destroyed channel never resolves to the channel
+// reusing its slot.
 //****************************************************************************
 class ChannelList
 {
@@ -234,52 +480,116 @@ public:
     bool initialize();
     void shutdown();
 
-    MsgChannel * addChannel(const char * _name, ChannelId _channelId, NWEvent * _eventMsgAvailable);
+    MsgChannel * addChannel(const char * _name, NWEvent * _eventMsgAvailable);
     void removeChannel(ChannelId _channelId);
 
-    ChannelId getChannelId(const char * _channelName);
-    MsgChannel * getChannel(const char * _channelName);
-    MsgChannel * getChannel(ChannelId _channelId);
+    inline MsgChannel * getChannel(ChannelId _channelId);
+    inline int getNumChannels() const;
 
 private:
     friend class MsgMgr;
 
+    enum
+    {
+        ChannelIndexBits = 20,
+        ChannelIndexMask = (1 << ChannelIndexBits) - 1,
+        ChannelGenerationMask = 0x7ff, // keeps the ids positive
+        InvalidSlot = 0xffffffff
+    };
+
+    struct ChannelSlot
+    {
+        MsgChannel * mChannel;
+        u32 mGeneration;
+        u32 mNextFree;
+        ChannelSlot() : mChannel(NULL), mGeneration(0), mNextFree(InvalidSlot) {}
+    };
+
     bool mInitd;
-    MsgChannel * mHeadChannelList;
-    MsgChannel * mTailChannel;
+    std::vector<ChannelSlot> mChannelTable;
+    u32 mFreeSlot; // head of the free slots list, linked by mNextFree
+    int mNumChannels;
 
-    MsgChannel * createChannel(const char * _name, ChannelId _channelId, NWEvent * _eventMsgAvailable);
-    void linkChannelAsTail(MsgChannel * msgChannel);
-    void unlinkAndDestroyChannel(ChannelId _channelId);
+    u32 allocSlot();
+    void freeSlot(u32 _index);
 
-    inline MsgChannel * getHeadChannelList();
+    static inline ChannelId makeChannelId(u32 _index, u32 _generation);
+    static inline u32 getSlotIndex(ChannelId _channelId);
 };
 
-inline MsgChannel * ChannelList::getHeadChannelList()
+inline MsgChannel * ChannelList::getChannel(ChannelId _channelId)
+{
+    MsgChannel * pRet = NULL;
+
+    u32 index = getSlotIndex(_channelId);
+    if(index < mChannelTable.size())
+    {
+        ChannelSlot & slot = mChannelTable[index];
+        if(slot.mChannel && makeChannelId(index, slot.mGeneration) == _channelId)
+        {
+            pRet = slot.mChannel;
+        }
+    }
+
+    return pRet;
+}
+
+inline int ChannelList::getNumChannels() const
+{
+    return mNumChannels;
+}
+
+/*static*/ inline ChannelId ChannelList::makeChannelId(u32 _index, u32 _generation)
+{
+    return (ChannelId)(((_generation & ChannelGenerationMask) << ChannelIndexBits) | ((_index + 1) & ChannelIndexMask));
+}
+
+/*static*/ inline u32 ChannelList::getSlotIndex(ChannelId _channelId)
 {
-    return mHeadChannelList;
+    return ((u32)_channelId & ChannelIndexMask) - 1; // InvalidChannelId wraps to an out of range index
 }
 
 //****************************************************************************
-//
+// Channel names directory: open addressing hash table (linear probing,
+// backward shift deletion) keyed by the interned names. Registering an
+// existing name rebinds it, the last one registered persists.
 //****************************************************************************
-struct DnsHash;
-
 class MsgMgr_Dns
 {
 public:
     MsgMgr_Dns();
     ~MsgMgr_Dns();
 
-    bool initialize();
+    bool initialize(u32 _reserve=64);
     void shutdown();
 
     void regChannelName(const char * _name, ChannelId _id);
     void unregChannelName(const char * _name);
-    ChannelId getChannelId(const char * _name);
+    ChannelId getChannelId(const char * _name) const;
 
 private:
-    DnsHash * mDnsHash;
+    enum
+    {
+        InvalidIndex = 0xffffffff
+    };
+
+    struct DnsEntry
+    {
+        char * mName; // interned copy, NULL if the entry is empty
+        u32 mHash;
+        ChannelId mId;
+        DnsEntry() : mName(NULL), mHash(0), mId(InvalidChannelId) {}
+    };
+
+    bool mInitd;
+    std::vector<DnsEntry> mEntries; // power of two size
+    u32 mNumEntries;
+
+    static u32 hashName(const char * _name);
+
+    u32 findEntry(const char * _name, u32 _hash) const;
+    void insertEntry(char * _name, u32 _hash, ChannelId _id);
+    void grow();
 };
 
 #endif // MESSAGE_MANAGER_AUX_H
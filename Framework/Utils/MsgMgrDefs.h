@@ -41,6 +41,8 @@
 #ifndef _MSG_MGR_DEFS_H_
 #define _MSG_MGR_DEFS_H_
 
+#include "NWTypes.h"
+
 typedef int ChannelId;
 typedef int CommNodeId;
 
@@ -48,7 +50,43 @@ enum
 {
     InvalidChannelId = 0,
     InvalidCommNodeID = 0,
-    NumMaxMsgsDispatched = 100
+    NumMaxMsgsDispatched = 100,
+    DefaultLaneStarvationLimit = 16,
+    DirectDispatchMaxTargets = 32 // listeners a msg can be delivered to without the dispatcher
+};
+
+//****************************************************************************
+// Priority lanes : every channel keeps one msgs queue per priority, the
+// receivers drain the higher priority lanes first
+//****************************************************************************
+enum eMsgPriority
+{
+    MSG_PRIORITY_DEFAULT = -1,  // the default priority of the channel
+    MSG_PRIORITY_HIGH = 0,      // control msgs, commands
+    MSG_PRIORITY_NORMAL,
+    MSG_PRIORITY_BULK,          // data syncs
+
+    NumMsgPriorities
+};
+
+//****************************************************************************
+// Retention : msgs a channel keeps for its slowest listener
+//****************************************************************************
+enum eSlowConsumerPolicy
+{
+    SLOW_CONSUMER_DROP = 0,     // msgs over the limit aren't stored, the listeners miss them
+    SLOW_CONSUMER_DISCONNECT    // the listeners holding the oldest msg are disconnected from the channel
+};
+
+struct MsgChannelMetrics
+{
+    int mRetainedMsgs;
+    int mPeakRetainedMsgs;
+    u64 mRetiredMsgs;
+    u64 mDroppedMsgs;
+    int mDisconnectedListeners;
+    u64 mCreditWaits; // sends that had to wait for the listeners (flow control)
+    u64 mConflatedMsgs; // msgs superseded by a newer one of the same key
 };
 
 #endif // _MSG_MGR_DEFS_H_
@@ -50,6 +50,10 @@ enum eMsgTypes
     MsgType_CliSrvMsg_Start,
     MsgType_CliSrvMsg_End = MsgType_CliSrvMsg_Start + 10,
 
+    // --- Reserved range for the network sockets (NWCommMsgs.h) ---
+    MsgType_NetMsg_Start,
+    MsgType_NetMsg_End = MsgType_NetMsg_Start + 10,
+
     // --- Reserved range for testing purposes ---
     MsgType_Test_Start,
     MsgType_Test_End    = MsgType_Test_Start + 10,
@@ -66,6 +70,9 @@ enum eMsgFamilies
     // --- Family for ClientServerDataService
     MsgFamily_CliSrvDataService,
 
+    // --- Family for the network sockets ---
+    MsgFamily_Net,
+
     // --- Family for testing purposes ---
     MsgFamily_Test,
 
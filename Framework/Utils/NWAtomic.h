@@ -0,0 +1,259 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_ATOMIC_H_
+#define _INCREW_ATOMIC_H_
+
+#include "NWTypes.h"
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+    #pragma intrinsic(_InterlockedIncrement)
+    #pragma intrinsic(_InterlockedDecrement)
+    #pragma intrinsic(_InterlockedExchange)
+    #pragma intrinsic(_InterlockedExchangeAdd)
+    #pragma intrinsic(_InterlockedCompareExchange)
+    #pragma intrinsic(_InterlockedCompareExchange64)
+    #pragma intrinsic(_ReadWriteBarrier)
+#endif
+
+//****************************************************************************
+// Atomic operations, all of them are full memory barriers
+//****************************************************************************
+namespace NWAtomic
+{
+    inline long increment(long volatile * _value); // returns the new value
+    inline long decrement(long volatile * _value); // returns the new value
+    inline long exchange(long volatile * _value, long _newValue); // returns the old value
+    inline long exchangeAdd(long volatile * _value, long _add); // returns the old value
+    inline long compareExchange(long volatile * _value, long _newValue, long _comparand); // returns the old value
+
+    inline s64 compareExchange64(s64 volatile * _value, s64 _newValue, s64 _comparand); // returns the old value
+    inline s64 increment64(s64 volatile * _value); // returns the new value
+    inline u64 exchangeAdd64(u64 volatile * _value, u64 _add); // returns the old value
+    inline u64 load64(u64 const volatile * _value); // not torn on 32 bits targets
+
+    template <class T> inline T * exchangePtr(T * volatile * _ptr, T * _newPtr); // returns the old pointer
+    template <class T> inline T * compareExchangePtr(T * volatile * _ptr, T * _newPtr, T * _comparand); // returns the old pointer
+
+    template <class T> inline T * loadAcquire(T * const volatile * _ptr);
+    template <class T> inline void storeRelease(T * volatile * _ptr, T * _newPtr);
+
+    inline void compilerBarrier();
+}
+
+#if defined(_MSC_VER)
+
+//----------------------------------------------------------------------------
+// Visual Studio
+//----------------------------------------------------------------------------
+inline long NWAtomic::increment(long volatile * _value)
+{
+    return _InterlockedIncrement(_value);
+}
+
+inline long NWAtomic::decrement(long volatile * _value)
+{
+    return _InterlockedDecrement(_value);
+}
+
+inline long NWAtomic::exchange(long volatile * _value, long _newValue)
+{
+    return _InterlockedExchange(_value, _newValue);
+}
+
+inline long NWAtomic::exchangeAdd(long volatile * _value, long _add)
+{
+    return _InterlockedExchangeAdd(_value, _add);
+}
+
+inline long NWAtomic::compareExchange(long volatile * _value, long _newValue, long _comparand)
+{
+    return _InterlockedCompareExchange(_value, _newValue, _comparand);
+}
+
+inline s64 NWAtomic::compareExchange64(s64 volatile * _value, s64 _newValue, s64 _comparand)
+{
+    return _InterlockedCompareExchange64(_value, _newValue, _comparand);
+}
+
+inline s64 NWAtomic::increment64(s64 volatile * _value)
+{
+    s64 oldValue = 0;
+    do
+    {
+        oldValue = *_value;
+    }
+    while(_InterlockedCompareExchange64(_value, oldValue + 1, oldValue) != oldValue);
+
+    return oldValue + 1;
+}
+
+inline u64 NWAtomic::exchangeAdd64(u64 volatile * _value, u64 _add)
+{
+    u64 oldValue = 0;
+    do
+    {
+        oldValue = *_value;
+    }
+    while((u64)_InterlockedCompareExchange64((__int64 volatile *)_value, (__int64)(oldValue + _add), (__int64)oldValue) != oldValue);
+
+    return oldValue;
+}
+
+inline u64 NWAtomic::load64(u64 const volatile * _value)
+{
+    return (u64)_InterlockedCompareExchange64((__int64 volatile *)_value, 0, 0); // doesn't change the value, a plain read could be torn
+}
+
+template <class T> inline T * NWAtomic::exchangePtr(T * volatile * _ptr, T * _newPtr)
+{
+#if defined(_WIN64)
+    return (T *)_InterlockedExchangePointer((void * volatile *)_ptr, _newPtr);
+#else
+    return (T *)(size_t)_InterlockedExchange((long volatile *)_ptr, (long)(size_t)_newPtr);
+#endif
+}
+
+template <class T> inline T * NWAtomic::compareExchangePtr(T * volatile * _ptr, T * _newPtr, T * _comparand)
+{
+#if defined(_WIN64)
+    return (T *)_InterlockedCompareExchangePointer((void * volatile *)_ptr, _newPtr, _comparand);
+#else
+    return (T *)(size_t)_InterlockedCompareExchange((long volatile *)_ptr, (long)(size_t)_newPtr, (long)(size_t)_comparand);
+#endif
+}
+
+template <class T> inline T * NWAtomic::loadAcquire(T * const volatile * _ptr)
+{
+    return *_ptr; // volatile reads have acquire semantics in Visual Studio 2005 and later
+}
+
+template <class T> inline void NWAtomic::storeRelease(T * volatile * _ptr, T * _newPtr)
+{
+    *_ptr = _newPtr; // volatile writes have release semantics in Visual Studio 2005 and later
+}
+
+inline void NWAtomic::compilerBarrier()
+{
+    _ReadWriteBarrier();
+}
+
+#else
+
+//----------------------------------------------------------------------------
+// GCC / Clang
+//----------------------------------------------------------------------------
+inline long NWAtomic::increment(long volatile * _value)
+{
+    return __atomic_add_fetch(_value, 1, __ATOMIC_SEQ_CST);
+}
+
+inline long NWAtomic::decrement(long volatile * _value)
+{
+    return __atomic_sub_fetch(_value, 1, __ATOMIC_SEQ_CST);
+}
+
+inline long NWAtomic::exchange(long volatile * _value, long _newValue)
+{
+    return __atomic_exchange_n(_value, _newValue, __ATOMIC_SEQ_CST);
+}
+
+inline long NWAtomic::exchangeAdd(long volatile * _value, long _add)
+{
+    return __atomic_fetch_add(_value, _add, __ATOMIC_SEQ_CST);
+}
+
+inline long NWAtomic::compareExchange(long volatile * _value, long _newValue, long _comparand)
+{
+    __atomic_compare_exchange_n(_value, &_comparand, _newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return _comparand;
+}
+
+inline s64 NWAtomic::compareExchange64(s64 volatile * _value, s64 _newValue, s64 _comparand)
+{
+    __atomic_compare_exchange_n(_value, &_comparand, _newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return _comparand;
+}
+
+inline s64 NWAtomic::increment64(s64 volatile * _value)
+{
+    return __atomic_add_fetch(_value, 1, __ATOMIC_SEQ_CST);
+}
+
+inline u64 NWAtomic::exchangeAdd64(u64 volatile * _value, u64 _add)
+{
+    return __atomic_fetch_add(_value, _add, __ATOMIC_SEQ_CST);
+}
+
+inline u64 NWAtomic::load64(u64 const volatile * _value)
+{
+    return __atomic_load_n(_value, __ATOMIC_SEQ_CST);
+}
+
+template <class T> inline T * NWAtomic::exchangePtr(T * volatile * _ptr, T * _newPtr)
+{
+    return __atomic_exchange_n(_ptr, _newPtr, __ATOMIC_SEQ_CST);
+}
+
+template <class T> inline T * NWAtomic::compareExchangePtr(T * volatile * _ptr, T * _newPtr, T * _comparand)
+{
+    __atomic_compare_exchange_n(_ptr, &_comparand, _newPtr, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return _comparand;
+}
+
+template <class T> inline T * NWAtomic::loadAcquire(T * const volatile * _ptr)
+{
+    return __atomic_load_n(_ptr, __ATOMIC_ACQUIRE);
+}
+
+template <class T> inline void NWAtomic::storeRelease(T * volatile * _ptr, T * _newPtr)
+{
+    __atomic_store_n(_ptr, _newPtr, __ATOMIC_RELEASE);
+}
+
+inline void NWAtomic::compilerBarrier()
+{
+    __asm__ __volatile__("" ::: "memory");
+}
+
+#endif
+
+#endif // _INCREW_ATOMIC_H_
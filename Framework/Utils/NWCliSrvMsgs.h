@@ -45,6 +45,7 @@
 #include "MsgTypes.h"
 
 #include "MemBufferRef.h"
+#include "Serializer.h"
 
 //----------------------------------------------------------------------------
 //
@@ -60,6 +61,64 @@ enum eCliSrvMsg
     // the last msg must be <= MsgType_CliSrvMsg_End
 };
 
+//----------------------------------------------------------------------------
+// Key of the msgs about an object : context + object name
+//----------------------------------------------------------------------------
+inline u32 getCliSrvObjKey(std::string const & _context, std::string const & _objName)
+{
+    u32 hash = 2166136261u; // FNV-1a
+
+    for(std::string::size_type i=0; i<_context.size(); i++)
+    {
+        hash = (hash ^ (u8)_context[i]) * 16777619u;
+    }
+
+    hash = (hash ^ '/') * 16777619u;
+
+    for(std::string::size_type i=0; i<_objName.size(); i++)
+    {
+        hash = (hash ^ (u8)_objName[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+#define NWCLISRV_OBJ_KEY(T, conflatable) \
+    virtual bool getMsgKey(u32 & key_) const {key_ = getCliSrvObjKey(mContext, mObjName); return true;} \
+    virtual bool isSameMsgKey(NWBaseMsgInternal const * _other) const \
+    { \
+        T const * other = (T const *)_other; \
+        return mObjName == other->mObjName && mContext == other->mContext; \
+    } \
+    virtual bool isConflatable() const {return conflatable;}
+
+//----------------------------------------------------------------------------
+// Serialization of the buffers carried by the msgs
+//----------------------------------------------------------------------------
+inline void addCliSrvBuffer(ISerializerOut & _out, MemBufferRef const & _buffer)
+{
+    _out.addInt(_buffer.getSize());
+    if(_buffer.getSize() > 0)
+    {
+        _out.addBuffer(_buffer.getPtr(), _buffer.getSize());
+    }
+}
+
+inline void getCliSrvBuffer(ISerializerIn & _in, MemBufferRef & buffer_)
+{
+    int size = _in.getInt();
+    if(size > 0)
+    {
+        MemBufferRef buffer(size);
+        _in.getBuffer(buffer.getPtr(), size);
+        buffer_ = buffer;
+    }
+    else
+    {
+        buffer_ = MemBufferRef();
+    }
+}
+
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
@@ -68,6 +127,22 @@ NWMSGF(MsgClientUpdateReq, MsgFamily_CliSrvDataService)
 {
     std::string mContext;
     std::string mObjName;
+
+    NWCLISRV_OBJ_KEY(MsgClientUpdateReq, true)
+
+    virtual bool serializeOut(ISerializerOut & _out) const
+    {
+        _out.addString(mContext);
+        _out.addString(mObjName);
+        return true;
+    }
+
+    virtual bool serializeIn(ISerializerIn & _in)
+    {
+        mContext = _in.getString();
+        mObjName = _in.getString();
+        return true;
+    }
 };
 #pragma pack(pop)
 
@@ -81,6 +156,24 @@ NWMSGF(MsgServerUpdateClient, MsgFamily_CliSrvDataService)
     MsgServerUpdateClient()
     {
     }
+
+    NWCLISRV_OBJ_KEY(MsgServerUpdateClient, true)
+
+    virtual bool serializeOut(ISerializerOut & _out) const
+    {
+        _out.addString(mContext);
+        _out.addString(mObjName);
+        addCliSrvBuffer(_out, mMemBuffer);
+        return true;
+    }
+
+    virtual bool serializeIn(ISerializerIn & _in)
+    {
+        mContext = _in.getString();
+        mObjName = _in.getString();
+        getCliSrvBuffer(_in, mMemBuffer);
+        return true;
+    }
 };
 #pragma pack(pop)
 
@@ -95,6 +188,23 @@ NWMSGF(MsgClientSetValue, MsgFamily_CliSrvDataService)
     {
     }
 
+    NWCLISRV_OBJ_KEY(MsgClientSetValue, true)
+
+    virtual bool serializeOut(ISerializerOut & _out) const
+    {
+        _out.addString(mContext);
+        _out.addString(mObjName);
+        addCliSrvBuffer(_out, mMemBuffer);
+        return true;
+    }
+
+    virtual bool serializeIn(ISerializerIn & _in)
+    {
+        mContext = _in.getString();
+        mObjName = _in.getString();
+        getCliSrvBuffer(_in, mMemBuffer);
+        return true;
+    }
 };
 #pragma pack(pop)
 
@@ -117,6 +227,28 @@ NWMSGF(MsgSvcEvent, MsgFamily_CliSrvDataService)
         mEventType(0)
     {
     }
+
+    NWCLISRV_OBJ_KEY(MsgSvcEvent, false)
+
+    virtual bool serializeOut(ISerializerOut & _out) const
+    {
+        _out.addBool(mServerMsg);
+        _out.addString(mContext);
+        _out.addString(mObjName);
+        _out.addInt(mEventType);
+        addCliSrvBuffer(_out, mMemBuffer);
+        return true;
+    }
+
+    virtual bool serializeIn(ISerializerIn & _in)
+    {
+        mServerMsg = _in.getBool();
+        mContext = _in.getString();
+        mObjName = _in.getString();
+        mEventType = _in.getInt();
+        getCliSrvBuffer(_in, mMemBuffer);
+        return true;
+    }
 };
 #pragma pack(pop)
 
@@ -0,0 +1,300 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWCommFrame.h"
+
+#include <memory.h>
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWFrame::writeVarint(unsigned char * out_buff, u32 _value)
+{
+    int iRet = 0;
+
+    while(_value >= 0x80)
+    {
+        out_buff[iRet++] = (unsigned char)(_value | 0x80);
+        _value >>= 7;
+    }
+    out_buff[iRet++] = (unsigned char)_value;
+
+    return iRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWFrame::readVarint(unsigned char const * _buffPtr, int _size, u32 & out_value)
+{
+    u32 value = 0;
+
+    for(int i=0; i<_size && i<5; i++)
+    {
+        value |= (u32)(_buffPtr[i] & 0x7F) << (7 * i);
+        if(!(_buffPtr[i] & 0x80))
+        {
+            out_value = value;
+            return i + 1;
+        }
+    }
+
+    return (_size < 5) ? 0 : -1;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWFrame::writeHeader(unsigned char * out_header, int _msgType, int _flags, int _size)
+{
+    ASSERT(_msgType >= 0 && _size >= 0 && _size <= NWFrameMaxSize);
+
+    int iRet = writeVarint(out_header, (u32)_size);
+    iRet += writeVarint(out_header + iRet, (u32)_msgType);
+    out_header[iRet++] = (unsigned char)_flags;
+
+    return iRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWFrame::readHeader(unsigned char const * _buffPtr, int _size, int & out_msgType, int & out_flags, int & out_frameSize)
+{
+    u32 frameSize = 0;
+    u32 msgType = 0;
+
+    int sizeLen = readVarint(_buffPtr, _size, frameSize);
+    if(sizeLen <= 0)
+        return sizeLen;
+
+    if(frameSize > NWFrameMaxSize)
+        return -1;
+
+    int typeLen = readVarint(_buffPtr + sizeLen, _size - sizeLen, msgType);
+    if(typeLen <= 0)
+        return typeLen;
+
+    if(msgType > 0x7FFFFFFF)
+        return -1;
+
+    int iRet = sizeLen + typeLen;
+    if(iRet >= _size)
+        return 0;
+
+    out_frameSize = (int)frameSize;
+    out_msgType = (int)msgType;
+    out_flags = _buffPtr[iRet];
+
+    return iRet + 1;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWFrameReader::NWFrameReader(MemBufferPool * _slabPool) :
+    mSlabPool(_slabPool),
+    mUsed(0),
+    mParsed(0),
+    mSpillUsed(0),
+    mSpillMsgType(0),
+    mSpillFlags(0),
+    mCommitTimeNs(0)
+{
+    ASSERT(_slabPool->getBufferSize() > NWFrameSpillMinSize + NWFrameMaxHeaderSize);
+}
+
+//----------------------------------------------------------------------------
+// A full slab is replaced here, the incomplete frame at its end is the only
+// data copied
+//----------------------------------------------------------------------------
+unsigned char * NWFrameReader::getWritePtr(int & out_size)
+{
+    if(mSpill.getSize() > 0)
+    {
+        out_size = mSpill.getSize() - mSpillUsed;
+        return mSpill.getPtr() + mSpillUsed;
+    }
+
+    int slabSize = mSlabPool->getBufferSize();
+
+    if(mSlab.getSize() == 0 || mUsed == slabSize)
+    {
+        MemBufferRef slab = mSlabPool->alloc();
+
+        int pending = mUsed - mParsed;
+        if(pending > 0)
+        {
+            memcpy(slab.getPtr(), mSlab.getPtr() + mParsed, pending);
+        }
+
+        mSlab = slab;
+        mUsed = pending;
+        mParsed = 0;
+    }
+
+    out_size = slabSize - mUsed;
+    return mSlab.getPtr() + mUsed;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWFrameReader::commit(int _size, u64 _timeNs/*=0*/)
+{
+    bool bRet = true;
+
+    mCommitTimeNs = _timeNs;
+
+    if(mSpill.getSize() > 0)
+    {
+        mSpillUsed += _size;
+        ASSERT(mSpillUsed <= mSpill.getSize());
+
+        if(mSpillUsed == mSpill.getSize())
+        {
+            addFrame(mSpillMsgType, mSpillFlags, mSpill);
+            mSpill = MemBufferRef();
+            mSpillUsed = 0;
+        }
+    }
+    else
+    {
+        mUsed += _size;
+        ASSERT(mUsed <= mSlab.getSize());
+
+        bRet = parse();
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// The slab is let go once nothing is pending in it, the frames keep it alive
+// and an idle connection doesn't hold one
+//----------------------------------------------------------------------------
+void NWFrameReader::takeFrames(std::vector<sNWFrame> & out_frames)
+{
+    if(out_frames.empty())
+    {
+        out_frames.swap(mFrames);
+    }
+    else
+    {
+        out_frames.insert(out_frames.end(), mFrames.begin(), mFrames.end());
+        mFrames.clear();
+    }
+
+    if(mParsed == mUsed)
+    {
+        mSlab = MemBufferRef();
+        mUsed = 0;
+        mParsed = 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWFrameReader::parse()
+{
+    while(mParsed < mUsed)
+    {
+        unsigned char * ptr = mSlab.getPtr() + mParsed;
+        int available = mUsed - mParsed;
+
+        int msgType = 0;
+        int flags = 0;
+        int frameSize = 0;
+        int headerSize = NWFrame::readHeader(ptr, available, msgType, flags, frameSize);
+
+        if(headerSize < 0)
+            return false;
+
+        if(headerSize == 0)
+            break;
+
+        int received = available - headerSize;
+
+        if(received >= frameSize)
+        {
+            addFrame(msgType, flags, MemBufferRef(mSlab, mParsed + headerSize, frameSize));
+            mParsed += headerSize + frameSize;
+        }
+        else
+        {
+            if(frameSize >= NWFrameSpillMinSize)
+            {
+                mSpill = MemBufferRef(frameSize);
+                memcpy(mSpill.getPtr(), ptr + headerSize, received);
+                mSpillUsed = received;
+                mSpillMsgType = msgType;
+                mSpillFlags = flags;
+
+                mParsed = mUsed;
+            }
+            break;
+        }
+    }
+
+    return true;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWFrameReader::addFrame(int _msgType, int _flags, MemBufferRef const & _data)
+{
+    mFrames.push_back(sNWFrame());
+
+    sNWFrame & frame = mFrames.back();
+    frame.mMsgType = _msgType;
+    frame.mFlags = _flags;
+    frame.mData = _data;
+    frame.mTimeNs = mCommitTimeNs;
+}
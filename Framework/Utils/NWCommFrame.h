@@ -0,0 +1,166 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_COMM_FRAME_H_
+#define _INCREW_COMM_FRAME_H_
+
+#include "NWTypes.h"
+#include "MemBufferRef.h"
+
+#include <vector>
+
+//****************************************************************************
+// Framing of the socket streams. Every message goes as
+//  - payload size  : varint, 7 bits per byte, low bits first
+//  - message type  : varint
+//  - flags         : 1 byte, eNWFrameFlags
+//  - payload
+//****************************************************************************
+enum eNWFrameDefs
+{
+    NWFrameMaxHeaderSize = 5 + 5 + 1,
+    NWFrameMaxSize = 16*1024*1024,          // bigger frames break the stream
+    NWFrameSlabSize = 64*1024,              // pooled receive buffers the frames are parsed from
+    NWFrameSlabsMaxFree = 64,               // slabs kept by the pool of a socket
+    NWFrameSpillMinSize = 16*1024           // an incomplete frame this big gets a buffer of its own
+};
+
+enum eNWFrameFlags
+{
+    NWFRAME_FLAG_NONE = 0,                  // the bits are defined by the features using them
+    NWFRAME_FLAG_CONTROL = 1 << 0,          // handled by the sockets, the type is a eNWFrameControl
+    NWFRAME_FLAG_SHARED = 1 << 1,           // local sockets, the payload is a sNWFrameFdRef of the descriptor sent with the frame
+    NWFRAME_FLAG_COMPRESSED = 1 << 2        // the payload is the size of the data (varint) and its NWLz block
+};
+
+enum eNWFrameControl
+{
+    NWFRAME_CONTROL_PING = 1,               // payload : the NWTime::getTimeNs of the sender, answered at once
+    NWFRAME_CONTROL_PONG,                   // the payload of the ping, back to its sender
+    NWFRAME_CONTROL_HELLO                   // payload : 1 byte of eNWFrameCaps, answered with those of the other side if it didn't send them yet
+};
+
+//----------------------------------------------------------------------------
+// What a side of a connection takes, told by its hello. A side only sends
+// its hello if it wants to use them, the peers that don't know it ignore it.
+//----------------------------------------------------------------------------
+enum eNWFrameCaps
+{
+    NWFRAME_CAP_NONE = 0,
+    NWFRAME_CAP_COMPRESSED = 1 << 0         // NWFRAME_FLAG_COMPRESSED frames
+};
+
+//----------------------------------------------------------------------------
+// Where the data of a shared frame is in its descriptor. Both ends are on the
+// same machine, it goes in its native layout.
+//----------------------------------------------------------------------------
+struct sNWFrameFdRef
+{
+    u32 mOffset;
+    u32 mSize;
+};
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+struct sNWFrame
+{
+    int mMsgType;
+    int mFlags;
+    MemBufferRef mData;
+    u64 mTimeNs;        // given to the commit that completed it
+};
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+namespace NWFrame
+{
+    int writeHeader(unsigned char * out_header, int _msgType, int _flags, int _size); // NWFrameMaxHeaderSize bytes room, returns the header size
+    int readHeader(unsigned char const * _buffPtr, int _size, int & out_msgType, int & out_flags, int & out_frameSize); // header size, 0 if incomplete, -1 if malformed
+    int writeVarint(unsigned char * out_buff, u32 _value); // 5 bytes room, returns the bytes written
+    int readVarint(unsigned char const * _buffPtr, int _size, u32 & out_value); // bytes taken, 0 if incomplete, -1 if longer than 5 bytes
+}
+
+//****************************************************************************
+// Splits a received stream into frames without copying them: the data is
+// read straight into a slab and every frame is a view of it. A frame left
+// incomplete at the end of a slab is moved to the start of the next one, a
+// big one is completed in its own spill buffer. The views keep the slabs
+// alive, a slab goes back to the pool with the last of them.
+//****************************************************************************
+class NWFrameReader
+{
+public:
+    NWFrameReader(MemBufferPool * _slabPool);
+
+    unsigned char * getWritePtr(int & out_size);            // where the next read goes
+    bool commit(int _size, u64 _timeNs=0);                  // _size bytes were read at _timeNs (NWTime), false if the stream is malformed
+    void takeFrames(std::vector<sNWFrame> & out_frames);    // the complete frames, appended
+
+    inline bool hasFrames() const;
+
+private:
+    MemBufferPool * mSlabPool;
+    MemBufferRef mSlab;
+    int mUsed;          // bytes read into mSlab
+    int mParsed;        // bytes of mSlab taken by frames
+
+    MemBufferRef mSpill;
+    int mSpillUsed;
+    int mSpillMsgType;
+    int mSpillFlags;
+
+    u64 mCommitTimeNs;
+    std::vector<sNWFrame> mFrames;
+
+    bool parse();
+    void addFrame(int _msgType, int _flags, MemBufferRef const & _data);
+
+    NWFrameReader(NWFrameReader const & _other);                // disabled copy
+    NWFrameReader operator=(NWFrameReader const & _other);      // disabled copy
+};
+
+inline bool NWFrameReader::hasFrames() const
+{
+    return !mFrames.empty();
+}
+
+#endif // _INCREW_COMM_FRAME_H_
@@ -51,14 +51,14 @@
 //****************************************************************************
 //
 //****************************************************************************
-/*static*/ bool NWCommManager::staticInit(int _serversReserve/*=eReserve_Servers*/, int _clientsReserve/*=eReserve_Clients*/)
+/*static*/ bool NWCommManager::staticInit(int _serversReserve/*=eReserve_Servers*/, int _clientsReserve/*=eReserve_Clients*/, eNWSocketBackend _backend/*=NWSOCKET_BACKEND_DEFAULT*/, int _numReactors/*=1*/)
 {
     bool bRet = true;
 
     if(!mInstance)
     {
         mInstance = NEW NWCommManager();
-        mInstance->init(_serversReserve , _clientsReserve);
+        mInstance->init(_serversReserve , _clientsReserve, _backend, _numReactors);
     }
 
     return bRet;
@@ -78,6 +78,8 @@
 //****************************************************************************
 NWCommManager::NWCommManager() :
     mInitd(false),
+    mSocketBackend(NWSOCKET_BACKEND_DEFAULT),
+    mNumReactors(1),
     mNWCommManagerNotificationCallback(NULL)
 {
 }
@@ -89,12 +91,14 @@ NWCommManager::~NWCommManager()
 //****************************************************************************
 //
 //****************************************************************************
-bool NWCommManager::init(int _serversReserve/*=eReserve_Servers*/, int _clientsReserve/*=eReserve_Clients*/)
+bool NWCommManager::init(int _serversReserve/*=eReserve_Servers*/, int _clientsReserve/*=eReserve_Clients*/, eNWSocketBackend _backend/*=NWSOCKET_BACKEND_DEFAULT*/, int _numReactors/*=1*/)
 {
     bool bRet = false;
 
     if(!mInitd)
     {
+        mSocketBackend = _backend;
+        mNumReactors = (_numReactors > 1) ? _numReactors : 1;
         mServerList.reserve(_serversReserve);
         mClientList.reserve(_clientsReserve);
 
@@ -141,6 +145,43 @@ NWClientSocket * NWCommManager::createClient(NWIP _serverIp, int _serverPort)
     return client;
 }
 
+NWServerSocket * NWCommManager::createServer(char const * _localPath)
+{
+    NWServerSocket * server = NWServerSocket::create();
+
+    sSockNode node;
+    node.mSocket = server;
+    mServerList.push_back(node);
+
+    server->init(_localPath);
+
+    return server;
+}
+
+NWClientSocket * NWCommManager::createClient(char const * _localPath)
+{
+    NWClientSocket * client = NWClientSocket::create();
+
+    sSockNode node;
+    node.mSocket = client;
+    mClientList.push_back(node);
+
+    client->init(_localPath);
+    return client;
+}
+
+NWClientSocket * NWCommManager::adoptClient(int _connectedFd)
+{
+    NWClientSocket * client = NWClientSocket::create();
+
+    sSockNode node;
+    node.mSocket = client;
+    mClientList.push_back(node);
+
+    client->init(_connectedFd);
+    return client;
+}
+
 //****************************************************************************
 //
 //****************************************************************************
@@ -157,6 +198,7 @@ void NWCommManager::destroyServer(NWServerSocket * _server)
             NWServerSocket::destroy(server);
             
             mServerList.erase(mServerList.begin() + i);
+            break;
         }
     }
 }
@@ -174,6 +216,7 @@ void NWCommManager::destroyClient(NWClientSocket * _client)
             NWClientSocket::destroy(client);
 
             mClientList.erase(mClientList.begin() + i);
+            break;
         }
     }
 }
@@ -186,7 +229,7 @@ int NWCommManager::getNumIntefaces()
     return 1;
 }
 
-NWIP NWCommManager::getInterface(int _idx)
+NWIP NWCommManager::getInterface(int /*_idx*/)
 {
     NWIP ip;
     ip.setFromStr("127.0.0.1"); // zzz pending
@@ -226,5 +269,9 @@ void NWCommManager::dispatchNetworkMessages()
 //****************************************************************************
 void NWCommManager::sendNotification()
 {
-    mNWCommManagerNotificationCallback->networkMsgNotification();
+    // called from the socket threads
+    if(mNWCommManagerNotificationCallback)
+    {
+        mNWCommManagerNotificationCallback->networkMsgNotification();
+    }
 }
@@ -49,6 +49,13 @@ class NWSocket;
 class NWServerSocket;
 class NWClientSocket;
 
+enum eNWSocketBackend
+{
+    NWSOCKET_BACKEND_DEFAULT = 0,   // epoll on Linux
+    NWSOCKET_BACKEND_EPOLL,
+    NWSOCKET_BACKEND_URING          // Linux io_uring, epoll if the kernel can't run it
+};
+
 struct NWCommManagerNotificationCallback
 {
     virtual void networkMsgNotification() = 0;
@@ -63,19 +70,27 @@ public:
         eReserve_Clients = 16
     };
 
-    // singleton management
-    static bool staticInit(int _serversReserve=eReserve_Servers, int _clientsReserve=eReserve_Clients);
+    // singleton management. Every server runs _numReactors threads, each one with its own listener
+    // on the port (SO_REUSEPORT) and its own clients
+    static bool staticInit(int _serversReserve=eReserve_Servers, int _clientsReserve=eReserve_Clients, eNWSocketBackend _backend=NWSOCKET_BACKEND_DEFAULT, int _numReactors=1);
     static void staticShutdown();
     static inline NWCommManager * instance();
 
     // --- ---
-    bool init(int _serversReserve, int _clientsReserve);
+    bool init(int _serversReserve, int _clientsReserve, eNWSocketBackend _backend=NWSOCKET_BACKEND_DEFAULT, int _numReactors=1);
     void shutdown();
 
+    inline eNWSocketBackend getSocketBackend() const; // used by the sockets created after
+    inline void setSocketBackend(eNWSocketBackend _backend); // the sockets already created keep theirs
+    inline int getNumReactors() const; // used by the servers created after
+
     inline void setNotificationCallback(NWCommManagerNotificationCallback * _callback);
 
     NWServerSocket * createServer(NWIP _serverIp, int _listenPort);
     NWClientSocket * createClient(NWIP _serverIp, int _serverPort);
+    NWServerSocket * createServer(char const * _localPath); // peers of the same machine, see NWServerSocket::init
+    NWClientSocket * createClient(char const * _localPath);
+    NWClientSocket * adoptClient(int _connectedFd); // an end of a socketpair, see NWClientSocket::init
 
     void destroyServer(NWServerSocket * _server);
     void destroyClient(NWClientSocket * _client);
@@ -96,6 +111,8 @@ private:
     static NWCommManager * mInstance;
 
     bool mInitd;
+    eNWSocketBackend mSocketBackend;
+    int mNumReactors;
     std::vector<sSockNode> mServerList;
     std::vector<sSockNode> mClientList;
 
@@ -113,6 +130,27 @@ private:
     return mInstance;
 }
 
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+inline eNWSocketBackend NWCommManager::getSocketBackend() const
+{
+    return mSocketBackend;
+}
+
+inline void NWCommManager::setSocketBackend(eNWSocketBackend _backend)
+{
+    mSocketBackend = _backend;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+inline int NWCommManager::getNumReactors() const
+{
+    return mNumReactors;
+}
+
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
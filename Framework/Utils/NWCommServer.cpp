@@ -37,9 +37,445 @@
 *      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
- */
+
 #include "PchUtils.h"
 
 #include "NWCommServer.h"
+#include "NWCommManager.h"
+#include "NWCriticalSection.h"
+#include "MemBufferRef.h"
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWCommServer::NWCommServer() :
+    mInitd(false),
+    mSocket(NULL),
+    mSoftVer(0),
+    mPingInterval(0),
+    mPingTimer(InvalidTimerId),
+    mPingCritSec(NULL)
+{
+}
+
+/*virtual*/ NWCommServer::~NWCommServer()
+{
+    done();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWCommServer::init()
+{
+    if(!mInitd)
+    {
+        mListenerList.reserve(8);
+        mPingCritSec = NWCriticalSection::create();
+        mInitd = true;
+    }
+
+    return true;
+}
+
+void NWCommServer::done()
+{
+    if(mInitd)
+    {
+        stop();
+        mListenerList.clear();
+        NWCriticalSection::destroy(mPingCritSec);
+
+        mInitd = false;
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Listens on every interface
+//----------------------------------------------------------------------------
+bool NWCommServer::start(StrId _serverName, int _port, int _softVer)
+{
+    bool bRet = false;
+
+    NWCommManager * commManager = NWCommManager::instance();
+    if(mInitd && !mSocket && commManager)
+    {
+        bRet = startSocket(commManager->createServer(NWIP(), _port), _serverName, _softVer);
+    }
+
+    return bRet;
+}
+
+bool NWCommServer::start(StrId _serverName, char const * _localPath, int _softVer)
+{
+    bool bRet = false;
+
+    NWCommManager * commManager = NWCommManager::instance();
+    if(mInitd && !mSocket && commManager)
+    {
+        bRet = startSocket(commManager->createServer(_localPath), _serverName, _softVer);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Takes the socket, destroyed if it didn't start
+//----------------------------------------------------------------------------
+bool NWCommServer::startSocket(NWServerSocket * _socket, StrId _serverName, int _softVer)
+{
+    bool bRet = false;
+
+    mSocket = _socket;
+    if(mSocket->isInitd())
+    {
+        mSocket->addListener(this);
+
+        mServerName = _serverName;
+        mSoftVer = _softVer;
+        startPingTimer();
+        bRet = true;
+    }
+    else
+    {
+        NWCommManager::instance()->destroyServer(mSocket);
+        mSocket = NULL;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// The listeners aren't told about the clients, they are just dropped
+//----------------------------------------------------------------------------
+void NWCommServer::stop()
+{
+    if(mSocket)
+    {
+        stopPingTimer();
+
+        NWServerSocket * socket = mSocket;
+        {
+            NWAutoCritSec autoCS(mPingCritSec);
+            mSocket = NULL;
+        }
+        NWCommManager::instance()->destroyServer(socket);
+
+        mClients.clear();
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWCommServer::getNumClients() const
+{
+    return (int)mClients.size();
+}
+
+NWCommServer::ClientData NWCommServer::getClientData(int _index)
+{
+    ASSERT(_index >= 0 && _index < (int)mClients.size());
+    return mClients[_index];
+}
+
+int NWCommServer::getClientId(int _index) const
+{
+    ASSERT(_index >= 0 && _index < (int)mClients.size());
+    return mClients[_index].mClientId;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWCommServer::getServerPort()
+{
+    return mSocket ? mSocket->getPort() : -1;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+// The client's send queue keeps a reference to the buffer, not a copy
+//----------------------------------------------------------------------------
+bool NWCommServer::sendMessage(int _clientId, int _msgType, MemBufferRef * _memBuff)
+{
+    bool bRet = false;
+
+    if(mSocket)
+    {
+        bRet = mSocket->send(_clientId, eMsgType_User + _msgType, *_memBuff);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// The frame is built once and every queue shares the buffer, so the cost
+// per client doesn't depend on the size of the message
+//----------------------------------------------------------------------------
+void NWCommServer::sendMessageAll(int _msgType, MemBufferRef * _memBuff)
+{
+    if(mSocket)
+    {
+        mSocket->send(eMsgType_User + _msgType, *_memBuff);
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWCommServer::setSendQueueLimits(int _lowBytes, int _highBytes, int _policy)
+{
+    if(mSocket)
+    {
+        mSocket->setSendQueueLimits(_lowBytes, _highBytes, _policy);
+    }
+}
+
+void NWCommServer::setCompression(int _minSize)
+{
+    if(mSocket)
+    {
+        mSocket->setCompression(_minSize);
+    }
+}
+
+bool NWCommServer::getSendQueueStats(int _clientId, NWSendQueueStats & out_stats)
+{
+    return mSocket && mSocket->getSendQueueStats(_clientId, out_stats);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+// The round trip comes later, see onPing
+//----------------------------------------------------------------------------
+void NWCommServer::ping(int _clientId)
+{
+    if(mSocket)
+    {
+        mSocket->ping(_clientId);
+    }
+}
+
+void NWCommServer::pingAll()
+{
+    if(mSocket)
+    {
+        mSocket->ping();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWCommServer::getLastPingClient(int _clientId)
+{
+    ClientData * client = findClient(_clientId);
+    return client ? client->mLastPing : -1;
+}
+
+int NWCommServer::getAveragePingClient(int _clientId)
+{
+    ClientData * client = findClient(_clientId);
+    return (client && client->mLastPing >= 0) ? (int)(client->mAveragePing + 0.5f) : -1;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWCommServer::setPingInterval(int _ms)
+{
+    mPingInterval = _ms;
+
+    if(mSocket)
+    {
+        stopPingTimer();
+        startPingTimer();
+    }
+}
+
+//----------------------------------------------------------------------------
+// A single periodic timer pings every client
+//----------------------------------------------------------------------------
+void NWCommServer::startPingTimer()
+{
+    NWTimerService * timerService = NWTimerService::instance();
+    if(mPingInterval > 0 && timerService)
+    {
+        NWAutoCritSec autoCS(mPingCritSec);
+        mPingTimer = timerService->addTimer(mPingInterval, this, NULL, true);
+    }
+}
+
+void NWCommServer::stopPingTimer()
+{
+    NWTimerId timerId = InvalidTimerId;
+    {
+        NWAutoCritSec autoCS(mPingCritSec);
+        timerId = mPingTimer;
+        mPingTimer = InvalidTimerId;
+    }
+
+    if(timerId != InvalidTimerId)
+    {
+        NWTimerService::instance()->removeTimer(timerId);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Timer thread, the socket sends are thread safe. removeTimer does not wait
+// for a callback already in flight, so stale ids are ignored here
+//----------------------------------------------------------------------------
+/*virtual*/ void NWCommServer::onTimer(NWTimerId _timerId, void * /*_userData*/)
+{
+    NWAutoCritSec autoCS(mPingCritSec);
+
+    if(mSocket && _timerId == mPingTimer)
+    {
+        mSocket->ping();
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWCommServer::addListener(IServerListener * _serverListener)
+{
+    removeListener(_serverListener);
+    mListenerList.push_back(_serverListener);
+}
+
+void NWCommServer::removeListener(IServerListener * _serverListener)
+{
+    int num = (int)mListenerList.size();
+    for(int i=0; i<num; i++)
+    {
+        if(mListenerList[i] == _serverListener)
+        {
+            mListenerList.erase(mListenerList.begin() + i);
+            break;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWCommServer::ClientData * NWCommServer::findClient(int _clientId)
+{
+    int num = (int)mClients.size();
+    for(int i=0; i<num; i++)
+    {
+        if(mClients[i].mClientId == _clientId)
+            return &mClients[i];
+    }
+
+    return NULL;
+}
+
+//****************************************************************************
+// IServerSocketListener
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ bool NWCommServer::onAccept(NWServerSocket * _socket)
+{
+    bool bRet = true;
+
+    for(int i=0; bRet && i<(int)mListenerList.size(); i++)
+    {
+        bRet = mListenerList[i]->onAccept(_socket);
+    }
+
+    return bRet;
+}
+
+/*virtual*/ void NWCommServer::onClientConnected(int _clientId)
+{
+    ClientData client;
+    client.mClientId = _clientId;
+    client.mLastPing = -1;
+    client.mAveragePing = 0.0f;
+    mClients.push_back(client);
+
+    for(int i=0; i<(int)mListenerList.size(); i++)
+    {
+        mListenerList[i]->onClientConnected(_clientId);
+    }
+}
+
+/*virtual*/ void NWCommServer::onClientDisconnected(int _clientId, int /*_reason*/)
+{
+    int num = (int)mClients.size();
+    for(int i=0; i<num; i++)
+    {
+        if(mClients[i].mClientId == _clientId)
+        {
+            mClients.erase(mClients.begin() + i);
+            break;
+        }
+    }
+
+    for(int i=0; i<(int)mListenerList.size(); i++)
+    {
+        mListenerList[i]->onClientDisconnected(_clientId);
+    }
+}
+
+//----------------------------------------------------------------------------
+// Only the messages of the application go to the listeners
+//----------------------------------------------------------------------------
+/*virtual*/ void NWCommServer::onClientData(int _clientIdFrom, int _msgType, MemBufferRef * _memBuff)
+{
+    if(_msgType >= eMsgType_User)
+    {
+        for(int i=0; i<(int)mListenerList.size(); i++)
+        {
+            mListenerList[i]->onClientData(_clientIdFrom, _msgType - eMsgType_User, _memBuff);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// The first round trip starts the average
+//----------------------------------------------------------------------------
+/*virtual*/ void NWCommServer::onPing(int _clientId, int _us)
+{
+    ClientData * client = findClient(_clientId);
+    if(client)
+    {
+        if(client->mLastPing < 0)
+        {
+            client->mAveragePing = (float)_us;
+        }
+        else
+        {
+            client->mAveragePing += ((float)_us - client->mAveragePing) / (float)(1 << eDefault_PingEwmaShift);
+        }
+
+        client->mLastPing = _us;
+        client->mPingHistogram.add((u32)_us);
+    }
 
+    for(int i=0; i<(int)mListenerList.size(); i++)
+    {
+        mListenerList[i]->onPing(_clientId, _us);
+    }
+}
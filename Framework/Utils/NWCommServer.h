@@ -42,16 +42,20 @@
 #define NWCOMM_SERVER_H
 
 #include "NWCommSocket.h"
+#include "NWTimerService.h"
+#include "NWLatencyHistogram.h"
 #include "StrId.h"
 
+#include <vector>
+
 class IServerListener
 {
 public:
     virtual bool onAccept(NWServerSocket * _socket) = 0;
     virtual void onClientConnected(int _clientId) = 0;
     virtual void onClientDisconnected(int _clientId) = 0;
-    virtual void onClientData(int _clientIdFrom, MemBufferRef * _memBuff) = 0;
-    virtual void onPing(int _clientId, int _ms) = 0;
+    virtual void onClientData(int _clientIdFrom, int _msgType, MemBufferRef * _memBuff) = 0;
+    virtual void onPing(int _clientId, int _us) = 0; // round trip, microseconds
 };
 
 class IClientListener
@@ -64,16 +68,33 @@ public:
 };
 
 //****************************************************************************
-//
+// The messages are sent from a MemBufferRef shared by the send queues of
+// the clients, a broadcast is serialised once whatever the number of
+// clients. Slow clients are handled as setSendQueueLimits says.
+// The clients are pinged from the timer service every setPingInterval, the
+// pings are answered by the socket thread of the client.
 //****************************************************************************
-class NWCommServer : public IServerSocketListener
+class NWCommServer : public IServerSocketListener, public NWTimerCallback
 {
 public:
     struct ClientData
     {
         int mClientId;
-        int mLastPing;
-        int mAveragePing;
+        int mLastPing;                          // microseconds, -1 until the first pong
+        float mAveragePing;                     // microseconds, EWMA of the round trips
+        NWLatencyHistogram mPingHistogram;      // p50, p99, max
+    };
+
+    enum eDefaults
+    {
+        eDefault_PingEwmaShift = 3              // each round trip weighs 1/8 in mAveragePing
+    };
+
+    enum eMsgTypes
+    {
+        eMsgType_Ping = 0,
+        eMsgType_Invalid,
+        eMsgType_User       // the types of the application follow, a client sends eMsgType_User + its type
     };
 
     NWCommServer();
@@ -85,6 +106,7 @@ public:
     inline bool isInitd() const;
 
     bool start(StrId _serverName, int _port, int _softVer);
+    bool start(StrId _serverName, char const * _localPath, int _softVer); // clients of the same machine, see NWServerSocket::init
     void stop();
 
     int getNumClients() const;
@@ -92,30 +114,55 @@ public:
 
     int getServerPort();
 
-    void sendMessage(int _clientId, int _msgType, MemBufferRef * _memBuff);
+    bool sendMessage(int _clientId, int _msgType, MemBufferRef * _memBuff); // don't change the buffer after sending it
     void sendMessageAll(int _msgType, MemBufferRef * _memBuff);
 
+    void setSendQueueLimits(int _lowBytes, int _highBytes, int _policy); // eNWSendQueuePolicy
+    void setCompression(int _minSize); // see NWSocket::setCompression
+    bool getSendQueueStats(int _clientId, NWSendQueueStats & out_stats);
+
     void ping(int _clientId);
     void pingAll();
 
-    int getClientId(int _clientId) const;
-    int getLastPingClient(int _clientId);
-    int getAveragePingClient(int _clientId);
+    int getClientId(int _index) const;
+    int getLastPingClient(int _clientId);       // microseconds, -1 if it isn't known
+    int getAveragePingClient(int _clientId);    // microseconds, -1 if it isn't known
 
-    void setPingInterval(int _ms);
+    void setPingInterval(int _ms);              // 0 stops the pings
 
     void addListener(IServerListener * _serverListener);
     void removeListener(IServerListener * _serverListener);
 
 private:
-    enum eMsgTypes
-    {
-        eMsgType_Ping = 0,
-        eMsgType_User,
-        eMsgType_Invalid
-    };
-
+    bool mInitd;
     NWServerSocket * mSocket;
+    StrId mServerName;
+    int mSoftVer;
+    int mPingInterval;
+    NWTimerId mPingTimer;
+    NWCriticalSection * mPingCritSec;   // mSocket, for the timer thread
+    std::vector<ClientData> mClients;
+    std::vector<IServerListener *> mListenerList;
+
+    bool startSocket(NWServerSocket * _socket, StrId _serverName, int _softVer);
+    ClientData * findClient(int _clientId);
+    void startPingTimer();
+    void stopPingTimer();
+
+    // NWTimerCallback
+    virtual void onTimer(NWTimerId _timerId, void * _userData);
+
+    // IServerSocketListener
+    virtual bool onAccept(NWServerSocket * _socket);
+    virtual void onClientConnected(int _clientId);
+    virtual void onClientDisconnected(int _clientId, int _reason);
+    virtual void onClientData(int _clientIdFrom, int _msgType, MemBufferRef * _memBuff);
+    virtual void onPing(int _clientId, int _ms);
 };
 
+inline bool NWCommServer::isInitd() const
+{
+    return mInitd;
+}
+
 #endif // NWCOMM_SERVER_H
@@ -43,15 +43,101 @@
 
 #include "NWThread.h"
 #include "NWIP.h"
+#include "NWIoVec.h"
 
 #include <vector>
 
 struct NWSocketData;
 class NWServerSocket;
+class NWSocketReactor;
 class MemBufferRef;
+class CommNode;
+
+enum eNWSocketDefs
+{
+    NWSocketMaxIoVecs = 64,                 // pieces given to each gathering send, the frame header is one
+    NWSocketMaxEventsPerWait = 256,         // readiness events taken by each wait of the reactor
+    NWSocketListenBacklog = 1024,
+    NWSendQueueDefaultLow = 4*1024*1024,    // bytes
+    NWSendQueueDefaultHigh = 32*1024*1024,  // bytes, above the largest frame
+    NWSocketCompressDefaultMinSize = 1024   // smaller payloads don't pay the compression, see setCompression
+};
+
+enum eNWSocketDisconnectReason
+{
+    NWSOCKET_DISCONNECT_CLOSED = 0, // closed by the other side
+    NWSOCKET_DISCONNECT_ERROR,      // connection error, or it couldn't be established
+    NWSOCKET_DISCONNECT_LOCAL,      // closed by this side
+    NWSOCKET_DISCONNECT_REFUSED     // refused by an onAccept listener
+};
+
+//----------------------------------------------------------------------------
+// Thread that calls the listeners of a server. The reactor threads of a
+// server don't share their clients, each one calls the listeners for its
+// own. In channel mode the events go as msgs (NWCommMsgs.h) through a
+// CommNode, and onAccept isn't asked.
+//----------------------------------------------------------------------------
+enum eNWSocketDispatch
+{
+    NWSOCKET_DISPATCH_APPLICATION = 0,  // dispatchMessages, see NWCommManager::dispatchNetworkMessages
+    NWSOCKET_DISPATCH_REACTOR,          // the reactor thread owning the client
+    NWSOCKET_DISPATCH_CHANNEL           // msgs sent by the reactor thread through a CommNode
+};
+
+//----------------------------------------------------------------------------
+// What is done with a connection whose send queue goes over the high
+// watermark. It is slow until the queue drains down to the low watermark.
+// The messages the socket already started to send are never dropped.
+//----------------------------------------------------------------------------
+enum eNWSendQueuePolicy
+{
+    NWSENDQUEUE_DISCONNECT = 0,     // the connection is closed
+    NWSENDQUEUE_DROP_OLDEST,        // the oldest messages are dropped down to the low watermark
+    NWSENDQUEUE_COALESCE            // while slow a message replaces the queued ones of its type, then as DROP_OLDEST
+};
+
+//----------------------------------------------------------------------------
+// Counters of the send queue of a connection
+//----------------------------------------------------------------------------
+struct NWSendQueueStats
+{
+    int mQueuedMsgs;
+    int mQueuedBytes;
+    int mPeakBytes;         // largest mQueuedBytes
+    int mSlowCount;         // times it went over the high watermark
+    int mDroppedMsgs;
+    int mCoalescedMsgs;
+    s64 mSentMsgs;          // taken by the socket
+    s64 mSentBytes;
+    bool mSlow;
+
+    inline NWSendQueueStats();
+};
+
+inline NWSendQueueStats::NWSendQueueStats() :
+    mQueuedMsgs(0),
+    mQueuedBytes(0),
+    mPeakBytes(0),
+    mSlowCount(0),
+    mDroppedMsgs(0),
+    mCoalescedMsgs(0),
+    mSentMsgs(0),
+    mSentBytes(0),
+    mSlow(false)
+{
+}
 
 //****************************************************************************
-//
+// The sockets run their I/O in their own thread, the listeners are called
+// from dispatchMessages (NWCommManager::dispatchNetworkMessages) in the
+// thread of the application, unless a server dispatches them from its
+// reactor threads (eNWSocketDispatch). Every send is a message with a type,
+// the other side gets it whole (NWCommFrame.h). What a connection can't take
+// at once waits in its send queue, see setSendQueueLimits. The pings are
+// answered by the socket thread of the other side, onPing gets the round
+// trip time. Local sockets (AF_UNIX) pass the big payloads as shared memory
+// instead of copying them through the socket, see allocShared. The payloads
+// can be compressed for slow links, see setCompression.
 //****************************************************************************
 class NWSocket : public NWThreadFn
 {
@@ -64,6 +150,11 @@ public:
 
     inline bool isInitd();
 
+    void setSendQueueLimits(int _lowBytes, int _highBytes, int _policy); // eNWSendQueuePolicy, for every connection, after init
+    void setCompression(int _minSize); // payloads this big go compressed (NWLz) to the peers that take it, 0 stops it. After init
+
+    static MemBufferRef allocShared(int _size); // a payload local peers map instead of receiving it (memfd), a plain buffer where there is none
+
     virtual bool messageAvailable() = 0;
     virtual void dispatchMessages() = 0;
 
@@ -74,8 +165,10 @@ protected:
     };
 
     bool mInitd;
+    bool mLocal;                            // AF_UNIX, set before init
     std::vector<sListener> mListenerList;
     NWSocketData * mSocketData;
+    std::vector<NWSocketData *> mShards;    // mSocketData first, a server has one per reactor thread
 };
 
 inline bool NWSocket::isInitd()
@@ -88,11 +181,11 @@ inline bool NWSocket::isInitd()
 //****************************************************************************
 struct IServerSocketListener
 {
-    virtual bool onAccept(NWServerSocket * _socket) = 0;
+    virtual bool onAccept(NWServerSocket * _socket) = 0; // false refuses the new connection
     virtual void onClientConnected(int _clientId) = 0;
-    virtual void onClientDisconnected(int _clientId, int _reason) = 0;
-    virtual void onClientData(int _clientIdFrom, MemBufferRef * _memBuff) = 0;
-    virtual void onPing(int _clientId, int _ms) = 0;
+    virtual void onClientDisconnected(int _clientId, int _reason) = 0; // eNWSocketDisconnectReason
+    virtual void onClientData(int _clientIdFrom, int _msgType, MemBufferRef * _memBuff) = 0; // copy the MemBufferRef to keep the data
+    virtual void onPing(int _clientId, int _us) = 0; // round trip of a ping, microseconds
 };
 
 //----------------------------------------------------------------------------
@@ -108,13 +201,29 @@ public:
     static NWServerSocket * create();
     static void destroy(NWServerSocket * _serverSocket);
 
-    bool init(NWIP _interface, int _listenPort);
+    bool init(NWIP _interface, int _listenPort); // port 0 takes a free one, see getPort. NWCommManager tells the reactor threads
+    bool init(char const * _localPath);         // AF_UNIX, "@name" is abstract. One reactor thread
     void done();
     void release();
 
     int getPort();
-   
-    void send(unsigned char * _buffPtr, int size);
+    int getNumClients();
+    int getNumReactors();
+
+    void setDispatchMode(int _dispatch, CommNode * _commNode=NULL); // eNWSocketDispatch, before dispatching. The node sends the msgs of the channel mode
+
+    bool send(int _clientId, int _msgType, unsigned char const * _buffPtr, int _size); // thread safe, false if the client isn't connected
+    bool send(int _clientId, int _msgType, NWIoVec const * _vecs, int _numVecs); // the pieces go as one message, see MemorySerializerOut::getIoVecs
+    void send(int _msgType, unsigned char const * _buffPtr, int _size); // to every client
+    void send(int _msgType, NWIoVec const * _vecs, int _numVecs); // to every client
+    bool send(int _clientId, int _msgType, MemBufferRef const & _payload); // the queues share the buffer, don't change it after sending it
+    void send(int _msgType, MemBufferRef const & _payload); // to every client, the buffer is shared by all of them
+    void disconnect(int _clientId);
+
+    bool ping(int _clientId);   // onPing tells the round trip, thread safe
+    void ping();                // every client
+
+    bool getSendQueueStats(int _clientId, NWSendQueueStats & out_stats); // false if the client isn't connected
 
     void addListener(IServerSocketListener * _listener);
     void removeListener(IServerSocketListener * _listener);
@@ -128,7 +237,7 @@ protected:
     };
 
     int mListenPort;
-    NWThread * mListenerThread;
+    std::vector<NWThread *> mReactorThreads;
     sListenerThreadParams mListenerThreadParams;
 
     NWServerSocket();
@@ -136,6 +245,7 @@ protected:
 
     virtual bool messageAvailable();
     virtual void dispatchMessages();
+    void dispatchEvents(NWSocketData * _shard, bool _reactorThread); // the events of the thread the dispatch mode names
 
     // NWThreadFn
     virtual unsigned int threadMain(ThreadParams const * _threadParams);
@@ -144,6 +254,8 @@ protected:
 
     NWServerSocket(NWServerSocket const & _other);              // disabled copy
     NWServerSocket operator=(NWServerSocket const & _other);    // disabled copy
+
+    friend class NWSocketReactor;
 };
 
 //****************************************************************************
@@ -152,9 +264,9 @@ protected:
 struct IClientSocketListener
 {
     virtual void onConnected() = 0;
-    virtual void onDisconnected(int _reason) = 0;
-    virtual void onData(MemBufferRef * _memBuff) = 0;
-    virtual void onPing(int _ms) = 0;
+    virtual void onDisconnected(int _reason) = 0; // eNWSocketDisconnectReason
+    virtual void onData(int _msgType, MemBufferRef * _memBuff) = 0; // copy the MemBufferRef to keep the data
+    virtual void onPing(int _us) = 0; // round trip of a ping, microseconds
 };
 
 //----------------------------------------------------------------------------
@@ -166,11 +278,28 @@ public:
     static NWClientSocket * create();
     static void destroy(NWClientSocket * _socket);
 
-    bool init(NWIP _serverIp, int _serverPort);
+    bool init(NWIP _serverIp, int _serverPort); // connects in the background, onConnected or onDisconnected tell how it went
+    bool init(char const * _localPath);         // to NWServerSocket::init(_localPath)
+    bool init(int _connectedFd);                // takes a connected local socket (socketpair), onConnected follows
     void done();
     void release();
 
+    bool isConnected();
+    bool send(int _msgType, unsigned char const * _buffPtr, int _size); // thread safe, false if it isn't connected
+    bool send(int _msgType, NWIoVec const * _vecs, int _numVecs); // the pieces go as one message, see MemorySerializerOut::getIoVecs
+    bool send(int _msgType, MemBufferRef const & _payload); // the queue shares the buffer, don't change it after sending it
+    void disconnect();
+
+    bool ping(); // onPing tells the round trip, thread safe
+
+    bool getSendQueueStats(NWSendQueueStats & out_stats); // false if it isn't connected
+
+    void addListener(IClientSocketListener * _listener);
+    void removeListener(IClientSocketListener * _listener);
+
 protected:
+    NWThread * mThread;
+
     NWClientSocket();
     virtual ~NWClientSocket();
 
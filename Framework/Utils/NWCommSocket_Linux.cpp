@@ -0,0 +1,1407 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PchUtils.h"
+
+#include "NWCommSocket.h"
+#include "NWCommManager.h"
+#include "NWSocketReactor_Linux.h"
+#include "NWCriticalSection.h"
+#include "MemBufferRef.h"
+#include "NWCommFrame.h"
+#include "NWCommMsgs.h"
+#include "CommNode.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+
+//****************************************************************************
+// Linux sockets : every socket runs a reactor (NWSocketReactor_Linux.h) in
+// its thread, the backend is the one given to NWCommManager::staticInit.
+// A server runs one for each reactor thread of the manager, every one with
+// its own listen socket, connections and events (NWSocketData). What the
+// reactor finds is queued as events for dispatchMessages, or dispatched by
+// the reactor itself (eNWSocketDispatch). The local sockets always run on
+// epoll, the descriptors of their shared frames need sendmsg.
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+static void setupAddress(sockaddr_in & out_addr, NWIP const & _ip, int _port)
+{
+    memset(&out_addr, 0, sizeof(out_addr));
+    out_addr.sin_family = AF_INET;
+    out_addr.sin_port = htons((unsigned short)_port);
+    out_addr.sin_addr.s_addr = htonl(((u32)_ip.a << 24) | ((u32)_ip.b << 16) | ((u32)_ip.c << 8) | (u32)_ip.d);
+}
+
+//----------------------------------------------------------------------------
+// A leading '@' names an abstract socket, which goes away with the last
+// descriptor instead of leaving a file. Returns the address size, 0 if the
+// path doesn't fit.
+//----------------------------------------------------------------------------
+static int setupLocalAddress(sockaddr_un & out_addr, char const * _path)
+{
+    memset(&out_addr, 0, sizeof(out_addr));
+    out_addr.sun_family = AF_UNIX;
+
+    int len = _path ? (int)strlen(_path) : 0;
+    if(len == 0 || len >= (int)sizeof(out_addr.sun_path))
+        return 0;
+
+    memcpy(out_addr.sun_path, _path, len);
+    if(_path[0] == '@')
+    {
+        out_addr.sun_path[0] = '\0';
+    }
+
+    return (int)(offsetof(sockaddr_un, sun_path) + len);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+static NWSocketData * createSocketData(bool _local)
+{
+    NWSocketData * pRet = NEW NWSocketData;
+    pRet->mLocal = _local;
+
+    NWCommManager * commManager = NWCommManager::instance();
+    int backend = commManager ? commManager->getSocketBackend() : NWSOCKET_BACKEND_DEFAULT;
+    if(_local)
+    {
+        backend = NWSOCKET_BACKEND_EPOLL;
+    }
+
+    pRet->mReactor = NWSocketReactor::create(backend, pRet);
+    if(!pRet->mReactor)
+    {
+        DISPOSE(pRet);
+    }
+
+    return pRet;
+}
+
+//----------------------------------------------------------------------------
+// The reactors of a server listen on the same port, the kernel spreads the
+// new connections among them
+//----------------------------------------------------------------------------
+static bool listenOn(NWSocketData * _data, NWIP const & _interface, int _port, bool _reusePort, int & out_port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    _data->mListenFd = fd;
+
+    int reuse = 1;
+    sockaddr_in addr;
+    setupAddress(addr, _interface, _port);
+    socklen_t addrLen = sizeof(addr);
+
+    bool bRet = fd >= 0 &&
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0 &&
+                (!_reusePort || setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == 0) &&
+                bind(fd, (sockaddr *)&addr, sizeof(addr)) == 0 &&
+                listen(fd, NWSocketListenBacklog) == 0 &&
+                getsockname(fd, (sockaddr *)&addr, &addrLen) == 0 &&
+                _data->mReactor->listen(fd);
+
+    if(bRet)
+    {
+        out_port = ntohs(addr.sin_port);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// A stale socket file left by a server that didn't end is replaced
+//----------------------------------------------------------------------------
+static bool listenOnLocal(NWSocketData * _data, char const * _path)
+{
+    sockaddr_un addr;
+    int addrLen = setupLocalAddress(addr, _path);
+    if(addrLen == 0)
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    _data->mListenFd = fd;
+
+    if(fd >= 0 && _path[0] != '@')
+    {
+        unlink(_path);
+        _data->mLocalPath = _path;
+    }
+
+    return fd >= 0 &&
+           bind(fd, (sockaddr *)&addr, addrLen) == 0 &&
+           listen(fd, NWSocketListenBacklog) == 0 &&
+           _data->mReactor->listen(fd);
+}
+
+//----------------------------------------------------------------------------
+// The frame of a local connection doesn't carry the big payloads, it passes
+// their memory. Shared memory is passed as it is, the rest is copied to new
+// shared memory once for all the connections.
+//----------------------------------------------------------------------------
+static bool buildFrame(NWSocketData * _data, NWSocketOutFrame & out_frame, int _msgType, NWIoVec const * _vecs, int _numVecs)
+{
+    if(_data->mLocal)
+    {
+        int size = 0;
+        for(int i=0; i<_numVecs && size >= 0; i++)
+        {
+            size = (_vecs[i].mSize >= 0 && _vecs[i].mSize <= 0x7fffffff - size) ? size + _vecs[i].mSize : -1;
+        }
+
+        if(size >= NWSocketLocalShareMinSize)
+        {
+            MemBufferRef shared = NWSharedMem::alloc(size);
+            if(shared.getSize() == size)
+            {
+                unsigned char * dst = shared.getPtr();
+                for(int i=0; i<_numVecs; i++)
+                {
+                    memcpy(dst, _vecs[i].mPtr, _vecs[i].mSize);
+                    dst += _vecs[i].mSize;
+                }
+
+                return out_frame.buildShared(_msgType, shared);
+            }
+        }
+    }
+
+    return out_frame.build(_msgType, _vecs, _numVecs);
+}
+
+static bool buildFrame(NWSocketData * _data, NWSocketOutFrame & out_frame, int _msgType, MemBufferRef const & _payload)
+{
+    if(_data->mLocal && NWSharedMem::getFd(_payload) >= 0)
+    {
+        return out_frame.buildShared(_msgType, _payload);
+    }
+
+    if(_data->mLocal && _payload.getSize() >= NWSocketLocalShareMinSize)
+    {
+        NWIoVec vec(_payload.getPtr(), _payload.getSize());
+        return buildFrame(_data, out_frame, _msgType, &vec, 1);
+    }
+
+    return out_frame.build(_msgType, _payload);
+}
+
+//----------------------------------------------------------------------------
+// The ids of the clients interleave, see NWServerSocket::init
+//----------------------------------------------------------------------------
+static NWSocketData * findShard(std::vector<NWSocketData *> const & _shards, int _clientId)
+{
+    NWSocketData * pRet = NULL;
+
+    if(_clientId > 0 && !_shards.empty())
+    {
+        pRet = _shards[(_clientId - 1) % (int)_shards.size()];
+    }
+
+    return pRet;
+}
+
+//----------------------------------------------------------------------------
+// Application thread
+//----------------------------------------------------------------------------
+static NWSocketConnection * lockConnection(NWSocketData * _data, int _clientId)
+{
+    NWSocketConnection * pRet = NULL;
+
+    _data->mCritSec->enter();
+    {
+        std::map<int, NWSocketConnection *>::iterator it = _data->mConnections.find(_clientId);
+        if(it != _data->mConnections.end())
+        {
+            pRet = it->second;
+            pRet->mCritSec->enter(); // before leaving, so the reactor can't close it meanwhile
+        }
+    }
+    _data->mCritSec->leave();
+
+    return pRet;
+}
+
+static bool sendToConnection(NWSocketData * _data, int _clientId, NWSocketOutFrame & _frame)
+{
+    bool bRet = false;
+
+    NWSocketConnection * conn = _data ? lockConnection(_data, _clientId) : NULL;
+    if(conn)
+    {
+        bRet = _data->mReactor->send(conn, _frame);
+        conn->mCritSec->leave();
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// The frame is built once, and its payload copied at most once for all the
+// connections that have to queue it
+//----------------------------------------------------------------------------
+static void sendToAll(NWSocketData * _data, NWSocketOutFrame & _frame)
+{
+    NWAutoCritSec autoCS(_data->mCritSec);
+
+    std::map<int, NWSocketConnection *>::iterator it = _data->mConnections.begin();
+    for(; it != _data->mConnections.end(); ++it)
+    {
+        NWAutoCritSec autoConnCS(it->second->mCritSec);
+        _data->mReactor->send(it->second, _frame);
+    }
+}
+
+static bool pingConnection(NWSocketData * _data, int _clientId)
+{
+    bool bRet = false;
+
+    NWSocketConnection * conn = _data ? lockConnection(_data, _clientId) : NULL;
+    if(conn)
+    {
+        bRet = _data->mReactor->ping(conn);
+        conn->mCritSec->leave();
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Microseconds, rounded
+//----------------------------------------------------------------------------
+static int getRttUs(NWSocketEvent const & _event)
+{
+    return (int)((_event.mRttNs + 500) / 1000);
+}
+
+static bool getQueueStats(NWSocketData * _data, int _clientId, NWSendQueueStats & out_stats)
+{
+    bool bRet = false;
+
+    NWSocketConnection * conn = _data ? lockConnection(_data, _clientId) : NULL;
+    if(conn)
+    {
+        out_stats = conn->mSendStats;
+        out_stats.mQueuedMsgs = (int)conn->mSendQueue.size();
+        out_stats.mQueuedBytes = conn->mQueuedBytes;
+        conn->mCritSec->leave();
+
+        bRet = true;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Only the thread the dispatch mode names takes them. out_commNode is the
+// node of the channel mode, NULL in the others.
+//----------------------------------------------------------------------------
+static bool takeEvents(NWSocketData * _data, bool _reactorThread, std::deque<NWSocketEvent> & out_events, CommNode * & out_commNode)
+{
+    NWAutoCritSec autoCS(_data->mCritSec);
+
+    bool bRet = (_data->mDispatch != NWSOCKET_DISPATCH_APPLICATION) == _reactorThread && !_data->mEvents.empty();
+    if(bRet)
+    {
+        out_events.swap(_data->mEvents);
+        out_commNode = (_data->mDispatch == NWSOCKET_DISPATCH_CHANNEL) ? _data->mDispatchNode : NULL;
+    }
+
+    return bRet;
+}
+
+static bool hasEvents(NWSocketData * _data)
+{
+    NWAutoCritSec autoCS(_data->mCritSec);
+    return _data->mDispatch == NWSOCKET_DISPATCH_APPLICATION && !_data->mEvents.empty();
+}
+
+//----------------------------------------------------------------------------
+// Channel mode, the data msgs keep the receive slabs alive
+//----------------------------------------------------------------------------
+static void sendEventMsg(CommNode * _commNode, NWServerSocket * _server, NWSocketEvent const & _event)
+{
+    switch(_event.mType)
+    {
+        case NWSocketEvent::EVENT_CONNECTED:
+        {
+            MsgNetClientConnected msg;
+            msg.mServer = _server;
+            msg.mClientId = _event.mClientId;
+            _commNode->sendMessage(msg);
+            break;
+        }
+
+        case NWSocketEvent::EVENT_DISCONNECTED:
+        {
+            MsgNetClientDisconnected msg;
+            msg.mServer = _server;
+            msg.mClientId = _event.mClientId;
+            msg.mReason = _event.mReason;
+            _commNode->sendMessage(msg);
+            break;
+        }
+
+        case NWSocketEvent::EVENT_DATA:
+        {
+            MsgNetClientData msg;
+            msg.mServer = _server;
+            msg.mClientId = _event.mClientId;
+            msg.mMsgType = _event.mMsgType;
+            msg.mData = _event.mData;
+            _commNode->sendMessage(msg);
+            break;
+        }
+
+        case NWSocketEvent::EVENT_PING:
+        {
+            MsgNetClientPing msg;
+            msg.mServer = _server;
+            msg.mClientId = _event.mClientId;
+            msg.mUs = getRttUs(_event);
+            _commNode->sendMessage(msg);
+            break;
+        }
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWSocket::NWSocket() : 
+    mInitd(false),
+    mLocal(false),
+    mSocketData(NULL)
+{
+}
+
+/*virtual*/ NWSocket::~NWSocket()
+{
+    ASSERT(!mInitd);
+}
+
+/*virtual*/ bool NWSocket::init()
+{
+    bool bRet = false;
+
+    if(!mInitd)
+    {
+        mListenerList.reserve(8);
+
+        mSocketData = createSocketData(mLocal);
+        if(mSocketData)
+        {
+            mShards.push_back(mSocketData);
+
+            mInitd = true;
+            bRet = true;
+        }
+    }
+    
+    return bRet;
+}
+
+/*virtual*/ void NWSocket::done()
+{
+    if(mInitd)
+    {
+        for(int i=0; i<(int)mShards.size(); i++)
+        {
+            DISPOSE(mShards[i]);
+        }
+        mShards.clear();
+        mSocketData = NULL;
+        mListenerList.clear();
+
+        mLocal = false;
+        mInitd = false;
+    }
+}
+
+//----------------------------------------------------------------------------
+// The peers are asked through a hello: the connections already open say it
+// now, the new ones once they open. A connection compresses once the other
+// side answered.
+//----------------------------------------------------------------------------
+void NWSocket::setCompression(int _minSize)
+{
+    ASSERT(_minSize >= 0);
+
+    for(int i=0; mInitd && i<(int)mShards.size(); i++)
+    {
+        NWSocketData * shard = mShards[i];
+        NWAutoCritSec autoCS(shard->mCritSec);
+
+        shard->mCompressMinSize = _minSize;
+
+        std::map<int, NWSocketConnection *>::iterator it = shard->mConnections.begin();
+        for(; it != shard->mConnections.end(); ++it)
+        {
+            NWAutoCritSec autoConnCS(it->second->mCritSec);
+            it->second->mCompressMinSize = _minSize;
+
+            if(_minSize > 0)
+            {
+                shard->mReactor->sendHello(it->second); // not while connecting, the reactor says it once connected
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Filled by the application, sent as any MemBufferRef payload
+//----------------------------------------------------------------------------
+/*static*/ MemBufferRef NWSocket::allocShared(int _size)
+{
+    MemBufferRef memBuff = NWSharedMem::alloc(_size);
+    if(memBuff.getSize() != _size)
+    {
+        memBuff = MemBufferRef(_size);
+    }
+
+    return memBuff;
+}
+
+//----------------------------------------------------------------------------
+// The connections already open take them as well
+//----------------------------------------------------------------------------
+void NWSocket::setSendQueueLimits(int _lowBytes, int _highBytes, int _policy)
+{
+    ASSERT(_lowBytes >= 0 && _lowBytes <= _highBytes);
+
+    for(int i=0; mInitd && i<(int)mShards.size(); i++)
+    {
+        NWSocketData * shard = mShards[i];
+        NWAutoCritSec autoCS(shard->mCritSec);
+
+        shard->mSendQueueLow = _lowBytes;
+        shard->mSendQueueHigh = _highBytes;
+        shard->mSendQueuePolicy = _policy;
+
+        std::map<int, NWSocketConnection *>::iterator it = shard->mConnections.begin();
+        for(; it != shard->mConnections.end(); ++it)
+        {
+            NWAutoCritSec autoConnCS(it->second->mCritSec);
+            it->second->mSendQueueLow = _lowBytes;
+            it->second->mSendQueueHigh = _highBytes;
+            it->second->mSendQueuePolicy = _policy;
+        }
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ NWServerSocket * NWServerSocket::create()
+{
+    return NEW NWServerSocket();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ void NWServerSocket::destroy(NWServerSocket * _serverSocket)
+{
+    if(_serverSocket)
+    {
+        _serverSocket->done();
+        DISPOSE(_serverSocket);
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWServerSocket::NWServerSocket() : NWSocket(),
+    mListenPort(-1)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ NWServerSocket::~NWServerSocket()
+{
+    done();
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+//----------------------------------------------------------------------------
+// Every reactor thread takes the client ids congruent to its index, the
+// first one binds the port the others share
+//----------------------------------------------------------------------------
+bool NWServerSocket::init(NWIP _interface, int _listenPort)
+{
+    bool bRet = false;
+
+    if(!mInitd && NWSocket::init())
+    {
+        NWCommManager * commManager = NWCommManager::instance();
+        int numReactors = commManager ? commManager->getNumReactors() : 1;
+
+        bRet = listenOn(mSocketData, _interface, _listenPort, numReactors > 1, mListenPort);
+
+        for(int i=1; bRet && i<numReactors; i++)
+        {
+            NWSocketData * shard = createSocketData(false);
+            if(shard)
+            {
+                mShards.push_back(shard);
+                bRet = listenOn(shard, _interface, mListenPort, true, mListenPort);
+            }
+            else
+            {
+                bRet = false;
+            }
+        }
+
+        if(bRet)
+        {
+            for(int i=0; i<(int)mShards.size(); i++)
+            {
+                mShards[i]->mServer = this;
+                mShards[i]->mNextClientId = i + 1;
+                mShards[i]->mClientIdStep = numReactors;
+            }
+
+            for(int i=0; i<(int)mShards.size(); i++)
+            {
+                NWThread * thread = NWThread::create();
+                thread->start(this, mShards[i]);
+                mReactorThreads.push_back(thread);
+            }
+        }
+        else
+        {
+            LOG("Can't listen on %s:%d: %s", _interface.getAsStr().c_str(), _listenPort, strerror(errno));
+            mListenPort = -1;
+            NWSocket::done();
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// AF_UNIX does not spread the connections of a shared path as SO_REUSEPORT
+// does, so a local server has a single reactor
+//----------------------------------------------------------------------------
+bool NWServerSocket::init(char const * _localPath)
+{
+    bool bRet = false;
+
+    if(!mInitd)
+    {
+        mLocal = true;
+
+        if(NWSocket::init())
+        {
+            bRet = listenOnLocal(mSocketData, _localPath);
+            if(bRet)
+            {
+                mSocketData->mServer = this;
+
+                NWThread * thread = NWThread::create();
+                thread->start(this, mSocketData);
+                mReactorThreads.push_back(thread);
+            }
+            else
+            {
+                LOG("Can't listen on %s: %s", _localPath ? _localPath : "", strerror(errno));
+                NWSocket::done();
+            }
+        }
+
+        mLocal = bRet; // a later init(NWIP...) is TCP again
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::done()
+{
+    if(mInitd)
+    {
+        for(int i=0; i<(int)mReactorThreads.size(); i++)
+        {
+            mReactorThreads[i]->requestEnd();
+        }
+        for(int i=0; i<(int)mReactorThreads.size(); i++)
+        {
+            mReactorThreads[i]->waitForEnd();
+            NWThread::destroy(mReactorThreads[i]);
+        }
+        mReactorThreads.clear();
+
+        mListenPort = -1;
+        NWSocket::done();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::release()
+{
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWServerSocket::getPort()
+{
+    return mListenPort;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWServerSocket::getNumClients()
+{
+    int iRet = 0;
+
+    for(int i=0; mInitd && i<(int)mShards.size(); i++)
+    {
+        NWAutoCritSec autoCS(mShards[i]->mCritSec);
+        iRet += (int)mShards[i]->mConnections.size();
+    }
+
+    return iRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWServerSocket::getNumReactors()
+{
+    return (int)mShards.size();
+}
+
+//----------------------------------------------------------------------------
+// The events already queued go to the new mode. The listeners of the reactor
+// mode can be called at once from several reactor threads.
+//----------------------------------------------------------------------------
+void NWServerSocket::setDispatchMode(int _dispatch, CommNode * _commNode/*=NULL*/)
+{
+    ASSERT(_dispatch != NWSOCKET_DISPATCH_CHANNEL || _commNode);
+
+    for(int i=0; mInitd && i<(int)mShards.size(); i++)
+    {
+        NWSocketData * shard = mShards[i];
+        {
+            NWAutoCritSec autoCS(shard->mCritSec);
+            shard->mDispatch = _dispatch;
+            shard->mDispatchNode = _commNode;
+        }
+
+        if(_dispatch != NWSOCKET_DISPATCH_APPLICATION)
+        {
+            shard->mReactor->wakeUp(); // for the events already queued
+        }
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWServerSocket::send(int _clientId, int _msgType, unsigned char const * _buffPtr, int _size)
+{
+    NWIoVec vec(_buffPtr, _size);
+    return send(_clientId, _msgType, &vec, 1);
+}
+
+bool NWServerSocket::send(int _clientId, int _msgType, NWIoVec const * _vecs, int _numVecs)
+{
+    bool bRet = false;
+
+    NWSocketOutFrame frame;
+    if(mInitd && buildFrame(mSocketData, frame, _msgType, _vecs, _numVecs))
+    {
+        bRet = sendToConnection(findShard(mShards, _clientId), _clientId, frame);
+    }
+
+    return bRet;
+}
+
+bool NWServerSocket::send(int _clientId, int _msgType, MemBufferRef const & _payload)
+{
+    bool bRet = false;
+
+    NWSocketOutFrame frame;
+    if(mInitd && buildFrame(mSocketData, frame, _msgType, _payload))
+    {
+        bRet = sendToConnection(findShard(mShards, _clientId), _clientId, frame);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::send(int _msgType, unsigned char const * _buffPtr, int _size)
+{
+    NWIoVec vec(_buffPtr, _size);
+    send(_msgType, &vec, 1);
+}
+
+void NWServerSocket::send(int _msgType, NWIoVec const * _vecs, int _numVecs)
+{
+    NWSocketOutFrame frame;
+    if(mInitd && buildFrame(mSocketData, frame, _msgType, _vecs, _numVecs))
+    {
+        for(int i=0; i<(int)mShards.size(); i++)
+        {
+            sendToAll(mShards[i], frame);
+        }
+    }
+}
+
+void NWServerSocket::send(int _msgType, MemBufferRef const & _payload)
+{
+    NWSocketOutFrame frame;
+    if(mInitd && buildFrame(mSocketData, frame, _msgType, _payload))
+    {
+        for(int i=0; i<(int)mShards.size(); i++)
+        {
+            sendToAll(mShards[i], frame);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// onClientDisconnected comes later, from dispatchMessages
+//----------------------------------------------------------------------------
+void NWServerSocket::disconnect(int _clientId)
+{
+    NWSocketData * shard = mInitd ? findShard(mShards, _clientId) : NULL;
+    if(shard)
+    {
+        shard->mReactor->requestClose(_clientId);
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWServerSocket::ping(int _clientId)
+{
+    return mInitd && pingConnection(findShard(mShards, _clientId), _clientId);
+}
+
+//----------------------------------------------------------------------------
+// Every ping is stamped when it is sent, not when the loop starts
+//----------------------------------------------------------------------------
+void NWServerSocket::ping()
+{
+    for(int i=0; mInitd && i<(int)mShards.size(); i++)
+    {
+        NWSocketData * shard = mShards[i];
+        NWAutoCritSec autoCS(shard->mCritSec);
+
+        std::map<int, NWSocketConnection *>::iterator it = shard->mConnections.begin();
+        for(; it != shard->mConnections.end(); ++it)
+        {
+            NWAutoCritSec autoConnCS(it->second->mCritSec);
+            shard->mReactor->ping(it->second);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWServerSocket::getSendQueueStats(int _clientId, NWSendQueueStats & out_stats)
+{
+    return mInitd && getQueueStats(findShard(mShards, _clientId), _clientId, out_stats);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::addListener(IServerSocketListener * _listener)
+{
+    removeListener(_listener);
+
+    sListener listener;
+    listener.mListener = _listener;
+    mListenerList.push_back(listener);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::removeListener(IServerSocketListener * _listener)
+{
+    int num = (int)mListenerList.size();
+    for(int i=0; i<num; i++)
+    {
+        if(mListenerList[i].mListener == _listener)
+        {
+            mListenerList.erase(mListenerList.begin() + i);
+            break;
+        }
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ bool NWServerSocket::messageAvailable()
+{
+    bool bRet = false;
+
+    for(int i=0; mInitd && !bRet && i<(int)mShards.size(); i++)
+    {
+        bRet = hasEvents(mShards[i]);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ void NWServerSocket::dispatchMessages()
+{
+    for(int i=0; mInitd && i<(int)mShards.size(); i++)
+    {
+        dispatchEvents(mShards[i], false);
+    }
+}
+
+//----------------------------------------------------------------------------
+// A client refused by onAccept is never reported to the listeners
+//----------------------------------------------------------------------------
+void NWServerSocket::dispatchEvents(NWSocketData * _shard, bool _reactorThread)
+{
+    std::deque<NWSocketEvent> & events = _shard->mDispatchEvents;
+    CommNode * commNode = NULL;
+
+    if(!takeEvents(_shard, _reactorThread, events, commNode))
+        return;
+
+    std::set<int> & refused = _shard->mRefusedClients;
+
+    int num = (int)events.size();
+    for(int j=0; j<num; j++)
+    {
+        NWSocketEvent & event = events[j];
+
+        if(commNode)
+        {
+            sendEventMsg(commNode, this, event);
+            continue;
+        }
+
+        switch(event.mType)
+        {
+            case NWSocketEvent::EVENT_CONNECTED:
+            {
+                bool bAccepted = true;
+                for(int i=0; bAccepted && i<(int)mListenerList.size(); i++)
+                {
+                    bAccepted = ((IServerSocketListener *)mListenerList[i].mListener)->onAccept(this);
+                }
+
+                if(bAccepted)
+                {
+                    for(int i=0; i<(int)mListenerList.size(); i++)
+                    {
+                        ((IServerSocketListener *)mListenerList[i].mListener)->onClientConnected(event.mClientId);
+                    }
+                }
+                else
+                {
+                    refused.insert(event.mClientId);
+                    _shard->mReactor->requestClose(event.mClientId);
+                }
+                break;
+            }
+
+            case NWSocketEvent::EVENT_DISCONNECTED:
+            {
+                if(refused.erase(event.mClientId) == 0)
+                {
+                    for(int i=0; i<(int)mListenerList.size(); i++)
+                    {
+                        ((IServerSocketListener *)mListenerList[i].mListener)->onClientDisconnected(event.mClientId, event.mReason);
+                    }
+                }
+                break;
+            }
+
+            case NWSocketEvent::EVENT_DATA:
+            {
+                if(refused.find(event.mClientId) == refused.end())
+                {
+                    for(int i=0; i<(int)mListenerList.size(); i++)
+                    {
+                        ((IServerSocketListener *)mListenerList[i].mListener)->onClientData(event.mClientId, event.mMsgType, &event.mData);
+                    }
+                }
+                break;
+            }
+
+            case NWSocketEvent::EVENT_PING:
+            {
+                if(refused.find(event.mClientId) == refused.end())
+                {
+                    for(int i=0; i<(int)mListenerList.size(); i++)
+                    {
+                        ((IServerSocketListener *)mListenerList[i].mListener)->onPing(event.mClientId, getRttUs(event));
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    events.clear(); // the data slabs go back to the pool
+}
+
+//****************************************************************************
+// NWThreadFn
+//****************************************************************************
+//----------------------------------------------------------------------------
+// One thread for each reactor, the parameter is its NWSocketData
+//----------------------------------------------------------------------------
+/*virtual*/ unsigned int NWServerSocket::threadMain(ThreadParams const * _threadParams)
+{
+    NWSocketData * shard = (NWSocketData *)_threadParams->mUserParams;
+    return shard->mReactor->run(_threadParams);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::onData(MemBufferRef * /*_memBuff*/)
+{
+}
+
+
+//****************************************************************************
+// Client Socket
+//****************************************************************************
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ NWClientSocket * NWClientSocket::create()
+{
+    return NEW NWClientSocket();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ void NWClientSocket::destroy(NWClientSocket * _socket)
+{
+    ASSERT(_socket);
+    
+    _socket->done();
+    DISPOSE(_socket);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWClientSocket::NWClientSocket() : NWSocket(),
+    mThread(NULL)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ NWClientSocket::~NWClientSocket()
+{
+    done();
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+// The only connection of the client is the id 0
+//----------------------------------------------------------------------------
+bool NWClientSocket::init(NWIP _serverIp, int _serverPort)
+{
+    bool bRet = false;
+
+    if(!mInitd && NWSocket::init())
+    {
+        sockaddr_in addr;
+        setupAddress(addr, _serverIp, _serverPort);
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(fd >= 0)
+        {
+            int noDelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+            bRet = mSocketData->mReactor->connect(fd, (sockaddr const *)&addr, sizeof(addr)); // takes the fd
+        }
+
+        if(bRet)
+        {
+            mThread = NWThread::create();
+            mThread->start(this);
+        }
+        else
+        {
+            LOG("Can't connect to %s:%d: %s", _serverIp.getAsStr().c_str(), _serverPort, strerror(errno));
+            NWSocket::done();
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWClientSocket::init(char const * _localPath)
+{
+    bool bRet = false;
+
+    sockaddr_un addr;
+    int addrLen = setupLocalAddress(addr, _localPath);
+
+    if(!mInitd && addrLen > 0)
+    {
+        mLocal = true;
+
+        if(NWSocket::init())
+        {
+            int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if(fd >= 0)
+            {
+                bRet = mSocketData->mReactor->connect(fd, (sockaddr const *)&addr, addrLen); // takes the fd
+            }
+
+            if(bRet)
+            {
+                mThread = NWThread::create();
+                mThread->start(this);
+            }
+            else
+            {
+                LOG("Can't connect to %s: %s", _localPath, strerror(errno));
+                NWSocket::done();
+            }
+        }
+
+        mLocal = bRet;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// The fd is closed with the socket, even if it fails
+//----------------------------------------------------------------------------
+bool NWClientSocket::init(int _connectedFd)
+{
+    bool bRet = false;
+
+    if(!mInitd && _connectedFd >= 0)
+    {
+        mLocal = true;
+
+        int flags = fcntl(_connectedFd, F_GETFL);
+        if(flags >= 0 && fcntl(_connectedFd, F_SETFL, flags | O_NONBLOCK) == 0 &&
+           fcntl(_connectedFd, F_SETFD, FD_CLOEXEC) == 0 && NWSocket::init())
+        {
+            bRet = mSocketData->mReactor->connect(_connectedFd, NULL, 0); // takes the fd
+            if(bRet)
+            {
+                mThread = NWThread::create();
+                mThread->start(this);
+            }
+            else
+            {
+                NWSocket::done();
+            }
+        }
+        else
+        {
+            close(_connectedFd);
+        }
+
+        mLocal = bRet;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWClientSocket::done()
+{
+    if(mInitd)
+    {
+        mThread->requestEnd();
+        mThread->waitForEnd();
+        NWThread::destroy(mThread);
+
+        NWSocket::done();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWClientSocket::release()
+{
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWClientSocket::isConnected()
+{
+    bool bRet = false;
+
+    if(mInitd)
+    {
+        NWAutoCritSec autoCS(mSocketData->mCritSec);
+        bRet = mSocketData->mConnected;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWClientSocket::send(int _msgType, unsigned char const * _buffPtr, int _size)
+{
+    NWIoVec vec(_buffPtr, _size);
+    return send(_msgType, &vec, 1);
+}
+
+bool NWClientSocket::send(int _msgType, NWIoVec const * _vecs, int _numVecs)
+{
+    bool bRet = false;
+
+    NWSocketOutFrame frame;
+    if(mInitd && buildFrame(mSocketData, frame, _msgType, _vecs, _numVecs))
+    {
+        bRet = sendToConnection(mSocketData, 0, frame);
+    }
+
+    return bRet;
+}
+
+bool NWClientSocket::send(int _msgType, MemBufferRef const & _payload)
+{
+    bool bRet = false;
+
+    NWSocketOutFrame frame;
+    if(mInitd && buildFrame(mSocketData, frame, _msgType, _payload))
+    {
+        bRet = sendToConnection(mSocketData, 0, frame);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// onDisconnected comes later, from dispatchMessages
+//----------------------------------------------------------------------------
+void NWClientSocket::disconnect()
+{
+    if(mInitd)
+    {
+        mSocketData->mReactor->requestClose(0);
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWClientSocket::ping()
+{
+    return mInitd && pingConnection(mSocketData, 0);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWClientSocket::getSendQueueStats(NWSendQueueStats & out_stats)
+{
+    return mInitd && getQueueStats(mSocketData, 0, out_stats);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWClientSocket::addListener(IClientSocketListener * _listener)
+{
+    removeListener(_listener);
+
+    sListener listener;
+    listener.mListener = _listener;
+    mListenerList.push_back(listener);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWClientSocket::removeListener(IClientSocketListener * _listener)
+{
+    int num = (int)mListenerList.size();
+    for(int i=0; i<num; i++)
+    {
+        if(mListenerList[i].mListener == _listener)
+        {
+            mListenerList.erase(mListenerList.begin() + i);
+            break;
+        }
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ unsigned int NWClientSocket::threadMain(ThreadParams const * _threadParams)
+{
+    return mSocketData->mReactor->run(_threadParams);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ bool NWClientSocket::messageAvailable()
+{
+    return mInitd && hasEvents(mSocketData);
+}
+
+/*virtual*/ void NWClientSocket::dispatchMessages()
+{
+    if(!mInitd)
+        return;
+
+    std::deque<NWSocketEvent> events;
+    CommNode * commNode = NULL;
+    takeEvents(mSocketData, false, events, commNode);
+
+    while(!events.empty())
+    {
+        NWSocketEvent & event = events.front();
+
+        for(int i=0; i<(int)mListenerList.size(); i++)
+        {
+            IClientSocketListener * listener = (IClientSocketListener *)mListenerList[i].mListener;
+
+            switch(event.mType)
+            {
+                case NWSocketEvent::EVENT_CONNECTED:    listener->onConnected(); break;
+                case NWSocketEvent::EVENT_DISCONNECTED: listener->onDisconnected(event.mReason); break;
+                case NWSocketEvent::EVENT_DATA:         listener->onData(event.mMsgType, &event.mData); break;
+                case NWSocketEvent::EVENT_PING:         listener->onPing(getRttUs(event)); break;
+            }
+        }
+
+        events.pop_front();
+    }
+}
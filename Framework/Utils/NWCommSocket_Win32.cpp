@@ -43,6 +43,7 @@
 #include "NWCommSocket.h"
 #include "NWEvent.h"
 #include "NWCriticalSection.h"
+#include "MemBufferRef.h"
 
 #include <WinSock.h>
 
@@ -60,6 +61,7 @@ struct NWSocketData
 //----------------------------------------------------------------------------
 NWSocket::NWSocket() : 
     mInitd(false),
+    mLocal(false),
     mSocketData(NULL)
 {
 }
@@ -96,6 +98,28 @@ NWSocket::NWSocket() :
     }
 }
 
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocket::setSendQueueLimits(int _lowBytes, int _highBytes, int _policy)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocket::setCompression(int _minSize)
+{
+}
+
+//----------------------------------------------------------------------------
+// No local sockets, a plain buffer
+//----------------------------------------------------------------------------
+/*static*/ MemBufferRef NWSocket::allocShared(int _size)
+{
+    return MemBufferRef(_size);
+}
+
 //****************************************************************************
 //
 //****************************************************************************
@@ -150,8 +174,9 @@ bool NWServerSocket::init(NWIP _interface, int _listenPort)
 
     if(!mInitd)
     {
-        mListenerThread = NWThread::create();
-        mListenerThread->start(this);
+        NWThread * thread = NWThread::create();
+        thread->start(this);
+        mReactorThreads.push_back(thread);
 
         mInitd = true;
         bRet = true;
@@ -160,6 +185,14 @@ bool NWServerSocket::init(NWIP _interface, int _listenPort)
     return bRet;
 }
 
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWServerSocket::init(char const * _localPath)
+{
+    return false;
+}
+
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
@@ -189,14 +222,90 @@ int NWServerSocket::getPort()
     return -1;
 }
 
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWServerSocket::getNumClients()
+{
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWServerSocket::getNumReactors()
+{
+    return 1;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::setDispatchMode(int _dispatch, CommNode * _commNode/*=NULL*/)
+{
+}
+
 //****************************************************************************
 //
 //****************************************************************************
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-void NWServerSocket::send(unsigned char * _buffPtr, int size)
+bool NWServerSocket::send(int _clientId, int _msgType, unsigned char const * _buffPtr, int _size)
+{
+    return false;
+}
+
+bool NWServerSocket::send(int _clientId, int _msgType, NWIoVec const * _vecs, int _numVecs)
+{
+    return false;
+}
+
+bool NWServerSocket::send(int _clientId, int _msgType, MemBufferRef const & _payload)
+{
+    return false;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::send(int _msgType, unsigned char const * _buffPtr, int _size)
+{
+}
+
+void NWServerSocket::send(int _msgType, NWIoVec const * _vecs, int _numVecs)
+{
+}
+
+void NWServerSocket::send(int _msgType, MemBufferRef const & _payload)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::disconnect(int _clientId)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWServerSocket::ping(int _clientId)
 {
+    return false;
+}
+
+void NWServerSocket::ping()
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWServerSocket::getSendQueueStats(int _clientId, NWSendQueueStats & out_stats)
+{
+    return false;
 }
 
 //****************************************************************************
@@ -234,6 +343,13 @@ void NWServerSocket::removeListener(IServerSocketListener * _listener)
 {
 }
 
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWServerSocket::dispatchEvents(NWSocketData * _shard, bool _reactorThread)
+{
+}
+
 //****************************************************************************
 // NWThreadFn
 //****************************************************************************
@@ -297,7 +413,8 @@ void NWServerSocket::onData(MemBufferRef * _memBuff)
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-NWClientSocket::NWClientSocket() : NWSocket()
+NWClientSocket::NWClientSocket() : NWSocket(),
+    mThread(NULL)
 {
 }
 
@@ -319,6 +436,16 @@ bool NWClientSocket::init(NWIP _serverIp, int _serverPort)
     return false;
 }
 
+bool NWClientSocket::init(char const * _localPath)
+{
+    return false;
+}
+
+bool NWClientSocket::init(int _connectedFd)
+{
+    return false;
+}
+
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
@@ -333,6 +460,75 @@ void NWClientSocket::release()
 {
 }
 
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWClientSocket::isConnected()
+{
+    return false;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWClientSocket::send(int _msgType, unsigned char const * _buffPtr, int _size)
+{
+    return false;
+}
+
+bool NWClientSocket::send(int _msgType, NWIoVec const * _vecs, int _numVecs)
+{
+    return false;
+}
+
+bool NWClientSocket::send(int _msgType, MemBufferRef const & _payload)
+{
+    return false;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWClientSocket::disconnect()
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWClientSocket::ping()
+{
+    return false;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWClientSocket::getSendQueueStats(NWSendQueueStats & out_stats)
+{
+    return false;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWClientSocket::addListener(IClientSocketListener * _listener)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWClientSocket::removeListener(IClientSocketListener * _listener)
+{
+}
+
 //****************************************************************************
 //
 //****************************************************************************
@@ -0,0 +1,112 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWCriticalSection.h"
+
+#include <pthread.h>
+
+typedef pthread_mutex_t NWCriticalSectionHandle;
+
+class NWCriticalSectionPosix : public NWCriticalSection
+{
+public:
+    NWCriticalSectionPosix();
+    virtual ~NWCriticalSectionPosix();
+
+    virtual void enter();
+    virtual void leave();
+
+private:
+    NWCriticalSectionHandle mHandle;
+};
+
+//****************************************************************************
+//
+//****************************************************************************
+/*static*/ NWCriticalSection * NWCriticalSection::create()
+{
+    return NEW NWCriticalSectionPosix();
+}
+
+/*static*/ void NWCriticalSection::destroy(NWCriticalSection* & _cs)
+{
+    DISPOSE(_cs);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Recursive, as the Win32 critical sections
+//----------------------------------------------------------------------------
+NWCriticalSectionPosix::NWCriticalSectionPosix()
+{
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mHandle, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWCriticalSectionPosix::~NWCriticalSectionPosix()
+{
+    pthread_mutex_destroy(&mHandle);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWCriticalSectionPosix::enter()
+{
+    pthread_mutex_lock(&mHandle);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWCriticalSectionPosix::leave()
+{
+    pthread_mutex_unlock(&mHandle);
+}
@@ -0,0 +1,167 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWEvent_Posix.h"
+#include "NWTime.h"
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+
+//****************************************************************************
+// Instanciation
+//****************************************************************************
+/*static*/ NWEvent * NWEvent::create(bool _manualReset/*=false*/, bool _initialState/*=false*/, const char * _name/*=0*/)
+{
+    return NEW NWEventPosix(_manualReset, _initialState, _name);
+}
+
+/*static*/ void NWEvent::destroy(NWEvent* & _cs)
+{
+    DISPOSE(_cs);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+NWEventPosix::NWEventPosix(bool _manualReset/*=false*/, bool _initialState/*=false*/, const char * _name/*=0*/) :
+    mFd(-1),
+    mManualReset(_manualReset)
+{
+    if(_name)
+        mEventName = _name;
+
+    mFd = eventfd(_initialState ? 1 : 0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ASSERT(mFd >= 0);
+}
+
+NWEventPosix::~NWEventPosix()
+{
+    if(mFd >= 0)
+    {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+void NWEventPosix::signal()
+{
+    eventfd_write(mFd, 1);
+}
+
+void NWEventPosix::reset()
+{
+    eventfd_t value = 0;
+    eventfd_read(mFd, &value); // EAGAIN if it wasn't signaled
+}
+
+//----------------------------------------------------------------------------
+// Reading the counter resets it, the signal goes to a single waiter
+//----------------------------------------------------------------------------
+bool NWEventPosix::consumeSignal()
+{
+    bool bRet = true;
+
+    if(!mManualReset)
+    {
+        eventfd_t value = 0;
+        bRet = eventfd_read(mFd, &value) == 0;
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+bool NWEventPosix::isSignaled()
+{
+    return waitForSignal(0); // as in Win32, it resets an auto reset event
+}
+
+bool NWEventPosix::waitForSignal(unsigned int _msTimeout/*=NWE_INFINITE*/)
+{
+    bool bRet = false;
+
+    u64 startMs = NWTime::getTimeMs();
+    bool bLoop = true;
+
+    while(bLoop)
+    {
+        int waitMs = -1;
+        if(_msTimeout != NWE_INFINITE)
+        {
+            u64 elapsedMs = NWTime::getTimeMs() - startMs;
+            waitMs = (elapsedMs < _msTimeout) ? (int)(_msTimeout - elapsedMs) : 0;
+        }
+
+        pollfd pollFd;
+        pollFd.fd = mFd;
+        pollFd.events = POLLIN;
+        pollFd.revents = 0;
+
+        int result = poll(&pollFd, 1, waitMs);
+        if(result > 0)
+        {
+            bRet = consumeSignal();
+            bLoop = !bRet;
+        }
+        else if(result == 0 || errno != EINTR)
+        {
+            bLoop = false;
+        }
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+const char * NWEventPosix::getName()
+{
+    return mEventName.c_str();
+}
@@ -0,0 +1,88 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_EVENT_POSIX_H_
+#define _INCREW_EVENT_POSIX_H_
+
+#include "NWEvent.h"
+
+#include <string>
+
+//****************************************************************************
+// Linux event on an eventfd : readable while signaled, so it can be waited
+// together with other events (NWMultipleEvents) or sockets (epoll). The
+// name is kept but the event isn't shared with other processes.
+//****************************************************************************
+class NWEventPosix : public NWEvent
+{
+public:
+    NWEventPosix(bool _manualReset=false, bool _initialState=false, const char * name=0);
+    virtual ~NWEventPosix();
+
+    virtual void signal();
+    virtual void reset();
+
+    virtual bool isSignaled();
+
+    virtual bool waitForSignal(unsigned int _msTimeout=NWE_INFINITE);
+
+    virtual const char * getName();
+
+    inline int getFd() const;
+    inline bool isManualReset() const;
+    bool consumeSignal(); // once readable, false if another waiter took the signal of an auto reset event
+
+private:
+    std::string mEventName;
+    int mFd;
+    bool mManualReset;
+};
+
+inline int NWEventPosix::getFd() const
+{
+    return mFd;
+}
+
+inline bool NWEventPosix::isManualReset() const
+{
+    return mManualReset;
+}
+
+#endif // _INCREW_EVENT_POSIX_H_
@@ -60,6 +60,9 @@
 //****************************************************************************
 NWEventW32::NWEventW32(bool _manualReset/*=false*/, bool _initialState/*=false*/, const char * _name/*=0*/)
 {
+    if(_name)
+        mEventName = _name; // named events are shared between processes
+
     mEventHandle = CreateEvent(NULL, _manualReset, _initialState, _name);
 }
 
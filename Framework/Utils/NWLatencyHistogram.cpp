@@ -0,0 +1,135 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWLatencyHistogram.h"
+
+#include <string.h>
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWLatencyHistogram::NWLatencyHistogram()
+{
+    reset();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWLatencyHistogram::add(u32 _us)
+{
+    mBuckets[getBucket(_us)]++;
+    mCount++;
+
+    if(_us > mMax)
+    {
+        mMax = _us;
+    }
+}
+
+void NWLatencyHistogram::reset()
+{
+    memset(mBuckets, 0, sizeof(mBuckets));
+    mCount = 0;
+    mMax = 0;
+}
+
+//----------------------------------------------------------------------------
+// The value of the sample ranked _percent, rounded up
+//----------------------------------------------------------------------------
+u32 NWLatencyHistogram::getPercentile(float _percent) const
+{
+    if(mCount == 0)
+        return 0;
+
+    u32 rank = (u32)(mCount * _percent / 100.0f + 0.999f);
+    if(rank < 1)
+        rank = 1;
+    if(rank > mCount)
+        rank = mCount;
+
+    u32 count = 0;
+    for(int i=0; i<NUM_BUCKETS; i++)
+    {
+        count += mBuckets[i];
+        if(count >= rank)
+        {
+            u32 top = getBucketTop(i);
+            return (top < mMax) ? top : mMax;
+        }
+    }
+
+    return mMax;
+}
+
+//----------------------------------------------------------------------------
+// Above the linear buckets, the highest bit picks the power of two and the
+// SUB_BITS below it the bucket inside it
+//----------------------------------------------------------------------------
+/*static*/ int NWLatencyHistogram::getBucket(u32 _us)
+{
+    if(_us < LINEAR_BUCKETS)
+        return (int)_us;
+
+    int highBit = 0;
+    for(u32 value = _us; value > 1; value >>= 1)
+    {
+        highBit++;
+    }
+
+    int shift = highBit - SUB_BITS;
+    return LINEAR_BUCKETS + (shift - 1) * SUB_BUCKETS + (int)((_us >> shift) - SUB_BUCKETS);
+}
+
+/*static*/ u32 NWLatencyHistogram::getBucketTop(int _bucket)
+{
+    if(_bucket < LINEAR_BUCKETS)
+        return (u32)_bucket;
+
+    int shift = (_bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 1;
+    u32 sub = (u32)((_bucket - LINEAR_BUCKETS) % SUB_BUCKETS) + SUB_BUCKETS;
+
+    return (u32)((((u64)sub + 1) << shift) - 1);
+}
@@ -0,0 +1,89 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_LATENCY_HISTOGRAM_H_
+#define _INCREW_LATENCY_HISTOGRAM_H_
+
+#include "NWTypes.h"
+
+//****************************************************************************
+// Distribution of latencies in microseconds. The buckets are exact below
+// 32us, then 16 per power of two, so a percentile is off by 6% at most.
+//****************************************************************************
+class NWLatencyHistogram
+{
+public:
+    NWLatencyHistogram();
+
+    void add(u32 _us);
+    void reset();
+
+    u32 getPercentile(float _percent) const;   // the top of the bucket it falls in, 0 if it is empty
+    inline u32 getMax() const;
+    inline u32 getCount() const;
+
+private:
+    enum eBucketDefs
+    {
+        SUB_BITS = 4,
+        SUB_BUCKETS = 1 << SUB_BITS,
+        LINEAR_BUCKETS = 2 * SUB_BUCKETS,                       // exact values
+        NUM_BUCKETS = LINEAR_BUCKETS + (31 - SUB_BITS) * SUB_BUCKETS
+    };
+
+    u32 mBuckets[NUM_BUCKETS];
+    u32 mCount;
+    u32 mMax;
+
+    static int getBucket(u32 _us);
+    static u32 getBucketTop(int _bucket);
+};
+
+inline u32 NWLatencyHistogram::getMax() const
+{
+    return mMax;
+}
+
+inline u32 NWLatencyHistogram::getCount() const
+{
+    return mCount;
+}
+
+#endif // _INCREW_LATENCY_HISTOGRAM_H_
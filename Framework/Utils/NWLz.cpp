@@ -0,0 +1,286 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWLz.h"
+
+#include <memory.h>
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+static inline u32 read32(unsigned char const * _ptr)
+{
+    u32 value;
+    memcpy(&value, _ptr, sizeof(value));
+    return value;
+}
+
+static inline u32 hash32(u32 _value)
+{
+    return (_value * 2654435761U) >> (32 - NWLzHashLog);
+}
+
+//----------------------------------------------------------------------------
+// The 4 bits of the token, then bytes of 255 while it goes on
+//----------------------------------------------------------------------------
+static inline unsigned char * writeLength(unsigned char * out_dst, int _length)
+{
+    for(_length -= 15; _length >= 255; _length -= 255)
+    {
+        *out_dst++ = 255;
+    }
+    *out_dst++ = (unsigned char)_length;
+
+    return out_dst;
+}
+
+//----------------------------------------------------------------------------
+// Returns false if it goes past the end or gets bigger than _max
+//----------------------------------------------------------------------------
+static inline bool readLength(unsigned char const * & io_src, unsigned char const * _srcEnd, int _max, int & io_length)
+{
+    unsigned char byte = 255;
+    while(byte == 255)
+    {
+        if(io_src >= _srcEnd)
+            return false;
+
+        byte = *io_src++;
+        io_length += byte;
+
+        if(io_length > _max)
+            return false;
+    }
+
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// The sequence bytes are checked against _dstEnd before writing them
+//----------------------------------------------------------------------------
+static unsigned char * writeSequence(unsigned char * out_dst, unsigned char * _dstEnd, unsigned char const * _literals, int _numLiterals, int _offset, int _matchLength)
+{
+    int size = 1 + _numLiterals + (_numLiterals >= 15 ? (_numLiterals - 15) / 255 + 1 : 0);
+    if(_offset > 0)
+    {
+        size += 2 + (_matchLength - NWLzMinMatch >= 15 ? (_matchLength - NWLzMinMatch - 15) / 255 + 1 : 0);
+    }
+
+    if(size > _dstEnd - out_dst)
+        return NULL;
+
+    unsigned char * token = out_dst++;
+    *token = (unsigned char)((_numLiterals >= 15 ? 15 : _numLiterals) << 4);
+    if(_numLiterals >= 15)
+    {
+        out_dst = writeLength(out_dst, _numLiterals);
+    }
+
+    memcpy(out_dst, _literals, _numLiterals);
+    out_dst += _numLiterals;
+
+    if(_offset > 0)
+    {
+        *out_dst++ = (unsigned char)_offset;
+        *out_dst++ = (unsigned char)(_offset >> 8);
+
+        int length = _matchLength - NWLzMinMatch;
+        *token |= (unsigned char)(length >= 15 ? 15 : length);
+        if(length >= 15)
+        {
+            out_dst = writeLength(out_dst, length);
+        }
+    }
+
+    return out_dst;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Incompressible data grows a bit
+//----------------------------------------------------------------------------
+int NWLz::getMaxCompressedSize(int _size)
+{
+    return _size + _size / 255 + 16;
+}
+
+//----------------------------------------------------------------------------
+// Greedy matching through a hash table of the last position of every 4
+// bytes. The search skips faster over data that doesn't match.
+//----------------------------------------------------------------------------
+int NWLz::compress(unsigned char const * _src, int _srcSize, unsigned char * out_dst, int _dstCapacity)
+{
+    if(_srcSize < 0)
+        return 0;
+
+    unsigned char * dst = out_dst;
+    unsigned char * dstEnd = out_dst + _dstCapacity;
+
+    unsigned char const * src = _src;
+    unsigned char const * srcEnd = _src + _srcSize;
+    unsigned char const * anchor = _src;       // first literal not written
+
+    if(_srcSize > NWLzMatchLimit)
+    {
+        u32 table[1 << NWLzHashLog];
+        memset(table, 0, sizeof(table));
+
+        unsigned char const * matchStartLimit = srcEnd - NWLzMatchLimit;
+        unsigned char const * matchEndLimit = srcEnd - NWLzLastLiterals;
+        unsigned int misses = 0;
+
+        src++;
+        while(src <= matchStartLimit)
+        {
+            u32 seq = read32(src);
+            u32 h = hash32(seq);
+            unsigned char const * match = _src + table[h];
+            table[h] = (u32)(src - _src);
+
+            if(match < src && src - match <= NWLzMaxOffset && read32(match) == seq)
+            {
+                while(src > anchor && match > _src && src[-1] == match[-1])
+                {
+                    src--;
+                    match--;
+                }
+
+                unsigned char const * end = src + NWLzMinMatch;
+                unsigned char const * ref = match + NWLzMinMatch;
+                while(end < matchEndLimit && *end == *ref)
+                {
+                    end++;
+                    ref++;
+                }
+
+                dst = writeSequence(dst, dstEnd, anchor, (int)(src - anchor), (int)(src - match), (int)(end - src));
+                if(!dst)
+                    return 0;
+
+                if(end - 2 > src)
+                {
+                    table[hash32(read32(end - 2))] = (u32)(end - 2 - _src);
+                }
+
+                src = anchor = end;
+                misses = 0;
+            }
+            else
+            {
+                src += 1 + (misses++ >> 6);
+            }
+        }
+    }
+
+    dst = writeSequence(dst, dstEnd, anchor, (int)(srcEnd - anchor), 0, 0);
+
+    return dst ? (int)(dst - out_dst) : 0;
+}
+
+//----------------------------------------------------------------------------
+// Every length and offset is checked, a malformed block can't write out of
+// out_dst nor read out of _src
+//----------------------------------------------------------------------------
+int NWLz::decompress(unsigned char const * _src, int _srcSize, unsigned char * out_dst, int _dstSize)
+{
+    unsigned char const * src = _src;
+    unsigned char const * srcEnd = _src + _srcSize;
+    unsigned char * dst = out_dst;
+    unsigned char * dstEnd = out_dst + _dstSize;
+
+    while(src < srcEnd)
+    {
+        int token = *src++;
+
+        int numLiterals = token >> 4;
+        if(numLiterals == 15 && !readLength(src, srcEnd, _dstSize, numLiterals))
+            return -1;
+
+        if(numLiterals > srcEnd - src || numLiterals > dstEnd - dst)
+            return -1;
+
+        memcpy(dst, src, numLiterals);
+        dst += numLiterals;
+        src += numLiterals;
+
+        if(src == srcEnd)
+            break; // the last sequence has no match
+
+        if(srcEnd - src < 2)
+            return -1;
+
+        int offset = src[0] | (src[1] << 8);
+        src += 2;
+
+        if(offset == 0 || offset > dst - out_dst)
+            return -1;
+
+        int length = token & 15;
+        if(length == 15 && !readLength(src, srcEnd, _dstSize, length))
+            return -1;
+
+        length += NWLzMinMatch;
+        if(length > dstEnd - dst)
+            return -1;
+
+        unsigned char const * match = dst - offset;
+        if(offset >= length)
+        {
+            memcpy(dst, match, length);
+            dst += length;
+        }
+        else
+        {
+            for(int i=0; i<length; i++)
+            {
+                *dst++ = *match++; // overlapping, repeats the last offset bytes
+            }
+        }
+    }
+
+    return (int)(dst - out_dst);
+}
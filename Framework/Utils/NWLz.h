@@ -0,0 +1,65 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_LZ_H_
+#define _INCREW_LZ_H_
+
+//****************************************************************************
+// Fast block compression in the LZ4 block format: sequences of a token,
+// literals, a 2 byte offset and a match length. Made for speed, not ratio,
+// a block is compressed or decompressed whole. No state between blocks.
+//****************************************************************************
+enum eNWLzDefs
+{
+    NWLzMinMatch = 4,
+    NWLzHashLog = 12,           // entries of the match table, 16KB of stack
+    NWLzLastLiterals = 5,       // a block ends with literals
+    NWLzMatchLimit = 12,        // no match starts this close to the end
+    NWLzMaxOffset = 65535
+};
+
+namespace NWLz
+{
+    int getMaxCompressedSize(int _size);
+    int compress(unsigned char const * _src, int _srcSize, unsigned char * out_dst, int _dstCapacity); // compressed size, 0 if it doesn't fit in _dstCapacity
+    int decompress(unsigned char const * _src, int _srcSize, unsigned char * out_dst, int _dstSize); // bytes written, -1 if _src is malformed or doesn't fit
+}
+
+#endif // _INCREW_LZ_H_
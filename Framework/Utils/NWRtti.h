@@ -43,6 +43,12 @@
 #ifndef _NW_RTTI_H_
 #define _NW_RTTI_H_
 
+#if defined(_MSC_VER)
+    #include <stddef.h>
+#else
+    #include <stdint.h>
+#endif
+
 typedef intptr_t NWRttiTypeId;
 
 //----------------------------------------------------------------------------
@@ -41,6 +41,8 @@
 #ifndef NW_SLINK_H
 #define NW_SLINK_H
 
+#include "NWAtomic.h"
+
 //****************************************************************************
 //
 //****************************************************************************
@@ -106,6 +108,10 @@ public:
     inline T * getNext();
     inline void setNext(T * _prev);
 
+    // to publish / read the link from other threads
+    inline T * getNextAcquire();
+    inline void setNextRelease(T * _next);
+
 private:
     T * volatile mNext; // volatile pointer to non volatile data
 
@@ -143,6 +149,16 @@ template <class T> inline void SNLink<T>::setNext(T * _next)
     mNext = _next;
 }
 
+template <class T> inline T * SNLink<T>::getNextAcquire()
+{
+    return NWAtomic::loadAcquire(&mNext);
+}
+
+template <class T> inline void SNLink<T>::setNextRelease(T * _next)
+{
+    NWAtomic::storeRelease(&mNext, _next);
+}
+
 //****************************************************************************
 //
 //****************************************************************************
@@ -0,0 +1,172 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWSharedMemory.h"
+
+#include "Log.h"
+
+#include <windows.h>
+#include <string>
+
+typedef HANDLE NWSharedMemoryHandle;
+
+class NWSharedMemoryW32 : public NWSharedMemory
+{
+public:
+    NWSharedMemoryW32();
+    virtual ~NWSharedMemoryW32();
+
+    bool init(const char * _name, u32 _size);
+
+    virtual void * getPtr();
+    virtual u32 getSize();
+    virtual bool isCreator();
+
+    virtual const char * getName();
+
+private:
+    std::string mName;
+    NWSharedMemoryHandle mHandle;
+    void * mPtr;
+    u32 mSize;
+    bool mCreator;
+};
+
+//****************************************************************************
+//
+//****************************************************************************
+/*static*/ NWSharedMemory * NWSharedMemory::create(const char * _name, u32 _size)
+{
+    NWSharedMemoryW32 * sharedMemory = NEW NWSharedMemoryW32();
+
+    if(!sharedMemory->init(_name, _size))
+    {
+        DISPOSE(sharedMemory);
+    }
+
+    return sharedMemory;
+}
+
+/*static*/ void NWSharedMemory::destroy(NWSharedMemory* & _sharedMemory)
+{
+    DISPOSE(_sharedMemory);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWSharedMemoryW32::NWSharedMemoryW32() :
+    mHandle(NULL),
+    mPtr(NULL),
+    mSize(0),
+    mCreator(false)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWSharedMemoryW32::~NWSharedMemoryW32()
+{
+    if(mPtr)
+    {
+        UnmapViewOfFile(mPtr);
+        mPtr = NULL;
+    }
+
+    if(mHandle)
+    {
+        CloseHandle(mHandle);
+        mHandle = NULL;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Backed by the paging file, the pages of a new mapping are zero filled
+//----------------------------------------------------------------------------
+bool NWSharedMemoryW32::init(const char * _name, u32 _size)
+{
+    ASSERT(_name && _size > 0);
+
+    mName = _name;
+    mSize = _size;
+
+    mHandle = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, _size, _name);
+    if(mHandle)
+    {
+        mCreator = GetLastError() != ERROR_ALREADY_EXISTS;
+        mPtr = MapViewOfFile(mHandle, FILE_MAP_ALL_ACCESS, 0, 0, _size);
+    }
+
+    if(mPtr == NULL)
+    {
+        LOG("NWSharedMemory : can't map %s (%u bytes), error %u", _name, _size, (u32)GetLastError());
+    }
+
+    return mPtr != NULL;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+void * NWSharedMemoryW32::getPtr()
+{
+    return mPtr;
+}
+
+u32 NWSharedMemoryW32::getSize()
+{
+    return mSize;
+}
+
+bool NWSharedMemoryW32::isCreator()
+{
+    return mCreator;
+}
+
+const char * NWSharedMemoryW32::getName()
+{
+    return mName.c_str();
+}
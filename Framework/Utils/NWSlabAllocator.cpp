@@ -0,0 +1,541 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWSlabAllocator.h"
+#include "NWAtomic.h"
+#include "NWThread.h"
+
+#include <stdlib.h>
+#include <new>
+
+#if defined(_MSC_VER)
+    #include <malloc.h>
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+#if defined(_MSC_VER)
+    #define NW_THREAD_LOCAL __declspec(thread)
+#else
+    #define NW_THREAD_LOCAL __thread
+#endif
+
+//****************************************************************************
+//
+//****************************************************************************
+struct NWSlabCache;
+
+enum
+{
+    eNumSizeClasses = 20,
+    eSlabHeaderSize = 64 // keeps the blocks 16 bytes aligned
+};
+
+// Every slab is aligned to its size, the header is found by masking a block address
+struct NWSlab
+{
+    NWSlabCache * mOwner;
+    NWSlab * mNext;
+    u32 mSizeClass;
+};
+
+struct NWSlabBlock
+{
+    NWSlabBlock * mNext;
+};
+
+// Blocks freed by this thread that belong to another cache
+struct NWSlabRemoteBatch
+{
+    NWSlabCache * mOwner;
+    NWSlabBlock * mHead;
+    NWSlabBlock * mTail;
+    u32 mCount;
+};
+
+struct NWSlabCache
+{
+    NWSlabBlock * mFreeList[eNumSizeClasses];
+    NWSlabBlock * volatile mRemoteFree[eNumSizeClasses]; // pushed by the other threads, taken all at once by the owner
+    u8 * mBump[eNumSizeClasses];
+    u8 * mBumpEnd[eNumSizeClasses];
+    NWSlabRemoteBatch mBatch[eNumSizeClasses];
+    NWSlab * mSlabs;
+    NWSlabCache * mNextCache;
+    NWSlabCache * mNextOrphan;
+
+    NWSlabCache();
+};
+
+NWSlabCache::NWSlabCache() :
+    mSlabs(NULL),
+    mNextCache(NULL),
+    mNextOrphan(NULL)
+{
+    for(int i = 0; i < eNumSizeClasses; i++)
+    {
+        mFreeList[i] = NULL;
+        mRemoteFree[i] = NULL;
+        mBump[i] = NULL;
+        mBumpEnd[i] = NULL;
+        mBatch[i].mOwner = NULL;
+        mBatch[i].mHead = NULL;
+        mBatch[i].mTail = NULL;
+        mBatch[i].mCount = 0;
+    }
+}
+
+static NW_THREAD_LOCAL NWSlabCache * tCache = NULL;
+
+static long volatile sLock = 0; // guards the caches lists, spin lock so it works before any init
+static NWSlabCache * sCaches = NULL;
+static NWSlabCache * sOrphans = NULL;
+static NWSlabStats * volatile sStatsHead = NULL;
+
+//****************************************************************************
+// Helpers
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+static inline void lockCaches()
+{
+    while(NWAtomic::exchange(&sLock, 1) != 0)
+    {
+        NWThread::yield();
+    }
+}
+
+static inline void unlockCaches()
+{
+    NWAtomic::exchange(&sLock, 0);
+}
+
+//----------------------------------------------------------------------------
+// 16 bytes steps up to 128, then 4 classes per power of two up to 1024
+//----------------------------------------------------------------------------
+static inline u32 getSizeClass(size_t _size)
+{
+    u32 size = (u32)(_size ? _size : 1);
+    u32 sizeClass = 0;
+
+    if(size <= 128)
+        sizeClass = (size - 1) >> 4;
+    else if(size <= 256)
+        sizeClass = 8 + ((size - 129) >> 5);
+    else if(size <= 512)
+        sizeClass = 12 + ((size - 257) >> 6);
+    else
+        sizeClass = 16 + ((size - 513) >> 7);
+
+    return sizeClass;
+}
+
+static inline u32 getClassSize(u32 _sizeClass)
+{
+    u32 size = 0;
+
+    if(_sizeClass < 8)
+        size = (_sizeClass + 1) << 4;
+    else if(_sizeClass < 12)
+        size = 128 + ((_sizeClass - 7) << 5);
+    else if(_sizeClass < 16)
+        size = 256 + ((_sizeClass - 11) << 6);
+    else
+        size = 512 + ((_sizeClass - 15) << 7);
+
+    return size;
+}
+
+static inline NWSlab * getSlab(void * _ptr)
+{
+    return (NWSlab *)((size_t)_ptr & ~((size_t)NWSlabAllocator::eSlabSize - 1));
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+static void * allocSlabMemory()
+{
+    #if defined(_MSC_VER)
+        return _aligned_malloc(NWSlabAllocator::eSlabSize, NWSlabAllocator::eSlabSize);
+    #else
+        void * ptr = NULL;
+        if(posix_memalign(&ptr, NWSlabAllocator::eSlabSize, NWSlabAllocator::eSlabSize) != 0)
+            ptr = NULL;
+        return ptr;
+    #endif
+}
+
+static void freeSlabMemory(void * _ptr)
+{
+    #if defined(_MSC_VER)
+        _aligned_free(_ptr);
+    #else
+        ::free(_ptr);
+    #endif
+}
+
+//----------------------------------------------------------------------------
+// Thread exit hook, the threads that aren't NWThreads hand their cache back
+// too. A TLS callback on Win32, a pthread key destructor otherwise, it only
+// runs for the threads that registered a cache.
+//----------------------------------------------------------------------------
+#if defined(_MSC_VER)
+
+static void NTAPI slabTlsCallback(PVOID, DWORD _reason, PVOID)
+{
+    if(_reason == DLL_THREAD_DETACH)
+    {
+        NWSlabAllocator::threadExit();
+    }
+}
+
+// .CRT$XLB sits between the CRT TLS callbacks markers, the linker keeps it with the /INCLUDE
+#if defined(_WIN64)
+    #pragma comment(linker, "/INCLUDE:_tls_used")
+    #pragma comment(linker, "/INCLUDE:gNWSlabTlsCallback")
+    #pragma const_seg(".CRT$XLB")
+    extern "C" const PIMAGE_TLS_CALLBACK gNWSlabTlsCallback = slabTlsCallback;
+    #pragma const_seg()
+#else
+    #pragma comment(linker, "/INCLUDE:__tls_used")
+    #pragma comment(linker, "/INCLUDE:_gNWSlabTlsCallback")
+    #pragma data_seg(".CRT$XLB")
+    extern "C" PIMAGE_TLS_CALLBACK gNWSlabTlsCallback = slabTlsCallback;
+    #pragma data_seg()
+#endif
+
+static inline void registerThreadExit(NWSlabCache *)
+{
+}
+
+#else
+
+static pthread_key_t sThreadExitKey;
+static pthread_once_t sThreadExitKeyOnce = PTHREAD_ONCE_INIT;
+
+static void threadExitKeyDestructor(void *)
+{
+    NWSlabAllocator::threadExit();
+}
+
+static void createThreadExitKey()
+{
+    pthread_key_create(&sThreadExitKey, threadExitKeyDestructor);
+}
+
+static inline void registerThreadExit(NWSlabCache * _cache)
+{
+    pthread_once(&sThreadExitKeyOnce, createThreadExitKey);
+    pthread_setspecific(sThreadExitKey, _cache); // the destructor isn't called for NULL values
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+// Adopts the cache of an ended thread if there is one
+//----------------------------------------------------------------------------
+static NWSlabCache * getCache()
+{
+    NWSlabCache * cache = tCache;
+
+    if(cache == NULL)
+    {
+        lockCaches();
+
+        if(sOrphans)
+        {
+            cache = sOrphans;
+            sOrphans = cache->mNextOrphan;
+            cache->mNextOrphan = NULL;
+        }
+        else
+        {
+            cache = NEW NWSlabCache();
+            cache->mNextCache = sCaches;
+            sCaches = cache;
+        }
+
+        unlockCaches();
+
+        tCache = cache;
+        registerThreadExit(cache);
+    }
+
+    return cache;
+}
+
+//----------------------------------------------------------------------------
+// Hands the whole batch to the owner with a single push
+//----------------------------------------------------------------------------
+static void flushRemoteBatch(NWSlabRemoteBatch & _batch, u32 _sizeClass)
+{
+    if(_batch.mHead)
+    {
+        NWSlabBlock * volatile * remoteFree = &_batch.mOwner->mRemoteFree[_sizeClass];
+
+        NWSlabBlock * head = NULL;
+        do
+        {
+            head = *remoteFree;
+            _batch.mTail->mNext = head;
+        }
+        while(NWAtomic::compareExchangePtr(remoteFree, _batch.mHead, head) != head);
+
+        _batch.mOwner = NULL;
+        _batch.mHead = NULL;
+        _batch.mTail = NULL;
+        _batch.mCount = 0;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+static void registerStats(NWSlabStats * _stats)
+{
+    if(NWAtomic::exchange(&_stats->mRegistered, 1) == 0)
+    {
+        NWSlabStats * head = NULL;
+        do
+        {
+            head = sStatsHead;
+            _stats->mNext = head;
+        }
+        while(NWAtomic::compareExchangePtr(&sStatsHead, _stats, head) != head);
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Every thread must have ended and every object must have been destroyed
+//----------------------------------------------------------------------------
+/*static*/ void NWSlabAllocator::staticShutdown()
+{
+    lockCaches();
+
+    while(sCaches)
+    {
+        NWSlabCache * cache = sCaches;
+        sCaches = cache->mNextCache;
+
+        while(cache->mSlabs)
+        {
+            NWSlab * slab = cache->mSlabs;
+            cache->mSlabs = slab->mNext;
+            freeSlabMemory(slab);
+        }
+
+        DISPOSE(cache);
+    }
+    sOrphans = NULL;
+
+    unlockCaches();
+
+    tCache = NULL;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ void * NWSlabAllocator::alloc(size_t _size, NWSlabStats * _stats)
+{
+    void * pRet = NULL;
+
+    if(_size > eMaxSlabObjectSize)
+    {
+        pRet = ::operator new(_size);
+    }
+    else
+    {
+        NWSlabCache * cache = getCache();
+        u32 sizeClass = getSizeClass(_size);
+
+        NWSlabBlock * block = cache->mFreeList[sizeClass];
+        if(block == NULL && cache->mRemoteFree[sizeClass])
+        {
+            block = NWAtomic::exchangePtr(&cache->mRemoteFree[sizeClass], (NWSlabBlock *)NULL);
+        }
+
+        if(block)
+        {
+            cache->mFreeList[sizeClass] = block->mNext;
+            pRet = block;
+        }
+        else
+        {
+            u32 classSize = getClassSize(sizeClass);
+
+            if(cache->mBump[sizeClass] + classSize > cache->mBumpEnd[sizeClass])
+            {
+                NWSlab * slab = (NWSlab *)allocSlabMemory();
+                if(slab == NULL)
+                {
+                    throw std::bad_alloc();
+                }
+
+                slab->mOwner = cache;
+                slab->mSizeClass = sizeClass;
+                slab->mNext = cache->mSlabs;
+                cache->mSlabs = slab;
+
+                cache->mBump[sizeClass] = (u8 *)slab + eSlabHeaderSize;
+                cache->mBumpEnd[sizeClass] = (u8 *)slab + eSlabSize;
+            }
+
+            pRet = cache->mBump[sizeClass];
+            cache->mBump[sizeClass] += classSize;
+        }
+    }
+
+    if(_stats)
+    {
+        if(_stats->mRegistered == 0)
+        {
+            registerStats(_stats);
+        }
+
+        NWAtomic::increment(&_stats->mLive);
+        NWAtomic::increment(&_stats->mTotal);
+    }
+
+    return pRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ void NWSlabAllocator::free(void * _ptr, size_t _size, NWSlabStats * _stats)
+{
+    if(_ptr)
+    {
+        if(_stats)
+        {
+            NWAtomic::decrement(&_stats->mLive);
+        }
+
+        if(_size > eMaxSlabObjectSize)
+        {
+            ::operator delete(_ptr);
+        }
+        else
+        {
+            NWSlabCache * cache = getCache();
+            NWSlab * slab = getSlab(_ptr);
+            u32 sizeClass = slab->mSizeClass;
+
+            ASSERT(sizeClass == getSizeClass(_size));
+
+            NWSlabBlock * block = (NWSlabBlock *)_ptr;
+
+            if(slab->mOwner == cache)
+            {
+                block->mNext = cache->mFreeList[sizeClass];
+                cache->mFreeList[sizeClass] = block;
+            }
+            else
+            {
+                NWSlabRemoteBatch & batch = cache->mBatch[sizeClass];
+                if(batch.mOwner != slab->mOwner)
+                {
+                    flushRemoteBatch(batch, sizeClass);
+                    batch.mOwner = slab->mOwner;
+                }
+
+                block->mNext = batch.mHead;
+                batch.mHead = block;
+                if(batch.mTail == NULL)
+                    batch.mTail = block;
+
+                if(++batch.mCount >= eRemoteFreeBatch)
+                {
+                    flushRemoteBatch(batch, sizeClass);
+                }
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// The cache keeps its slabs, it is parked until another thread adopts it.
+// Called again by the thread exit hook, it does nothing then
+//----------------------------------------------------------------------------
+/*static*/ void NWSlabAllocator::threadExit()
+{
+    NWSlabCache * cache = tCache;
+
+    if(cache)
+    {
+        for(u32 i = 0; i < eNumSizeClasses; i++)
+        {
+            flushRemoteBatch(cache->mBatch[i], i);
+        }
+
+        tCache = NULL;
+
+        lockCaches();
+
+        cache->mNextOrphan = sOrphans;
+        sOrphans = cache;
+
+        unlockCaches();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ void NWSlabAllocator::enumStats(NWSlabStatsCallback * _callback)
+{
+    ASSERT(_callback);
+
+    NWSlabStats * stats = sStatsHead;
+    while(stats)
+    {
+        _callback->slabStats(*stats);
+        stats = stats->mNext;
+    }
+}
@@ -0,0 +1,118 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_SLAB_ALLOCATOR_H_
+#define _INCREW_SLAB_ALLOCATOR_H_
+
+#include "NWTypes.h"
+
+#include <stddef.h>
+
+//****************************************************************************
+// Live objects counters, one instance per allocated type. They must be
+// statically initialized (NWSLAB_STATS_INIT) so they can be used before main
+//****************************************************************************
+struct NWSlabStats
+{
+    const char * mName;
+    int mFamily;
+    int mType;
+    long volatile mLive;
+    long volatile mTotal;
+    long volatile mRegistered;
+    NWSlabStats * mNext;
+};
+
+#define NWSLAB_STATS_INIT(_name, _family, _type) { _name, _family, _type, 0, 0, 0, NULL }
+
+class NWSlabStatsCallback
+{
+public:
+    virtual void slabStats(NWSlabStats const & _stats) = 0;
+};
+
+//****************************************************************************
+// Small objects allocator
+//  - size classes up to eMaxSlabObjectSize, bigger objects go to the heap
+//  - every thread allocates from its own cache without locking
+//  - a block freed by another thread is batched and handed back to the
+//    owner cache with a single atomic push
+//  - the cache of an ended thread is adopted by the next thread that
+//    needs one, the blocks still alive are returned to it
+// Slabs are only released by staticShutdown(), every object must have been
+// destroyed by then.
+//****************************************************************************
+class NWSlabAllocator
+{
+public:
+    enum eDefaults
+    {
+        eMaxSlabObjectSize = 1024,
+        eSlabSize = 64 * 1024,
+        eRemoteFreeBatch = 64
+    };
+
+    static void staticShutdown();
+
+    static void * alloc(size_t _size, NWSlabStats * _stats);
+    static void free(void * _ptr, size_t _size, NWSlabStats * _stats);
+
+    static void threadExit(); // called by NWThread when the thread function returns, and by the thread exit hook for any thread
+
+    static void enumStats(NWSlabStatsCallback * _callback);
+};
+
+//****************************************************************************
+// Class operators routing the allocations of a class through the slabs
+//****************************************************************************
+#if defined(_DEBUG) && defined(_MSC_VER)
+    #define NWSLAB_DEBUG_OPERATORS(_class, _stats) \
+        static inline void * operator new(size_t _size, int, const char *, int) { return NWSlabAllocator::alloc(_size, &_stats); } \
+        static inline void operator delete(void * _ptr, int, const char *, int) { NWSlabAllocator::free(_ptr, sizeof(_class), &_stats); }
+#else
+    #define NWSLAB_DEBUG_OPERATORS(_class, _stats)
+#endif
+
+#define NWSLAB_OPERATORS(_class, _stats) \
+    static inline void * operator new(size_t _size) { return NWSlabAllocator::alloc(_size, &_stats); } \
+    static inline void operator delete(void * _ptr, size_t _size) { NWSlabAllocator::free(_ptr, _size, &_stats); } \
+    NWSLAB_DEBUG_OPERATORS(_class, _stats)
+
+#endif // _INCREW_SLAB_ALLOCATOR_H_
@@ -0,0 +1,692 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWSocketReactor_Linux.h"
+#include "NWEvent_Posix.h"
+#include "NWCriticalSection.h"
+#include "NWTime.h"
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+#include <linux/net_tstamp.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+//****************************************************************************
+// Edge triggered epoll reactor : accepts and reads until the socket would
+// block, flushes the send queues on EPOLLOUT. The application sends
+// straight to the socket from its own thread, whatever doesn't fit waits in
+// the send queue of the connection.
+//****************************************************************************
+class NWSocketReactorEpoll : public NWSocketReactor
+{
+public:
+    NWSocketReactorEpoll(NWSocketData * _data);
+    virtual ~NWSocketReactorEpoll();
+
+    bool init();
+
+    virtual bool listen(int _fd);
+    virtual bool connect(int _fd, sockaddr const * _addr, int _addrLen);
+    virtual void wakeUp();
+
+    virtual unsigned int run(ThreadParams const * _threadParams);
+
+protected:
+    virtual int sendNow(NWSocketConnection * _conn, NWIoVec const * _vecs, int _numVecs, int _fd);
+
+private:
+    int mEpollFd;
+    NWEventPosix * mWakeEvent;
+    std::vector<NWSocketConnection *> mClosedConnections; // deleted after each wait
+
+    bool watch(int _fd, unsigned int _events, void * _tag);
+    bool watchConnection(NWSocketConnection * _conn);
+    void closeConnection(NWSocketConnection * _conn, int _reason, bool _notify);
+    void deleteClosedConnections();
+
+    void acceptConnections();
+    int readConnection(NWSocketConnection * _conn);
+    bool flushConnection(NWSocketConnection * _conn);
+    bool completeConnect(NWSocketConnection * _conn, unsigned int _events);
+    void processConnection(NWSocketConnection * _conn, unsigned int _events);
+    void processCloseRequests();
+};
+
+enum eNWSocketEpollDefs
+{
+    NWSocketEpollMaxRecvWaitNs = 1000000000     // longer waits since the kernel got the data are taken as clock changes
+};
+
+static char sEndRequestTag;
+static char sWakeTag;
+static char sListenTag;
+
+//----------------------------------------------------------------------------
+// The kernel stamps the data it receives, so the reads know how long it
+// waited for them. Without it they are timed when they return.
+//----------------------------------------------------------------------------
+static void enableRecvTimestamps(int _fd)
+{
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ NWSocketReactor * NWSocketReactor::createEpoll(NWSocketData * _data)
+{
+    NWSocketReactorEpoll * pRet = NEW NWSocketReactorEpoll(_data);
+    if(!pRet->init())
+    {
+        DISPOSE(pRet);
+    }
+
+    return pRet;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWSocketReactorEpoll::NWSocketReactorEpoll(NWSocketData * _data) : NWSocketReactor(_data),
+    mEpollFd(-1)
+{
+    mWakeEvent = NEW NWEventPosix();
+}
+
+/*virtual*/ NWSocketReactorEpoll::~NWSocketReactorEpoll()
+{
+    deleteClosedConnections();
+
+    if(mEpollFd >= 0)
+        close(mEpollFd);
+
+    DISPOSE(mWakeEvent);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWSocketReactorEpoll::init()
+{
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(mEpollFd < 0)
+    {
+        LOG("epoll_create1 failed: %s", strerror(errno));
+    }
+
+    return mEpollFd >= 0;
+}
+
+//****************************************************************************
+// Application thread
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ bool NWSocketReactorEpoll::listen(int _fd)
+{
+    return watch(_fd, EPOLLIN | EPOLLET, &sListenTag);
+}
+
+//----------------------------------------------------------------------------
+// The non blocking connect reports through EPOLLOUT. Without an address the
+// fd is already connected (socketpair), EPOLLOUT tells it at once.
+//----------------------------------------------------------------------------
+/*virtual*/ bool NWSocketReactorEpoll::connect(int _fd, sockaddr const * _addr, int _addrLen)
+{
+    bool bRet = false;
+
+    if(!_addr || ::connect(_fd, _addr, _addrLen) == 0 || errno == EINPROGRESS)
+    {
+        if(!mData->mLocal)
+            enableRecvTimestamps(_fd);
+
+        NWSocketConnection * conn = NEW NWSocketConnection(_fd, 0, mData->mRecvSlabs);
+        conn->mConnecting = true; // EPOLLOUT tells, even if it already connected
+
+        bRet = watchConnection(conn);
+    }
+    else
+    {
+        close(_fd);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// NWTime of the arrival of the data read. The kernel stamps are
+// CLOCK_REALTIME, only the time waited since is taken from them.
+//----------------------------------------------------------------------------
+static u64 getRecvTimeNs(msghdr & _msg)
+{
+    u64 timeNs = NWTime::getTimeNs();
+
+    for(cmsghdr * cmsg = CMSG_FIRSTHDR(&_msg); cmsg; cmsg = CMSG_NXTHDR(&_msg, cmsg))
+    {
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+        {
+            timespec stamps[3]; // software, deprecated, hardware
+            memcpy(stamps, CMSG_DATA(cmsg), sizeof(stamps));
+
+            if(stamps[0].tv_sec != 0)
+            {
+                timespec now;
+                clock_gettime(CLOCK_REALTIME, &now);
+
+                s64 waitedNs = (s64)(now.tv_sec - stamps[0].tv_sec) * 1000000000 + (now.tv_nsec - stamps[0].tv_nsec);
+                if(waitedNs > 0 && waitedNs < NWSocketEpollMaxRecvWaitNs && (u64)waitedNs < timeNs)
+                {
+                    timeNs -= waitedNs;
+                }
+            }
+        }
+    }
+
+    return timeNs;
+}
+
+//----------------------------------------------------------------------------
+// The descriptors passed by a local peer, they come before the data they
+// belong to is parsed. Returns false if some didn't fit and were lost.
+//----------------------------------------------------------------------------
+static bool takeRecvFds(msghdr & _msg, std::deque<int> & out_fds)
+{
+    for(cmsghdr * cmsg = CMSG_FIRSTHDR(&_msg); cmsg; cmsg = CMSG_NXTHDR(&_msg, cmsg))
+    {
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            int num = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            for(int i=0; i<num; i++)
+            {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                out_fds.push_back(fd);
+            }
+        }
+    }
+
+    return (_msg.msg_flags & MSG_CTRUNC) == 0;
+}
+
+//----------------------------------------------------------------------------
+// One gathering sendmsg, _fd goes with its first byte. Returns the bytes
+// sent, 0 if the socket is full and -1 on error.
+//----------------------------------------------------------------------------
+static int sendVecs(int _fd, NWIoVec const * _vecs, int _numVecs, int _passFd=-1)
+{
+    iovec iov[NWSocketMaxIoVecs];
+    int numIov = 0;
+
+    for(int i=0; i<_numVecs && numIov<NWSocketMaxIoVecs; i++)
+    {
+        if(_vecs[i].mSize > 0)
+        {
+            iov[numIov].iov_base = (void *)_vecs[i].mPtr;
+            iov[numIov].iov_len = _vecs[i].mSize;
+            numIov++;
+        }
+    }
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = numIov;
+
+    union
+    {
+        cmsghdr mAlign;
+        char mBuffer[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    if(_passFd >= 0)
+    {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.mBuffer;
+        msg.msg_controllen = sizeof(control.mBuffer);
+
+        cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &_passFd, sizeof(int));
+    }
+
+    ssize_t n = -1;
+    do
+    {
+        n = sendmsg(_fd, &msg, MSG_NOSIGNAL);
+    }
+    while(n < 0 && errno == EINTR);
+
+    if(n < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+    return (int)n;
+}
+
+//----------------------------------------------------------------------------
+// Sends what the socket takes straight from the pieces, the rest is queued
+// for EPOLLOUT. An error is left for the reactor, which gets it as well.
+//----------------------------------------------------------------------------
+/*virtual*/ int NWSocketReactorEpoll::sendNow(NWSocketConnection * _conn, NWIoVec const * _vecs, int _numVecs, int _fd)
+{
+    int iRet = 0;
+
+    int vec = 0;        // first piece not sent completely
+    int vecOffset = 0;  // bytes of it already sent
+
+    while(vec < _numVecs)
+    {
+        NWIoVec pieces[NWSocketMaxIoVecs];
+        int numPieces = 0;
+
+        for(int i=vec; i<_numVecs && numPieces<NWSocketMaxIoVecs; i++)
+        {
+            int offset = (i == vec) ? vecOffset : 0;
+            pieces[numPieces++] = NWIoVec(_vecs[i].mPtr + offset, _vecs[i].mSize - offset);
+        }
+
+        int n = sendVecs(_conn->mFd, pieces, numPieces, iRet == 0 ? _fd : -1);
+        if(n < 0)
+            return -1;
+        if(n == 0)
+            break;
+
+        iRet += n;
+        vecOffset += n;
+        while(vec < _numVecs && vecOffset >= _vecs[vec].mSize)
+        {
+            vecOffset -= _vecs[vec].mSize;
+            vec++;
+        }
+    }
+
+    return iRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ void NWSocketReactorEpoll::wakeUp()
+{
+    mWakeEvent->signal();
+}
+
+//****************************************************************************
+// Reactor thread
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWSocketReactorEpoll::watch(int _fd, unsigned int _events, void * _tag)
+{
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = _events;
+    ev.data.ptr = _tag;
+
+    return epoll_ctl(mEpollFd, EPOLL_CTL_ADD, _fd, &ev) == 0;
+}
+
+//----------------------------------------------------------------------------
+// A connection that can't be watched is closed without telling anybody
+//----------------------------------------------------------------------------
+bool NWSocketReactorEpoll::watchConnection(NWSocketConnection * _conn)
+{
+    addConnection(_conn);
+
+    bool bRet = watch(_conn->mFd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, _conn);
+    if(!bRet)
+    {
+        LOG("epoll_ctl failed for client %d: %s", _conn->mClientId, strerror(errno));
+        closeConnection(_conn, NWSOCKET_DISCONNECT_ERROR, false);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// The connection is deleted after the events of the current wait, which
+// could still point to it
+//----------------------------------------------------------------------------
+void NWSocketReactorEpoll::closeConnection(NWSocketConnection * _conn, int _reason, bool _notify)
+{
+    int fd = detachConnection(_conn, _reason, _notify);
+
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+
+    mClosedConnections.push_back(_conn);
+}
+
+void NWSocketReactorEpoll::deleteClosedConnections()
+{
+    int num = (int)mClosedConnections.size();
+    for(int i=0; i<num; i++)
+    {
+        DISPOSE(mClosedConnections[i]);
+    }
+    mClosedConnections.clear();
+}
+
+//----------------------------------------------------------------------------
+// Edge triggered : accept until it would block
+//----------------------------------------------------------------------------
+void NWSocketReactorEpoll::acceptConnections()
+{
+    bool bLoop = true;
+
+    while(bLoop)
+    {
+        int fd = accept4(mData->mListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd >= 0)
+        {
+            if(!mData->mLocal)
+            {
+                int noDelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                enableRecvTimestamps(fd);
+            }
+
+            NWSocketConnection * conn = NEW NWSocketConnection(fd, mData->newClientId(), mData->mRecvSlabs);
+            if(watchConnection(conn))
+            {
+                connectionAccepted(conn);
+            }
+        }
+        else if(errno != EINTR && errno != ECONNABORTED)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                LOG("accept failed: %s", strerror(errno));
+            }
+            bLoop = false;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Edge triggered : read until it would block, straight into the frame
+// reader. Returns the disconnect reason, -1 if it is still open.
+//----------------------------------------------------------------------------
+int NWSocketReactorEpoll::readConnection(NWSocketConnection * _conn)
+{
+    int iRet = -1;
+
+    bool bLoop = true;
+
+    while(bLoop)
+    {
+        int room = 0;
+        unsigned char * ptr = _conn->mFrameReader.getWritePtr(room);
+
+        iovec iov;
+        iov.iov_base = ptr;
+        iov.iov_len = room;
+
+        union
+        {
+            cmsghdr mAlign;
+            char mBuffer[CMSG_SPACE(3 * sizeof(timespec)) + CMSG_SPACE(NWSocketMaxRecvFds * sizeof(int))];
+        } control;
+
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.mBuffer;
+        msg.msg_controllen = sizeof(control.mBuffer);
+
+        ssize_t n = recvmsg(_conn->mFd, &msg, MSG_CMSG_CLOEXEC);
+
+        if(n > 0)
+        {
+            if(mData->mLocal && !takeRecvFds(msg, _conn->mRecvFds))
+            {
+                LOG("Descriptors lost from client %d", _conn->mClientId);
+                iRet = NWSOCKET_DISCONNECT_ERROR;
+                bLoop = false;
+            }
+            else if(!_conn->mFrameReader.commit((int)n, getRecvTimeNs(msg)))
+            {
+                LOG("Bad frame from client %d", _conn->mClientId);
+                iRet = NWSOCKET_DISCONNECT_ERROR;
+                bLoop = false;
+            }
+        }
+        else if(n == 0)
+        {
+            iRet = NWSOCKET_DISCONNECT_CLOSED;
+            bLoop = false;
+        }
+        else if(errno != EINTR)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                iRet = NWSOCKET_DISCONNECT_ERROR;
+            }
+            bLoop = false;
+        }
+    }
+
+    flushReadFrames(_conn);
+
+    return iRet;
+}
+
+//----------------------------------------------------------------------------
+// With the connection locked. false on a connection error
+//----------------------------------------------------------------------------
+bool NWSocketReactorEpoll::flushConnection(NWSocketConnection * _conn)
+{
+    bool bRet = true;
+
+    NWIoVec vecs[NWSocketMaxIoVecs];
+    while(!_conn->mSendQueue.empty())
+    {
+        int fd = -1;
+        int num = getQueuedVecs(_conn, vecs, NWSocketMaxIoVecs, fd);
+
+        int n = sendVecs(_conn->mFd, vecs, num, fd);
+        if(n > 0)
+        {
+            consumeQueued(_conn, n);
+        }
+        else
+        {
+            bRet = (n == 0); // the rest waits for EPOLLOUT
+            break;
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWSocketReactorEpoll::completeConnect(NWSocketConnection * _conn, unsigned int _events)
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if(getsockopt(_conn->mFd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+    {
+        error = errno;
+    }
+
+    bool bRet = (error == 0 && !(_events & (EPOLLERR | EPOLLHUP)));
+    if(bRet)
+    {
+        connectionEstablished(_conn);
+    }
+    else
+    {
+        closeConnection(_conn, NWSOCKET_DISCONNECT_ERROR, true);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocketReactorEpoll::processConnection(NWSocketConnection * _conn, unsigned int _events)
+{
+    if(_conn->mConnecting)
+    {
+        if(!(_events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) || !completeConnect(_conn, _events))
+            return;
+    }
+
+    if(_events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+    {
+        int reason = readConnection(_conn);
+        if(reason >= 0)
+        {
+            closeConnection(_conn, reason, true);
+            return;
+        }
+    }
+
+    if(_events & EPOLLOUT)
+    {
+        bool bFlushed = false;
+        {
+            NWAutoCritSec autoCS(_conn->mCritSec);
+            bFlushed = flushConnection(_conn);
+        }
+
+        if(!bFlushed)
+        {
+            closeConnection(_conn, NWSOCKET_DISCONNECT_ERROR, true);
+        }
+    }
+}
+
+void NWSocketReactorEpoll::processCloseRequests()
+{
+    std::vector<int> requests;
+    takeCloseRequests(requests);
+
+    int num = (int)requests.size();
+    for(int i=0; i<num; i++)
+    {
+        NWSocketConnection * conn = findConnection(requests[i]);
+        if(conn)
+        {
+            closeConnection(conn, NWSOCKET_DISCONNECT_LOCAL, true);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Runs until the end of the thread is requested, blocked in epoll_wait
+// while there is nothing to do
+//----------------------------------------------------------------------------
+/*virtual*/ unsigned int NWSocketReactorEpoll::run(ThreadParams const * _threadParams)
+{
+    NWEventPosix * endEvent = (NWEventPosix *)_threadParams->mEventEndRequest;
+
+    bool bLoop = watch(endEvent->getFd(), EPOLLIN, &sEndRequestTag) &&
+                 watch(mWakeEvent->getFd(), EPOLLIN, &sWakeTag);
+
+    epoll_event events[NWSocketMaxEventsPerWait];
+
+    while(bLoop)
+    {
+        int num = epoll_wait(mEpollFd, events, NWSocketMaxEventsPerWait, -1);
+        if(num < 0 && errno != EINTR)
+        {
+            LOG("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+
+        for(int i=0; i<num; i++)
+        {
+            void * tag = events[i].data.ptr;
+
+            if(tag == &sEndRequestTag)
+            {
+                bLoop = false;
+            }
+            else if(tag == &sWakeTag)
+            {
+                mWakeEvent->consumeSignal();
+                processCloseRequests();
+            }
+            else if(tag == &sListenTag)
+            {
+                acceptConnections();
+            }
+            else
+            {
+                NWSocketConnection * conn = (NWSocketConnection *)tag;
+                if(conn->mFd >= 0) // else closed by a previous event of this wait
+                {
+                    processConnection(conn, events[i].events);
+                }
+            }
+        }
+
+        deleteClosedConnections();
+        dispatchEvents();
+    }
+
+    // nobody dispatches after this, the connections just close
+    while(!mData->mConnections.empty())
+    {
+        closeConnection(mData->mConnections.begin()->second, NWSOCKET_DISCONNECT_LOCAL, false);
+    }
+    deleteClosedConnections();
+
+    return 0;
+}
@@ -0,0 +1,1131 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWSocketReactor_Linux.h"
+#include "NWEvent_Posix.h"
+#include "NWCriticalSection.h"
+#include "NWAtomic.h"
+#include "NWTime.h"
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#ifndef IORING_FEAT_REG_REG_RING
+    #define IORING_FEAT_REG_REG_RING (1U << 13) // Linux 6.3, older headers don't have it
+#endif
+
+//****************************************************************************
+// io_uring reactor : a multishot accept, a multishot recv per connection
+// taking its buffers from a provided buffer ring, and the sends of each
+// connection as a linked chain. The sends go from registered buffers, the
+// large ones zero copy (only SEND_ZC takes registered buffers on sockets,
+// and WRITE_FIXED would raise SIGPIPE). The
+// application never does the I/O itself, its sends are handed to the
+// reactor and a single io_uring_enter submits them and waits for the next
+// completions. Uses raw syscalls, it needs the io_uring features of
+// Linux 6.3 and falls back to epoll on older kernels.
+//****************************************************************************
+enum eNWSocketUringDefs
+{
+    NWSocketUringEntries = 1024,            // submission queue
+    NWSocketUringCqEntries = 8192,          // completion queue
+    NWSocketUringRecvBuffers = 1024,        // provided receive buffers, power of 2
+    NWSocketUringRecvBufferSize = 4096,
+    NWSocketUringSendSlots = 512,           // registered send buffers
+    NWSocketUringSendSlotSize = 16*1024,
+    NWSocketUringZeroCopyMinSize = 8*1024,  // smaller sends are copied by the kernel
+    NWSocketUringMaxSendChain = 8           // linked sends in flight per connection
+};
+
+// user_data : the connection with the op in the low bits, the send slot
+// with sUringSlotTag, or one of these
+enum eNWSocketUringOp
+{
+    URING_OP_MASK = 7,
+
+    URING_OP_RECV = 1,
+    URING_OP_CONNECT,
+
+    URING_UD_END = 1,
+    URING_UD_WAKE,
+    URING_UD_ACCEPT,
+    URING_UD_CANCEL
+};
+
+static u64 const sUringSlotTag = (u64)1 << 63;
+
+//----------------------------------------------------------------------------
+// Besides mFlushQueued (mCritSec), only used by the reactor thread
+//----------------------------------------------------------------------------
+struct NWSocketConnectionUring : public NWSocketConnection
+{
+    struct sSendOp
+    {
+        int mSlot;
+        int mOffset;
+        int mSize;
+        bool mDone;
+    };
+
+    std::deque<sSendOp> mSendOps;   // in order, the first mSendsInFlight are submitted
+    int mSendsInFlight;
+    int mSendsCompleted;            // of the chain in flight
+    bool mFlushQueued;
+    bool mWaitingSlots;
+    bool mRecvArmed;
+    bool mRecvRearm;                // after the batch, the buffers ran out
+    bool mConnectPending;
+    bool mReadPending;              // frames read in this batch
+    int mClosedFd;                  // see closeConnection
+
+    NWSocketConnectionUring(int _fd, int _clientId, MemBufferPool * _slabPool);
+    virtual ~NWSocketConnectionUring();
+
+    inline bool isIdle() const;
+};
+
+NWSocketConnectionUring::NWSocketConnectionUring(int _fd, int _clientId, MemBufferPool * _slabPool) : NWSocketConnection(_fd, _clientId, _slabPool),
+    mSendsInFlight(0),
+    mSendsCompleted(0),
+    mFlushQueued(false),
+    mWaitingSlots(false),
+    mRecvArmed(false),
+    mRecvRearm(false),
+    mConnectPending(false),
+    mReadPending(false),
+    mClosedFd(-1)
+{
+}
+
+/*virtual*/ NWSocketConnectionUring::~NWSocketConnectionUring()
+{
+    if(mClosedFd >= 0)
+        close(mClosedFd);
+}
+
+inline bool NWSocketConnectionUring::isIdle() const
+{
+    return !mRecvArmed && mSendsInFlight == 0 && !mConnectPending;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+class NWSocketReactorUring : public NWSocketReactor
+{
+public:
+    NWSocketReactorUring(NWSocketData * _data);
+    virtual ~NWSocketReactorUring();
+
+    bool init();
+
+    virtual bool listen(int _fd);
+    virtual bool connect(int _fd, sockaddr const * _addr, int _addrLen);
+    virtual void wakeUp();
+
+    virtual unsigned int run(ThreadParams const * _threadParams);
+
+protected:
+    virtual void queued(NWSocketConnection * _conn);
+
+private:
+    typedef NWSocketConnectionUring Conn;
+
+    // ring
+    int mRingFd;
+    void * mRingPtr;
+    size_t mRingSize;
+    io_uring_sqe * mSqes;
+    size_t mSqesSize;
+    unsigned * mSqHead;
+    unsigned * mSqTail;
+    unsigned * mSqArray;
+    unsigned mSqMask;
+    unsigned mSqEntries;
+    unsigned mSqLocalTail;
+    unsigned * mCqHead;
+    unsigned * mCqTail;
+    unsigned mCqMask;
+    io_uring_cqe * mCqes;
+
+    // receive buffers
+    io_uring_buf_ring * mBufRing;
+    size_t mBufRingSize;
+    unsigned char * mRecvArena;
+    unsigned short mBufTail;
+
+    // send buffers, a slot is free once its connection released it and the
+    // zero copy notifications came
+    struct sSendSlot
+    {
+        Conn * mConn;
+        int mNotifs;
+    };
+
+    unsigned char * mSendArena;
+    std::vector<sSendSlot> mSlots;
+    std::vector<int> mFreeSlots;
+    bool mSendFixed;                // registered, else every send is copied
+    std::vector<int> mSlotWaiters;  // client ids
+
+    // application thread requests
+    NWEventPosix * mWakeEvent;
+    u64 mWakeValue;
+    long volatile mWakeRequested;
+    NWCriticalSection * mFlushCritSec;
+    std::vector<int> mFlushList;    // client ids
+
+    Conn * mClientConn;             // connect() until run()
+    sockaddr_storage mConnectAddr;
+    int mConnectAddrLen;
+
+    bool mStopping;
+    bool mEndArmed;
+    bool mWakeArmed;
+    bool mAcceptArmed;
+    bool mAcceptBlocked;            // out of fds, until a connection closes
+    std::vector<Conn *> mPendingReads;
+    std::vector<Conn *> mClosedConnections; // deleted once their ops complete
+
+    io_uring_sqe * getSqe();
+    void ensureSqSpace(unsigned _num);
+    int submit(unsigned _minComplete);
+    void processCompletions();
+
+    void addRecvBuffer(int _bid);
+    void publishRecvBuffers();
+
+    void armAccept();
+    void armRecv(Conn * _conn);
+    void armWake();
+    void submitSends(Conn * _conn);
+    void releaseSlot(int _slot);
+    void closeConnection(Conn * _conn, int _reason, bool _notify);
+
+    void onAccept(int _res, unsigned int _flags);
+    void onRecv(Conn * _conn, int _res, unsigned int _flags);
+    void onSend(int _slot, int _res, unsigned int _flags);
+    void onConnect(Conn * _conn, int _res);
+    void onWake();
+    void endOfBatch();
+
+    static bool setBlocking(int _fd);
+};
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ NWSocketReactor * NWSocketReactor::createUring(NWSocketData * _data)
+{
+    NWSocketReactorUring * pRet = NEW NWSocketReactorUring(_data);
+    if(!pRet->init())
+    {
+        DISPOSE(pRet);
+    }
+
+    return pRet;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWSocketReactorUring::NWSocketReactorUring(NWSocketData * _data) : NWSocketReactor(_data),
+    mRingFd(-1),
+    mRingPtr(MAP_FAILED),
+    mRingSize(0),
+    mSqes((io_uring_sqe *)MAP_FAILED),
+    mSqesSize(0),
+    mSqHead(NULL),
+    mSqTail(NULL),
+    mSqArray(NULL),
+    mSqMask(0),
+    mSqEntries(0),
+    mSqLocalTail(0),
+    mCqHead(NULL),
+    mCqTail(NULL),
+    mCqMask(0),
+    mCqes(NULL),
+    mBufRing((io_uring_buf_ring *)MAP_FAILED),
+    mBufRingSize(0),
+    mRecvArena((unsigned char *)MAP_FAILED),
+    mBufTail(0),
+    mSendArena((unsigned char *)MAP_FAILED),
+    mSendFixed(false),
+    mWakeValue(0),
+    mWakeRequested(0),
+    mClientConn(NULL),
+    mConnectAddrLen(0),
+    mStopping(false),
+    mEndArmed(false),
+    mWakeArmed(false),
+    mAcceptArmed(false),
+    mAcceptBlocked(false)
+{
+    memset(&mConnectAddr, 0, sizeof(mConnectAddr));
+
+    mWakeEvent = NEW NWEventPosix();
+    mFlushCritSec = NWCriticalSection::create();
+}
+
+//----------------------------------------------------------------------------
+// Closing the ring cancels whatever run() left, the memory the kernel could
+// write goes after it
+//----------------------------------------------------------------------------
+/*virtual*/ NWSocketReactorUring::~NWSocketReactorUring()
+{
+    if(mClientConn)
+    {
+        closeConnection(mClientConn, NWSOCKET_DISCONNECT_LOCAL, false); // never ran
+        mClientConn = NULL;
+    }
+
+    int num = (int)mClosedConnections.size();
+    for(int i=0; i<num; i++)
+    {
+        DISPOSE(mClosedConnections[i]);
+    }
+
+    if(mRingFd >= 0)
+        close(mRingFd);
+
+    if(mRingPtr != MAP_FAILED)
+        munmap(mRingPtr, mRingSize);
+    if(mSqes != MAP_FAILED)
+        munmap(mSqes, mSqesSize);
+    if(mBufRing != MAP_FAILED)
+        munmap(mBufRing, mBufRingSize);
+    if(mRecvArena != MAP_FAILED)
+        munmap(mRecvArena, NWSocketUringRecvBuffers * NWSocketUringRecvBufferSize);
+    if(mSendArena != MAP_FAILED)
+        munmap(mSendArena, NWSocketUringSendSlots * NWSocketUringSendSlotSize);
+
+    NWCriticalSection::destroy(mFlushCritSec);
+    DISPOSE(mWakeEvent);
+}
+
+//----------------------------------------------------------------------------
+// false if the kernel can't run it
+//----------------------------------------------------------------------------
+bool NWSocketReactorUring::init()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = NWSocketUringCqEntries;
+
+    mRingFd = (int)syscall(__NR_io_uring_setup, NWSocketUringEntries, &params);
+    if(mRingFd < 0)
+    {
+        LOG("io_uring_setup failed: %s", strerror(errno));
+        return false;
+    }
+
+    unsigned int const requiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL | IORING_FEAT_REG_REG_RING;
+    if((params.features & requiredFeatures) != requiredFeatures)
+    {
+        LOG("io_uring is too old (features 0x%x)", params.features);
+        return false;
+    }
+
+    // rings
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    mRingSize = (sqSize > cqSize) ? sqSize : cqSize;
+    mRingPtr = mmap(NULL, mRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQ_RING);
+
+    mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    mSqes = (io_uring_sqe *)mmap(NULL, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFd, IORING_OFF_SQES);
+
+    if(mRingPtr == MAP_FAILED || mSqes == MAP_FAILED)
+    {
+        LOG("io_uring mmap failed: %s", strerror(errno));
+        return false;
+    }
+
+    unsigned char * ring = (unsigned char *)mRingPtr;
+    mSqHead = (unsigned *)(ring + params.sq_off.head);
+    mSqTail = (unsigned *)(ring + params.sq_off.tail);
+    mSqArray = (unsigned *)(ring + params.sq_off.array);
+    mSqMask = *(unsigned *)(ring + params.sq_off.ring_mask);
+    mSqEntries = params.sq_entries;
+    mSqLocalTail = *mSqTail;
+    mCqHead = (unsigned *)(ring + params.cq_off.head);
+    mCqTail = (unsigned *)(ring + params.cq_off.tail);
+    mCqMask = *(unsigned *)(ring + params.cq_off.ring_mask);
+    mCqes = (io_uring_cqe *)(ring + params.cq_off.cqes);
+
+    // provided receive buffers
+    mBufRingSize = NWSocketUringRecvBuffers * sizeof(io_uring_buf);
+    mBufRing = (io_uring_buf_ring *)mmap(NULL, mBufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    mRecvArena = (unsigned char *)mmap(NULL, NWSocketUringRecvBuffers * NWSocketUringRecvBufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    mSendArena = (unsigned char *)mmap(NULL, NWSocketUringSendSlots * NWSocketUringSendSlotSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(mBufRing == MAP_FAILED || mRecvArena == MAP_FAILED || mSendArena == MAP_FAILED)
+    {
+        LOG("io_uring buffers mmap failed: %s", strerror(errno));
+        return false;
+    }
+
+    io_uring_buf_reg bufReg;
+    memset(&bufReg, 0, sizeof(bufReg));
+    bufReg.ring_addr = (u64)(size_t)mBufRing;
+    bufReg.ring_entries = NWSocketUringRecvBuffers;
+    bufReg.bgid = 0;
+
+    if(syscall(__NR_io_uring_register, mRingFd, IORING_REGISTER_PBUF_RING, &bufReg, 1) < 0)
+    {
+        LOG("io_uring buffer ring failed: %s", strerror(errno));
+        return false;
+    }
+
+    for(int i=0; i<NWSocketUringRecvBuffers; i++)
+    {
+        addRecvBuffer(i);
+    }
+    publishRecvBuffers();
+
+    // registered send buffers, they count against RLIMIT_MEMLOCK
+    iovec sendIov;
+    sendIov.iov_base = mSendArena;
+    sendIov.iov_len = NWSocketUringSendSlots * NWSocketUringSendSlotSize;
+
+    mSendFixed = syscall(__NR_io_uring_register, mRingFd, IORING_REGISTER_BUFFERS, &sendIov, 1) == 0;
+    if(!mSendFixed)
+    {
+        LOG("io_uring can't register the send buffers (%s), sending without", strerror(errno));
+    }
+
+    sSendSlot slot;
+    slot.mConn = NULL;
+    slot.mNotifs = 0;
+    mSlots.resize(NWSocketUringSendSlots, slot);
+
+    mFreeSlots.reserve(NWSocketUringSendSlots);
+    for(int i=NWSocketUringSendSlots-1; i>=0; i--)
+    {
+        mFreeSlots.push_back(i);
+    }
+
+    return true;
+}
+
+//****************************************************************************
+// Application thread
+//****************************************************************************
+//----------------------------------------------------------------------------
+// The ops wait in the kernel instead of returning EAGAIN
+//----------------------------------------------------------------------------
+/*static*/ bool NWSocketReactorUring::setBlocking(int _fd)
+{
+    int flags = fcntl(_fd, F_GETFL);
+    return flags >= 0 && fcntl(_fd, F_SETFL, flags & ~O_NONBLOCK) == 0;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ bool NWSocketReactorUring::listen(int _fd)
+{
+    return setBlocking(_fd); // run() arms the accept
+}
+
+/*virtual*/ bool NWSocketReactorUring::connect(int _fd, sockaddr const * _addr, int _addrLen)
+{
+    bool bRet = false;
+
+    if(_addrLen <= (int)sizeof(mConnectAddr) && setBlocking(_fd))
+    {
+        mClientConn = NEW Conn(_fd, 0, mData->mRecvSlabs);
+        mClientConn->mConnecting = true;
+        memcpy(&mConnectAddr, _addr, _addrLen);
+        mConnectAddrLen = _addrLen;
+
+        addConnection(mClientConn); // run() starts the connect
+        bRet = true;
+    }
+    else
+    {
+        close(_fd);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Every send is queued for the reactor, which is woken once for all the
+// sends until it takes them
+//----------------------------------------------------------------------------
+/*virtual*/ void NWSocketReactorUring::queued(NWSocketConnection * _conn)
+{
+    Conn * conn = (Conn *)_conn;
+    if(!conn->mFlushQueued)
+    {
+        conn->mFlushQueued = true;
+        {
+            NWAutoCritSec autoCS(mFlushCritSec);
+            mFlushList.push_back(conn->mClientId);
+        }
+
+        wakeUp();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ void NWSocketReactorUring::wakeUp()
+{
+    if(NWAtomic::exchange(&mWakeRequested, 1) == 0)
+    {
+        mWakeEvent->signal();
+    }
+}
+
+//****************************************************************************
+// Ring
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+io_uring_sqe * NWSocketReactorUring::getSqe()
+{
+    ensureSqSpace(1);
+
+    unsigned index = mSqLocalTail & mSqMask;
+    mSqLocalTail++;
+
+    io_uring_sqe * sqe = &mSqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    mSqArray[index] = index;
+
+    return sqe;
+}
+
+//----------------------------------------------------------------------------
+// A chain of linked sends has to go in a single submission
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::ensureSqSpace(unsigned _num)
+{
+    while(mSqLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) + _num > mSqEntries)
+    {
+        if(submit(0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            LOG("io_uring_enter failed: %s", strerror(errno));
+            break;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWSocketReactorUring::submit(unsigned _minComplete)
+{
+    __atomic_store_n(mSqTail, mSqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = mSqLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE);
+
+    unsigned flags = (_minComplete > 0) ? IORING_ENTER_GETEVENTS : 0;
+    return (int)syscall(__NR_io_uring_enter, mRingFd, toSubmit, _minComplete, flags, NULL, 0);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::processCompletions()
+{
+    unsigned head = *mCqHead;
+    unsigned tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+
+    for(; head != tail; head++)
+    {
+        io_uring_cqe const & cqe = mCqes[head & mCqMask];
+
+        u64 userData = cqe.user_data;
+        if(userData & sUringSlotTag)
+        {
+            onSend((int)(userData & ~sUringSlotTag), cqe.res, cqe.flags);
+        }
+        else if(userData <= URING_OP_MASK)
+        {
+            switch(userData)
+            {
+                case URING_UD_END:      mEndArmed = false; mStopping = true; break;
+                case URING_UD_WAKE:     mWakeArmed = false; onWake(); break;
+                case URING_UD_ACCEPT:   onAccept(cqe.res, cqe.flags); break;
+            }
+        }
+        else
+        {
+            Conn * conn = (Conn *)(size_t)(userData & ~(u64)URING_OP_MASK);
+
+            switch(userData & URING_OP_MASK)
+            {
+                case URING_OP_RECV:     onRecv(conn, cqe.res, cqe.flags); break;
+                case URING_OP_CONNECT:  onConnect(conn, cqe.res); break;
+            }
+        }
+    }
+
+    __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+}
+
+//----------------------------------------------------------------------------
+// The kernel sees the returned buffers on publish. The entries are indexed
+// from the start of the ring: in C++ the header's flexible bufs[] lands 8
+// bytes in, over the tail
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::addRecvBuffer(int _bid)
+{
+    io_uring_buf * buf = (io_uring_buf *)mBufRing + (mBufTail & (NWSocketUringRecvBuffers - 1));
+    buf->addr = (u64)(size_t)(mRecvArena + _bid * NWSocketUringRecvBufferSize);
+    buf->len = NWSocketUringRecvBufferSize;
+    buf->bid = (unsigned short)_bid;
+
+    mBufTail++;
+}
+
+void NWSocketReactorUring::publishRecvBuffers()
+{
+    __atomic_store_n(&mBufRing->tail, mBufTail, __ATOMIC_RELEASE);
+}
+
+//****************************************************************************
+// Ops
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::armAccept()
+{
+    io_uring_sqe * sqe = getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = mData->mListenFd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = URING_UD_ACCEPT;
+
+    mAcceptArmed = true;
+}
+
+void NWSocketReactorUring::armRecv(Conn * _conn)
+{
+    io_uring_sqe * sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = _conn->mFd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->user_data = (u64)(size_t)_conn | URING_OP_RECV;
+
+    _conn->mRecvArmed = true;
+    _conn->mRecvRearm = false;
+}
+
+void NWSocketReactorUring::armWake()
+{
+    io_uring_sqe * sqe = getSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = mWakeEvent->getFd();
+    sqe->addr = (u64)(size_t)&mWakeValue;
+    sqe->len = sizeof(mWakeValue);
+    sqe->user_data = URING_UD_WAKE;
+
+    mWakeArmed = true;
+}
+
+//----------------------------------------------------------------------------
+// Only one chain in flight per connection. Resubmits what a short write left
+// and fills the chain from the send queue.
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::submitSends(Conn * _conn)
+{
+    if(_conn->mFd < 0 || _conn->mSendsInFlight > 0)
+        return;
+
+    {
+        NWAutoCritSec autoCS(_conn->mCritSec);
+
+        while(!_conn->mSendQueue.empty() && (int)_conn->mSendOps.size() < NWSocketUringMaxSendChain && !mFreeSlots.empty())
+        {
+            Conn::sSendOp op;
+            op.mSlot = mFreeSlots.back();
+            op.mOffset = 0;
+            op.mSize = copyQueued(_conn, mSendArena + op.mSlot * NWSocketUringSendSlotSize, NWSocketUringSendSlotSize);
+            op.mDone = false;
+
+            mFreeSlots.pop_back();
+            mSlots[op.mSlot].mConn = _conn;
+            _conn->mSendOps.push_back(op);
+        }
+
+        if(!_conn->mSendQueue.empty() && mFreeSlots.empty() && !_conn->mWaitingSlots)
+        {
+            _conn->mWaitingSlots = true;
+            mSlotWaiters.push_back(_conn->mClientId);
+        }
+    }
+
+    int num = (int)_conn->mSendOps.size();
+    ensureSqSpace(num);
+
+    for(int i=0; i<num; i++)
+    {
+        Conn::sSendOp const & op = _conn->mSendOps[i];
+
+        io_uring_sqe * sqe = getSqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = _conn->mFd;
+        sqe->addr = (u64)(size_t)(mSendArena + op.mSlot * NWSocketUringSendSlotSize + op.mOffset);
+        sqe->len = op.mSize;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->flags = (i < num - 1) ? IOSQE_IO_LINK : 0;
+        sqe->user_data = sUringSlotTag | (u64)op.mSlot;
+
+        if(mSendFixed && op.mSize >= NWSocketUringZeroCopyMinSize)
+        {
+            sqe->opcode = IORING_OP_SEND_ZC;
+            sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+            sqe->buf_index = 0;
+        }
+    }
+
+    _conn->mSendsInFlight = num;
+    _conn->mSendsCompleted = 0;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::releaseSlot(int _slot)
+{
+    mSlots[_slot].mConn = NULL;
+
+    if(mSlots[_slot].mNotifs == 0)
+    {
+        mFreeSlots.push_back(_slot);
+    }
+}
+
+//----------------------------------------------------------------------------
+// The ops in flight end once the socket is shut down, the connection is
+// deleted after them. The descriptor is closed with it: the ops not
+// submitted yet only have its number, which another socket of the process
+// could get meanwhile.
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::closeConnection(Conn * _conn, int _reason, bool _notify)
+{
+    int fd = detachConnection(_conn, _reason, _notify);
+
+    shutdown(fd, SHUT_RDWR);
+    _conn->mClosedFd = fd;
+
+    mClosedConnections.push_back(_conn);
+}
+
+//****************************************************************************
+// Completions
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::onAccept(int _res, unsigned int _flags)
+{
+    if(_res >= 0)
+    {
+        int noDelay = 1;
+        setsockopt(_res, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        Conn * conn = NEW Conn(_res, mData->newClientId(), mData->mRecvSlabs);
+        addConnection(conn);
+        armRecv(conn);
+
+        connectionAccepted(conn);
+    }
+    else if(_res != -ECONNABORTED && _res != -EINTR && _res != -EAGAIN && _res != -ECANCELED)
+    {
+        LOG("accept failed: %s", strerror(-_res));
+        mAcceptBlocked = true; // no busy loop until a connection closes
+    }
+
+    if(!(_flags & IORING_CQE_F_MORE))
+    {
+        mAcceptArmed = false;
+    }
+}
+
+//----------------------------------------------------------------------------
+// The provided buffer is copied into the frame reader and given back at once,
+// the frames of the whole batch are queued together, see endOfBatch
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::onRecv(Conn * _conn, int _res, unsigned int _flags)
+{
+    bool bBadFrame = false;
+    u64 timeNs = NWTime::getTimeNs(); // no kernel stamps through the provided buffers
+
+    if(_flags & IORING_CQE_F_BUFFER)
+    {
+        int bid = (int)(_flags >> IORING_CQE_BUFFER_SHIFT);
+
+        if(_res > 0 && _conn->mFd >= 0)
+        {
+            unsigned char const * data = mRecvArena + bid * NWSocketUringRecvBufferSize;
+            int copied = 0;
+
+            while(copied < _res && !bBadFrame)
+            {
+                int room = 0;
+                unsigned char * ptr = _conn->mFrameReader.getWritePtr(room);
+                int size = (room < _res - copied) ? room : _res - copied;
+
+                memcpy(ptr, data + copied, size);
+                copied += size;
+
+                bBadFrame = !_conn->mFrameReader.commit(size, timeNs);
+            }
+
+            if(!_conn->mReadPending)
+            {
+                _conn->mReadPending = true;
+                mPendingReads.push_back(_conn);
+            }
+        }
+
+        addRecvBuffer(bid);
+        publishRecvBuffers();
+    }
+
+    if(bBadFrame)
+    {
+        LOG("Bad frame from client %d", _conn->mClientId);
+        closeConnection(_conn, NWSOCKET_DISCONNECT_ERROR, true);
+    }
+
+    bool bMore = (_flags & IORING_CQE_F_MORE) != 0;
+    if(!bMore)
+    {
+        _conn->mRecvArmed = false;
+    }
+
+    if(_conn->mFd >= 0)
+    {
+        if(_res == 0)
+        {
+            closeConnection(_conn, NWSOCKET_DISCONNECT_CLOSED, true);
+        }
+        else if(_res < 0 && _res != -ENOBUFS)
+        {
+            closeConnection(_conn, NWSOCKET_DISCONNECT_ERROR, true);
+        }
+        else if(!bMore)
+        {
+            _conn->mRecvRearm = true; // once the batch returns the buffers
+
+            if(!_conn->mReadPending)
+            {
+                _conn->mReadPending = true;
+                mPendingReads.push_back(_conn);
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// The completions of a chain come in order. A short write cancels the rest
+// of the chain, which is submitted again once it all completed. A zero copy
+// send keeps its slot until the notification says the kernel is done.
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::onSend(int _slot, int _res, unsigned int _flags)
+{
+    sSendSlot & slot = mSlots[_slot];
+
+    if(_flags & IORING_CQE_F_NOTIF)
+    {
+        if(--slot.mNotifs == 0 && !slot.mConn)
+        {
+            mFreeSlots.push_back(_slot);
+        }
+        return;
+    }
+
+    if(_flags & IORING_CQE_F_MORE)
+    {
+        slot.mNotifs++;
+    }
+
+    Conn * conn = slot.mConn;
+    Conn::sSendOp & op = conn->mSendOps[conn->mSendsCompleted++];
+    conn->mSendsInFlight--;
+    ASSERT(op.mSlot == _slot);
+
+    if(_res == op.mSize)
+    {
+        op.mDone = true;
+    }
+    else if(_res > 0)
+    {
+        op.mOffset += _res;
+        op.mSize -= _res;
+    }
+    else if(_res != -ECANCELED && _res != -EINTR && _res != -EAGAIN && conn->mFd >= 0)
+    {
+        closeConnection(conn, NWSOCKET_DISCONNECT_ERROR, true);
+    }
+
+    if(conn->mSendsInFlight == 0)
+    {
+        while(!conn->mSendOps.empty() && conn->mSendOps.front().mDone)
+        {
+            releaseSlot(conn->mSendOps.front().mSlot);
+            conn->mSendOps.pop_front();
+        }
+
+        submitSends(conn);
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::onConnect(Conn * _conn, int _res)
+{
+    _conn->mConnectPending = false;
+
+    if(_conn->mFd >= 0)
+    {
+        if(_res == 0)
+        {
+            connectionEstablished(_conn);
+            armRecv(_conn);
+        }
+        else
+        {
+            closeConnection(_conn, NWSOCKET_DISCONNECT_ERROR, true);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Clearing mWakeRequested first, a later request wakes it again
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::onWake()
+{
+    NWAtomic::exchange(&mWakeRequested, 0);
+
+    std::vector<int> closeRequests;
+    takeCloseRequests(closeRequests);
+
+    int num = (int)closeRequests.size();
+    for(int i=0; i<num; i++)
+    {
+        Conn * conn = (Conn *)findConnection(closeRequests[i]);
+        if(conn)
+        {
+            closeConnection(conn, NWSOCKET_DISCONNECT_LOCAL, true);
+        }
+    }
+
+    std::vector<int> flushList;
+    {
+        NWAutoCritSec autoCS(mFlushCritSec);
+        flushList.swap(mFlushList);
+    }
+
+    num = (int)flushList.size();
+    for(int i=0; i<num; i++)
+    {
+        Conn * conn = (Conn *)findConnection(flushList[i]);
+        if(conn)
+        {
+            {
+                NWAutoCritSec autoCS(conn->mCritSec);
+                conn->mFlushQueued = false;
+            }
+
+            submitSends(conn);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocketReactorUring::endOfBatch()
+{
+    int num = (int)mPendingReads.size();
+    for(int i=0; i<num; i++)
+    {
+        Conn * conn = mPendingReads[i];
+        conn->mReadPending = false;
+
+        if(conn->mFd >= 0)
+        {
+            flushReadFrames(conn);
+
+            if(conn->mRecvRearm && !conn->mRecvArmed && !mStopping)
+            {
+                armRecv(conn);
+            }
+        }
+    }
+    mPendingReads.clear();
+
+    if(!mSlotWaiters.empty() && !mFreeSlots.empty())
+    {
+        std::vector<int> waiters;
+        waiters.swap(mSlotWaiters);
+
+        num = (int)waiters.size();
+        for(int i=0; i<num; i++)
+        {
+            Conn * conn = (Conn *)findConnection(waiters[i]);
+            if(conn)
+            {
+                conn->mWaitingSlots = false;
+                submitSends(conn);
+            }
+        }
+    }
+
+    for(int i=0; i<(int)mClosedConnections.size(); )
+    {
+        Conn * conn = mClosedConnections[i];
+        if(conn->isIdle())
+        {
+            for(int j=0; j<(int)conn->mSendOps.size(); j++)
+            {
+                releaseSlot(conn->mSendOps[j].mSlot);
+            }
+
+            DISPOSE(conn);
+            mClosedConnections[i] = mClosedConnections.back();
+            mClosedConnections.pop_back();
+            mAcceptBlocked = false;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if(!mStopping)
+    {
+        if(!mWakeArmed)
+            armWake();
+        if(!mAcceptArmed && !mAcceptBlocked && mData->mListenFd >= 0)
+            armAccept();
+    }
+}
+
+//----------------------------------------------------------------------------
+// One io_uring_enter per loop submits everything and waits. On the end
+// request every op is canceled and waited for before returning.
+//----------------------------------------------------------------------------
+/*virtual*/ unsigned int NWSocketReactorUring::run(ThreadParams const * _threadParams)
+{
+    NWEventPosix * endEvent = (NWEventPosix *)_threadParams->mEventEndRequest;
+
+    io_uring_sqe * sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = endEvent->getFd();
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = URING_UD_END;
+    mEndArmed = true;
+
+    if(mClientConn)
+    {
+        sqe = getSqe();
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->fd = mClientConn->mFd;
+        sqe->addr = (u64)(size_t)&mConnectAddr;
+        sqe->off = mConnectAddrLen;
+        sqe->user_data = (u64)(size_t)mClientConn | URING_OP_CONNECT;
+
+        mClientConn->mConnectPending = true;
+        mClientConn = NULL;
+    }
+
+    endOfBatch(); // arms the rest
+
+    bool bCanceled = false;
+    while(!mStopping || mEndArmed || mWakeArmed || mAcceptArmed || !mClosedConnections.empty())
+    {
+        if(submit(1) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            LOG("io_uring_enter failed: %s", strerror(errno));
+            break;
+        }
+
+        processCompletions();
+
+        if(mStopping && !bCanceled)
+        {
+            // nobody dispatches after this, the connections just close
+            while(!mData->mConnections.empty())
+            {
+                closeConnection((Conn *)mData->mConnections.begin()->second, NWSOCKET_DISCONNECT_LOCAL, false);
+            }
+
+            sqe = getSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+            sqe->user_data = URING_UD_CANCEL;
+            bCanceled = true;
+        }
+
+        endOfBatch();
+        dispatchEvents();
+    }
+
+    return 0;
+}
@@ -0,0 +1,1068 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWSocketReactor_Linux.h"
+#include "NWCommManager.h"
+#include "NWCriticalSection.h"
+#include "MemBufferRef.h"
+#include "NWTime.h"
+#include "NWLz.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+//****************************************************************************
+// memfd memory. The sender seals its size, so a mapping of the receiver can't
+// fault because the file shrinks under it.
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Unmaps and closes the memory with the last reference of its MemBufferRef
+//----------------------------------------------------------------------------
+class NWSharedMemOwner : public IMemBufferOwner
+{
+public:
+    NWSharedMemOwner(int _fd, size_t _mapSize) : mFd(_fd), mMapSize(_mapSize) {}
+
+    virtual void freeMemBuffer(unsigned char * _buffer, int /*_size*/)
+    {
+        munmap(_buffer, mMapSize);
+        if(mFd >= 0)
+            close(mFd);
+        delete this;
+    }
+
+    virtual int getFd() const { return mFd; }
+
+private:
+    int mFd;            // -1 for the received ones, the mapping is enough
+    size_t mMapSize;
+};
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+MemBufferRef NWSharedMem::alloc(int _size)
+{
+    MemBufferRef memBuff;
+
+    if(_size > 0)
+    {
+        int fd = memfd_create("NWSharedMem", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if(fd >= 0)
+        {
+            void * ptr = MAP_FAILED;
+            if(ftruncate(fd, _size) == 0 && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0)
+            {
+                ptr = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+
+            if(ptr != MAP_FAILED)
+            {
+                memBuff = MemBufferRef((unsigned char *)ptr, _size, NEW NWSharedMemOwner(fd, _size));
+            }
+            else
+            {
+                LOG("Shared memory of %d bytes failed: %s", _size, strerror(errno));
+                close(fd);
+            }
+        }
+        else
+        {
+            LOG("memfd_create failed: %s", strerror(errno));
+        }
+    }
+
+    return memBuff;
+}
+
+//----------------------------------------------------------------------------
+// The whole file is mapped, the view is the part the frame refers to
+//----------------------------------------------------------------------------
+MemBufferRef NWSharedMem::map(int _fd, int _offset, int _size)
+{
+    MemBufferRef memBuff;
+
+    struct stat st;
+    int seals = fcntl(_fd, F_GET_SEALS);
+
+    if(seals < 0 || (seals & F_SEAL_SHRINK) == 0)
+    {
+        LOG("Shared memory not sealed");
+    }
+    else if(fstat(_fd, &st) != 0 || _offset < 0 || _size <= 0 || (s64)_offset + _size > (s64)st.st_size)
+    {
+        LOG("Shared memory too short");
+    }
+    else
+    {
+        void * ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+        if(ptr != MAP_FAILED)
+        {
+            MemBufferRef whole((unsigned char *)ptr, (int)st.st_size, NEW NWSharedMemOwner(-1, st.st_size));
+            memBuff = MemBufferRef(whole, _offset, _size);
+        }
+        else
+        {
+            LOG("Shared memory of %d bytes can't be mapped: %s", (int)st.st_size, strerror(errno));
+        }
+    }
+
+    close(_fd);
+
+    return memBuff;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWSharedMem::getFd(MemBufferRef const & _buffer)
+{
+    IMemBufferOwner * owner = _buffer.getOwner();
+    return owner ? owner->getFd() : -1;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWSocketOutFrame::NWSocketOutFrame() :
+    mHeaderSize(0),
+    mMsgType(0),
+    mFlags(NWFRAME_FLAG_NONE),
+    mSize(0),
+    mVecs(NULL),
+    mNumVecs(0),
+    mPayloadReady(false),
+    mFd(-1),
+    mLzHeaderSize(0),
+    mLzState(0)
+{
+    mFdRef.mOffset = 0;
+    mFdRef.mSize = 0;
+}
+
+bool NWSocketOutFrame::build(int _msgType, NWIoVec const * _vecs, int _numVecs, int _flags/*=NWFRAME_FLAG_NONE*/)
+{
+    int size = 0;
+    for(int i=0; i<_numVecs; i++)
+    {
+        if(_vecs[i].mSize < 0 || (!_vecs[i].mPtr && _vecs[i].mSize > 0) || _vecs[i].mSize > NWFrameMaxSize - size)
+            return false;
+
+        size += _vecs[i].mSize;
+    }
+
+    NWIoVec * vecs = mLocalVecs;
+    if(_numVecs + 1 > NWSocketMaxIoVecs)
+    {
+        mMoreVecs.resize(_numVecs + 1);
+        vecs = &mMoreVecs[0];
+    }
+
+    mHeaderSize = NWFrame::writeHeader(mHeader, _msgType, _flags, size);
+    mMsgType = _msgType;
+    mFlags = _flags;
+    mSize = mHeaderSize + size;
+
+    vecs[0] = NWIoVec(mHeader, mHeaderSize);
+    for(int i=0; i<_numVecs; i++)
+    {
+        vecs[i + 1] = _vecs[i];
+    }
+
+    mVecs = vecs;
+    mNumVecs = _numVecs + 1;
+    mPayload = MemBufferRef();
+    mPayloadReady = false;
+    mFd = -1;
+    mShared = MemBufferRef();
+    mLzPayload = MemBufferRef();
+    mLzState = 0;
+
+    return true;
+}
+
+bool NWSocketOutFrame::build(int _msgType, MemBufferRef const & _payload)
+{
+    NWIoVec vec(_payload.getPtr(), _payload.getSize());
+
+    bool bRet = build(_msgType, &vec, 1);
+    if(bRet)
+    {
+        mPayload = _payload;
+        mPayloadReady = true;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// The receiver maps the same memory, it must not change once sent
+//----------------------------------------------------------------------------
+bool NWSocketOutFrame::buildShared(int _msgType, MemBufferRef const & _shared)
+{
+    int fd = NWSharedMem::getFd(_shared);
+    ASSERT(fd >= 0);
+
+    mFdRef.mOffset = _shared.getOffset();
+    mFdRef.mSize = _shared.getSize();
+    NWIoVec vec((unsigned char const *)&mFdRef, sizeof(mFdRef));
+
+    bool bRet = fd >= 0 && build(_msgType, &vec, 1, NWFRAME_FLAG_SHARED);
+    if(bRet)
+    {
+        mFd = fd;
+        mShared = _shared;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Gathered once, the first time a connection queues the frame
+//----------------------------------------------------------------------------
+MemBufferRef const & NWSocketOutFrame::getPayload()
+{
+    if(!mPayloadReady)
+    {
+        int size = mSize - mHeaderSize;
+        if(size > 0)
+        {
+            mPayload = MemBufferRef(size);
+
+            unsigned char * dst = mPayload.getPtr();
+            for(int i=1; i<mNumVecs; i++)
+            {
+                memcpy(dst, mVecs[i].mPtr, mVecs[i].mSize);
+                dst += mVecs[i].mSize;
+            }
+        }
+
+        mPayloadReady = true;
+    }
+
+    return mPayload;
+}
+
+//----------------------------------------------------------------------------
+// Made once, from the payload in one buffer. The block has to save at least
+// 1/NWSocketCompressMinGain of the payload, the compressor gives up as soon
+// as it can't.
+//----------------------------------------------------------------------------
+bool NWSocketOutFrame::compress()
+{
+    if(mLzState == 0)
+    {
+        mLzState = -1;
+
+        MemBufferRef const & payload = getPayload();
+        int size = payload.getSize();
+
+        if(size > 0 && mFd < 0 && (mFlags & (NWFRAME_FLAG_CONTROL | NWFRAME_FLAG_COMPRESSED)) == 0)
+        {
+            MemBufferRef buffer(size);
+            int sizeLen = NWFrame::writeVarint(buffer.getPtr(), (u32)size);
+            int room = size - size / NWSocketCompressMinGain - sizeLen;
+
+            int lzSize = room > 0 ? NWLz::compress(payload.getPtr(), size, buffer.getPtr() + sizeLen, room) : 0;
+            if(lzSize > 0)
+            {
+                mLzPayload = MemBufferRef(buffer, 0, sizeLen + lzSize);
+                mLzHeaderSize = NWFrame::writeHeader(mLzHeader, mMsgType, mFlags | NWFRAME_FLAG_COMPRESSED, mLzPayload.getSize());
+                mLzVecs[0] = NWIoVec(mLzHeader, mLzHeaderSize);
+                mLzVecs[1] = NWIoVec(mLzPayload.getPtr(), mLzPayload.getSize());
+                mLzState = 1;
+            }
+        }
+    }
+
+    return mLzState > 0;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWSocketConnection::NWSocketConnection(int _fd, int _clientId, MemBufferPool * _slabPool) :
+    mFd(_fd),
+    mClientId(_clientId),
+    mConnecting(false),
+    mFrameReader(_slabPool),
+    mQueuedBytes(0),
+    mSendQueueLow(NWSendQueueDefaultLow),
+    mSendQueueHigh(NWSendQueueDefaultHigh),
+    mSendQueuePolicy(NWSENDQUEUE_DISCONNECT),
+    mCompressMinSize(0),
+    mPeerCaps(NWFRAME_CAP_NONE),
+    mHelloSent(false)
+{
+    mCritSec = NWCriticalSection::create();
+}
+
+/*virtual*/ NWSocketConnection::~NWSocketConnection()
+{
+    ASSERT(mFd < 0);
+
+    for(int i=0; i<(int)mRecvFds.size(); i++)
+    {
+        close(mRecvFds[i]);
+    }
+    NWCriticalSection::destroy(mCritSec);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWSocketData::NWSocketData() :
+    mReactor(NULL),
+    mServer(NULL),
+    mListenFd(-1),
+    mLocal(false),
+    mConnected(false),
+    mSendQueueLow(NWSendQueueDefaultLow),
+    mSendQueueHigh(NWSendQueueDefaultHigh),
+    mSendQueuePolicy(NWSENDQUEUE_DISCONNECT),
+    mCompressMinSize(0),
+    mDispatch(NWSOCKET_DISPATCH_APPLICATION),
+    mDispatchNode(NULL),
+    mNextClientId(1),
+    mClientIdStep(1)
+{
+    mCritSec = NWCriticalSection::create();
+    mCloseCritSec = NWCriticalSection::create();
+    mRecvSlabs = MemBufferPool::create(NWFrameSlabSize, NWFrameSlabsMaxFree);
+}
+
+NWSocketData::~NWSocketData()
+{
+    NWSocketReactor::destroy(mReactor); // first, it can still use the listen socket
+
+    ASSERT(mConnections.empty());
+
+    mEvents.clear();
+    mDispatchEvents.clear();
+
+    if(mListenFd >= 0)
+        close(mListenFd);
+
+    if(!mLocalPath.empty())
+        unlink(mLocalPath.c_str());
+
+    MemBufferPool::destroy(mRecvSlabs); // the slabs still referenced by the application keep it alive
+    NWCriticalSection::destroy(mCloseCritSec);
+    NWCriticalSection::destroy(mCritSec);
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ NWSocketReactor * NWSocketReactor::create(int _backend, NWSocketData * _data)
+{
+    NWSocketReactor * pRet = NULL;
+
+    if(_backend == NWSOCKET_BACKEND_URING)
+    {
+        pRet = createUring(_data);
+        if(!pRet)
+        {
+            LOG("io_uring isn't available, the sockets use epoll");
+        }
+    }
+
+    if(!pRet)
+    {
+        pRet = createEpoll(_data);
+    }
+
+    return pRet;
+}
+
+/*static*/ void NWSocketReactor::destroy(NWSocketReactor* & _reactor)
+{
+    DISPOSE(_reactor);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWSocketReactor::NWSocketReactor(NWSocketData * _data) :
+    mData(_data)
+{
+}
+
+/*virtual*/ NWSocketReactor::~NWSocketReactor()
+{
+}
+
+//****************************************************************************
+// Application thread
+//****************************************************************************
+//----------------------------------------------------------------------------
+// The frame goes straight to the socket if nothing is queued before it.
+// Whatever the socket doesn't take is queued, the payload shared with the
+// other connections the frame goes to. The connections that compress send
+// its compressed form.
+//----------------------------------------------------------------------------
+bool NWSocketReactor::send(NWSocketConnection * _conn, NWSocketOutFrame & _frame)
+{
+    if(_conn->mFd < 0 || _conn->mConnecting)
+        return false;
+
+    bool bCompressed = _conn->mCompressMinSize > 0 && (_conn->mPeerCaps & NWFRAME_CAP_COMPRESSED) &&
+                       _frame.mSize - _frame.mHeaderSize >= _conn->mCompressMinSize && _frame.compress();
+
+    NWIoVec const * vecs = bCompressed ? _frame.mLzVecs : _frame.mVecs;
+    int numVecs = bCompressed ? 2 : _frame.mNumVecs;
+    int size = bCompressed ? _frame.mLzHeaderSize + _frame.mLzPayload.getSize() : _frame.mSize;
+
+    int sent = 0;
+    if(_conn->mSendQueue.empty())
+    {
+        sent = sendNow(_conn, vecs, numVecs, _frame.mFd);
+        if(sent < 0)
+            return false; // the reactor gets the error as well
+    }
+
+    NWSendQueueStats & stats = _conn->mSendStats;
+    stats.mSentBytes += sent;
+
+    if(sent == size)
+    {
+        stats.mSentMsgs++;
+    }
+    else
+    {
+        bool bWasEmpty = _conn->mSendQueue.empty();
+
+        _conn->mSendQueue.push_back(NWSocketSendMsg());
+
+        NWSocketSendMsg & msg = _conn->mSendQueue.back();
+        if(bCompressed)
+        {
+            memcpy(msg.mHeader, _frame.mLzHeader, _frame.mLzHeaderSize);
+            msg.mHeaderSize = _frame.mLzHeaderSize;
+            msg.mPayload = _frame.mLzPayload;
+        }
+        else
+        {
+            memcpy(msg.mHeader, _frame.mHeader, _frame.mHeaderSize);
+            msg.mHeaderSize = _frame.mHeaderSize;
+            msg.mPayload = _frame.getPayload();
+        }
+        msg.mMsgType = _frame.mMsgType;
+        msg.mSent = sent;
+        msg.mFd = -1;
+        if(sent == 0 && _frame.mFd >= 0)
+        {
+            msg.mFd = _frame.mFd;
+            msg.mShared = _frame.mShared;
+        }
+
+        _conn->mQueuedBytes += size - sent;
+        if(_conn->mQueuedBytes > stats.mPeakBytes)
+        {
+            stats.mPeakBytes = _conn->mQueuedBytes;
+        }
+
+        applySendQueuePolicy(_conn);
+
+        if(bWasEmpty)
+        {
+            queued(_conn);
+        }
+    }
+
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Closed by the reactor, which doesn't need the connection to be locked
+//----------------------------------------------------------------------------
+void NWSocketReactor::requestClose(int _clientId)
+{
+    {
+        NWAutoCritSec autoCS(mData->mCloseCritSec);
+        mData->mCloseRequests.push_back(_clientId);
+    }
+
+    wakeUp();
+}
+
+//----------------------------------------------------------------------------
+// Stamped just before it is sent, the round trip includes the time it waits
+// behind the messages already queued
+//----------------------------------------------------------------------------
+bool NWSocketReactor::ping(NWSocketConnection * _conn)
+{
+    u64 timeNs = NWTime::getTimeNs();
+    NWIoVec vec((unsigned char const *)&timeNs, sizeof(timeNs));
+
+    NWSocketOutFrame frame;
+    frame.build(NWFRAME_CONTROL_PING, &vec, 1, NWFRAME_FLAG_CONTROL);
+
+    return send(_conn, frame);
+}
+
+//----------------------------------------------------------------------------
+// The caps this side takes. The other side answers with its own, or already
+// sent them.
+//----------------------------------------------------------------------------
+bool NWSocketReactor::sendHello(NWSocketConnection * _conn)
+{
+    if(!_conn->mHelloSent)
+    {
+        unsigned char caps = NWFRAME_CAP_COMPRESSED;
+        NWIoVec vec(&caps, 1);
+
+        NWSocketOutFrame frame;
+        frame.build(NWFRAME_CONTROL_HELLO, &vec, 1, NWFRAME_FLAG_CONTROL);
+
+        _conn->mHelloSent = send(_conn, frame);
+    }
+
+    return _conn->mHelloSent;
+}
+
+//----------------------------------------------------------------------------
+// The backends that can send from the application thread override it
+//----------------------------------------------------------------------------
+/*virtual*/ int NWSocketReactor::sendNow(NWSocketConnection * /*_conn*/, NWIoVec const * /*_vecs*/, int /*_numVecs*/, int /*_fd*/)
+{
+    return 0;
+}
+
+/*virtual*/ void NWSocketReactor::queued(NWSocketConnection * /*_conn*/)
+{
+}
+
+//----------------------------------------------------------------------------
+// The newest message and the one the socket already started are kept
+//----------------------------------------------------------------------------
+void NWSocketReactor::applySendQueuePolicy(NWSocketConnection * _conn)
+{
+    NWSendQueueStats & stats = _conn->mSendStats;
+
+    if(_conn->mQueuedBytes > _conn->mSendQueueHigh && !stats.mSlow)
+    {
+        stats.mSlow = true;
+        stats.mSlowCount++;
+
+        if(_conn->mSendQueuePolicy == NWSENDQUEUE_DISCONNECT)
+        {
+            LOG("Client %d is too slow, %d bytes queued", _conn->mClientId, _conn->mQueuedBytes);
+            requestClose(_conn->mClientId);
+        }
+    }
+
+    if(!stats.mSlow || _conn->mSendQueuePolicy == NWSENDQUEUE_DISCONNECT)
+        return;
+
+    std::deque<NWSocketSendMsg> & queue = _conn->mSendQueue;
+
+    if(_conn->mSendQueuePolicy == NWSENDQUEUE_COALESCE)
+    {
+        int msgType = queue.back().mMsgType;
+        for(int i=(int)queue.size()-2; i>=0; i--)
+        {
+            if(queue[i].mSent == 0 && queue[i].mMsgType == msgType)
+            {
+                _conn->mQueuedBytes -= queue[i].getSize();
+                queue.erase(queue.begin() + i);
+                stats.mCoalescedMsgs++;
+            }
+        }
+    }
+
+    if(_conn->mQueuedBytes > _conn->mSendQueueHigh)
+    {
+        int i = 0;
+        while(i < (int)queue.size()-1 && _conn->mQueuedBytes > _conn->mSendQueueLow)
+        {
+            if(queue[i].mSent == 0)
+            {
+                _conn->mQueuedBytes -= queue[i].getSize();
+                queue.erase(queue.begin() + i);
+                stats.mDroppedMsgs++;
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+}
+
+//****************************************************************************
+// Reactor thread
+//****************************************************************************
+//----------------------------------------------------------------------------
+// The application is told once per batch, when the queue stops being empty.
+// It isn't when the reactor dispatches them itself.
+//----------------------------------------------------------------------------
+void NWSocketReactor::pushEvent(NWSocketEvent const & _event)
+{
+    bool bNotify = false;
+    {
+        NWAutoCritSec autoCS(mData->mCritSec);
+
+        bNotify = mData->mEvents.empty() && mData->mDispatch == NWSOCKET_DISPATCH_APPLICATION;
+        mData->mEvents.push_back(_event);
+    }
+
+    if(bNotify && NWCommManager::instance())
+    {
+        NWCommManager::instance()->sendNotification();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocketReactor::addConnection(NWSocketConnection * _conn)
+{
+    NWAutoCritSec autoCS(mData->mCritSec);
+    mData->mConnections[_conn->mClientId] = _conn;
+
+    _conn->mSendQueueLow = mData->mSendQueueLow;
+    _conn->mSendQueueHigh = mData->mSendQueueHigh;
+    _conn->mSendQueuePolicy = mData->mSendQueuePolicy;
+    _conn->mCompressMinSize = mData->mCompressMinSize;
+}
+
+//----------------------------------------------------------------------------
+// Server. A side that compresses says hello first.
+//----------------------------------------------------------------------------
+void NWSocketReactor::connectionAccepted(NWSocketConnection * _conn)
+{
+    {
+        NWAutoCritSec autoCS(_conn->mCritSec);
+        if(_conn->mCompressMinSize > 0)
+        {
+            sendHello(_conn);
+        }
+    }
+
+    pushEvent(NWSocketEvent(NWSocketEvent::EVENT_CONNECTED, _conn->mClientId));
+}
+
+//----------------------------------------------------------------------------
+// Client
+//----------------------------------------------------------------------------
+void NWSocketReactor::connectionEstablished(NWSocketConnection * _conn)
+{
+    {
+        NWAutoCritSec autoCS(_conn->mCritSec);
+        _conn->mConnecting = false;
+
+        if(_conn->mCompressMinSize > 0)
+        {
+            sendHello(_conn);
+        }
+    }
+    {
+        NWAutoCritSec autoCS(mData->mCritSec);
+        mData->mConnected = true;
+    }
+
+    pushEvent(NWSocketEvent(NWSocketEvent::EVENT_CONNECTED, _conn->mClientId));
+}
+
+//----------------------------------------------------------------------------
+// After this the application can't reach the connection, the backend closes
+// the returned fd and deletes the connection once it isn't in use
+//----------------------------------------------------------------------------
+int NWSocketReactor::detachConnection(NWSocketConnection * _conn, int _reason, bool _notify)
+{
+    int fd = -1;
+
+    if(_notify)
+    {
+        flushReadFrames(_conn); // the data goes before the disconnection
+    }
+
+    mData->mCritSec->enter();
+    {
+        mData->mConnections.erase(_conn->mClientId);
+        mData->mConnected = false;
+
+        NWAutoCritSec autoCS(_conn->mCritSec);
+        fd = _conn->mFd;
+        _conn->mFd = -1;
+    }
+    mData->mCritSec->leave();
+
+    if(_notify)
+    {
+        pushEvent(NWSocketEvent(NWSocketEvent::EVENT_DISCONNECTED, _conn->mClientId, _reason));
+    }
+
+    return fd;
+}
+
+//----------------------------------------------------------------------------
+// The frames read since the last flush are queued under a single lock
+//----------------------------------------------------------------------------
+void NWSocketReactor::flushReadFrames(NWSocketConnection * _conn)
+{
+    mFrames.clear();
+    _conn->mFrameReader.takeFrames(mFrames);
+
+    int num = 0;
+    for(int i=0; i<(int)mFrames.size(); i++)
+    {
+        if(processControlFrame(_conn, mFrames[i]))
+            continue;
+
+        if((mFrames[i].mFlags & NWFRAME_FLAG_SHARED) && !mapSharedFrame(_conn, mFrames[i]))
+            continue;
+
+        if((mFrames[i].mFlags & NWFRAME_FLAG_COMPRESSED) && !decompressFrame(_conn, mFrames[i]))
+            continue;
+
+        if(num != i)
+        {
+            mFrames[num] = mFrames[i];
+        }
+        num++;
+    }
+    mFrames.resize(num);
+
+    if(num > 0)
+    {
+        bool bNotify = false;
+        {
+            NWAutoCritSec autoCS(mData->mCritSec);
+
+            bNotify = mData->mEvents.empty() && mData->mDispatch == NWSOCKET_DISPATCH_APPLICATION;
+            for(int i=0; i<num; i++)
+            {
+                mData->mEvents.push_back(NWSocketEvent(NWSocketEvent::EVENT_DATA, _conn->mClientId));
+
+                NWSocketEvent & event = mData->mEvents.back();
+                event.mMsgType = mFrames[i].mMsgType;
+                event.mData = mFrames[i].mData;
+            }
+        }
+        mFrames.clear();
+
+        if(bNotify && NWCommManager::instance())
+        {
+            NWCommManager::instance()->sendNotification();
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// The servers that don't dispatch from the application thread do it here,
+// nothing of the reactor is locked meanwhile
+//----------------------------------------------------------------------------
+void NWSocketReactor::dispatchEvents()
+{
+    if(mData->mServer)
+    {
+        mData->mServer->dispatchEvents(mData, true);
+    }
+}
+
+//----------------------------------------------------------------------------
+// A ping is answered from here, so the round trip doesn't depend on the
+// application of the other side. The pong is timed by the read that
+// completed it. Unknown control frames are ignored.
+//----------------------------------------------------------------------------
+bool NWSocketReactor::processControlFrame(NWSocketConnection * _conn, sNWFrame const & _frame)
+{
+    if(!(_frame.mFlags & NWFRAME_FLAG_CONTROL))
+        return false;
+
+    if(_frame.mMsgType == NWFRAME_CONTROL_PING)
+    {
+        NWIoVec vec(_frame.mData.getPtr(), _frame.mData.getSize());
+
+        NWSocketOutFrame frame;
+        if(frame.build(NWFRAME_CONTROL_PONG, &vec, 1, NWFRAME_FLAG_CONTROL))
+        {
+            NWAutoCritSec autoCS(_conn->mCritSec);
+            send(_conn, frame);
+        }
+    }
+    else if(_frame.mMsgType == NWFRAME_CONTROL_PONG && _frame.mData.getSize() == sizeof(u64))
+    {
+        u64 sentNs = 0;
+        memcpy(&sentNs, _frame.mData.getPtr(), sizeof(sentNs));
+
+        u64 recvNs = _frame.mTimeNs ? _frame.mTimeNs : NWTime::getTimeNs();
+        if(recvNs >= sentNs)
+        {
+            NWSocketEvent event(NWSocketEvent::EVENT_PING, _conn->mClientId);
+            event.mRttNs = recvNs - sentNs;
+            pushEvent(event);
+        }
+    }
+    else if(_frame.mMsgType == NWFRAME_CONTROL_HELLO && _frame.mData.getSize() >= 1)
+    {
+        NWAutoCritSec autoCS(_conn->mCritSec);
+        _conn->mPeerCaps = _frame.mData.getPtr()[0];
+        sendHello(_conn);
+    }
+
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// The descriptor of a shared frame came with its first byte at the latest,
+// so it is the oldest one not taken yet. A frame without its memory is
+// dropped.
+//----------------------------------------------------------------------------
+bool NWSocketReactor::mapSharedFrame(NWSocketConnection * _conn, sNWFrame & _frame)
+{
+    bool bRet = false;
+
+    if(_conn->mRecvFds.empty())
+    {
+        LOG("Shared frame without its descriptor from client %d", _conn->mClientId);
+    }
+    else
+    {
+        int fd = _conn->mRecvFds.front();
+        _conn->mRecvFds.pop_front();
+
+        sNWFrameFdRef fdRef;
+        if(_frame.mData.getSize() == (int)sizeof(fdRef))
+        {
+            memcpy(&fdRef, _frame.mData.getPtr(), sizeof(fdRef));
+            _frame.mData = NWSharedMem::map(fd, fdRef.mOffset, fdRef.mSize);
+            bRet = _frame.mData.getSize() > 0;
+        }
+        else
+        {
+            close(fd);
+        }
+
+        if(!bRet)
+        {
+            LOG("Shared frame dropped from client %d", _conn->mClientId);
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Straight into a receive slab when it fits, as the frames read, a bigger
+// one gets its own buffer. A malformed frame is dropped.
+//----------------------------------------------------------------------------
+bool NWSocketReactor::decompressFrame(NWSocketConnection * _conn, sNWFrame & _frame)
+{
+    bool bRet = false;
+
+    unsigned char const * src = _frame.mData.getPtr();
+    int srcSize = _frame.mData.getSize();
+
+    u32 size = 0;
+    int sizeLen = NWFrame::readVarint(src, srcSize, size);
+
+    if(sizeLen > 0 && size > 0 && size <= NWFrameMaxSize)
+    {
+        MemBufferRef data;
+        if((int)size <= mData->mRecvSlabs->getBufferSize())
+        {
+            data = MemBufferRef(mData->mRecvSlabs->alloc(), 0, (int)size);
+        }
+        else
+        {
+            data = MemBufferRef((int)size);
+        }
+
+        if(NWLz::decompress(src + sizeLen, srcSize - sizeLen, data.getPtr(), (int)size) == (int)size)
+        {
+            _frame.mData = data;
+            bRet = true;
+        }
+    }
+
+    if(!bRet)
+    {
+        LOG("Bad compressed frame from client %d", _conn->mClientId);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSocketReactor::takeCloseRequests(std::vector<int> & out_clientIds)
+{
+    NWAutoCritSec autoCS(mData->mCloseCritSec);
+    out_clientIds.swap(mData->mCloseRequests);
+}
+
+//----------------------------------------------------------------------------
+// mConnections only changes in the reactor thread, no need to lock
+//----------------------------------------------------------------------------
+NWSocketConnection * NWSocketReactor::findConnection(int _clientId)
+{
+    std::map<int, NWSocketConnection *>::iterator it = mData->mConnections.find(_clientId);
+    return (it != mData->mConnections.end()) ? it->second : NULL;
+}
+
+//----------------------------------------------------------------------------
+// The header and the payload left of the first queued messages
+//----------------------------------------------------------------------------
+int NWSocketReactor::getQueuedVecs(NWSocketConnection * _conn, NWIoVec * out_vecs, int _maxVecs, int & out_fd)
+{
+    int iRet = 0;
+    out_fd = -1;
+
+    std::deque<NWSocketSendMsg>::const_iterator it = _conn->mSendQueue.begin();
+    for(; it != _conn->mSendQueue.end() && iRet + 2 <= _maxVecs; ++it)
+    {
+        if(it->mFd >= 0)
+        {
+            if(iRet > 0)
+                break; // its descriptor goes with its first byte, in a send of its own
+
+            out_fd = it->mFd;
+        }
+
+        int sent = it->mSent;
+        if(sent < it->mHeaderSize)
+        {
+            out_vecs[iRet++] = NWIoVec(it->mHeader + sent, it->mHeaderSize - sent);
+            sent = 0;
+        }
+        else
+        {
+            sent -= it->mHeaderSize;
+        }
+
+        int payloadSize = it->mPayload.getSize();
+        if(sent < payloadSize)
+        {
+            out_vecs[iRet++] = NWIoVec(it->mPayload.getPtr() + sent, payloadSize - sent);
+        }
+    }
+
+    return iRet;
+}
+
+//----------------------------------------------------------------------------
+// The connection stops being slow once the queue drains to the low watermark
+//----------------------------------------------------------------------------
+void NWSocketReactor::consumeQueued(NWSocketConnection * _conn, int _bytes)
+{
+    NWSendQueueStats & stats = _conn->mSendStats;
+    stats.mSentBytes += _bytes;
+    _conn->mQueuedBytes -= _bytes;
+
+    while(_bytes > 0)
+    {
+        NWSocketSendMsg & msg = _conn->mSendQueue.front();
+
+        int left = msg.getSize() - msg.mSent;
+        if(_bytes >= left)
+        {
+            _bytes -= left;
+            _conn->mSendQueue.pop_front();
+            stats.mSentMsgs++;
+        }
+        else
+        {
+            msg.mSent += _bytes;
+            _bytes = 0;
+
+            if(msg.mFd >= 0)
+            {
+                msg.mFd = -1; // the socket took it with the first byte
+                msg.mShared = MemBufferRef();
+            }
+        }
+    }
+
+    if(stats.mSlow && _conn->mQueuedBytes <= _conn->mSendQueueLow)
+    {
+        stats.mSlow = false;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWSocketReactor::copyQueued(NWSocketConnection * _conn, unsigned char * out_buffer, int _size)
+{
+    int iRet = 0;
+
+    NWIoVec vecs[NWSocketMaxIoVecs];
+    while(iRet < _size && !_conn->mSendQueue.empty())
+    {
+        int copied = 0;
+
+        int fd = -1;
+        int num = getQueuedVecs(_conn, vecs, NWSocketMaxIoVecs, fd);
+        ASSERT(fd < 0); // shared frames only go through epoll
+        for(int i=0; i<num && iRet + copied < _size; i++)
+        {
+            int size = vecs[i].mSize;
+            if(size > _size - iRet - copied)
+                size = _size - iRet - copied;
+
+            memcpy(out_buffer + iRet + copied, vecs[i].mPtr, size);
+            copied += size;
+        }
+
+        consumeQueued(_conn, copied);
+        iRet += copied;
+    }
+
+    return iRet;
+}
@@ -0,0 +1,311 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_SOCKET_REACTOR_LINUX_H_
+#define _INCREW_SOCKET_REACTOR_LINUX_H_
+
+#include "NWCommSocket.h"
+#include "NWCommFrame.h"
+#include "NWIoVec.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+
+class NWCriticalSection;
+class NWEventPosix;
+class NWSocketReactor;
+class CommNode;
+
+//****************************************************************************
+// Linux socket internals shared by NWCommSocket_Linux.cpp and the reactor
+// backends (epoll, io_uring)
+//****************************************************************************
+enum eNWSocketLinuxDefs
+{
+    NWSocketLocalShareMinSize = 64*1024,    // bigger payloads go to local peers as a memfd
+    NWSocketCompressMinGain = 8,            // a compressed payload saves 1/8 of it at least
+    NWSocketMaxRecvFds = 4                  // descriptors a read can get, a sender passes one per sendmsg
+};
+
+//----------------------------------------------------------------------------
+// Memory local peers pass as a descriptor (memfd, SCM_RIGHTS) instead of
+// sending its bytes. Sealed, so the receiver can trust its size.
+//----------------------------------------------------------------------------
+namespace NWSharedMem
+{
+    MemBufferRef alloc(int _size);                          // mapped for writing, empty if it fails
+    MemBufferRef map(int _fd, int _offset, int _size);      // read only view of a received one, takes _fd, empty if it isn't valid
+    int getFd(MemBufferRef const & _buffer);                // -1 if it isn't shared memory
+}
+
+//----------------------------------------------------------------------------
+// A frame to send : the header followed by the pieces of the payload. It is
+// built once for every connection it goes to. The payload is only copied if
+// a connection has to queue it, and then once for all of them. A shared
+// frame only sends a sNWFrameFdRef, the memory goes with mFd. The
+// compressed form is made once as well, for the connections that take it.
+//----------------------------------------------------------------------------
+struct NWSocketOutFrame
+{
+    unsigned char mHeader[NWFrameMaxHeaderSize];
+    int mHeaderSize;
+    int mMsgType;
+    int mFlags;
+    int mSize;                          // header and payload
+    NWIoVec mLocalVecs[NWSocketMaxIoVecs];
+    std::vector<NWIoVec> mMoreVecs;     // when mLocalVecs is short
+    NWIoVec const * mVecs;              // the header is the first one
+    int mNumVecs;
+    MemBufferRef mPayload;              // see getPayload
+    bool mPayloadReady;
+    sNWFrameFdRef mFdRef;               // shared frame
+    int mFd;                            // -1 if it isn't a shared frame
+    MemBufferRef mShared;               // keeps mFd open
+
+    unsigned char mLzHeader[NWFrameMaxHeaderSize];
+    int mLzHeaderSize;
+    MemBufferRef mLzPayload;            // see compress
+    NWIoVec mLzVecs[2];
+    int mLzState;                       // 0 not tried yet, 1 compressed, -1 it doesn't pay
+
+    NWSocketOutFrame();
+
+    bool build(int _msgType, NWIoVec const * _vecs, int _numVecs, int _flags=NWFRAME_FLAG_NONE); // false if the payload isn't valid
+    bool build(int _msgType, MemBufferRef const & _payload);        // shares it with the send queues
+    bool buildShared(int _msgType, MemBufferRef const & _shared);   // NWSharedMem memory
+    MemBufferRef const & getPayload();                              // the payload in one buffer, for the send queues
+    bool compress();                                                // false if it can't be compressed or it doesn't pay
+};
+
+//----------------------------------------------------------------------------
+// A frame waiting in the send queue of a connection, the payload is shared
+// with the other connections it was sent to
+//----------------------------------------------------------------------------
+struct NWSocketSendMsg
+{
+    unsigned char mHeader[NWFrameMaxHeaderSize];
+    int mHeaderSize;
+    int mMsgType;
+    MemBufferRef mPayload;
+    int mSent;          // bytes of the header and the payload already taken
+    int mFd;            // goes with the first byte, -1 once sent
+    MemBufferRef mShared;
+
+    inline int getSize() const;
+};
+
+inline int NWSocketSendMsg::getSize() const
+{
+    return mHeaderSize + mPayload.getSize();
+}
+
+//----------------------------------------------------------------------------
+// mCritSec guards mFd, mConnecting and the send queue, the rest is only used
+// by the reactor thread. The backends extend it.
+//----------------------------------------------------------------------------
+struct NWSocketConnection
+{
+    int mFd;
+    int mClientId;
+    bool mConnecting;   // client, until the connect completes
+    NWCriticalSection * mCritSec;
+    NWFrameReader mFrameReader;     // frames read by the reactor, not dispatched yet
+
+    std::deque<NWSocketSendMsg> mSendQueue; // what the socket didn't take yet
+    int mQueuedBytes;
+    int mSendQueueLow;                      // see NWSocket::setSendQueueLimits
+    int mSendQueueHigh;
+    int mSendQueuePolicy;                   // eNWSendQueuePolicy
+    NWSendQueueStats mSendStats;            // mQueuedMsgs and mQueuedBytes are filled when they are asked for
+
+    std::deque<int> mRecvFds;               // received with the stream, taken in order by its shared frames
+
+    int mCompressMinSize;                   // see NWSocket::setCompression
+    int mPeerCaps;                          // eNWFrameCaps, from the hello of the other side
+    bool mHelloSent;
+
+    NWSocketConnection(int _fd, int _clientId, MemBufferPool * _slabPool);
+    virtual ~NWSocketConnection();
+};
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+struct NWSocketEvent
+{
+    enum eType
+    {
+        EVENT_CONNECTED = 0,
+        EVENT_DISCONNECTED,
+        EVENT_DATA,
+        EVENT_PING
+    };
+
+    int mType;
+    int mClientId;
+    int mReason;            // eNWSocketDisconnectReason
+    int mMsgType;           // data
+    MemBufferRef mData;     // data, a view of a receive slab
+    u64 mRttNs;             // ping
+
+    inline NWSocketEvent(int _type, int _clientId, int _reason=NWSOCKET_DISCONNECT_CLOSED);
+};
+
+inline NWSocketEvent::NWSocketEvent(int _type, int _clientId, int _reason/*=NWSOCKET_DISCONNECT_CLOSED*/) :
+    mType(_type),
+    mClientId(_clientId),
+    mReason(_reason),
+    mMsgType(0),
+    mRttNs(0)
+{
+}
+
+//----------------------------------------------------------------------------
+// mCritSec guards the containers the application thread shares with the
+// reactor, the send queue limits and the dispatch mode. mConnections is only
+// changed by the reactor. mCloseCritSec is taken with a connection locked,
+// so it only guards mCloseRequests. A server has one for each reactor
+// thread, their client ids interleave.
+//----------------------------------------------------------------------------
+struct NWSocketData
+{
+    NWSocketReactor * mReactor;
+    NWServerSocket * mServer;           // NULL for the clients
+    int mListenFd;
+    bool mLocal;                        // AF_UNIX, always epoll
+    std::string mLocalPath;             // unlinked with the socket
+    NWCriticalSection * mCritSec;
+    NWCriticalSection * mCloseCritSec;
+    MemBufferPool * mRecvSlabs;         // NWFrameReader slabs of every connection
+
+    std::map<int, NWSocketConnection *> mConnections;
+    std::deque<NWSocketEvent> mEvents;
+    std::deque<NWSocketEvent> mDispatchEvents;  // dispatching thread, swapped with mEvents
+    std::vector<int> mCloseRequests;
+    bool mConnected;                    // client
+
+    int mSendQueueLow;                  // given to the new connections
+    int mSendQueueHigh;
+    int mSendQueuePolicy;
+    int mCompressMinSize;
+
+    int mDispatch;                      // eNWSocketDispatch
+    CommNode * mDispatchNode;           // channel mode
+
+    int mNextClientId;                  // reactor thread
+    int mClientIdStep;                  // the reactors of the server
+    std::set<int> mRefusedClients;      // dispatching thread
+
+    NWSocketData();
+    ~NWSocketData();
+
+    inline int newClientId();
+};
+
+inline int NWSocketData::newClientId()
+{
+    int iRet = mNextClientId;
+    mNextClientId += mClientIdStep;
+    return iRet;
+}
+
+//****************************************************************************
+// The I/O engine of a socket. run() is the socket thread, the rest is called
+// from the application thread.
+//****************************************************************************
+class NWSocketReactor
+{
+public:
+    static NWSocketReactor * create(int _backend, NWSocketData * _data); // eNWSocketBackend, falls back to epoll
+    static void destroy(NWSocketReactor* & _reactor);
+
+    virtual bool listen(int _fd) = 0;                                   // before the thread starts
+    virtual bool connect(int _fd, sockaddr const * _addr, int _addrLen) = 0; // before the thread starts, the connection is the id 0
+    virtual void wakeUp() = 0;                                          // close requests are waiting
+
+    bool send(NWSocketConnection * _conn, NWSocketOutFrame & _frame);   // with the connection locked, sends it or queues it
+    void requestClose(int _clientId);
+    bool ping(NWSocketConnection * _conn);                              // with the connection locked
+    bool sendHello(NWSocketConnection * _conn);                         // with the connection locked, once
+
+    virtual unsigned int run(ThreadParams const * _threadParams) = 0;
+
+protected:
+    NWSocketData * mData;
+    std::vector<sNWFrame> mFrames;     // flushReadFrames
+
+    NWSocketReactor(NWSocketData * _data);
+    virtual ~NWSocketReactor();
+
+    // application thread, with the connection locked
+    virtual int sendNow(NWSocketConnection * _conn, NWIoVec const * _vecs, int _numVecs, int _fd); // bytes taken by the socket, -1 on error
+    virtual void queued(NWSocketConnection * _conn);                    // the send queue was empty
+    void applySendQueuePolicy(NWSocketConnection * _conn);
+
+    // reactor thread
+    void pushEvent(NWSocketEvent const & _event);
+    void addConnection(NWSocketConnection * _conn);
+    void connectionAccepted(NWSocketConnection * _conn);
+    void connectionEstablished(NWSocketConnection * _conn);
+    int detachConnection(NWSocketConnection * _conn, int _reason, bool _notify); // returns the fd to close
+    void flushReadFrames(NWSocketConnection * _conn);
+    void dispatchEvents();                                              // end of every wait
+    bool processControlFrame(NWSocketConnection * _conn, sNWFrame const & _frame); // false if it isn't a control frame
+    bool mapSharedFrame(NWSocketConnection * _conn, sNWFrame & _frame); // false if its memory can't be mapped
+    bool decompressFrame(NWSocketConnection * _conn, sNWFrame & _frame); // false if it is malformed
+    void takeCloseRequests(std::vector<int> & out_clientIds);
+    NWSocketConnection * findConnection(int _clientId);
+
+    // reactor thread, with the connection locked
+    int getQueuedVecs(NWSocketConnection * _conn, NWIoVec * out_vecs, int _maxVecs, int & out_fd);
+    void consumeQueued(NWSocketConnection * _conn, int _bytes);
+    int copyQueued(NWSocketConnection * _conn, unsigned char * out_buffer, int _size); // returns the bytes copied
+
+    static NWSocketReactor * createEpoll(NWSocketData * _data);
+    static NWSocketReactor * createUring(NWSocketData * _data);
+};
+
+#endif // _INCREW_SOCKET_REACTOR_LINUX_H_
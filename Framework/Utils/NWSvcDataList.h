@@ -101,7 +101,7 @@ protected:
     virtual void serializeOut(MemorySerializerOut & _serializerOut) const;
 
     virtual void NotifyEvent(int _eventType, int _updatedElementIndex, int _objUniqueId);
-    virtual void receiveEventMsg(int _eventType, MemBufferRef * _eventData);
+    virtual void receiveEventMsg(int _eventType, MemBufferRef const * _eventData);
 
 private:
     typedef NWSvcDataObject Inherited;
@@ -625,7 +625,7 @@ template <class T>
 //
 //----------------------------------------------------------------------------
 template <class T>
-/*virtual*/ void NWSvcDataList<T>::receiveEventMsg(int _eventType, MemBufferRef * _eventData)
+/*virtual*/ void NWSvcDataList<T>::receiveEventMsg(int _eventType, MemBufferRef const * _eventData)
 {
     MemorySerializerIn serializerIn;
     serializerIn.setBuffer(_eventData->getPtr(), _eventData->getSize());
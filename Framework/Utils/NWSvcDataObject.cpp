@@ -301,7 +301,7 @@ NWSvcDataEventHandler::NWSvcDataEventHandler() : NWSvcDataBase()
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
-/*virtual*/ void NWSvcDataEventHandler::receiveEventMsg(int _eventType, MemBufferRef * _eventData)
+/*virtual*/ void NWSvcDataEventHandler::receiveEventMsg(int _eventType, MemBufferRef const * _eventData)
 {
     int num = (int)mNotificationCallbackList.size();
     for (int i=0; i<num; i++)
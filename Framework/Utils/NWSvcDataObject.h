@@ -628,7 +628,7 @@ public:
 //****************************************************************************
 struct NWSvcDataEventNotificationCallback
 {
-    virtual void receiveEventMsg(int _eventType, MemBufferRef * _eventData)=0;
+    virtual void receiveEventMsg(int _eventType, MemBufferRef const * _eventData)=0;
 };
 
 //----------------------------------------------------------------------------
@@ -647,7 +647,7 @@ public:
     virtual void removeNotificationCallback(NWSvcDataEventNotificationCallback * _callback);
 
     virtual void sendEvent(NWSvcDataEvent * _event);
-    virtual void receiveEventMsg(int _eventType, MemBufferRef * _eventData);
+    virtual void receiveEventMsg(int _eventType, MemBufferRef const * _eventData);
 
 protected:
 
@@ -53,6 +53,7 @@
 #include "NWCliSrvMsgs.h"
 
 #include "CommNode.h"
+#include "MsgMgr.h"
 
 #include <string>
 #include <list>
@@ -99,7 +100,11 @@ bool NWSvcDataServer::init(const char * _name, CommNodeId _commId)
             mCommNode->setReceiveAllMessages(true);
             mCommNode->addToNotificationList();
             mCommNode->joinChannel(SERVER_DATA_SERVICE_CHANNEL);
-            mCommNode->addMessageReceiverCallback(this);
+            MsgMgr::instance()->setChannelConflation(MsgMgr::instance()->getChannelId(SERVER_DATA_SERVICE_CHANNEL), true); // object values, only the latest matters
+            mCommNode->on<MsgClientUpdateReq>(this, &NWSvcDataServer::onClientUpdateReq);
+            mCommNode->on<MsgServerUpdateClient>(this, &NWSvcDataServer::onServerUpdateClient);
+            mCommNode->on<MsgClientSetValue>(this, &NWSvcDataServer::onClientSetValue);
+            mCommNode->on<MsgSvcEvent>(this, &NWSvcDataServer::onSvcEvent);
         }
         
         mInitd = true;
@@ -276,113 +281,93 @@ void NWSvcDataServer::updateObj(NWSvcDataObject * _obj, MemorySerializerIn & _da
 //****************************************************************************
 //
 //****************************************************************************
-/*virtual*/ void NWSvcDataServer::receiveMessage(CommNodeId _from, int _msgFamily, int _msgType, void * _msg, int _msgSize)
+void NWSvcDataServer::onClientUpdateReq(CommNodeId _from, MsgClientUpdateReq const & _msg) // Cli->Svr : A client wants be updated
 {
-    if(_msgFamily == MsgFamily_CliSrvDataService)
+    NWSvcDataContext * context = findContext(_msg.mContext);
+    if(context)
     {
-        switch(_msgType)
+        NWSvcDataContext::HashObjectsItRange itr = context->findObjects(_msg.mObjName.c_str());
+        for(NWSvcDataContext::HashObjectsIt it = itr.first; it != itr.second; ++it)
         {
-            case MsgType_MsgClientUpdateReq: // Cli->Svr : A client wants be updated
+            NWSvcDataObject * obj = it->second;
+            if(obj && obj->isServer())
             {
-                MsgClientUpdateReq * msg = (MsgClientUpdateReq *)_msg;
-                if(msg)
-                {
-                    NWSvcDataContext * context = findContext(msg->mContext);
-                    if(context)
-                    {
-                        NWSvcDataContext::HashObjectsItRange itr = context->findObjects(msg->mObjName.c_str());
-                        for(NWSvcDataContext::HashObjectsIt it = itr.first; it != itr.second; ++it)
-                        {
-                            NWSvcDataObject * obj = it->second;
-                            if(obj && obj->isServer())
-                            {
-                                ASSERT(strcmp(obj->getContextName(),msg->mContext.c_str()) == 0);
-                                ASSERT(strcmp(obj->getObjName(),msg->mObjName.c_str()) == 0);
-                                updateClients(obj);
-                            }
-                        }
-                    }
-                }
-                break;
+                ASSERT(strcmp(obj->getContextName(),_msg.mContext.c_str()) == 0);
+                ASSERT(strcmp(obj->getObjName(),_msg.mObjName.c_str()) == 0);
+                updateClients(obj);
             }
+        }
+    }
+}
 
-            case MsgType_MsgServerUpdateClient: // Srv->Cli : Server answer to update client
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSvcDataServer::onServerUpdateClient(CommNodeId _from, MsgServerUpdateClient const & _msg) // Srv->Cli : Server answer to update client
+{
+    NWSvcDataContext * context = findContext(_msg.mContext);
+    if(context)
+    {
+        NWSvcDataContext::HashObjectsItRange itr = context->findObjects(_msg.mObjName.c_str());
+        for(NWSvcDataContext::HashObjectsIt it = itr.first; it != itr.second; ++it)
+        {
+            NWSvcDataObject * obj = it->second;
+            if(obj && !obj->isServer())
             {
-                MsgServerUpdateClient * msg = (MsgServerUpdateClient *)_msg;
-                if(msg)
-                {
-                    NWSvcDataContext * context = findContext(msg->mContext);
-                    if(context)
-                    {
-                        NWSvcDataContext::HashObjectsItRange itr = context->findObjects(msg->mObjName.c_str());
-                        for(NWSvcDataContext::HashObjectsIt it = itr.first; it != itr.second; ++it)
-                        {
-                            NWSvcDataObject * obj = it->second;
-                            if(obj && !obj->isServer())
-                            {
-                                ASSERT(strcmp(obj->getContextName(),msg->mContext.c_str()) == 0);
-                                ASSERT(strcmp(obj->getObjName(),msg->mObjName.c_str()) == 0);
-                                MemorySerializerIn serializerIn;
-                                serializerIn.setBuffer(msg->mMemBuffer.getPtr(), msg->mMemBuffer.getSize());
-
-                                updateObj(obj, serializerIn);
-                            }
-                        }
-                    }
-                }
-                break;
+                ASSERT(strcmp(obj->getContextName(),_msg.mContext.c_str()) == 0);
+                ASSERT(strcmp(obj->getObjName(),_msg.mObjName.c_str()) == 0);
+                MemorySerializerIn serializerIn;
+                serializerIn.setBuffer(_msg.mMemBuffer.getPtr(), _msg.mMemBuffer.getSize());
+
+                updateObj(obj, serializerIn);
             }
+        }
+    }
+}
 
-            case MsgType_MsgClientSetValue: // Cli->Srv : Client wants set a value
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSvcDataServer::onClientSetValue(CommNodeId _from, MsgClientSetValue const & _msg) // Cli->Srv : Client wants set a value
+{
+    NWSvcDataContext * context = findContext(_msg.mContext);
+    if(context)
+    {
+        NWSvcDataContext::HashObjectsItRange itr = context->findObjects(_msg.mObjName.c_str());
+        for(NWSvcDataContext::HashObjectsIt it = itr.first; it != itr.second; ++it)
+        {
+            NWSvcDataObject * obj = it->second;
+            if(obj && obj->isServer())
             {
-                MsgClientSetValue * msg = (MsgClientSetValue *)_msg;
-                if(msg)
-                {
-                    NWSvcDataContext * context = findContext(msg->mContext);
-                    if(context)
-                    {
-                        NWSvcDataContext::HashObjectsItRange itr = context->findObjects(msg->mObjName.c_str());
-                        for(NWSvcDataContext::HashObjectsIt it = itr.first; it != itr.second; ++it)
-                        {
-                            NWSvcDataObject * obj = it->second;
-                            if(obj && obj->isServer())
-                            {
-                                ASSERT(strcmp(obj->getContextName(),msg->mContext.c_str()) == 0);
-                                ASSERT(strcmp(obj->getObjName(),msg->mObjName.c_str()) == 0);
-                                MemorySerializerIn serializerIn;
-                                serializerIn.setBuffer(msg->mMemBuffer.getPtr(), msg->mMemBuffer.getSize());
-
-                                updateObj(obj, serializerIn);
-                            }
-                        }
-                    }
-                }
-                break;
+                ASSERT(strcmp(obj->getContextName(),_msg.mContext.c_str()) == 0);
+                ASSERT(strcmp(obj->getObjName(),_msg.mObjName.c_str()) == 0);
+                MemorySerializerIn serializerIn;
+                serializerIn.setBuffer(_msg.mMemBuffer.getPtr(), _msg.mMemBuffer.getSize());
+
+                updateObj(obj, serializerIn);
             }
+        }
+    }
+}
 
-            case MsgType_MsgSvcEvent:
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWSvcDataServer::onSvcEvent(CommNodeId _from, MsgSvcEvent const & _msg)
+{
+    NWSvcDataContext * context = findContext(_msg.mContext);
+    if(context)
+    {
+        NWSvcDataContext::HashEventHandlersItRange itr = context->findEventHandlers(_msg.mObjName.c_str());
+        for(NWSvcDataContext::HashEventHandlersIt it = itr.first; it != itr.second; ++it)
+        {
+            NWSvcDataEventHandler * eventHandler = it->second;
+            if(eventHandler && ((eventHandler->isServer() && _msg.mServerMsg) || (!eventHandler->isServer() && !_msg.mServerMsg)))
             {
-                MsgSvcEvent * msg = (MsgSvcEvent*)_msg;
-                if(msg)
-                {
-                    NWSvcDataContext * context = findContext(msg->mContext);
-                    if(context)
-                    {
-                        NWSvcDataContext::HashEventHandlersItRange itr = context->findEventHandlers(msg->mObjName.c_str());
-                        for(NWSvcDataContext::HashEventHandlersIt it = itr.first; it != itr.second; ++it)
-                        {
-                            NWSvcDataEventHandler * eventHandler = it->second;
-                            if(eventHandler && ((eventHandler->isServer() && msg->mServerMsg) || (!eventHandler->isServer() && !msg->mServerMsg)))
-                            {
-                                ASSERT(strcmp(eventHandler->getContextName(),msg->mContext.c_str()) == 0);
-                                ASSERT(strcmp(eventHandler->getObjName(),msg->mObjName.c_str()) == 0);
-                                eventHandler->receiveEventMsg(msg->mEventType, &msg->mMemBuffer);
-                            }
-                        }
-                    }
-                }
-                break;
-            };
+                ASSERT(strcmp(eventHandler->getContextName(),_msg.mContext.c_str()) == 0);
+                ASSERT(strcmp(eventHandler->getObjName(),_msg.mObjName.c_str()) == 0);
+                eventHandler->receiveEventMsg(_msg.mEventType, &_msg.mMemBuffer);
+            }
         }
     }
 }
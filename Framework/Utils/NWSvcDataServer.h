@@ -55,6 +55,10 @@ class MemorySerializerOut;
 class NWSvcDataContext;
 class NWSvcDataEvent;
 class MemBufferRef;
+struct MsgClientUpdateReq;
+struct MsgServerUpdateClient;
+struct MsgClientSetValue;
+struct MsgSvcEvent;
 
 //****************************************************************************
 //
@@ -66,7 +70,7 @@ typedef NWSvcDataEvent * (*EventCreationFn)();
 //****************************************************************************
 //
 //****************************************************************************
-class NWSvcDataServer : public MsgReceiverCallback
+class NWSvcDataServer
 {
 public:
     NWSvcDataServer();
@@ -88,8 +92,6 @@ public:
     void sendSetValue(NWSvcDataObject * _clientObj, MemorySerializerOut & _data);
     void updateObj(NWSvcDataObject * _obj, MemorySerializerIn & _data);
 
-    virtual void receiveMessage(CommNodeId _from, int _msgFamily, int _msgType, void * _msg, int _msgSize);
-
 private:
     bool mInitd;
     std::map<std::string, NWSvcDataContext> mHashContext;
@@ -97,6 +99,12 @@ private:
     CommNode * mCommNode;
 
     NWSvcDataContext * findContext(std::string _contextName);
+
+    // CommNode typed handlers
+    void onClientUpdateReq(CommNodeId _from, MsgClientUpdateReq const & _msg);
+    void onServerUpdateClient(CommNodeId _from, MsgServerUpdateClient const & _msg);
+    void onClientSetValue(CommNodeId _from, MsgClientSetValue const & _msg);
+    void onSvcEvent(CommNodeId _from, MsgSvcEvent const & _msg);
 };
 
 #endif // NW_SVC_DATA_SERVER_H
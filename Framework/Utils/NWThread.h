@@ -45,6 +45,12 @@ class NWEvent;
 class NWThreadFn;
 class NWThreadInstance;
 
+#if defined(_MSC_VER)
+    #define NWTHREAD_ENTRY __stdcall
+#else
+    #define NWTHREAD_ENTRY
+#endif
+
 //----------------------------------------------------------------------------
 //
 //----------------------------------------------------------------------------
@@ -68,7 +74,7 @@ protected:
     virtual unsigned int threadMain(ThreadParams const * _threadParams) = 0;
 
 private:
-    static unsigned int __stdcall threadEntryPoint(void * _params);
+    static unsigned int NWTHREAD_ENTRY threadEntryPoint(void * _params);
     friend class NWThreadInstance;
 };
 
@@ -105,6 +111,8 @@ public:
     static NWThread * create();
     static void destroy(NWThread* & _thread);
 
+    static void yield(); // the calling thread gives up the rest of its time slice
+
 private:
     NWThreadInstance * mNWThreadInstance;
 
@@ -0,0 +1,104 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWTime.h"
+
+#include <windows.h>
+
+//********************************************************************
+//
+//********************************************************************
+namespace NWTime
+{
+
+//--------------------------------------------------------------------
+//
+//--------------------------------------------------------------------
+static u64 getFrequency()
+{
+    static u64 sFrequency = 0;
+
+    if(sFrequency == 0)
+    {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        sFrequency = (u64)frequency.QuadPart;
+    }
+
+    return sFrequency;
+}
+
+//--------------------------------------------------------------------
+//
+//--------------------------------------------------------------------
+u64 getTimeMs()
+{
+    return getTimeNs() / 1000000;
+}
+
+//--------------------------------------------------------------------
+//
+//--------------------------------------------------------------------
+u64 getTimeUs()
+{
+    return getTimeNs() / 1000;
+}
+
+//--------------------------------------------------------------------
+//
+//--------------------------------------------------------------------
+u64 getTimeNs()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    u64 frequency = getFrequency();
+    u64 ticks = (u64)counter.QuadPart;
+
+    // split to avoid overflowing ticks * 1e9
+    u64 seconds = ticks / frequency;
+    u64 remainder = ticks % frequency;
+
+    return seconds * 1000000000 + (remainder * 1000000000) / frequency;
+}
+
+} // NWTime
@@ -0,0 +1,998 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchUtils.h"
+
+#include "NWTimerService.h"
+
+#include "NWTime.h"
+#include "NWEvent.h"
+#include "NWMultipleEvents.h"
+#include "NWCriticalSection.h"
+
+#include <string.h>
+
+//****************************************************************************
+//
+//****************************************************************************
+static const u32 NODE_BLOCK_BITS = 10;
+static const u32 NODE_BLOCK_SIZE = 1 << NODE_BLOCK_BITS;
+static const u32 NODE_BLOCK_MASK = NODE_BLOCK_SIZE - 1;
+
+static const u32 TIMER_ID_INDEX_MASK = 0x00ffffff; // index + 1, 0 is reserved for InvalidTimerId
+static const u32 TIMER_ID_GENERATION_SHIFT = 24;
+static const u32 TIMER_ID_GENERATION_MASK = 0xff;
+
+static const u32 INVALID_NODE_INDEX = 0xffffffff;
+
+static const u64 MAX_TIMER_TICKS = 0xffffffff; // farthest expiration the wheel can hold
+
+static const int FIRED_LIST_RESERVE = 256;
+static const int QUEUE_LIST_RESERVE = 64;
+
+//****************************************************************************
+//
+//****************************************************************************
+enum eNWTimerNodeState
+{
+    NWTNS_FREE = 0,
+    NWTNS_PENDING,  // linked in the wheel
+    NWTNS_FIRED     // one shot timer expired, callback not delivered yet
+};
+
+struct NWTimerNode : public DLink<NWTimerNode>
+{
+    u64 mExpireTick;
+    u32 mPeriodTicks;
+    NWTimerCallback * mCallback;
+    void * mUserData;
+    NWTimerQueue * mQueue;
+    NWTimerNode * mQueuePrev; // timers of mQueue
+    NWTimerNode * mQueueNext;
+    u32 mIndex;
+    u32 mGeneration;
+    u32 mNextFree;
+    u8 mState;
+    u8 mLevel;
+    u16 mSlot;
+
+    NWTimerNode();
+
+    inline NWTimerId getTimerId() const;
+};
+
+NWTimerNode::NWTimerNode() :
+    mExpireTick(0),
+    mPeriodTicks(0),
+    mCallback(NULL),
+    mUserData(NULL),
+    mQueue(NULL),
+    mQueuePrev(NULL),
+    mQueueNext(NULL),
+    mIndex(0),
+    mGeneration(0),
+    mNextFree(INVALID_NODE_INDEX),
+    mState(NWTNS_FREE),
+    mLevel(0),
+    mSlot(0)
+{
+}
+
+inline NWTimerId NWTimerNode::getTimerId() const
+{
+    return ((mGeneration & TIMER_ID_GENERATION_MASK) << TIMER_ID_GENERATION_SHIFT) | (mIndex + 1);
+}
+
+//****************************************************************************
+// NWTimerQueue
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWTimerQueue::NWTimerQueue() :
+    mInitd(false),
+    mCritSec(NULL),
+    mEventTimersAvailable(NULL),
+    mNotificationCallback(NULL),
+    mTimers(NULL)
+{
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWTimerQueue::~NWTimerQueue()
+{
+    done();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWTimerQueue::init(NWEvent * _eventTimersAvailable, NWTimerNotificationCallback * _notificationCallback/*=NULL*/)
+{
+    bool bRet = false;
+
+    if(!mInitd)
+    {
+        mCritSec = NWCriticalSection::create();
+        mEventTimersAvailable = _eventTimersAvailable;
+        mNotificationCallback = _notificationCallback;
+
+        mPendingList.reserve(QUEUE_LIST_RESERVE);
+        mDispatchList.reserve(QUEUE_LIST_RESERVE);
+
+        mInitd = true;
+        bRet = true;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWTimerQueue::done()
+{
+    if(mInitd)
+    {
+        if(NWTimerService::instance())
+        {
+            NWTimerService::instance()->removeQueueTimers(this);
+        }
+
+        mPendingList.clear();
+        mDispatchList.clear();
+
+        NWCriticalSection::destroy(mCritSec);
+        mEventTimersAvailable = NULL;
+        mNotificationCallback = NULL;
+
+        mInitd = false;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWTimerQueue::timersAvailable()
+{
+    bool bRet = false;
+
+    if(mInitd)
+    {
+        NWAutoCritSec critSec(mCritSec);
+
+        bRet = !mPendingList.empty();
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Invokes the expired timers on the calling thread
+//----------------------------------------------------------------------------
+void NWTimerQueue::dispatchExpiredTimers()
+{
+    if(mInitd)
+    {
+        {
+            NWAutoCritSec critSec(mCritSec);
+
+            mDispatchList.swap(mPendingList);
+        }
+
+        NWTimerService * timerService = NWTimerService::instance();
+
+        int num = (int)mDispatchList.size();
+        for(int i=0; i<num; i++)
+        {
+            ExpiredTimer & expiredTimer = mDispatchList[i];
+
+            if(timerService && timerService->beginTimerCallback(expiredTimer.mTimerId)) // could be removed after expiring
+            {
+                expiredTimer.mCallback->onTimer(expiredTimer.mTimerId, expiredTimer.mUserData);
+            }
+        }
+
+        mDispatchList.clear();
+    }
+}
+
+//----------------------------------------------------------------------------
+// Only the first timer since the last dispatch needs a notification
+//----------------------------------------------------------------------------
+bool NWTimerQueue::pushExpiredTimer(NWTimerId _timerId, NWTimerCallback * _callback, void * _userData)
+{
+    bool bRet = false;
+
+    if(mInitd)
+    {
+        NWAutoCritSec critSec(mCritSec);
+
+        ExpiredTimer expiredTimer;
+        expiredTimer.mTimerId = _timerId;
+        expiredTimer.mCallback = _callback;
+        expiredTimer.mUserData = _userData;
+
+        bRet = mPendingList.empty();
+        mPendingList.push_back(expiredTimer);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWTimerQueue::notifyTimersAvailable()
+{
+    if(mInitd)
+    {
+        if(mEventTimersAvailable)
+        {
+            mEventTimersAvailable->signal();
+        }
+
+        if(mNotificationCallback)
+        {
+            mNotificationCallback->timerNotification();
+        }
+    }
+}
+
+//****************************************************************************
+// NWTimerService Singleton
+//****************************************************************************
+/*static*/ NWTimerService * NWTimerService::mInstance = NULL;
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ bool NWTimerService::staticInit(int _tickMs/*=eDefault_TickMs*/, int _reserveTimers/*=eDefault_ReserveTimers*/)
+{
+    if(mInstance == NULL)
+    {
+        mInstance = NEW NWTimerService();
+        if(!mInstance->init(_tickMs, _reserveTimers))
+        {
+            DISPOSE(mInstance);
+        }
+    }
+
+    return (mInstance != NULL);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ void NWTimerService::staticShutdown()
+{
+    if(mInstance)
+    {
+        mInstance->shutdown();
+        DISPOSE(mInstance);
+    }
+}
+
+//****************************************************************************
+// NWTimerService class
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWTimerService::NWTimerService() :
+    mInitd(false),
+    mTickMs(eDefault_TickMs),
+    mStartMs(0),
+    mCurrentTick(0),
+    mWakeTick(0),
+    mNumTimers(0),
+    mNumLinked(0),
+    mNumNodes(0),
+    mFreeNodeHead(INVALID_NODE_INDEX),
+    mCritSec(NULL),
+    mNotifyCritSec(NULL),
+    mEventWakeUp(NULL),
+    mThread(NULL)
+{
+    memset(mSlots, 0, sizeof(mSlots));
+    memset(mSlotsBitmap, 0, sizeof(mSlotsBitmap));
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWTimerService::~NWTimerService()
+{
+    shutdown();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWTimerService::init(int _tickMs, int _reserveTimers)
+{
+    bool bRet = false;
+
+    if(!mInitd)
+    {
+        mTickMs = (_tickMs > 0) ? _tickMs : eDefault_TickMs;
+        mStartMs = NWTime::getTimeMs();
+        mCurrentTick = 0;
+        mWakeTick = 0;
+        mNumTimers = 0;
+        mNumLinked = 0;
+
+        mCritSec = NWCriticalSection::create();
+        mNotifyCritSec = NWCriticalSection::create();
+        mEventWakeUp = NWEvent::create();
+
+        mFiredList.reserve(FIRED_LIST_RESERVE);
+        mNotifyList.reserve(QUEUE_LIST_RESERVE);
+
+        {
+            NWAutoCritSec critSec(mCritSec);
+
+            while((int)mNumNodes < _reserveTimers) // preallocate node blocks, they are never released until shutdown
+            {
+                NWTimerNode * node = allocNode();
+                freeNode(node);
+            }
+        }
+
+        mThread = NWThread::create();
+        mThread->start(this, NULL, NWT_PRIORITY_HIGH);
+
+        mInitd = true;
+        bRet = true;
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWTimerService::shutdown()
+{
+    if(mInitd)
+    {
+        NWThread::destroy(mThread);
+
+        int num = (int)mNodeBlocks.size();
+        for(int i=0; i<num; i++)
+        {
+            DISPOSE_ARRAY(mNodeBlocks[i]);
+        }
+        mNodeBlocks.clear();
+        mNumNodes = 0;
+        mFreeNodeHead = INVALID_NODE_INDEX;
+        mNumTimers = 0;
+        mNumLinked = 0;
+
+        memset(mSlots, 0, sizeof(mSlots));
+        memset(mSlotsBitmap, 0, sizeof(mSlotsBitmap));
+
+        mFiredList.clear();
+        mNotifyList.clear();
+
+        NWEvent::destroy(mEventWakeUp);
+        NWCriticalSection::destroy(mNotifyCritSec);
+        NWCriticalSection::destroy(mCritSec);
+
+        mInitd = false;
+    }
+}
+
+//****************************************************************************
+// Timers
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWTimerId NWTimerService::addTimer(int _ms, NWTimerCallback * _callback, void * _userData/*=NULL*/, bool _periodic/*=false*/, NWTimerQueue * _queue/*=NULL*/)
+{
+    ASSERT(_callback);
+
+    NWTimerId timerId = InvalidTimerId;
+
+    if(mInitd && _callback)
+    {
+        bool bWakeUp = false;
+
+        u64 ticks = (_ms > 0) ? ((u64)_ms + mTickMs - 1) / mTickMs : 1;
+        if(ticks > MAX_TIMER_TICKS)
+        {
+            ticks = MAX_TIMER_TICKS;
+        }
+
+        {
+            NWAutoCritSec critSec(mCritSec);
+
+            NWTimerNode * node = allocNode();
+            if(node)
+            {
+                u64 elapsedTicks = getElapsedTicks();
+                if(mNumLinked == 0 && mCurrentTick < elapsedTicks) // the wheel doesn't advance while it is empty
+                {
+                    mCurrentTick = elapsedTicks;
+                }
+
+                node->mExpireTick = elapsedTicks + ticks;
+                node->mPeriodTicks = _periodic ? (u32)ticks : 0;
+                node->mCallback = _callback;
+                node->mUserData = _userData;
+                node->mQueue = _queue;
+                node->mState = NWTNS_PENDING;
+
+                if(_queue)
+                {
+                    node->mQueueNext = _queue->mTimers;
+                    if(_queue->mTimers)
+                    {
+                        _queue->mTimers->mQueuePrev = node;
+                    }
+                    _queue->mTimers = node;
+                }
+
+                linkNode(node);
+                mNumTimers++;
+
+                timerId = node->getTimerId();
+
+                bWakeUp = (node->mExpireTick < mWakeTick);
+            }
+        }
+
+        if(bWakeUp) // timer thread is sleeping past this expiration
+        {
+            mEventWakeUp->signal();
+        }
+    }
+
+    return timerId;
+}
+
+//----------------------------------------------------------------------------
+// Does not wait for a callback already running in other thread
+//----------------------------------------------------------------------------
+bool NWTimerService::removeTimer(NWTimerId _timerId)
+{
+    bool bRet = false;
+
+    if(mInitd && _timerId != InvalidTimerId)
+    {
+        NWAutoCritSec critSec(mCritSec);
+
+        NWTimerNode * node = getNode(_timerId);
+        if(node)
+        {
+            if(node->mState == NWTNS_PENDING)
+            {
+                unlinkNode(node);
+            }
+
+            freeNode(node);
+            mNumTimers--;
+            bRet = true;
+        }
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+// Waits for a notification of the queue in progress, none comes after it
+//----------------------------------------------------------------------------
+void NWTimerService::removeQueueTimers(NWTimerQueue * _queue)
+{
+    if(mInitd && _queue)
+    {
+        NWAutoCritSec notifyCritSec(mNotifyCritSec);
+        NWAutoCritSec critSec(mCritSec);
+
+        while(_queue->mTimers)
+        {
+            NWTimerNode * node = _queue->mTimers;
+            if(node->mState == NWTNS_PENDING)
+            {
+                unlinkNode(node);
+            }
+
+            freeNode(node); // unlinks it from the queue
+            mNumTimers--;
+        }
+
+        int num = (int)mNotifyList.size();
+        for(int i=0; i<num; i++)
+        {
+            if(mNotifyList[i] == _queue)
+            {
+                mNotifyList[i] = NULL;
+            }
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool NWTimerService::isTimerActive(NWTimerId _timerId)
+{
+    bool bRet = false;
+
+    if(mInitd && _timerId != InvalidTimerId)
+    {
+        NWAutoCritSec critSec(mCritSec);
+
+        bRet = (getNode(_timerId) != NULL);
+    }
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int NWTimerService::getNumTimers()
+{
+    NWAutoCritSec critSec(mCritSec);
+
+    return mNumTimers;
+}
+
+//****************************************************************************
+// Node pool
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWTimerNode * NWTimerService::allocNode()
+{
+    NWTimerNode * node = NULL;
+
+    if(mFreeNodeHead == INVALID_NODE_INDEX)
+    {
+        ASSERT(mNumNodes + NODE_BLOCK_SIZE <= TIMER_ID_INDEX_MASK);
+        if(mNumNodes + NODE_BLOCK_SIZE <= TIMER_ID_INDEX_MASK)
+        {
+            NWTimerNode * block = NEW NWTimerNode[NODE_BLOCK_SIZE];
+            mNodeBlocks.push_back(block);
+
+            for(u32 i=NODE_BLOCK_SIZE; i>0; i--) // keep lower indices at the free list head
+            {
+                NWTimerNode * blockNode = &block[i-1];
+                blockNode->mIndex = mNumNodes + i - 1;
+                blockNode->mNextFree = mFreeNodeHead;
+                mFreeNodeHead = blockNode->mIndex;
+            }
+
+            mNumNodes += NODE_BLOCK_SIZE;
+        }
+    }
+
+    if(mFreeNodeHead != INVALID_NODE_INDEX)
+    {
+        node = &mNodeBlocks[mFreeNodeHead >> NODE_BLOCK_BITS][mFreeNodeHead & NODE_BLOCK_MASK];
+        mFreeNodeHead = node->mNextFree;
+        node->mNextFree = INVALID_NODE_INDEX;
+    }
+
+    return node;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWTimerService::freeNode(NWTimerNode * _node)
+{
+    _node->mGeneration++; // invalidates outstanding ids
+    _node->mState = NWTNS_FREE;
+    _node->mCallback = NULL;
+    _node->mUserData = NULL;
+
+    if(_node->mQueue)
+    {
+        if(_node->mQueuePrev)
+        {
+            _node->mQueuePrev->mQueueNext = _node->mQueueNext;
+        }
+        else
+        {
+            _node->mQueue->mTimers = _node->mQueueNext;
+        }
+
+        if(_node->mQueueNext)
+        {
+            _node->mQueueNext->mQueuePrev = _node->mQueuePrev;
+        }
+
+        _node->mQueuePrev = NULL;
+        _node->mQueueNext = NULL;
+        _node->mQueue = NULL;
+    }
+
+    _node->mNextFree = mFreeNodeHead;
+    mFreeNodeHead = _node->mIndex;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+NWTimerNode * NWTimerService::getNode(NWTimerId _timerId)
+{
+    NWTimerNode * node = NULL;
+
+    u32 index = (_timerId & TIMER_ID_INDEX_MASK) - 1;
+    if(index < mNumNodes)
+    {
+        NWTimerNode * candidate = &mNodeBlocks[index >> NODE_BLOCK_BITS][index & NODE_BLOCK_MASK];
+        if(candidate->mState != NWTNS_FREE && candidate->getTimerId() == _timerId)
+        {
+            node = candidate;
+        }
+    }
+
+    return node;
+}
+
+//****************************************************************************
+// Wheel
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWTimerService::linkNode(NWTimerNode * _node)
+{
+    u64 expire = _node->mExpireTick;
+    int level = 0;
+    int slot = 0;
+
+    if(expire < mCurrentTick) // already expired, fire on next tick
+    {
+        slot = (int)(mCurrentTick & WHEEL_SLOT_MASK);
+    }
+    else
+    {
+        u64 delta = expire - mCurrentTick;
+        if(delta > MAX_TIMER_TICKS)
+        {
+            expire = mCurrentTick + MAX_TIMER_TICKS; // re-evaluated when cascading down
+        }
+
+        while(level < WHEEL_LEVELS - 1 && delta >= ((u64)1 << ((level + 1) * WHEEL_SLOT_BITS)))
+        {
+            level++;
+        }
+
+        slot = (int)((expire >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK);
+    }
+
+    _node->mLevel = (u8)level;
+    _node->mSlot = (u16)slot;
+
+    NWTimerNode * head = mSlots[level][slot];
+    if(head)
+    {
+        _node->linkAsPrevOf(head);
+    }
+    mSlots[level][slot] = _node;
+    mSlotsBitmap[level][slot >> 5] |= (1 << (slot & 31));
+
+    mNumLinked++;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void NWTimerService::unlinkNode(NWTimerNode * _node)
+{
+    int level = _node->mLevel;
+    int slot = _node->mSlot;
+
+    if(mSlots[level][slot] == _node)
+    {
+        mSlots[level][slot] = _node->getNext();
+        if(mSlots[level][slot] == NULL)
+        {
+            mSlotsBitmap[level][slot >> 5] &= ~(1 << (slot & 31));
+        }
+    }
+
+    _node->unlink();
+
+    mNumLinked--;
+}
+
+//----------------------------------------------------------------------------
+// Moves every timer of the slot to the lower levels, returns the slot index
+//----------------------------------------------------------------------------
+int NWTimerService::cascade(int _level, int _slot)
+{
+    NWTimerNode * node = mSlots[_level][_slot];
+    mSlots[_level][_slot] = NULL;
+    mSlotsBitmap[_level][_slot >> 5] &= ~(1 << (_slot & 31));
+
+    while(node)
+    {
+        NWTimerNode * next = node->getNext();
+        node->unlink();
+        mNumLinked--;
+        linkNode(node);
+        node = next;
+    }
+
+    return _slot;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+u64 NWTimerService::getElapsedTicks()
+{
+    return (NWTime::getTimeMs() - mStartMs) / mTickMs;
+}
+
+//----------------------------------------------------------------------------
+// Ticks from mCurrentTick to the nearest expiration or cascade,
+// scans the occupancy bitmaps instead of the slots
+//----------------------------------------------------------------------------
+u64 NWTimerService::getTicksToNextExpiration()
+{
+    u64 nextTick = mCurrentTick + MAX_TIMER_TICKS;
+
+    for(int level=0; level<WHEEL_LEVELS; level++)
+    {
+        int shift = level * WHEEL_SLOT_BITS;
+        u64 base = (mCurrentTick + ((u64)1 << shift) - 1) >> shift; // first slot boundary not processed yet
+
+        for(int i=0; i<WHEEL_SLOTS; i++)
+        {
+            int slot = (int)((base + i) & WHEEL_SLOT_MASK);
+
+            if(mSlotsBitmap[level][slot >> 5] == 0)
+            {
+                i += 31 - (slot & 31); // skip the empty word
+                continue;
+            }
+
+            if(mSlotsBitmap[level][slot >> 5] & (1 << (slot & 31)))
+            {
+                u64 tick = (base + i) << shift;
+                if(tick < nextTick)
+                {
+                    nextTick = tick;
+                }
+                break;
+            }
+        }
+    }
+
+    return nextTick - mCurrentTick;
+}
+
+//----------------------------------------------------------------------------
+// Advances the wheel until the current time, expired timers go to their
+// queue or to mFiredList. The queues to notify go to mNotifyList.
+//----------------------------------------------------------------------------
+void NWTimerService::processTicks()
+{
+    u64 elapsedTicks = getElapsedTicks();
+
+    while(mCurrentTick <= elapsedTicks)
+    {
+        if(mNumLinked == 0) // nothing to cascade nor fire, jump ahead
+        {
+            mCurrentTick = elapsedTicks + 1;
+            break;
+        }
+
+        int slot = (int)(mCurrentTick & WHEEL_SLOT_MASK);
+
+        if(slot == 0)
+        {
+            for(int level=1; level<WHEEL_LEVELS; level++)
+            {
+                int levelSlot = (int)((mCurrentTick >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK);
+                if(cascade(level, levelSlot) != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        NWTimerNode * node = mSlots[0][slot];
+        mSlots[0][slot] = NULL;
+        mSlotsBitmap[0][slot >> 5] &= ~(1 << (slot & 31));
+
+        while(node)
+        {
+            NWTimerNode * next = node->getNext();
+            node->unlink();
+            mNumLinked--;
+
+            if(node->mQueue) // delivered while locked, the queue can't be released meanwhile
+            {
+                if(node->mQueue->pushExpiredTimer(node->getTimerId(), node->mCallback, node->mUserData))
+                {
+                    mNotifyList.push_back(node->mQueue);
+                }
+            }
+            else
+            {
+                FiredTimer firedTimer;
+                firedTimer.mTimerId = node->getTimerId();
+                firedTimer.mCallback = node->mCallback;
+                firedTimer.mUserData = node->mUserData;
+                mFiredList.push_back(firedTimer);
+            }
+
+            if(node->mPeriodTicks)
+            {
+                node->mExpireTick += node->mPeriodTicks;
+                if(node->mExpireTick <= mCurrentTick) // we are late, don't try to catch up
+                {
+                    node->mExpireTick = mCurrentTick + node->mPeriodTicks;
+                }
+                linkNode(node);
+            }
+            else
+            {
+                node->mState = NWTNS_FIRED;
+            }
+
+            node = next;
+        }
+
+        mCurrentTick++;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Validates the timer before invoking its callback, releases fired one shots
+//----------------------------------------------------------------------------
+bool NWTimerService::beginTimerCallback(NWTimerId _timerId)
+{
+    bool bRet = false;
+
+    NWAutoCritSec critSec(mCritSec);
+
+    NWTimerNode * node = getNode(_timerId);
+    if(node)
+    {
+        if(node->mState == NWTNS_FIRED)
+        {
+            freeNode(node);
+            mNumTimers--;
+        }
+        bRet = true;
+    }
+
+    return bRet;
+}
+
+//****************************************************************************
+// Timer Thread Main Fn
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ unsigned int NWTimerService::threadMain(ThreadParams const * _params)
+{
+    enum eTimerThreadEvents
+    {
+        TTE_WAKE_UP = 0,
+        TTE_END_REQUEST
+    };
+
+    NWMultipleEvents multipleEventWait(mEventWakeUp, _params->mEventEndRequest);
+
+    std::vector<FiredTimer> firedList;
+    firedList.reserve(FIRED_LIST_RESERVE);
+
+    bool bLoop = true;
+    while(bLoop)
+    {
+        unsigned int waitMs = NWME_INFINITE;
+
+        {
+            NWAutoCritSec notifyCritSec(mNotifyCritSec);
+
+            {
+                NWAutoCritSec critSec(mCritSec);
+
+                processTicks();
+                firedList.swap(mFiredList);
+
+                if(mNumLinked > 0)
+                {
+                    u64 ticks = getTicksToNextExpiration();
+                    mWakeTick = mCurrentTick + ticks;
+
+                    u64 nowMs = NWTime::getTimeMs() - mStartMs;
+                    u64 wakeMs = mWakeTick * mTickMs;
+                    waitMs = (wakeMs > nowMs) ? (unsigned int)(wakeMs - nowMs) : 0;
+                }
+                else
+                {
+                    mWakeTick = 0xffffffffffffffff;
+                }
+            }
+
+            int num = (int)mNotifyList.size(); // out of the service lock, the notifications may add or remove timers
+            for(int i=0; i<num; i++)
+            {
+                if(mNotifyList[i]) // NULL if its queue was released meanwhile
+                {
+                    mNotifyList[i]->notifyTimersAvailable();
+                }
+            }
+            mNotifyList.clear();
+        }
+
+        int num = (int)firedList.size(); // callbacks run outside the lock, they may add or remove timers
+        for(int i=0; i<num; i++)
+        {
+            FiredTimer & firedTimer = firedList[i];
+
+            if(beginTimerCallback(firedTimer.mTimerId))
+            {
+                firedTimer.mCallback->onTimer(firedTimer.mTimerId, firedTimer.mUserData);
+            }
+        }
+        firedList.clear();
+
+        if(waitMs > 0)
+        {
+            int eventSignaled = multipleEventWait.waitForSignal(waitMs);
+            if(eventSignaled == TTE_END_REQUEST)
+            {
+                bLoop = false;
+            }
+        }
+        else if(_params->mEventEndRequest->isSignaled())
+        {
+            bLoop = false;
+        }
+    }
+
+    return 0;
+}
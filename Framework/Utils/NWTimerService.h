@@ -0,0 +1,225 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _INCREW_TIMER_SERVICE_H_
+#define _INCREW_TIMER_SERVICE_H_
+
+#include "NWThread.h"
+#include "NWTypes.h"
+#include "NWSLink.h"
+
+#include <vector>
+
+class NWEvent;
+class NWCriticalSection;
+class NWTimerQueue;
+struct NWTimerNode;
+
+//****************************************************************************
+//
+//****************************************************************************
+typedef u32 NWTimerId;
+
+enum
+{
+    InvalidTimerId = 0
+};
+
+class NWTimerCallback
+{
+public:
+    virtual void onTimer(NWTimerId _timerId, void * _userData) = 0;
+};
+
+class NWTimerNotificationCallback
+{
+public:
+    virtual void timerNotification() = 0;
+};
+
+//****************************************************************************
+// Expired timers waiting to be dispatched by the thread that owns the queue.
+// The event and the notification callback are signaled by the timer thread
+// out of the service lock, done() waits for a notification in progress.
+//****************************************************************************
+class NWTimerQueue
+{
+public:
+    NWTimerQueue();
+    ~NWTimerQueue();
+
+    bool init(NWEvent * _eventTimersAvailable, NWTimerNotificationCallback * _notificationCallback=NULL);
+    void done();
+
+    inline void setNotificationCallback(NWTimerNotificationCallback * _notificationCallback);
+
+    bool timersAvailable();
+    void dispatchExpiredTimers();
+
+private:
+    friend class NWTimerService;
+
+    struct ExpiredTimer
+    {
+        NWTimerId mTimerId;
+        NWTimerCallback * mCallback;
+        void * mUserData;
+    };
+
+    bool mInitd;
+    NWCriticalSection * mCritSec;
+    std::vector<ExpiredTimer> mPendingList;
+    std::vector<ExpiredTimer> mDispatchList;
+    NWEvent * mEventTimersAvailable;
+    NWTimerNotificationCallback * mNotificationCallback;
+    NWTimerNode * mTimers; // its timers, guarded by the service lock
+
+    bool pushExpiredTimer(NWTimerId _timerId, NWTimerCallback * _callback, void * _userData); // called from the timer thread, true if it has to be notified
+    void notifyTimersAvailable(); // called from the timer thread
+};
+
+inline void NWTimerQueue::setNotificationCallback(NWTimerNotificationCallback * _notificationCallback)
+{
+    mNotificationCallback = _notificationCallback;
+}
+
+//****************************************************************************
+// Hierarchical timer wheel
+//  - schedule / cancel are O(1), expiration is amortized O(1) per timer
+//  - callbacks run on the timer thread unless a NWTimerQueue is supplied,
+//    in that case they run on the thread calling dispatchExpiredTimers()
+//****************************************************************************
+class NWTimerService : public NWThreadFn
+{
+public:
+    enum eDefaults
+    {
+        eDefault_TickMs = 1,
+        eDefault_ReserveTimers = 1024
+    };
+
+    // singleton management
+    static bool staticInit(int _tickMs=eDefault_TickMs, int _reserveTimers=eDefault_ReserveTimers);
+    static void staticShutdown();
+    static inline NWTimerService * instance();
+
+    NWTimerId addTimer(int _ms, NWTimerCallback * _callback, void * _userData=NULL, bool _periodic=false, NWTimerQueue * _queue=NULL);
+    bool removeTimer(NWTimerId _timerId);
+    void removeQueueTimers(NWTimerQueue * _queue);
+
+    bool isTimerActive(NWTimerId _timerId);
+    int getNumTimers();
+
+protected:
+    virtual unsigned int threadMain(ThreadParams const * _params); // timer thread entry point
+
+private:
+    friend class NWTimerQueue;
+
+    enum eWheelDefs
+    {
+        WHEEL_LEVELS = 4,
+        WHEEL_SLOT_BITS = 8,
+        WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS,
+        WHEEL_SLOT_MASK = WHEEL_SLOTS - 1,
+        WHEEL_BITMAP_WORDS = WHEEL_SLOTS / 32
+    };
+
+    struct FiredTimer
+    {
+        NWTimerId mTimerId;
+        NWTimerCallback * mCallback;
+        void * mUserData;
+    };
+
+    static NWTimerService * mInstance;
+
+    bool mInitd;
+    int mTickMs;
+    u64 mStartMs;
+    u64 mCurrentTick; // next tick to be processed
+    u64 mWakeTick; // tick the timer thread is sleeping until
+    int mNumTimers;
+    int mNumLinked; // timers in the wheel, the fired ones not dispatched yet aren't
+
+    NWTimerNode * mSlots[WHEEL_LEVELS][WHEEL_SLOTS];
+    u32 mSlotsBitmap[WHEEL_LEVELS][WHEEL_BITMAP_WORDS];
+
+    std::vector<NWTimerNode *> mNodeBlocks;
+    u32 mNumNodes;
+    u32 mFreeNodeHead;
+
+    std::vector<FiredTimer> mFiredList;
+    std::vector<NWTimerQueue *> mNotifyList; // guarded by mNotifyCritSec
+
+    NWCriticalSection * mCritSec;
+    NWCriticalSection * mNotifyCritSec; // taken before mCritSec, held while the queues are notified
+    NWEvent * mEventWakeUp;
+    NWThread * mThread;
+
+    NWTimerService();
+    virtual ~NWTimerService();
+
+    bool init(int _tickMs, int _reserveTimers);
+    void shutdown();
+
+    NWTimerNode * allocNode();
+    void freeNode(NWTimerNode * _node);
+    NWTimerNode * getNode(NWTimerId _timerId);
+
+    void linkNode(NWTimerNode * _node);
+    void unlinkNode(NWTimerNode * _node);
+    int cascade(int _level, int _slot);
+
+    u64 getElapsedTicks();
+    u64 getTicksToNextExpiration();
+    void processTicks();
+    bool beginTimerCallback(NWTimerId _timerId);
+};
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ inline NWTimerService * NWTimerService::instance()
+{
+    return mInstance;
+}
+
+#endif // _INCREW_TIMER_SERVICE_H_
@@ -50,7 +50,12 @@ typedef unsigned short u16;
 typedef int s32;
 typedef unsigned int u32;
 
-typedef __int64 s64;
-typedef unsigned __int64 u64;
+#if defined(_MSC_VER)
+    typedef __int64 s64;
+    typedef unsigned __int64 u64;
+#else
+    typedef long long s64;
+    typedef unsigned long long u64;
+#endif
 
 #endif // _INCREW_TYPES_H_
@@ -134,7 +134,7 @@ void FormMain::done()
     }
 }
 
-/*virtual*/ void FormMain::receiveEventMsg(int _eventType, MemBufferRef * _eventData)
+/*virtual*/ void FormMain::receiveEventMsg(int _eventType, MemBufferRef const * _eventData)
 {
     MemorySerializerIn serializerIn; // move this to sender and pass as parameter instead the MemBuffer
     serializerIn.setBuffer(_eventData->getPtr(), _eventData->getSize());
@@ -63,7 +63,7 @@ public:
     virtual bool          init        (GUI* _gui, const char* _name, GUIControl* _parent, const char* _fileName, const char* _context, NWSvcDataServer * _dataProvider);
     virtual void          done        ();
 
-    virtual void receiveEventMsg(int _eventType, MemBufferRef * _eventData);
+    virtual void receiveEventMsg(int _eventType, MemBufferRef const * _eventData);
     virtual void dataListEvent(StrId _contextName, StrId _objName, int _eventType, int _updatedElementIndex, int _objUniqueId);
 
 private:
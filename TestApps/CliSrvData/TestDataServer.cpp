@@ -128,7 +128,7 @@ void TestDataServer::shutdown()
     }
 }
 
-/*virtual*/ void TestDataServer::receiveEventMsg(int _eventType, MemBufferRef * _eventData)
+/*virtual*/ void TestDataServer::receiveEventMsg(int _eventType, MemBufferRef const * _eventData)
 {
     MemorySerializerIn serializerIn; // move this to sender and pass as parameter instead the MemBuffer
     serializerIn.setBuffer(_eventData->getPtr(), _eventData->getSize());
@@ -112,7 +112,7 @@ public:
     bool init(NWSvcDataServer * _svrDataService);
     void shutdown();
 
-    virtual void receiveEventMsg(int _eventType, MemBufferRef * _eventData);
+    virtual void receiveEventMsg(int _eventType, MemBufferRef const * _eventData);
 
 private:
     bool mInitd;
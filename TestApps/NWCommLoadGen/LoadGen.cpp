@@ -0,0 +1,601 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchLoadGen.h"
+
+#include "LoadGen.h"
+#include "LoadGenServer.h"
+#include "NWCommServer.h"
+#include "NWEvent.h"
+#include "NWIP.h"
+#include "NWLz.h"
+#include "NWTime.h"
+#include "MemBufferRef.h"
+
+#include <cstring>
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+LoadGenOptions::LoadGenOptions() :
+    mMode(LoadGenMode_Both),
+    mHost("127.0.0.1"),
+    mPort(0),
+    mLocalPath(NULL),
+    mBackend(NWSOCKET_BACKEND_DEFAULT),
+    mClientBackend(NWSOCKET_BACKEND_EPOLL),
+    mReactors(1),
+    mNumClients(1000),
+    mConnectTimeoutMs(30000),
+    mDurationMs(10000),
+    mRate(10),
+    mPingWeight(10),
+    mSetWeight(80),
+    mSubscribeWeight(10),
+    mStormIntervalMs(0),
+    mValueSize(64),
+    mNumValues(1000),
+    mBroadcast(false),
+    mCompressMinSize(0),
+    mCodecBenchMs(500)
+{
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+LoadGen::LoadGen() :
+    mWakeEvent(NULL),
+    mServer(NULL),
+    mNextClient(0),
+    mRandSeed(1),
+    mConnected(0),
+    mConnectFailed(0),
+    mDisconnected(0),
+    mLastConnectNs(0),
+    mSentBytes(0),
+    mReceivedBytes(0),
+    mLagged(0),
+    mSnapshotBytes(0)
+{
+    for(int i=0; i<Kind_Num; i++)
+    {
+        mKinds[i].mSent = 0;
+        mKinds[i].mReceived = 0;
+    }
+}
+
+LoadGen::~LoadGen()
+{
+    ASSERT(!mServer && mClients.empty());
+}
+
+//----------------------------------------------------------------------------
+// True if every client connected and stayed connected
+//----------------------------------------------------------------------------
+bool LoadGen::run(LoadGenOptions const & _options, FILE * _out)
+{
+    bool bRet = false;
+
+    mOptions = _options;
+    mWakeEvent = NWEvent::create(false, false, 0);
+
+    NWCommManager * commManager = NWCommManager::instance();
+    commManager->setNotificationCallback(this);
+
+    if(mOptions.mMode == LoadGenMode_Clients || startServer())
+    {
+        u64 connectNs = 0;
+        u64 runNs = 0;
+
+        if(mOptions.mMode == LoadGenMode_Server)
+        {
+            u64 startNs = NWTime::getTimeNs();
+            while(NWTime::getTimeNs() - startNs < (u64)mOptions.mDurationMs * 1000000)
+            {
+                dispatch(WaitMs);
+            }
+            runNs = NWTime::getTimeNs() - startNs;
+            bRet = true;
+        }
+        else
+        {
+            bRet = connectClients(connectNs);
+            runNs = drive();
+            drain();
+            bRet = bRet && mDisconnected == 0;
+        }
+
+        writeReport(_out, connectNs, runNs, bRet);
+
+        destroyClients();
+        if(mServer)
+        {
+            mServer->done();
+            DISPOSE(mServer);
+        }
+    }
+
+    commManager->setNotificationCallback(NULL);
+    NWEvent::destroy(mWakeEvent);
+
+    return bRet;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+u32 LoadGen::nextRand()
+{
+    mRandSeed = mRandSeed * 1103515245 + 12345;
+    return mRandSeed >> 8;
+}
+
+void LoadGen::dispatch(int _waitMs)
+{
+    mWakeEvent->waitForSignal(_waitMs);
+    NWCommManager::instance()->dispatchNetworkMessages();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool LoadGen::startServer()
+{
+    mServer = NEW LoadGenServer();
+    if(!mServer->init(mOptions.mPort, mOptions.mLocalPath, mOptions.mNumValues, mOptions.mBroadcast, mOptions.mCompressMinSize))
+    {
+        LOG("LoadGen: the server can't listen");
+        DISPOSE(mServer);
+    }
+
+    return mServer != NULL;
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+// All the clients start connecting at once, the setup rate counts until the
+// last one is in. False if some didn't make it before the timeout
+//----------------------------------------------------------------------------
+bool LoadGen::connectClients(u64 & out_connectNs)
+{
+    NWCommManager * commManager = NWCommManager::instance();
+    int port = mServer ? mServer->getServerPort() : mOptions.mPort;
+    commManager->setSocketBackend((eNWSocketBackend)mOptions.mClientBackend);
+
+    u64 startNs = NWTime::getTimeNs();
+    mClients.reserve(mOptions.mNumClients);
+    for(int i=0; i<mOptions.mNumClients; i++)
+    {
+        Client * client = NEW Client();
+        client->mOwner = this;
+        client->mConnectStartNs = NWTime::getTimeNs();
+        client->mConnected = false;
+        client->mSocket = mOptions.mLocalPath ? commManager->createClient(mOptions.mLocalPath) : commManager->createClient(NWIP(mOptions.mHost), port);
+        if(client->mSocket->isInitd())
+        {
+            client->mSocket->addListener(client);
+            if(mOptions.mCompressMinSize > 0)
+            {
+                client->mSocket->setCompression(mOptions.mCompressMinSize);
+            }
+        }
+        else
+        {
+            mConnectFailed++;
+        }
+        mClients.push_back(client);
+
+        if((i & 63) == 0)
+        {
+            dispatch(0);
+        }
+    }
+
+    while(mConnected + mConnectFailed < mOptions.mNumClients && NWTime::getTimeNs() - startNs < (u64)mOptions.mConnectTimeoutMs * 1000000)
+    {
+        dispatch(WaitMs);
+    }
+
+    out_connectNs = (mConnected > 0 ? mLastConnectNs : NWTime::getTimeNs()) - startNs;
+
+    return mConnected == mOptions.mNumClients;
+}
+
+//----------------------------------------------------------------------------
+// The sends are spread over the run at the rate asked for, those the loop
+// couldn't keep up with are counted in mLagged
+//----------------------------------------------------------------------------
+u64 LoadGen::drive()
+{
+    double msgsPerNs = (double)mOptions.mRate * (double)mOptions.mNumClients / 1e9;
+    s64 sent = 0;
+    s64 due = 0;
+
+    u64 startNs = NWTime::getTimeNs();
+    u64 nextStormNs = startNs + (u64)mOptions.mStormIntervalMs * 1000000;
+    u64 nowNs = startNs;
+    while(nowNs - startNs < (u64)mOptions.mDurationMs * 1000000 && mConnected > mDisconnected)
+    {
+        dispatch(WaitMs);
+
+        nowNs = NWTime::getTimeNs();
+        due = (s64)((double)(nowNs - startNs) * msgsPerNs);
+        for(int budget=MaxSendsPerTick; sent < due && budget > 0; budget--)
+        {
+            Client * client = NULL;
+            for(int i=0; !client && i<(int)mClients.size(); i++)
+            {
+                Client * next = mClients[mNextClient];
+                mNextClient = (mNextClient + 1) % (int)mClients.size();
+                if(next->mConnected)
+                {
+                    client = next;
+                }
+            }
+
+            if(client)
+            {
+                sendMsg(client);
+            }
+            sent++;
+        }
+
+        if(mOptions.mStormIntervalMs > 0 && nowNs >= nextStormNs)
+        {
+            for(int i=0; i<(int)mClients.size(); i++)
+            {
+                if(mClients[i]->mConnected)
+                {
+                    subscribe(mClients[i]);
+                }
+            }
+            nextStormNs += (u64)mOptions.mStormIntervalMs * 1000000;
+        }
+    }
+
+    mLagged = (int)(due - sent);
+
+    return nowNs - startNs;
+}
+
+//----------------------------------------------------------------------------
+// Until every question got its answer, the updates aren't waited for
+//----------------------------------------------------------------------------
+void LoadGen::drain()
+{
+    u64 startNs = NWTime::getTimeNs();
+    bool pending = true;
+    while(pending && NWTime::getTimeNs() - startNs < (u64)DrainMs * 1000000)
+    {
+        dispatch(WaitMs);
+
+        pending = false;
+        for(int i=Kind_Ping; i<Kind_Update; i++)
+        {
+            pending = pending || mKinds[i].mReceived < mKinds[i].mSent;
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void LoadGen::sendMsg(Client * _client)
+{
+    int totalWeight = mOptions.mPingWeight + mOptions.mSetWeight + mOptions.mSubscribeWeight;
+    int pick = totalWeight > 0 ? (int)(nextRand() % (u32)totalWeight) : 0;
+
+    if(pick < mOptions.mPingWeight)
+    {
+        if(_client->mSocket->ping())
+        {
+            mKinds[Kind_Ping].mSent++;
+        }
+    }
+    else if(pick < mOptions.mPingWeight + mOptions.mSetWeight)
+    {
+        int size = mOptions.mValueSize > (int)sizeof(sLoadGenValue) ? mOptions.mValueSize : (int)sizeof(sLoadGenValue);
+        mValueBuff.resize(size, 0);
+
+        sLoadGenValue value;
+        value.mKey = nextRand();
+        value.mValue = nextRand();
+        value.mSendNs = NWTime::getTimeNs();
+        memcpy(&mValueBuff[0], &value, sizeof(value));
+
+        if(_client->mSocket->send(NWCommServer::eMsgType_User + LoadGenMsg_SetValue, &mValueBuff[0], size))
+        {
+            mKinds[Kind_SetValue].mSent++;
+            mSentBytes += size;
+        }
+    }
+    else
+    {
+        subscribe(_client);
+    }
+}
+
+void LoadGen::subscribe(Client * _client)
+{
+    u64 nowNs = NWTime::getTimeNs();
+    if(_client->mSocket->send(NWCommServer::eMsgType_User + LoadGenMsg_Subscribe, (unsigned char const *)NULL, 0))
+    {
+        _client->mSubscribeNs.push_back(nowNs);
+        mKinds[Kind_Subscribe].mSent++;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void LoadGen::destroyClients()
+{
+    NWCommManager * commManager = NWCommManager::instance();
+    for(int i=0; i<(int)mClients.size(); i++)
+    {
+        commManager->destroyClient(mClients[i]->mSocket);
+        DISPOSE(mClients[i]);
+    }
+    mClients.clear();
+}
+
+//----------------------------------------------------------------------------
+// The answers carry the time of their question
+//----------------------------------------------------------------------------
+void LoadGen::onClientData(Client * _client, int _msgType, MemBufferRef * _memBuff)
+{
+    u64 nowNs = NWTime::getTimeNs();
+    mReceivedBytes += _memBuff->getSize();
+
+    int kind = -1;
+    u64 sendNs = nowNs;
+    switch(_msgType - NWCommServer::eMsgType_User)
+    {
+        case LoadGenMsg_SetValueAck:
+        case LoadGenMsg_Update:
+            if(_memBuff->getSize() >= (int)sizeof(sLoadGenValue))
+            {
+                sLoadGenValue value;
+                memcpy(&value, _memBuff->getPtr(), sizeof(value));
+                sendNs = value.mSendNs;
+                kind = (_msgType - NWCommServer::eMsgType_User == LoadGenMsg_Update) ? Kind_Update : Kind_SetValue;
+            }
+            break;
+
+        case LoadGenMsg_Snapshot:
+            if(!_client->mSubscribeNs.empty())
+            {
+                sendNs = _client->mSubscribeNs.front();
+                _client->mSubscribeNs.pop_front();
+                mSnapshotBytes = _memBuff->getSize();
+                kind = Kind_Subscribe;
+            }
+            break;
+    }
+
+    if(kind >= 0)
+    {
+        mKinds[kind].mReceived++;
+        mKinds[kind].mLatency.add(nowNs > sendNs ? (u32)((nowNs - sendNs) / 1000) : 0);
+    }
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+void LoadGen::writeReport(FILE * _out, u64 _connectNs, u64 _runNs, bool _ok)
+{
+    static char const * modeNames[] = { "both", "server", "clients" };
+
+    double runSecs = (double)_runNs / 1e9;
+    double connectSecs = (double)_connectNs / 1e9;
+    int received = 0;
+    int sent = 0;
+    for(int i=0; i<Kind_Num; i++)
+    {
+        received += mKinds[i].mReceived;
+        sent += mKinds[i].mSent;
+    }
+
+    fprintf(_out, "{\n");
+    fprintf(_out, "  \"mode\": \"%s\", \"transport\": \"%s\", \"backend\": %d, \"clientBackend\": %d, \"reactors\": %d,\n", modeNames[mOptions.mMode], mOptions.mLocalPath ? "local" : "tcp", mOptions.mBackend, mOptions.mClientBackend, mOptions.mReactors);
+    fprintf(_out, "  \"valueSize\": %d, \"values\": %d, \"broadcast\": %s, \"compressMinSize\": %d,\n", mOptions.mValueSize, mOptions.mNumValues, mOptions.mBroadcast ? "true" : "false", mOptions.mCompressMinSize);
+
+    if(mOptions.mMode != LoadGenMode_Server)
+    {
+        fprintf(_out, "  \"clients\": %d, \"durationMs\": %d, \"rate\": %d, \"mix\": {\"ping\": %d, \"set\": %d, \"subscribe\": %d}, \"stormIntervalMs\": %d,\n",
+            mOptions.mNumClients, mOptions.mDurationMs, mOptions.mRate, mOptions.mPingWeight, mOptions.mSetWeight, mOptions.mSubscribeWeight, mOptions.mStormIntervalMs);
+        fprintf(_out, "  \"connect\": {\"connected\": %d, \"failed\": %d, \"ms\": %.1f, \"perSec\": %.1f, \"latencyUs\": {\"p50\": %u, \"p99\": %u, \"max\": %u}},\n",
+            mConnected, mConnectFailed, connectSecs * 1000.0, connectSecs > 0.0 ? (double)mConnected / connectSecs : 0.0,
+            mConnectLatency.getPercentile(50.0f), mConnectLatency.getPercentile(99.0f), mConnectLatency.getMax());
+        fprintf(_out, "  \"run\": {\"ms\": %.1f, \"sent\": %d, \"received\": %d, \"lagged\": %d, \"disconnected\": %d, \"sentPerSec\": %.1f, \"receivedPerSec\": %.1f, \"sentBytesPerSec\": %.0f, \"receivedBytesPerSec\": %.0f},\n",
+            runSecs * 1000.0, sent, received, mLagged, mDisconnected, runSecs > 0.0 ? (double)sent / runSecs : 0.0, runSecs > 0.0 ? (double)received / runSecs : 0.0,
+            runSecs > 0.0 ? (double)mSentBytes / runSecs : 0.0, runSecs > 0.0 ? (double)mReceivedBytes / runSecs : 0.0);
+
+        writeLatency(_out, "ping", mKinds[Kind_Ping]);
+        writeLatency(_out, "setValue", mKinds[Kind_SetValue]);
+        writeLatency(_out, "subscribe", mKinds[Kind_Subscribe]);
+        writeLatency(_out, "update", mKinds[Kind_Update]);
+        fprintf(_out, "  \"snapshotBytes\": %d,\n", mSnapshotBytes);
+    }
+
+    if(mServer)
+    {
+        LoadGenServer::Stats const & stats = mServer->getStats();
+        fprintf(_out, "  \"server\": {\"clients\": %d, \"connected\": %d, \"disconnected\": %d, \"setValues\": %d, \"subscribes\": %d, \"snapshots\": %d, \"snapshotBytes\": %d, \"runMs\": %.1f},\n",
+            mServer->getNumClients(), stats.mConnected, stats.mDisconnected, stats.mSetValues, stats.mSubscribes, stats.mSnapshots, stats.mSnapshotBytes, runSecs * 1000.0);
+    }
+
+    if(mOptions.mCodecBenchMs > 0)
+    {
+        writeCodecBench(_out);
+    }
+    fprintf(_out, "  \"ok\": %s\n", _ok ? "true" : "false");
+    fprintf(_out, "}\n");
+    fflush(_out);
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*static*/ void LoadGen::writeLatency(FILE * _out, char const * _name, KindStats const & _stats)
+{
+    NWLatencyHistogram const & latency = _stats.mLatency;
+    fprintf(_out, "  \"%s\": {\"sent\": %d, \"received\": %d, \"latencyUs\": {\"count\": %u, \"p50\": %u, \"p90\": %u, \"p99\": %u, \"p999\": %u, \"max\": %u}},\n",
+        _name, _stats.mSent, _stats.mReceived, latency.getCount(), latency.getPercentile(50.0f), latency.getPercentile(90.0f),
+        latency.getPercentile(99.0f), latency.getPercentile(99.9f), latency.getMax());
+}
+
+//----------------------------------------------------------------------------
+// NWLz on a snapshot of the size of the run, the values are small counters
+// as those of a live table
+//----------------------------------------------------------------------------
+void LoadGen::writeCodecBench(FILE * _out)
+{
+    std::vector<u32> values(mOptions.mNumValues);
+    for(int i=0; i<(int)values.size(); i++)
+    {
+        values[i] = nextRand() % 1000;
+    }
+
+    MemBufferRef snapshot = LoadGenServer::serializeSnapshot(values, 1);
+    std::vector<unsigned char> compressed(NWLz::getMaxCompressedSize(snapshot.getSize()));
+    std::vector<unsigned char> decompressed(snapshot.getSize() + 1);
+
+    int compressedSize = 0;
+    int compressIters = 0;
+    int decompressIters = 0;
+    u64 compressNs = 0;
+    u64 decompressNs = 0;
+    bool bOk = true;
+
+    if(snapshot.getSize() > 0)
+    {
+        u64 budgetNs = (u64)mOptions.mCodecBenchMs * 1000000 / 2;
+        u64 startNs = NWTime::getTimeNs();
+        do
+        {
+            compressedSize = NWLz::compress(snapshot.getPtr(), snapshot.getSize(), &compressed[0], (int)compressed.size());
+            compressIters++;
+            compressNs = NWTime::getTimeNs() - startNs;
+        }
+        while(compressNs < budgetNs);
+
+        startNs = NWTime::getTimeNs();
+        do
+        {
+            bOk = bOk && NWLz::decompress(&compressed[0], compressedSize, &decompressed[0], snapshot.getSize()) == snapshot.getSize();
+            decompressIters++;
+            decompressNs = NWTime::getTimeNs() - startNs;
+        }
+        while(decompressNs < budgetNs);
+
+        bOk = bOk && memcmp(&decompressed[0], snapshot.getPtr(), snapshot.getSize()) == 0;
+    }
+
+    double size = (double)snapshot.getSize();
+    fprintf(_out, "  \"codec\": {\"inputBytes\": %d, \"compressedBytes\": %d, \"ratio\": %.3f, \"compressMBps\": %.1f, \"decompressMBps\": %.1f, \"roundTrip\": %s},\n",
+        snapshot.getSize(), compressedSize, compressedSize > 0 ? size / (double)compressedSize : 0.0,
+        compressNs > 0 ? size * (double)compressIters * 1000.0 / (double)compressNs : 0.0,
+        decompressNs > 0 ? size * (double)decompressIters * 1000.0 / (double)decompressNs : 0.0,
+        bOk ? "true" : "false");
+}
+
+//****************************************************************************
+// Callbacks, in the thread calling run
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ void LoadGen::networkMsgNotification()
+{
+    mWakeEvent->signal();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ void LoadGen::Client::onConnected()
+{
+    u64 nowNs = NWTime::getTimeNs();
+
+    mConnected = true;
+    mOwner->mConnected++;
+    mOwner->mLastConnectNs = nowNs;
+    mOwner->mConnectLatency.add((u32)((nowNs - mConnectStartNs) / 1000));
+}
+
+/*virtual*/ void LoadGen::Client::onDisconnected(int /*_reason*/)
+{
+    if(mConnected)
+    {
+        mOwner->mDisconnected++;
+    }
+    else
+    {
+        mOwner->mConnectFailed++;
+    }
+
+    mConnected = false;
+    mSubscribeNs.clear();
+}
+
+/*virtual*/ void LoadGen::Client::onData(int _msgType, MemBufferRef * _memBuff)
+{
+    mOwner->onClientData(this, _msgType, _memBuff);
+}
+
+/*virtual*/ void LoadGen::Client::onPing(int _us)
+{
+    mOwner->mKinds[Kind_Ping].mReceived++;
+    mOwner->mKinds[Kind_Ping].mLatency.add((u32)_us);
+}
@@ -0,0 +1,190 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef LOAD_GEN_H
+#define LOAD_GEN_H
+
+#include "NWCommSocket.h"
+#include "NWCommManager.h"
+#include "NWLatencyHistogram.h"
+
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+class LoadGenServer;
+class NWEvent;
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+enum eLoadGenMode
+{
+    LoadGenMode_Both = 0,       // the server and the clients in this process
+    LoadGenMode_Server,         // a server for the clients of another process
+    LoadGenMode_Clients         // clients of the server of another process
+};
+
+//----------------------------------------------------------------------------
+// What a run does, see the usage of NWCommLoadGen.cpp
+//----------------------------------------------------------------------------
+struct LoadGenOptions
+{
+    int mMode;                  // eLoadGenMode
+    char const * mHost;
+    int mPort;                  // 0 picks one, LoadGenMode_Both only
+    char const * mLocalPath;    // NULL goes through TCP
+    int mBackend;               // eNWSocketBackend of the server
+    int mClientBackend;         // of the clients, an io_uring reactor sized for a server for each one doesn't scale
+    int mReactors;
+
+    int mNumClients;
+    int mConnectTimeoutMs;
+    int mDurationMs;
+    int mRate;                  // messages a second of every client
+    int mPingWeight;            // the mix of the messages
+    int mSetWeight;
+    int mSubscribeWeight;
+    int mStormIntervalMs;       // every client subscribes at once this often, 0 never
+    int mValueSize;             // bytes of a set
+    int mNumValues;             // in the table of the server, the snapshots grow with it
+    bool mBroadcast;            // the sets go to every client
+    int mCompressMinSize;       // 0 doesn't compress
+    int mCodecBenchMs;          // NWLz on a snapshot, 0 skips it
+
+    LoadGenOptions();
+};
+
+//****************************************************************************
+// Opens the clients, drives the mix of messages at the rate asked for and
+// writes what it measured as a JSON object. Everything runs from the
+// notifications of the comm manager in the calling thread, the sockets do
+// the IO in their own ones.
+//****************************************************************************
+class LoadGen : public NWCommManagerNotificationCallback
+{
+public:
+    LoadGen();
+    ~LoadGen();
+
+    bool run(LoadGenOptions const & _options, FILE * _out);
+
+private:
+    enum eKind
+    {
+        Kind_Ping = 0,
+        Kind_SetValue,
+        Kind_Subscribe,
+        Kind_Update,
+        // ---
+        Kind_Num
+    };
+
+    enum eDefs
+    {
+        MaxSendsPerTick = 4096,     // the dispatch isn't starved when the sends are late
+        DrainMs = 2000,             // waiting for the answers after the run
+        WaitMs = 1
+    };
+
+    struct KindStats
+    {
+        int mSent;
+        int mReceived;
+        NWLatencyHistogram mLatency;
+    };
+
+    struct Client : public IClientSocketListener
+    {
+        LoadGen * mOwner;
+        NWClientSocket * mSocket;
+        u64 mConnectStartNs;
+        bool mConnected;
+        std::deque<u64> mSubscribeNs;   // the snapshots come back in order
+
+        virtual ~Client() {}
+
+        // IClientSocketListener
+        virtual void onConnected();
+        virtual void onDisconnected(int _reason);
+        virtual void onData(int _msgType, MemBufferRef * _memBuff);
+        virtual void onPing(int _us);
+    };
+
+    LoadGenOptions mOptions;
+    NWEvent * mWakeEvent;
+    LoadGenServer * mServer;
+    std::vector<Client *> mClients;
+    int mNextClient;
+    u32 mRandSeed;
+
+    int mConnected;
+    int mConnectFailed;
+    int mDisconnected;
+    u64 mLastConnectNs;
+    NWLatencyHistogram mConnectLatency;
+
+    KindStats mKinds[Kind_Num];
+    s64 mSentBytes;
+    s64 mReceivedBytes;
+    int mLagged;                        // sends the rate asked for that didn't make it
+    int mSnapshotBytes;
+    std::vector<unsigned char> mValueBuff;  // the sets are copied into their frames
+
+    u32 nextRand();
+    void dispatch(int _waitMs);
+    bool startServer();
+    bool connectClients(u64 & out_connectNs);
+    u64 drive();
+    void drain();
+    void sendMsg(Client * _client);
+    void subscribe(Client * _client);
+    void destroyClients();
+    void onClientData(Client * _client, int _msgType, MemBufferRef * _memBuff);
+
+    void writeReport(FILE * _out, u64 _connectNs, u64 _runNs, bool _ok);
+    void writeCodecBench(FILE * _out);
+    static void writeLatency(FILE * _out, char const * _name, KindStats const & _stats);
+
+    // NWCommManagerNotificationCallback
+    virtual void networkMsgNotification();
+};
+
+#endif // LOAD_GEN_H
@@ -0,0 +1,221 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchLoadGen.h"
+
+#include "LoadGenServer.h"
+#include "MemorySerializer.h"
+
+#include <cstdio>
+#include <cstring>
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+LoadGenServer::LoadGenServer() :
+    mInitd(false),
+    mVersion(0),
+    mDirty(true),
+    mBroadcast(false)
+{
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+LoadGenServer::~LoadGenServer()
+{
+    done();
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+bool LoadGenServer::init(int _port, char const * _localPath, int _numValues, bool _broadcast, int _compressMinSize)
+{
+    bool bRet = false;
+
+    if(!mInitd && mServer.init())
+    {
+        mValues.assign(_numValues, 0);
+        mBroadcast = _broadcast;
+
+        mServer.addListener(this);
+        bRet = _localPath ? mServer.start(StrId("LoadGen"), _localPath, 1) : mServer.start(StrId("LoadGen"), _port, 1);
+        if(bRet)
+        {
+            mServer.setCompression(_compressMinSize);
+            mInitd = true;
+        }
+        else
+        {
+            mServer.done();
+        }
+    }
+
+    return bRet;
+}
+
+void LoadGenServer::done()
+{
+    if(mInitd)
+    {
+        mServer.done();
+        mSnapshot = MemBufferRef();
+        mInitd = false;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int LoadGenServer::getServerPort()
+{
+    return mServer.getServerPort();
+}
+
+int LoadGenServer::getNumClients() const
+{
+    return mServer.getNumClients();
+}
+
+//****************************************************************************
+//
+//****************************************************************************
+//----------------------------------------------------------------------------
+// Every value goes as an element of a list would: its index, its name and
+// the value
+//----------------------------------------------------------------------------
+/*static*/ MemBufferRef LoadGenServer::serializeSnapshot(std::vector<u32> const & _values, u32 _version)
+{
+    MemorySerializerOut serializerOut;
+    serializerOut.addUInt(_version);
+    serializerOut.addInt((int)_values.size());
+
+    char name[32];
+    for(int i=0; i<(int)_values.size(); i++)
+    {
+        sprintf(name, "LoadGen.Value%d", i);
+
+        serializerOut.addInt(i);
+        serializerOut.addString(name);
+        serializerOut.addUInt(_values[i]);
+    }
+    serializerOut.finalize();
+
+    std::vector<NWIoVec> vecs;
+    int size = serializerOut.getIoVecs(vecs);
+
+    MemBufferRef memBuff = NWSocket::allocShared(size);
+    unsigned char * dstPtr = memBuff.getPtr();
+    for(int i=0; i<(int)vecs.size(); i++)
+    {
+        memcpy(dstPtr, vecs[i].mPtr, vecs[i].mSize);
+        dstPtr += vecs[i].mSize;
+    }
+
+    return memBuff;
+}
+
+//****************************************************************************
+// IServerListener
+//****************************************************************************
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ bool LoadGenServer::onAccept(NWServerSocket * /*_socket*/)
+{
+    return true;
+}
+
+/*virtual*/ void LoadGenServer::onClientConnected(int /*_clientId*/)
+{
+    mStats.mConnected++;
+}
+
+/*virtual*/ void LoadGenServer::onClientDisconnected(int /*_clientId*/)
+{
+    mStats.mDisconnected++;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+/*virtual*/ void LoadGenServer::onClientData(int _clientIdFrom, int _msgType, MemBufferRef * _memBuff)
+{
+    switch(_msgType)
+    {
+        case LoadGenMsg_SetValue:
+            if(_memBuff->getSize() >= (int)sizeof(sLoadGenValue) && !mValues.empty())
+            {
+                sLoadGenValue value;
+                memcpy(&value, _memBuff->getPtr(), sizeof(value));
+                mValues[value.mKey % mValues.size()] = value.mValue;
+                mDirty = true;
+                mStats.mSetValues++;
+
+                MemBufferRef ack(sizeof(value));
+                memcpy(ack.getPtr(), &value, sizeof(value));
+                mServer.sendMessage(_clientIdFrom, LoadGenMsg_SetValueAck, &ack);
+                if(mBroadcast)
+                {
+                    mServer.sendMessageAll(LoadGenMsg_Update, &ack);
+                }
+            }
+            break;
+
+        case LoadGenMsg_Subscribe:
+            if(mDirty)
+            {
+                mSnapshot = serializeSnapshot(mValues, ++mVersion);
+                mDirty = false;
+                mStats.mSnapshots++;
+                mStats.mSnapshotBytes = mSnapshot.getSize();
+            }
+            mStats.mSubscribes++;
+            mServer.sendMessage(_clientIdFrom, LoadGenMsg_Snapshot, &mSnapshot);
+            break;
+    }
+}
+
+/*virtual*/ void LoadGenServer::onPing(int /*_clientId*/, int /*_us*/)
+{
+}
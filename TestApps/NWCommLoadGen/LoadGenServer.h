@@ -0,0 +1,125 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef LOAD_GEN_SERVER_H
+#define LOAD_GEN_SERVER_H
+
+#include "NWCommServer.h"
+#include "MemBufferRef.h"
+
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Messages between the load generator clients and its server, on top of the
+// eMsgType_User of NWCommServer. Both ends are built from the same sources,
+// the headers go in their native layout.
+//----------------------------------------------------------------------------
+enum eLoadGenMsg
+{
+    LoadGenMsg_SetValue = 0,    // sLoadGenValue and padding up to the value size, answered with LoadGenMsg_SetValueAck
+    LoadGenMsg_SetValueAck,     // the sLoadGenValue of the set
+    LoadGenMsg_Subscribe,       // no payload, answered with LoadGenMsg_Snapshot
+    LoadGenMsg_Snapshot,        // the values serialised as the svc data lists do it, see LoadGenServer::serializeSnapshot
+    LoadGenMsg_Update           // the sLoadGenValue of a set, to every client when the updates are broadcast
+};
+
+#pragma pack(push, 4)
+struct sLoadGenValue
+{
+    u32 mKey;
+    u32 mValue;
+    u64 mSendNs;                // NWTime of the client that set it
+};
+#pragma pack(pop)
+
+//****************************************************************************
+// Keeps a table of values the clients set and subscribe to. A subscription
+// gets the whole table, serialised again only when a value changed since
+// the last one, so a storm of them shares a single buffer.
+//****************************************************************************
+class LoadGenServer : public IServerListener
+{
+public:
+    struct Stats
+    {
+        int mConnected;
+        int mDisconnected;
+        int mSetValues;
+        int mSubscribes;
+        int mSnapshots;         // serialisations of the table
+        int mSnapshotBytes;     // size of the last one
+    };
+
+    LoadGenServer();
+    virtual ~LoadGenServer();
+
+    bool init(int _port, char const * _localPath, int _numValues, bool _broadcast, int _compressMinSize); // _localPath NULL listens on _port
+    void done();
+
+    int getServerPort();
+    int getNumClients() const;
+    inline Stats const & getStats() const;
+
+    static MemBufferRef serializeSnapshot(std::vector<u32> const & _values, u32 _version); // allocShared, local clients map it
+
+private:
+    bool mInitd;
+    NWCommServer mServer;
+    std::vector<u32> mValues;
+    u32 mVersion;
+    bool mDirty;
+    bool mBroadcast;
+    MemBufferRef mSnapshot;
+    Stats mStats;
+
+    // IServerListener
+    virtual bool onAccept(NWServerSocket * _socket);
+    virtual void onClientConnected(int _clientId);
+    virtual void onClientDisconnected(int _clientId);
+    virtual void onClientData(int _clientIdFrom, int _msgType, MemBufferRef * _memBuff);
+    virtual void onPing(int _clientId, int _us);
+};
+
+inline LoadGenServer::Stats const & LoadGenServer::getStats() const
+{
+    return mStats;
+}
+
+#endif // LOAD_GEN_SERVER_H
@@ -0,0 +1,194 @@
+/*       
+*       This file is part of NWFramework.
+*       Copyright (c) InCrew Software and Others.
+*       (See the AUTHORS file in the root of this distribution.)
+*
+*       NWFramework is free software; you can redistribute it and/or modify
+*       it under the terms of the GNU General Public License as published by
+*       the Free Software Foundation; either version 2 of the License, or
+*       (at your option) any later version.
+*
+*       NWFramework is distributed in the hope that it will be useful,
+*       but WITHOUT ANY WARRANTY; without even the implied warranty of
+*       MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*       GNU General Public License for more details.
+* 
+*       You should have received a copy of the GNU General Public License
+*       along with NWFramework; if not, write to the Free Software
+*       Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*
+*      Permission is hereby granted, free of charge, to any person obtaining
+*      a copy of this software and associated documentation files (the
+*      "Software"), to deal in the Software without restriction, including
+*      without limitation the rights to use, copy, modify, merge, publish,
+*      distribute, sublicense, and/or sell copies of the Software, and to
+*      permit persons to whom the Software is furnished to do so, subject to
+*      the following conditions:
+*
+*      The above copyright notice and this permission notice shall be
+*      included in all copies or substantial portions of the Software.
+*
+*      THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+*      EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+*      MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+*      NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+*      LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+*      OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+*      WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "PchLoadGen.h"
+
+#include "LoadGen.h"
+#include "NWCommManager.h"
+#include "NWTimerService.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+//****************************************************************************
+// Headless load generator for NWCommServer. Opens the clients over loopback
+// (or a local socket), drives a mix of pings, sets and subscriptions and
+// writes a JSON object with the connection setup rate, the throughput and
+// the latency percentiles. The exit code is 0 if every client connected and
+// stayed connected.
+//****************************************************************************
+static char const * USAGE =
+    "NWCommLoadGen [options]\n"
+    "  -mode both|server|clients  the server, the clients or both in this process (both)\n"
+    "  -host ip                   server of -mode clients (127.0.0.1)\n"
+    "  -port n                    0 picks a free one with -mode both (0)\n"
+    "  -local path                local socket instead of TCP, '@' starts an abstract name\n"
+    "  -backend name              default|epoll|uring, of the server (default)\n"
+    "  -clientBackend name        default|epoll|uring, of the clients (epoll)\n"
+    "  -reactors n                reactor threads of the server (1)\n"
+    "  -clients n                 (1000)\n"
+    "  -connectTimeout ms         (30000)\n"
+    "  -duration ms               (10000)\n"
+    "  -rate n                    messages a second of every client (10)\n"
+    "  -mix ping,set,subscribe    weights of the messages (10,80,10)\n"
+    "  -storm ms                  every client subscribes at once this often (0, never)\n"
+    "  -valueSize n               bytes of a set (64)\n"
+    "  -values n                  values of the server, the snapshots grow with them (1000)\n"
+    "  -broadcast                 every set goes to every client\n"
+    "  -compress n                payloads this big go compressed (0, never)\n"
+    "  -codecBench ms             NWLz on a snapshot (500, 0 skips it)\n"
+    "  -out file                  the report, stdout if not given\n";
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+static bool parseBackend(char const * _value, int & out_backend)
+{
+    out_backend = strcmp(_value, "epoll") == 0 ? NWSOCKET_BACKEND_EPOLL : (strcmp(_value, "uring") == 0 ? NWSOCKET_BACKEND_URING : NWSOCKET_BACKEND_DEFAULT);
+    return out_backend != NWSOCKET_BACKEND_DEFAULT || strcmp(_value, "default") == 0;
+}
+
+//----------------------------------------------------------------------------
+// False if an option isn't known or lacks its value
+//----------------------------------------------------------------------------
+static bool parseArgs(int _argc, char * _argv[], LoadGenOptions & out_options, char const * & out_outPath)
+{
+    bool bRet = true;
+
+    for(int i=1; bRet && i<_argc; i++)
+    {
+        char const * arg = _argv[i];
+        char const * value = (i + 1 < _argc) ? _argv[i + 1] : NULL;
+
+        if(strcmp(arg, "-broadcast") == 0)
+        {
+            out_options.mBroadcast = true;
+            continue;
+        }
+
+        if(!value)
+        {
+            bRet = false;
+        }
+        else if(strcmp(arg, "-mode") == 0)
+        {
+            out_options.mMode = strcmp(value, "server") == 0 ? LoadGenMode_Server : (strcmp(value, "clients") == 0 ? LoadGenMode_Clients : LoadGenMode_Both);
+            bRet = out_options.mMode != LoadGenMode_Both || strcmp(value, "both") == 0;
+        }
+        else if(strcmp(arg, "-backend") == 0)
+        {
+            bRet = parseBackend(value, out_options.mBackend);
+        }
+        else if(strcmp(arg, "-clientBackend") == 0)
+        {
+            bRet = parseBackend(value, out_options.mClientBackend);
+        }
+        else if(strcmp(arg, "-mix") == 0)
+        {
+            bRet = sscanf(value, "%d,%d,%d", &out_options.mPingWeight, &out_options.mSetWeight, &out_options.mSubscribeWeight) == 3;
+        }
+        else if(strcmp(arg, "-host") == 0)              out_options.mHost = value;
+        else if(strcmp(arg, "-local") == 0)             out_options.mLocalPath = value;
+        else if(strcmp(arg, "-out") == 0)               out_outPath = value;
+        else if(strcmp(arg, "-port") == 0)              out_options.mPort = atoi(value);
+        else if(strcmp(arg, "-reactors") == 0)          out_options.mReactors = atoi(value);
+        else if(strcmp(arg, "-clients") == 0)           out_options.mNumClients = atoi(value);
+        else if(strcmp(arg, "-connectTimeout") == 0)    out_options.mConnectTimeoutMs = atoi(value);
+        else if(strcmp(arg, "-duration") == 0)          out_options.mDurationMs = atoi(value);
+        else if(strcmp(arg, "-rate") == 0)              out_options.mRate = atoi(value);
+        else if(strcmp(arg, "-storm") == 0)             out_options.mStormIntervalMs = atoi(value);
+        else if(strcmp(arg, "-valueSize") == 0)         out_options.mValueSize = atoi(value);
+        else if(strcmp(arg, "-values") == 0)            out_options.mNumValues = atoi(value);
+        else if(strcmp(arg, "-compress") == 0)          out_options.mCompressMinSize = atoi(value);
+        else if(strcmp(arg, "-codecBench") == 0)        out_options.mCodecBenchMs = atoi(value);
+        else
+        {
+            bRet = false;
+        }
+        i++;
+    }
+
+    return bRet && out_options.mNumClients >= 0 && out_options.mReactors > 0 && out_options.mRate >= 0;
+}
+
+//----------------------------------------------------------------------------
+//
+//----------------------------------------------------------------------------
+int main(int _argc, char * _argv[])
+{
+    int iRet = 1;
+
+    LoadGenOptions options;
+    char const * outPath = NULL;
+    if(!parseArgs(_argc, _argv, options, outPath))
+    {
+        fprintf(stderr, "%s", USAGE);
+        return 2;
+    }
+
+    FILE * out = outPath ? fopen(outPath, "w") : stdout;
+    if(!out)
+    {
+        fprintf(stderr, "Can't write %s\n", outPath);
+        return 2;
+    }
+
+    Utils::init(false);
+    NWTimerService::staticInit();
+    NWCommManager::staticInit(NWCommManager::eReserve_Servers, options.mNumClients + NWCommManager::eReserve_Clients, (eNWSocketBackend)options.mBackend, options.mReactors);
+
+    LoadGen loadGen;
+    if(loadGen.run(options, out))
+    {
+        iRet = 0;
+    }
+
+    NWCommManager::staticShutdown();
+    NWTimerService::staticShutdown();
+    Utils::done();
+
+    if(out != stdout)
+    {
+        fclose(out);
+    }
+
+    return iRet;
+}